@@ -0,0 +1,312 @@
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <malloc.h>
+#elif defined(__GLIBC__)
+#include <execinfo.h>
+#include <malloc.h>
+#define ALLOCATION_BACKTRACE
+#elif defined(__APPLE__)
+#include <execinfo.h>
+#include <malloc/malloc.h>
+#define ALLOCATION_BACKTRACE
+#endif
+
+// Set while the tracker itself runs on this thread, so what it allocates (backtrace loading
+// its unwinder) is neither counted nor recorded.
+static thread_local bool t_inTracker = false;
+
+AllocationCounts FrameAllocations::total() const {
+	AllocationCounts total;
+	for (auto& phase : phases) {
+		total.allocations += phase.allocations;
+		total.frees += phase.frees;
+		total.bytes += phase.bytes;
+	}
+	return total;
+}
+
+AllocationTracker& AllocationTracker::current() {
+	static AllocationTracker tracker;
+	return tracker;
+}
+
+void AllocationTracker::enable(SteadyStatePolicy policy, bool recordStacks) {
+	m_inFrame = false;
+	m_policy = policy;
+	m_recordStacks = recordStacks;
+	m_phaseCount = 0;
+	m_siteCount = 0;
+	m_unrecorded = 0;
+	m_enabled = true;
+}
+
+void AllocationTracker::disable() {
+	m_inFrame = false;
+	m_enabled = false;
+}
+
+void AllocationTracker::beginFrame(bool steadyState) {
+	if (!enabled()) {
+		return;
+	}
+	for (size_t i = 0; i < MAX_ALLOCATION_PHASES; i++) {
+		m_allocations[i] = 0;
+		m_frees[i] = 0;
+		m_bytes[i] = 0;
+	}
+	m_heapGrowth = 0;
+	m_peakHeapGrowth = 0;
+	m_phase = 0;
+	m_steadyState = steadyState;
+	m_inFrame = true;
+}
+
+void AllocationTracker::phase(const char* name) {
+	size_t index = 0;
+	while (index < m_phaseCount && std::strcmp(m_phaseNames[index], name) != 0) {
+		index++;
+	}
+	if (index == m_phaseCount) {
+		if (m_phaseCount == MAX_ALLOCATION_PHASES) {
+			index = MAX_ALLOCATION_PHASES - 1;
+		}
+		else {
+			m_phaseNames[m_phaseCount++] = name;
+		}
+	}
+	m_phase = index;
+}
+
+FrameAllocations AllocationTracker::endFrame() {
+	m_inFrame = false;
+	FrameAllocations frame;
+	frame.steadyState = m_steadyState;
+	for (size_t i = 0; i < MAX_ALLOCATION_PHASES; i++) {
+		frame.phases[i].allocations = m_allocations[i];
+		frame.phases[i].frees = m_frees[i];
+		frame.phases[i].bytes = m_bytes[i];
+	}
+	frame.peakHeapGrowth = static_cast<uint64_t>(std::max<int64_t>(m_peakHeapGrowth, 0));
+	return frame;
+}
+
+void AllocationTracker::allocated(size_t bytes, size_t heapBytes) {
+	if (!counting() || t_inTracker) {
+		return;
+	}
+	size_t phase = m_phase.load(std::memory_order_relaxed);
+	m_allocations[phase].fetch_add(1, std::memory_order_relaxed);
+	m_bytes[phase].fetch_add(bytes, std::memory_order_relaxed);
+	int64_t growth = m_heapGrowth.fetch_add(static_cast<int64_t>(heapBytes), std::memory_order_relaxed)
+		+ static_cast<int64_t>(heapBytes);
+	int64_t peak = m_peakHeapGrowth.load(std::memory_order_relaxed);
+	while (growth > peak && !m_peakHeapGrowth.compare_exchange_weak(peak, growth, std::memory_order_relaxed)) {
+	}
+	if (!m_steadyState.load(std::memory_order_relaxed)) {
+		return;
+	}
+	if (m_policy == SteadyStatePolicy::Abort) {
+		// No iostreams here: they may allocate.
+		std::fprintf(stderr, "ERROR: a steady-state frame allocated %zu bytes\n", bytes);
+		std::abort();
+	}
+	if (m_recordStacks) {
+		recordSite(phase, bytes);
+	}
+	else {
+		std::lock_guard<std::mutex> lock(m_sitesMutex);
+		m_unrecorded++;
+	}
+}
+
+void AllocationTracker::freed(size_t heapBytes) {
+	if (!counting() || t_inTracker) {
+		return;
+	}
+	m_frees[m_phase.load(std::memory_order_relaxed)].fetch_add(1, std::memory_order_relaxed);
+	m_heapGrowth.fetch_sub(static_cast<int64_t>(heapBytes), std::memory_order_relaxed);
+}
+
+void AllocationTracker::recordSite(size_t phase, size_t bytes) {
+	void* frames[MAX_ALLOCATION_STACK_DEPTH];
+	size_t depth = 0;
+	t_inTracker = true;
+#if defined(_WIN32)
+	depth = CaptureStackBackTrace(0, MAX_ALLOCATION_STACK_DEPTH, frames, nullptr);
+#elif defined(ALLOCATION_BACKTRACE)
+	depth = static_cast<size_t>(backtrace(frames, static_cast<int>(MAX_ALLOCATION_STACK_DEPTH)));
+#endif
+	t_inTracker = false;
+
+	std::lock_guard<std::mutex> lock(m_sitesMutex);
+	if (depth == 0) {
+		m_unrecorded++;
+		return;
+	}
+	for (size_t i = 0; i < m_siteCount; i++) {
+		AllocationSite& site = m_sites[i];
+		if (site.depth == depth && std::memcmp(site.frames, frames, depth * sizeof(void*)) == 0) {
+			site.allocations++;
+			site.bytes += bytes;
+			return;
+		}
+	}
+	if (m_siteCount == MAX_ALLOCATION_SITES) {
+		m_unrecorded++;
+		return;
+	}
+	AllocationSite& site = m_sites[m_siteCount++];
+	std::memcpy(site.frames, frames, depth * sizeof(void*));
+	site.depth = depth;
+	site.phase = phase;
+	site.allocations = 1;
+	site.bytes = bytes;
+}
+
+std::string AllocationTracker::describe(const AllocationSite& site) const {
+	std::ostringstream out;
+	out << site.allocations << " allocations (" << site.bytes << " bytes) in "
+		<< (site.phase < m_phaseCount ? m_phaseNames[site.phase] : "the frame") << ", from:";
+#if defined(ALLOCATION_BACKTRACE)
+	// The first frames are the tracker's and operator new's.
+	char** symbols = backtrace_symbols(site.frames, static_cast<int>(site.depth));
+	for (size_t i = 0; i < site.depth; i++) {
+		out << "\n    " << (symbols != nullptr ? symbols[i] : "?");
+	}
+	std::free(symbols);
+#else
+	for (size_t i = 0; i < site.depth; i++) {
+		out << "\n    " << site.frames[i];
+	}
+#endif
+	return out.str();
+}
+
+// The replaced global operators. The nothrow and array forms the standard library provides
+// call these.
+
+// The size of the block the allocator gave for an allocation, or 0 if it cannot say.
+static size_t heapSize(void* memory) {
+#if defined(_WIN32)
+	return _msize(memory);
+#elif defined(__GLIBC__)
+	return malloc_usable_size(memory);
+#elif defined(__APPLE__)
+	return malloc_size(memory);
+#else
+	return 0;
+#endif
+}
+
+static size_t alignedHeapSize(void* memory, size_t alignment) {
+#if defined(_WIN32)
+	return _aligned_msize(memory, alignment, 0);
+#else
+	return heapSize(memory);
+#endif
+}
+
+static void* allocateAligned(size_t size, size_t alignment) {
+#if defined(_WIN32)
+	return _aligned_malloc(size == 0 ? 1 : size, alignment);
+#else
+	// aligned_alloc wants a nonzero multiple of the alignment.
+	return std::aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment);
+#endif
+}
+
+static void freeAligned(void* memory) {
+#if defined(_WIN32)
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+void* operator new(size_t size) {
+	void* memory = std::malloc(size == 0 ? 1 : size);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	AllocationTracker& tracker = AllocationTracker::current();
+	if (tracker.counting()) {
+		tracker.allocated(size, heapSize(memory));
+	}
+	return memory;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	void* memory = allocateAligned(size, static_cast<size_t>(alignment));
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	AllocationTracker& tracker = AllocationTracker::current();
+	if (tracker.counting()) {
+		tracker.allocated(size, alignedHeapSize(memory, static_cast<size_t>(alignment)));
+	}
+	return memory;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return operator new(size, alignment);
+}
+
+void operator delete(void* memory) noexcept {
+	if (memory == nullptr) {
+		return;
+	}
+	AllocationTracker& tracker = AllocationTracker::current();
+	if (tracker.counting()) {
+		tracker.freed(heapSize(memory));
+	}
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	operator delete(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	operator delete(memory);
+}
+
+void operator delete(void* memory, std::align_val_t alignment) noexcept {
+	if (memory == nullptr) {
+		return;
+	}
+	AllocationTracker& tracker = AllocationTracker::current();
+	if (tracker.counting()) {
+		tracker.freed(alignedHeapSize(memory, static_cast<size_t>(alignment)));
+	}
+	freeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept {
+	operator delete(memory, alignment);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept {
+	operator delete(memory, alignment);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept {
+	operator delete(memory, alignment);
+}
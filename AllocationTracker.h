@@ -0,0 +1,165 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief The most phases a frame can be divided into, the deepest call stack recorded per
+ * allocation, and the most distinct call stacks kept.
+ */
+const size_t MAX_ALLOCATION_PHASES = 8;
+const size_t MAX_ALLOCATION_STACK_DEPTH = 24;
+const size_t MAX_ALLOCATION_SITES = 32;
+
+/**
+ * @brief Heap allocations through global operator new, and frees through operator delete.
+ */
+struct AllocationCounts {
+	uint64_t allocations = 0;
+	uint64_t frees = 0;
+	uint64_t bytes = 0;
+};
+
+/**
+ * @brief The allocations made during one frame, in each of its phases.
+ */
+struct FrameAllocations {
+	bool steadyState = false;
+	AllocationCounts phases[MAX_ALLOCATION_PHASES];
+	// The most the heap grew above its size when the frame began, counting the space the
+	// allocator gave each block; 0 where that space cannot be asked for.
+	uint64_t peakHeapGrowth = 0;
+
+	AllocationCounts total() const;
+};
+
+/**
+ * @brief A call stack that allocated in steady-state frames, and how much.
+ */
+struct AllocationSite {
+	void* frames[MAX_ALLOCATION_STACK_DEPTH];
+	size_t depth;
+	// The phase the first allocation was made in.
+	size_t phase;
+	uint64_t allocations;
+	uint64_t bytes;
+};
+
+/**
+ * @brief What the tracker does when a steady-state frame allocates: record it, or print the
+ * allocation's size and abort, so a debugger stops in the allocating call.
+ */
+enum class SteadyStatePolicy {
+	Record,
+	Abort
+};
+
+/**
+ * @brief Counts the heap allocations of every thread, frame by frame, by replacing global
+ * operator new and delete. Frames are marked steady-state or not; steady-state frames are
+ * expected not to allocate at all, so the call stack of every allocation they make is
+ * recorded, up to MAX_ALLOCATION_SITES distinct ones. Frames are divided into named phases
+ * ("update", "render") whose allocations are counted separately.
+ * Off until enabled; while off, or between frames, an allocation costs one atomic load. The
+ * tracker itself never allocates while counting. Call stacks are only recorded on platforms
+ * with backtrace().
+ */
+class AllocationTracker {
+private:
+	std::atomic<bool> m_enabled;
+	std::atomic<bool> m_inFrame;
+	std::atomic<bool> m_steadyState;
+	std::atomic<size_t> m_phase;
+	SteadyStatePolicy m_policy;
+	bool m_recordStacks;
+
+	// Phase names, as passed to phase; they must outlive the tracker.
+	const char* m_phaseNames[MAX_ALLOCATION_PHASES];
+	size_t m_phaseCount;
+
+	// The current frame's counts.
+	std::atomic<uint64_t> m_allocations[MAX_ALLOCATION_PHASES];
+	std::atomic<uint64_t> m_frees[MAX_ALLOCATION_PHASES];
+	std::atomic<uint64_t> m_bytes[MAX_ALLOCATION_PHASES];
+	// Heap bytes allocated less those freed since the frame began, and the most there were.
+	std::atomic<int64_t> m_heapGrowth;
+	std::atomic<int64_t> m_peakHeapGrowth;
+
+	std::mutex m_sitesMutex;
+	AllocationSite m_sites[MAX_ALLOCATION_SITES];
+	size_t m_siteCount;
+	// Steady-state allocations whose stacks did not fit.
+	uint64_t m_unrecorded;
+
+	constexpr AllocationTracker()
+		: m_enabled(false), m_inFrame(false), m_steadyState(false), m_phase(0),
+		m_policy(SteadyStatePolicy::Record), m_recordStacks(true), m_phaseNames(), m_phaseCount(0),
+		m_allocations(), m_frees(), m_bytes(), m_heapGrowth(0), m_peakHeapGrowth(0), m_sites(),
+		m_siteCount(0), m_unrecorded(0) {}
+
+	void recordSite(size_t phase, size_t bytes);
+
+public:
+	AllocationTracker(const AllocationTracker&) = delete;
+	AllocationTracker& operator=(const AllocationTracker&) = delete;
+
+	static AllocationTracker& current();
+
+	/**
+	 * @brief Starts tracking, forgetting the phases and sites of any earlier tracking.
+	 * @param recordStacks whether to record the call stacks of steady-state allocations.
+	 */
+	void enable(SteadyStatePolicy policy = SteadyStatePolicy::Record, bool recordStacks = true);
+	void disable();
+	bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief Starts counting a frame's allocations, in its first phase. Allocations made
+	 * between endFrame and the next beginFrame are not counted.
+	 */
+	void beginFrame(bool steadyState);
+
+	/**
+	 * @brief Counts the allocations that follow in the named phase, until the next call or the
+	 * end of the frame. Phases past MAX_ALLOCATION_PHASES share the last one.
+	 * @param name a string that outlives the tracker, such as a literal.
+	 */
+	void phase(const char* name);
+
+	/**
+	 * @brief Stops counting, and returns the frame's counts.
+	 */
+	FrameAllocations endFrame();
+
+	/**
+	 * @brief Whether allocations are being counted; the replaced operators only report them
+	 * while they are.
+	 */
+	bool counting() const { return m_inFrame.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief Called by the replaced operators with the size asked for and the size of the
+	 * block the allocator gave, or 0 if unknown.
+	 */
+	void allocated(size_t bytes, size_t heapBytes);
+	void freed(size_t heapBytes);
+
+	size_t phaseCount() const { return m_phaseCount; }
+	const char* phaseName(size_t phase) const { return m_phaseNames[phase]; }
+
+	/**
+	 * @brief The call stacks that allocated in steady-state frames, and the number of
+	 * allocations there was no room to record. Must not be called during a frame.
+	 */
+	size_t siteCount() const { return m_siteCount; }
+	const AllocationSite& site(size_t index) const { return m_sites[index]; }
+	uint64_t unrecordedAllocations() const { return m_unrecorded; }
+
+	/**
+	 * @brief A site's phase and counts, and its call stack with symbols where they can be
+	 * found, one frame per line. Must not be called during a frame.
+	 */
+	std::string describe(const AllocationSite& site) const;
+};
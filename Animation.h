@@ -1,5 +1,8 @@
 #pragma once
 #include "Object3D.h"
+#include "ObjectStore.h"
+
+class KeyframeTracks;
 
 /**
 * @brief Represents an abstract animation of an object, manipulating one or more of its
@@ -10,7 +13,7 @@ class Animation {
 private:
 	float_t m_duration;
 	float_t m_currentTime;
-	Object3D& m_object;
+	ObjectHandle m_object;
 
 	/**
 	 * @brief Called when the animation is activated by an Animator.
@@ -18,12 +21,13 @@ private:
 	virtual void startAnimation() {}
 	/**
 	 * @brief Called when the animation is ticked by an Animator.
+	 * @param object the object being animated.
 	 * @param dt the change in time since the last tick.
 	 */
-	virtual void applyAnimation(float_t dt) = 0;
+	virtual void applyAnimation(Object3D& object, float_t dt) = 0;
 
 public:
-	Animation(Object3D& obj, float_t duration) : m_object(obj), m_duration(duration),
+	Animation(ObjectHandle obj, float_t duration) : m_object(obj), m_duration(duration),
 		m_currentTime(-1) {
 	}
 
@@ -38,18 +42,34 @@ public:
 	float_t currentTime() const { return m_currentTime; }
 
 	/**
-	* @brief The object the animation is manipulating.
+	* @brief The handle of the object the animation is manipulating.
 	*/
-	Object3D& object() const { return m_object; }
+	ObjectHandle object() const { return m_object; }
 
 	/**
-	* @brief Advances the animation by the given interval, in seconds.
+	* @brief Advances the animation by the given interval, in seconds. The animation does
+	* nothing if its object has been removed from the store.
 	*/
-	void tick(float_t dt) {
+	void tick(ObjectStore& store, float_t dt) {
 		m_currentTime += dt;
-		applyAnimation(dt);
+		Object3D* object = store.find(m_object);
+		if (object != nullptr) {
+			applyAnimation(*object, dt);
+		}
 	}
 
+	/**
+	 * @brief Whether the animation has a keyframe track equivalent, which appendTrack adds.
+	 */
+	virtual bool hasTrack() const { return false; }
+
+	/**
+	 * @brief Appends a keyframe track equivalent to this animation to the given track system,
+	 * beginning after the given delay in seconds.
+	 * @return false if the animation has no keyframe equivalent.
+	 */
+	virtual bool appendTrack(KeyframeTracks& tracks, float_t delay) const { return false; }
+
 	/**
 	 * @brief Starts the animation.
 	 */
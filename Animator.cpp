@@ -15,7 +15,7 @@ void Animator::nextAnimation() {
 	}
 }
 
-void Animator::tick(float_t dt) {
+void Animator::tick(ObjectStore& store, float_t dt) {
 	// Advance the active animation by the given interval.
 	if (m_currentIndex >= 0) {
 		float_t lastTime = m_currentTime;
@@ -25,15 +25,15 @@ void Animator::tick(float_t dt) {
 		// both the active animation (up to the transition time), and the subsequent animation
 		// (by the amount we exceeded the transition time).
 		if (m_currentTime >= m_nextTransition) {
-			m_currentAnimation->tick(m_nextTransition - lastTime);
+			m_currentAnimation->tick(store, m_nextTransition - lastTime);
 			float_t overTime = m_currentTime - m_nextTransition;
 			nextAnimation();
 			if (m_currentAnimation != nullptr) {
-				m_currentAnimation->tick(overTime);
+				m_currentAnimation->tick(store, overTime);
 			}
 		}
 		else {
-			m_currentAnimation->tick(dt);
+			m_currentAnimation->tick(store, dt);
 		}
 	}
 }
@@ -42,3 +42,18 @@ void Animator::start() {
 	m_currentTime = 0;
 	nextAnimation();
 }
+
+bool Animator::appendTracks(KeyframeTracks& tracks) const {
+	// Check every animation first, so a failure leaves the caller's tracks untouched.
+	for (auto& animation : m_animations) {
+		if (!animation->hasTrack()) {
+			return false;
+		}
+	}
+	float_t delay = 0;
+	for (auto& animation : m_animations) {
+		animation->appendTrack(tracks, delay);
+		delay += animation->duration();
+	}
+	return true;
+}
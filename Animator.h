@@ -55,8 +55,16 @@ public:
 	void start();
 
 	/**
-	 * @brief Advance the animation sequence by the given time interval, in seconds.
+	 * @brief Appends the whole animation sequence to a keyframe track system, as one track per
+	 * animation delayed by the durations of the animations before it.
+	 * @return false (adding nothing) if any animation has no keyframe equivalent.
 	 */
-	void tick(float_t dt);
+	bool appendTracks(KeyframeTracks& tracks) const;
+
+	/**
+	 * @brief Advance the animation sequence by the given time interval, in seconds, applying
+	 * it to objects in the given store.
+	 */
+	void tick(ObjectStore& store, float_t dt);
 
 };
\ No newline at end of file
@@ -1,5 +1,11 @@
 #include "AssimpImport.h"
+#include "GltfImport.h"
+#include "ObjImport.h"
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -10,88 +16,264 @@
 const size_t FLOATS_PER_VERTEX = 3;
 const size_t VERTICES_PER_FACE = 3;
 
+/**
+ * @brief The Assimp flag a step runs, or 0 for our own steps.
+ */
+static unsigned int assimpFlag(ImportStep step) {
+	switch (step) {
+	case ImportStep::Validate: return aiProcess_ValidateDataStructure;
+	case ImportStep::RemoveRedundantMaterials: return aiProcess_RemoveRedundantMaterials;
+	case ImportStep::OptimizeMeshes: return aiProcess_OptimizeMeshes;
+	case ImportStep::RemoveDegenerates: return aiProcess_FindDegenerates;
+	case ImportStep::GenerateUVs: return aiProcess_GenUVCoords;
+	case ImportStep::Triangulate: return aiProcess_Triangulate;
+	case ImportStep::SortByType: return aiProcess_SortByPType;
+	case ImportStep::FindInvalidData: return aiProcess_FindInvalidData;
+	case ImportStep::LimitBoneWeights: return aiProcess_LimitBoneWeights;
+	default: return 0;
+	}
+}
+
 std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
+	std::unordered_map<std::filesystem::path, Texture>& loadedTextures, ImportReport* report) {
 	std::vector<Texture> textures;
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
 		aiString name;
 		mat->GetTexture(type, i, &name);
 		std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
-
-		auto existing = loadedTextures.find(texPath);
-		if (existing != loadedTextures.end()) {
-			textures.push_back(existing->second);
-		}
-		else {
-			sf::Image image;
-			image.loadFromFile(texPath.string());
-			Texture tex = Texture::loadImage(image, typeName);
-			textures.push_back(tex);
-			loadedTextures.insert(std::make_pair(texPath, tex));
-		}
+		textures.push_back(loadTextureFile(texPath, typeName, loadedTextures, report));
 	}
 	return textures;
 }
 
-Mesh3D fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
-	std::vector<Vertex3D> vertices;
-
-	for (size_t i = 0; i < mesh->mNumVertices; i++) {
-		auto* tex = mesh->mTextureCoords[0];
-		if (tex != nullptr) {
-			vertices.emplace_back( mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z,
-				mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z,
-				//mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z,
-				mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y );
+/**
+ * @brief One mesh of one node, converted and processed in staging memory, waiting to be
+ * uploaded.
+ */
+struct PreparedMesh {
+	const aiMesh* mesh;
+	const aiNode* node;
+	bool skinned = false;
+	uint32_t skin = 0;
+	std::vector<VertexBoneData> influences;
+	Vertex3D* vertices = nullptr;
+	size_t vertexCount = 0;
+	size_t convertedCount = 0;
+	uint32_t* indices = nullptr;
+	size_t indexCount = 0;
+	// Time spent converting and in each step, on whichever thread prepared the mesh.
+	double convertMs = 0;
+	double stepMs[IMPORT_STEP_COUNT] = {};
+
+	PreparedMesh(const aiMesh* mesh, const aiNode* node) : mesh(mesh), node(node) {}
+};
+
+static bool isTriangleMesh(const aiMesh* mesh) {
+	return mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+}
+
+/**
+ * @brief Lists the triangle meshes under a node, depth first, adding their skins to the
+ * skeleton; skins are added here, on one thread, in the order the meshes are uploaded.
+ */
+static void collectMeshes(const aiNode* node, const aiScene* scene, const std::shared_ptr<Skeleton>& skeleton,
+	ImportReport* report, std::vector<PreparedMesh>& prepared) {
+	for (auto i = 0; i < node->mNumMeshes; i++) {
+		const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+		if (!isTriangleMesh(mesh)) {
+			continue;
 		}
-		else {
-			vertices.push_back({ mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z,
-				0, 0, 1, 0, 0 });
+		PreparedMesh& p = prepared.emplace_back(mesh, node);
+		// Influences are gathered before the steps, so only vertices with the same influences
+		// weld.
+		auto start = ImportClock::now();
+		p.skinned = skeleton != nullptr && mesh->HasBones();
+		if (p.skinned) {
+			p.skin = skeleton->addSkin(mesh, node, p.influences);
 		}
+		addImportTime(report, &ImportReport::convertMs, start);
 	}
+	for (auto i = 0; i < node->mNumChildren; i++) {
+		collectMeshes(node->mChildren[i], scene, skeleton, report, prepared);
+	}
+}
 
-	std::vector<uint32_t> faces;
-	faces.reserve(mesh->mNumFaces * VERTICES_PER_FACE);
+/**
+ * @brief Converts a mesh into the mesh arena and runs the settings' mesh steps on it, with
+ * scratch memory from the scratch arena, reset after each step. The pool, if given, is used
+ * within steps, so this must not be called from one of its tasks.
+ */
+static void prepareMesh(PreparedMesh& p, const ImportSettings& settings, FrameArena& meshArena,
+	FrameArena& scratch, WorkerPool* pool) {
+	auto start = ImportClock::now();
+	const aiMesh* mesh = p.mesh;
+	p.vertexCount = mesh->mNumVertices;
+	p.convertedCount = p.vertexCount;
+	p.vertices = meshArena.allocateArray<Vertex3D>(p.vertexCount);
+	const aiVector3D* normals = mesh->mNormals;
+	const aiVector3D* texCoords = mesh->mTextureCoords[0];
+	for (size_t i = 0; i < p.vertexCount; i++) {
+		const aiVector3D& position = mesh->mVertices[i];
+		aiVector3D normal = normals != nullptr ? normals[i] : aiVector3D(0, 0, 1);
+		aiVector3D uv = texCoords != nullptr ? texCoords[i] : aiVector3D(0, 0, 0);
+		new (&p.vertices[i]) Vertex3D(position.x, position.y, position.z, normal.x, normal.y, normal.z,
+			uv.x, uv.y);
+	}
+	p.indexCount = mesh->mNumFaces * VERTICES_PER_FACE;
+	p.indices = meshArena.allocateArray<uint32_t>(p.indexCount);
 	for (size_t i = 0; i < mesh->mNumFaces; i++) {
-		faces.push_back(mesh->mFaces[i].mIndices[0]);
-		faces.push_back(mesh->mFaces[i].mIndices[1]);
-		faces.push_back(mesh->mFaces[i].mIndices[2]);
+		p.indices[i * 3] = mesh->mFaces[i].mIndices[0];
+		p.indices[i * 3 + 1] = mesh->mFaces[i].mIndices[1];
+		p.indices[i * 3 + 2] = mesh->mFaces[i].mIndices[2];
+	}
+	p.convertMs += std::chrono::duration<double, std::milli>(ImportClock::now() - start).count();
+
+	p.vertexCount = runMeshSteps(p.vertices, p.vertexCount, p.indices, p.indexCount, normals != nullptr, settings,
+		scratch, pool, p.skinned ? p.influences.data() : nullptr, p.stepMs);
+	if (p.skinned) {
+		p.influences.resize(p.vertexCount);
 	}
+}
 
+/**
+ * @brief Prepares every mesh, on the staging's pool, and adds their times to the report.
+ */
+static void prepareMeshes(std::vector<PreparedMesh>& prepared, ImportStaging& staging, ImportReport* report) {
+	auto start = ImportClock::now();
+	prepareMeshesInParallel(staging, prepared.size(),
+		[&](size_t mesh) { return static_cast<size_t>(prepared[mesh].mesh->mNumVertices); },
+		[&](size_t mesh, FrameArena& meshArena, FrameArena& scratch, WorkerPool* pool) {
+			prepareMesh(prepared[mesh], staging.settings, meshArena, scratch, pool);
+		});
+	addImportTime(report, &ImportReport::processMs, start);
+
+	if (report != nullptr) {
+		for (auto& p : prepared) {
+			report->convertMs += p.convertMs;
+			for (size_t s = 0; s < IMPORT_STEP_COUNT; s++) {
+				report->stepMs[s] += p.stepMs[s];
+			}
+		}
+	}
+}
+
+/**
+ * @brief Loads a prepared mesh's textures and uploads it from staging memory.
+ */
+static Mesh3D uploadMesh(PreparedMesh& p, const aiScene* scene, const std::filesystem::path& modelPath,
+	std::unordered_map<std::filesystem::path, Texture>& loadedTextures,
+	const std::shared_ptr<Skeleton>& skeleton, ImportReport* report) {
+	const aiMesh* mesh = p.mesh;
 	std::vector<Texture> textures = {};
 	if (mesh->mMaterialIndex >= 0)
 	{
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 		std::vector<Texture> diffuseMaps = loadMaterialTextures(material,
-			aiTextureType_DIFFUSE, "baseTexture", modelPath, loadedTextures);
+			aiTextureType_DIFFUSE, "baseTexture", modelPath, loadedTextures, report);
 		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 		std::vector<Texture> specularMaps = loadMaterialTextures(material,
-			aiTextureType_SPECULAR, "specMap", modelPath, loadedTextures);
+			aiTextureType_SPECULAR, "specMap", modelPath, loadedTextures, report);
 		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 		std::vector<Texture> normalMaps = loadMaterialTextures(material,
-			aiTextureType_HEIGHT, "normalMap", modelPath, loadedTextures);
+			aiTextureType_HEIGHT, "normalMap", modelPath, loadedTextures, report);
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 		normalMaps = loadMaterialTextures(material,
-			aiTextureType_NORMALS, "normalMap", modelPath, loadedTextures);
+			aiTextureType_NORMALS, "normalMap", modelPath, loadedTextures, report);
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 	}
 
-	auto m = Mesh3D(std::move(vertices), std::move(faces), std::move(textures));
+	if (report != nullptr) {
+		report->meshCount++;
+		report->vertexCount += p.vertexCount;
+		report->convertedVertexCount += p.convertedCount;
+		report->triangleCount += mesh->mNumFaces;
+		report->vertexBytes += p.vertexCount * sizeof(Vertex3D) + p.influences.size() * sizeof(VertexBoneData);
+		report->indexBytes += p.indexCount * sizeof(uint32_t);
+	}
+	auto start = ImportClock::now();
+	auto m = Mesh3D(p.vertices, p.vertexCount, p.indices, p.indexCount, std::move(textures));
+	if (p.skinned) {
+		// Rigged meshes keep a copy of their bind-pose vertices for CPU skinning.
+		std::vector<Vertex3D> bindVertices(p.vertices, p.vertices + p.vertexCount);
+		m.setSkin(skeleton, p.skin, std::move(bindVertices), std::move(p.influences));
+	}
+	addImportTime(report, &ImportReport::meshUploadMs, start);
 	return m;
 }
 
+Mesh3D fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
+	std::unordered_map<std::filesystem::path, Texture>& loadedTextures,
+	const std::shared_ptr<Skeleton>& skeleton, const aiNode* node, ImportReport* report,
+	ImportStaging* staging) {
+	std::unique_ptr<ImportStaging> ownStaging;
+	if (staging == nullptr) {
+		ownStaging = std::make_unique<ImportStaging>();
+		staging = ownStaging.get();
+	}
 
+	std::vector<PreparedMesh> prepared;
+	PreparedMesh& p = prepared.emplace_back(mesh, node);
+	auto start = ImportClock::now();
+	p.skinned = skeleton != nullptr && node != nullptr && mesh->HasBones();
+	if (p.skinned) {
+		p.skin = skeleton->addSkin(mesh, node, p.influences);
+	}
+	addImportTime(report, &ImportReport::convertMs, start);
+	prepareMeshes(prepared, *staging, report);
+	auto m = uploadMesh(p, scene, modelPath, loadedTextures, skeleton, report);
 
-Object3D assimpLoad(const std::string& path, bool flipTextureCoords) {
+	// The upload copied the staged data; the next mesh reuses the memory.
+	if (report != nullptr) {
+		report->stagingBytes = std::max(report->stagingBytes, staging->capacity());
+	}
+	staging->reset();
+	return m;
+}
+
+Object3D assimpLoad(const std::string& path, bool flipTextureCoords, ImportReport* report) {
+	ImportSettings settings = ImportSettings::profile(ImportProfile::Balanced);
+	settings.flipTextureCoords = flipTextureCoords;
+	return assimpLoad(path, settings, report);
+}
+
+Object3D assimpLoad(const std::string& path, const ImportSettings& settings, ImportReport* report) {
+	std::string extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	if (settings.nativeLoaders && extension == ".obj") {
+		return objLoad(path, settings, report);
+	}
+	if (settings.nativeLoaders && (extension == ".gltf" || extension == ".glb")) {
+		return gltfLoad(path, settings, report);
+	}
+
+	auto loadStart = ImportClock::now();
 	Assimp::Importer importer;
 
-	auto options = aiProcessPreset_TargetRealtime_MaxQuality;
-	if (flipTextureCoords) {
-		options |= aiProcess_FlipUVs;
+	// Parse first, then run each of Assimp's steps on its own, so each can be timed. Assimp
+	// flips texture coordinates before its other steps, so that comes first.
+	auto start = ImportClock::now();
+	const aiScene* scene = importer.ReadFile(path, 0);
+	addImportTime(report, &ImportReport::parseMs, start);
+	if (scene != nullptr && settings.flipTextureCoords) {
+		start = ImportClock::now();
+		scene = importer.ApplyPostProcessing(aiProcess_FlipUVs);
+		addImportTime(report, &ImportReport::postProcessMs, start);
+	}
+	ImportSettings steps = settings;
+	steps.add(ImportStep::Triangulate).add(ImportStep::SortByType);
+	for (size_t i = 0; i < IMPORT_STEP_COUNT && scene != nullptr; i++) {
+		unsigned int flag = assimpFlag(static_cast<ImportStep>(i));
+		if (flag != 0 && steps.has(static_cast<ImportStep>(i))) {
+			start = ImportClock::now();
+			scene = importer.ApplyPostProcessing(flag);
+			double ms = std::chrono::duration<double, std::milli>(ImportClock::now() - start).count();
+			if (report != nullptr) {
+				report->stepMs[i] += ms;
+				report->postProcessMs += ms;
+			}
+		}
 	}
-	const aiScene* scene = importer.ReadFile(path, options);
 
 	// If the import failed, report it
 	if (nullptr == scene) {
@@ -132,30 +314,57 @@ Object3D assimpLoad(const std::string& path, bool flipTextureCoords) {
 		}
 	}*/
 	//auto ret = Object3D(std::make_shared<Mesh3D>(fromAssimpMesh(scene->mMeshes[0], scene, textures)));
-	std::vector<Mesh3D> meshes;
+	// Rigged or animated models get a skeleton mirroring the whole node hierarchy.
+	start = ImportClock::now();
+	std::shared_ptr<Skeleton> skeleton;
+	bool hasBones = false;
+	for (auto i = 0; i < scene->mNumMeshes; i++) {
+		hasBones = hasBones || scene->mMeshes[i]->HasBones();
+	}
+	if (hasBones || scene->HasAnimations()) {
+		skeleton = Skeleton::fromAssimp(scene);
+	}
+	addImportTime(report, &ImportReport::skeletonMs, start);
+
+	// Staging for every mesh, sized for the largest batch; freed when the import is done.
+	// Meshes are processed on a pool started for the import.
+	WorkerPool pool;
+	ImportStaging staging(settings, &pool);
 	std::unordered_map<std::filesystem::path, Texture> loadedTextures;
-	auto ret = processAssimpNode(scene->mRootNode, scene, std::filesystem::path(path), loadedTextures);
+	auto ret = processAssimpNode(scene->mRootNode, scene, std::filesystem::path(path), loadedTextures,
+		skeleton, report, &staging);
+	ret.setSkeleton(skeleton);
+
+	if (report != nullptr) {
+		std::error_code error;
+		auto bytes = std::filesystem::file_size(path, error);
+		report->fileBytes += error ? 0 : bytes;
+	}
+	addImportTime(report, &ImportReport::totalMs, loadStart);
 
 	// aiNode -> Object3D. the aiNode's mTransformation -> Object3D.m_baseTransform.
 	// The list of meshes in aiNode -> Model3D.
 	return ret;
 }
 
-Object3D processAssimpNode(aiNode* node, const aiScene* scene,
-	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
+/**
+ * @brief Builds a node's object and its children's, uploading their prepared meshes, which
+ * are consumed in the order collectMeshes listed them.
+ */
+static Object3D buildNode(const aiNode* node, const aiScene* scene, const std::filesystem::path& modelPath,
+	std::unordered_map<std::filesystem::path, Texture>& loadedTextures,
+	const std::shared_ptr<Skeleton>& skeleton, ImportReport* report,
+	std::vector<PreparedMesh>& prepared, size_t& next) {
 
 	// Load the aiNode's meshes.
 	std::vector<Mesh3D> meshes;
+	meshes.reserve(node->mNumMeshes);
 	for (auto i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.emplace_back(fromAssimpMesh(mesh, scene, modelPath, loadedTextures));
+		if (isTriangleMesh(scene->mMeshes[node->mMeshes[i]])) {
+			meshes.emplace_back(uploadMesh(prepared[next++], scene, modelPath, loadedTextures, skeleton, report));
+		}
 	}
 
-	std::vector<Texture> textures;
-	for (auto& p : loadedTextures) {
-		textures.push_back(p.second);
-	}
 	glm::mat4 baseTransform;
 	for (auto i = 0; i < 4; i++) {
 		for (auto j = 0; j < 4; j++) {
@@ -165,9 +374,34 @@ Object3D processAssimpNode(aiNode* node, const aiScene* scene,
 	auto parent = Object3D(std::move(meshes), baseTransform);
 
 	for (auto i = 0; i < node->mNumChildren; i++) {
-		Object3D child = processAssimpNode(node->mChildren[i], scene, modelPath, loadedTextures);
+		Object3D child = buildNode(node->mChildren[i], scene, modelPath, loadedTextures, skeleton, report,
+			prepared, next);
 		parent.addChild(std::move(child));
 	}
 
 	return parent;
 }
+
+Object3D processAssimpNode(aiNode* node, const aiScene* scene,
+	const std::filesystem::path& modelPath,
+	std::unordered_map<std::filesystem::path, Texture>& loadedTextures,
+	const std::shared_ptr<Skeleton>& skeleton, ImportReport* report, ImportStaging* staging) {
+	std::unique_ptr<ImportStaging> ownStaging;
+	if (staging == nullptr) {
+		ownStaging = std::make_unique<ImportStaging>();
+		staging = ownStaging.get();
+	}
+
+	std::vector<PreparedMesh> prepared;
+	collectMeshes(node, scene, skeleton, report, prepared);
+	prepareMeshes(prepared, *staging, report);
+	size_t next = 0;
+	Object3D result = buildNode(node, scene, modelPath, loadedTextures, skeleton, report, prepared, next);
+
+	// The uploads copied the staged data; the next import reuses the memory.
+	if (report != nullptr) {
+		report->stagingBytes = std::max(report->stagingBytes, staging->capacity());
+	}
+	staging->reset();
+	return result;
+}
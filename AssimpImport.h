@@ -1,15 +1,44 @@
 #pragma once
+#include "ImportPipeline.h"
 #include "Mesh3D.h"
 #include "Object3D.h"
+#include "Skeleton.h"
+#include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 #include <assimp/scene.h>
 
+/**
+ * @brief Converts a mesh into staging memory, runs the staging settings' mesh steps on it
+ * there, and uploads it from there, then resets the staging. Without staging, the mesh gets
+ * staging of its own, with the balanced profile and no pool.
+ */
 Mesh3D fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures);
-Object3D assimpLoad(const std::string& path, bool flipTextureCoords);
+	std::unordered_map<std::filesystem::path, Texture>& loadedTextures,
+	const std::shared_ptr<Skeleton>& skeleton = nullptr, const aiNode* node = nullptr,
+	ImportReport* report = nullptr, ImportStaging* staging = nullptr);
+/**
+ * @brief Imports a model file into an object hierarchy, with the balanced profile. If a report
+ * is given, the time and sizes of each import phase and step are added to it.
+ */
+Object3D assimpLoad(const std::string& path, bool flipTextureCoords, ImportReport* report = nullptr);
+/**
+ * @brief Imports a model file with the given steps. Meshes are processed on a pool started
+ * for the import. OBJ and glTF files go to objLoad and gltfLoad instead, unless the settings
+ * turn native loaders off.
+ */
+Object3D assimpLoad(const std::string& path, const ImportSettings& settings, ImportReport* report = nullptr);
+/**
+ * @brief Converts and processes every triangle mesh under the node, in parallel on the
+ * staging's pool if it has one, then builds the node's hierarchy and uploads the meshes.
+ * Meshes of points or lines are skipped.
+ */
 Object3D processAssimpNode(aiNode* node, const aiScene* scene,
 	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& textures);
+	std::unordered_map<std::filesystem::path, Texture>& textures,
+	const std::shared_ptr<Skeleton>& skeleton = nullptr, ImportReport* report = nullptr,
+	ImportStaging* staging = nullptr);
 std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName,
 	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures);
\ No newline at end of file
+	std::unordered_map<std::filesystem::path, Texture>& loadedTextures, ImportReport* report = nullptr);
@@ -0,0 +1,456 @@
+#include "ClipCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include "Skeleton.h"
+
+// The three smallest components of a unit quaternion lie in [-1/sqrt(2), 1/sqrt(2)].
+const float_t SMALLEST_THREE_RANGE = 0.70710678f;
+const float_t MAX_15_BITS = 32767.0f;
+const float_t MAX_16_BITS = 65535.0f;
+const uint32_t CLIP_FILE_MAGIC = 0x50494C43; // "CLIP"
+// Bounds the cost of extending a segment, which re-checks every key it skips.
+const size_t MAX_SEGMENT_KEYS = 64;
+
+std::string ClipCompressionReport::describe() const {
+	std::ostringstream out;
+	out << name << ": " << rawKeys << " -> " << keptKeys << " keys, " << rawBytes << " -> "
+		<< compressedBytes << " bytes (" << ratio() << "x); max error: translation "
+		<< maxTranslationError << ", rotation " << maxRotationError << " rad, scale " << maxScaleError;
+	return out.str();
+}
+
+size_t CompressedClip::ChannelSet::bytes() const {
+	return (node.size() + firstKey.size() + keyCount.size()) * sizeof(uint32_t)
+		+ (keyTimes.size() + keyValues.size()) * sizeof(uint16_t);
+}
+
+/**
+ * @brief Quantizes a value in [min, min + extent] to 16 bits.
+ */
+static uint16_t quantize16(float_t value, float_t min, float_t extent) {
+	if (extent <= 0) {
+		return 0;
+	}
+	float_t normalized = std::clamp((value - min) / extent, 0.0f, 1.0f);
+	return static_cast<uint16_t>(std::lround(normalized * MAX_16_BITS));
+}
+
+static float_t dequantize16(uint16_t value, float_t min, float_t extent) {
+	return min + (value / MAX_16_BITS) * extent;
+}
+
+/**
+ * @brief Encodes a unit quaternion as three 16-bit words: the two high bits of the first two
+ * words hold the index of the largest component, which is dropped (and made positive, since
+ * q and -q are the same rotation); the other three components take 15 bits each.
+ */
+static void encodeSmallestThree(glm::vec4 q, uint16_t* out) {
+	size_t largest = 0;
+	for (size_t i = 1; i < 4; i++) {
+		if (std::abs(q[i]) > std::abs(q[largest])) {
+			largest = i;
+		}
+	}
+	if (q[largest] < 0) {
+		q = -1.0f * q;
+	}
+	size_t written = 0;
+	for (size_t i = 0; i < 4; i++) {
+		if (i == largest) {
+			continue;
+		}
+		float_t normalized = std::clamp((q[i] + SMALLEST_THREE_RANGE) / (2 * SMALLEST_THREE_RANGE), 0.0f, 1.0f);
+		out[written++] = static_cast<uint16_t>(std::lround(normalized * MAX_15_BITS));
+	}
+	out[0] |= static_cast<uint16_t>((largest >> 1) << 15);
+	out[1] |= static_cast<uint16_t>((largest & 1) << 15);
+}
+
+static glm::vec4 decodeSmallestThree(const uint16_t* in) {
+	size_t largest = ((in[0] >> 15) << 1) | (in[1] >> 15);
+	glm::vec4 q;
+	float_t sumOfSquares = 0;
+	size_t read = 0;
+	for (size_t i = 0; i < 4; i++) {
+		if (i == largest) {
+			continue;
+		}
+		float_t component = ((in[read++] & 0x7FFF) / MAX_15_BITS) * 2 * SMALLEST_THREE_RANGE - SMALLEST_THREE_RANGE;
+		q[i] = component;
+		sumOfSquares += component * component;
+	}
+	q[largest] = std::sqrt(std::max(0.0f, 1 - sumOfSquares));
+	return q;
+}
+
+/**
+ * @brief The angle between two rotations, in radians.
+ */
+static float_t rotationError(const glm::vec4& a, const glm::vec4& b) {
+	float_t d = std::min(1.0f, std::abs(glm::dot(glm::normalize(a), glm::normalize(b))));
+	return 2 * std::acos(d);
+}
+
+static float_t vectorError(const glm::vec4& a, const glm::vec4& b) {
+	return std::max({ std::abs(a.x - b.x), std::abs(a.y - b.y), std::abs(a.z - b.z) });
+}
+
+/**
+ * @brief Interpolates between two keys the same way sampling does: lerp, or nlerp along the
+ * shorter arc for quaternions.
+ */
+static glm::vec4 interpolate(const glm::vec4& from, glm::vec4 to, float_t alpha, bool quaternion) {
+	if (quaternion && glm::dot(from, to) < 0) {
+		to = -1.0f * to;
+	}
+	glm::vec4 result = from + (to - from) * alpha;
+	return quaternion ? glm::normalize(result) : result;
+}
+
+/**
+ * @brief Chooses which keys of a channel to keep: starting from each kept key, extends the
+ * segment as far as every skipped key stays within tolerance of the interpolated segment
+ * (up to MAX_SEGMENT_KEYS long).
+ * A channel that never leaves the tolerance of its first key collapses to one key.
+ */
+static std::vector<size_t> reduceKeys(const float_t* times, const glm::vec4* values, size_t count,
+	bool quaternion, float_t tolerance) {
+	auto error = [quaternion](const glm::vec4& a, const glm::vec4& b) {
+		return quaternion ? rotationError(a, b) : vectorError(a, b);
+	};
+
+	bool constant = true;
+	for (size_t k = 1; k < count && constant; k++) {
+		constant = error(values[0], values[k]) <= tolerance;
+	}
+	if (constant) {
+		return { 0 };
+	}
+
+	std::vector<size_t> kept = { 0 };
+	size_t anchor = 0;
+	for (size_t end = anchor + 2; end < count; end++) {
+		bool fits = end - anchor <= MAX_SEGMENT_KEYS;
+		for (size_t k = anchor + 1; k < end && fits; k++) {
+			float_t span = times[end] - times[anchor];
+			float_t alpha = span > 0 ? (times[k] - times[anchor]) / span : 0;
+			fits = error(interpolate(values[anchor], values[end], alpha, quaternion), values[k]) <= tolerance;
+		}
+		if (!fits) {
+			anchor = end - 1;
+			kept.push_back(anchor);
+		}
+	}
+	if (count > 1) {
+		kept.push_back(count - 1);
+	}
+	return kept;
+}
+
+/**
+ * @brief Finds the keys bracketing a time in one compressed channel.
+ */
+static void bracket(const CompressedClip::ChannelSet& set, size_t channel, float_t quantizedTime,
+	size_t& a, size_t& b, float_t& alpha) {
+	size_t first = set.firstKey[channel];
+	size_t keys = set.keyCount[channel];
+	auto begin = set.keyTimes.begin() + first;
+	size_t after = std::upper_bound(begin, begin + keys, quantizedTime,
+		[](float_t t, uint16_t key) { return t < key; }) - begin;
+	a = first + (after == 0 ? 0 : after - 1);
+	b = first + std::min(after, keys - 1);
+	float_t ta = set.keyTimes[a];
+	float_t tb = set.keyTimes[b];
+	alpha = tb > ta ? std::clamp((quantizedTime - ta) / (tb - ta), 0.0f, 1.0f) : 0;
+}
+
+CompressedClip::CompressedClip()
+	: m_duration(0), m_translationMin(0), m_translationExtent(0), m_scaleMin(0), m_scaleExtent(0) {
+}
+
+const CompressedClip::ChannelSet& CompressedClip::channels(TrackChannel channel) const {
+	switch (channel) {
+	case TrackChannel::Translation:
+		return m_translations;
+	case TrackChannel::Rotation:
+		return m_rotations;
+	case TrackChannel::Scale:
+		return m_scales;
+	default:
+		throw std::runtime_error("Compressed clips only store translation, rotation, and scale");
+	}
+}
+
+const std::vector<uint32_t>& CompressedClip::nodes(TrackChannel channel) const {
+	return channels(channel).node;
+}
+
+size_t CompressedClip::bytes() const {
+	return m_translations.bytes() + m_rotations.bytes() + m_scales.bytes()
+		+ sizeof(CompressedClip) + m_name.size();
+}
+
+glm::vec4 CompressedClip::decodeKey(TrackChannel channel, size_t key) const {
+	const uint16_t* value = &channels(channel).keyValues[key * 3];
+	switch (channel) {
+	case TrackChannel::Rotation:
+		return decodeSmallestThree(value);
+	case TrackChannel::Translation:
+		return glm::vec4(dequantize16(value[0], m_translationMin.x, m_translationExtent.x),
+			dequantize16(value[1], m_translationMin.y, m_translationExtent.y),
+			dequantize16(value[2], m_translationMin.z, m_translationExtent.z), 0);
+	default:
+		return glm::vec4(dequantize16(value[0], m_scaleMin.x, m_scaleExtent.x),
+			dequantize16(value[1], m_scaleMin.y, m_scaleExtent.y),
+			dequantize16(value[2], m_scaleMin.z, m_scaleExtent.z), 0);
+	}
+}
+
+void CompressedClip::gather(TrackChannel channel, float_t time, Vec4Lanes& from, Vec4Lanes& to,
+	std::vector<float_t>& alpha) const {
+	const ChannelSet& set = channels(channel);
+	size_t count = set.node.size();
+	from.resize(count);
+	to.resize(count);
+	alpha.resize(count);
+
+	float_t quantizedTime = m_duration > 0 ? std::clamp(time / m_duration, 0.0f, 1.0f) * MAX_16_BITS : 0;
+	bool quaternion = channel == TrackChannel::Rotation;
+	for (size_t c = 0; c < count; c++) {
+		size_t a, b;
+		bracket(set, c, quantizedTime, a, b, alpha[c]);
+		glm::vec4 fromValue = decodeKey(channel, a);
+		glm::vec4 toValue = a == b ? fromValue : decodeKey(channel, b);
+		if (quaternion && glm::dot(fromValue, toValue) < 0) {
+			toValue = -1.0f * toValue;
+		}
+		from.set(c, fromValue);
+		to.set(c, toValue);
+	}
+}
+
+/**
+ * @brief Expands the given range to include every value of a raw channel set.
+ */
+static void extendRange(const SkeletalClip::ChannelSet& set, glm::vec3& min, glm::vec3& max) {
+	for (size_t k = 0; k < set.keyTimes.size(); k++) {
+		glm::vec3 value(set.keyValues.get(k));
+		min = glm::min(min, value);
+		max = glm::max(max, value);
+	}
+}
+
+CompressedClip CompressedClip::compress(const SkeletalClip& clip,
+	const ClipCompressionSettings& settings, ClipCompressionReport& report) {
+	CompressedClip compressed;
+	compressed.m_name = clip.name;
+	compressed.m_duration = clip.duration;
+
+	// Translations and scales are quantized relative to the range of values in this clip.
+	const float_t huge = 1e30f;
+	glm::vec3 min(huge), max(-huge);
+	extendRange(clip.translations, min, max);
+	if (!clip.translations.keyTimes.empty()) {
+		compressed.m_translationMin = min;
+		compressed.m_translationExtent = max - min;
+	}
+	min = glm::vec3(huge);
+	max = glm::vec3(-huge);
+	extendRange(clip.scales, min, max);
+	if (!clip.scales.keyTimes.empty()) {
+		compressed.m_scaleMin = min;
+		compressed.m_scaleExtent = max - min;
+	}
+
+	const TrackChannel kinds[] = { TrackChannel::Translation, TrackChannel::Rotation, TrackChannel::Scale };
+	const SkeletalClip::ChannelSet* sources[] = { &clip.translations, &clip.rotations, &clip.scales };
+	ChannelSet* targets[] = { &compressed.m_translations, &compressed.m_rotations, &compressed.m_scales };
+	const float_t tolerances[] = { settings.translationTolerance, settings.rotationTolerance,
+		settings.scaleTolerance };
+
+	for (size_t kind = 0; kind < 3; kind++) {
+		const SkeletalClip::ChannelSet& source = *sources[kind];
+		ChannelSet& target = *targets[kind];
+		bool quaternion = kinds[kind] == TrackChannel::Rotation;
+		std::vector<glm::vec4> values;
+		for (size_t c = 0; c < source.node.size(); c++) {
+			size_t first = source.firstKey[c];
+			size_t count = source.keyCount[c];
+			values.clear();
+			for (size_t k = 0; k < count; k++) {
+				values.push_back(source.keyValues.get(first + k));
+			}
+			std::vector<size_t> kept = reduceKeys(&source.keyTimes[first], values.data(), count,
+				quaternion, tolerances[kind]);
+
+			target.node.push_back(source.node[c]);
+			target.firstKey.push_back(static_cast<uint32_t>(target.keyTimes.size()));
+			target.keyCount.push_back(static_cast<uint32_t>(kept.size()));
+			for (size_t k : kept) {
+				target.keyTimes.push_back(quantize16(source.keyTimes[first + k], 0, clip.duration));
+				uint16_t encoded[3];
+				if (quaternion) {
+					encodeSmallestThree(values[k], encoded);
+				}
+				else {
+					const glm::vec3& rangeMin = kind == 0 ? compressed.m_translationMin : compressed.m_scaleMin;
+					const glm::vec3& extent = kind == 0 ? compressed.m_translationExtent : compressed.m_scaleExtent;
+					for (size_t i = 0; i < 3; i++) {
+						encoded[i] = quantize16(values[k][i], rangeMin[i], extent[i]);
+					}
+				}
+				target.keyValues.insert(target.keyValues.end(), encoded, encoded + 3);
+			}
+		}
+	}
+
+	report = compressed.measure(clip);
+	return compressed;
+}
+
+ClipCompressionReport CompressedClip::measure(const SkeletalClip& clip) const {
+	ClipCompressionReport report;
+	report.name = clip.name;
+	const TrackChannel kinds[] = { TrackChannel::Translation, TrackChannel::Rotation, TrackChannel::Scale };
+	const SkeletalClip::ChannelSet* sources[] = { &clip.translations, &clip.rotations, &clip.scales };
+	for (size_t kind = 0; kind < 3; kind++) {
+		const SkeletalClip::ChannelSet& source = *sources[kind];
+		const ChannelSet& target = channels(kinds[kind]);
+		if (target.node != source.node) {
+			throw std::runtime_error("Compressed animation clip " + m_name + " animates other nodes than the clip");
+		}
+		bool quaternion = kinds[kind] == TrackChannel::Rotation;
+		report.rawBytes += source.node.size() * 3 * sizeof(uint32_t)
+			+ source.keyTimes.size() * (sizeof(float_t) + 4 * sizeof(float_t));
+		report.rawKeys += source.keyTimes.size();
+		report.keptKeys += target.keyTimes.size();
+
+		// The real error at every original key, including quantization.
+		float_t& maxError = kind == 0 ? report.maxTranslationError
+			: kind == 1 ? report.maxRotationError : report.maxScaleError;
+		for (size_t c = 0; c < source.node.size(); c++) {
+			for (size_t k = 0; k < source.keyCount[c]; k++) {
+				size_t key = source.firstKey[c] + k;
+				float_t time = source.keyTimes[key];
+				float_t quantizedTime = clip.duration > 0
+					? std::clamp(time / clip.duration, 0.0f, 1.0f) * MAX_16_BITS : 0;
+				size_t a, b;
+				float_t alpha;
+				bracket(target, c, quantizedTime, a, b, alpha);
+				glm::vec4 sampled = interpolate(decodeKey(kinds[kind], a), decodeKey(kinds[kind], b), alpha, quaternion);
+				glm::vec4 original = source.keyValues.get(key);
+				maxError = std::max(maxError, quaternion ? rotationError(sampled, original)
+					: vectorError(sampled, original));
+			}
+		}
+	}
+	report.compressedBytes = bytes();
+	return report;
+}
+
+template <typename T>
+static void writeVector(std::ostream& out, const std::vector<T>& values) {
+	uint32_t size = static_cast<uint32_t>(values.size());
+	out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	out.write(reinterpret_cast<const char*>(values.data()), size * sizeof(T));
+}
+
+/**
+ * @brief Reads a vector written by writeVector. The stored size is not trusted: the vector
+ * grows a block at a time as its elements are read, so a corrupt size fails as a truncated
+ * stream rather than allocating whatever it claims.
+ */
+template <typename T>
+static void readVector(std::istream& in, std::vector<T>& values) {
+	const size_t blockSize = 65536;
+	uint32_t size = 0;
+	in.read(reinterpret_cast<char*>(&size), sizeof(size));
+	values.clear();
+	while (in && values.size() < size) {
+		size_t start = values.size();
+		values.resize(start + std::min<size_t>(blockSize, size - start));
+		in.read(reinterpret_cast<char*>(values.data() + start), (values.size() - start) * sizeof(T));
+	}
+}
+
+template <typename T>
+static void writeValue(std::ostream& out, const T& value) {
+	out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static void readValue(std::istream& in, T& value) {
+	in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+void CompressedClip::save(std::ostream& out) const {
+	writeValue(out, CLIP_FILE_MAGIC);
+	std::vector<char> name(m_name.begin(), m_name.end());
+	writeVector(out, name);
+	writeValue(out, m_duration);
+	writeValue(out, m_translationMin);
+	writeValue(out, m_translationExtent);
+	writeValue(out, m_scaleMin);
+	writeValue(out, m_scaleExtent);
+	for (const ChannelSet* set : { &m_translations, &m_rotations, &m_scales }) {
+		writeVector(out, set->node);
+		writeVector(out, set->firstKey);
+		writeVector(out, set->keyCount);
+		writeVector(out, set->keyTimes);
+		writeVector(out, set->keyValues);
+	}
+}
+
+CompressedClip CompressedClip::load(std::istream& in, size_t nodeCount) {
+	uint32_t magic = 0;
+	readValue(in, magic);
+	if (magic != CLIP_FILE_MAGIC) {
+		throw std::runtime_error("Not a compressed animation clip");
+	}
+	CompressedClip clip;
+	std::vector<char> name;
+	readVector(in, name);
+	clip.m_name.assign(name.begin(), name.end());
+	readValue(in, clip.m_duration);
+	readValue(in, clip.m_translationMin);
+	readValue(in, clip.m_translationExtent);
+	readValue(in, clip.m_scaleMin);
+	readValue(in, clip.m_scaleExtent);
+	for (ChannelSet* set : { &clip.m_translations, &clip.m_rotations, &clip.m_scales }) {
+		readVector(in, set->node);
+		readVector(in, set->firstKey);
+		readVector(in, set->keyCount);
+		readVector(in, set->keyTimes);
+		readVector(in, set->keyValues);
+	}
+	if (!in) {
+		throw std::runtime_error("Compressed animation clip is truncated");
+	}
+	if (!std::isfinite(clip.m_duration) || clip.m_duration < 0) {
+		throw std::runtime_error("Compressed animation clip has a bad duration");
+	}
+
+	// Every channel must have keys, all within the key pool, which has three values per key.
+	for (const ChannelSet* set : { &clip.m_translations, &clip.m_rotations, &clip.m_scales }) {
+		size_t channelCount = set->node.size();
+		if (set->firstKey.size() != channelCount || set->keyCount.size() != channelCount
+			|| set->keyValues.size() != set->keyTimes.size() * 3) {
+			throw std::runtime_error("Compressed animation clip has mismatched channel tables");
+		}
+		for (size_t c = 0; c < channelCount; c++) {
+			// Sampling writes each channel into the pose at its node.
+			if (set->node[c] >= nodeCount) {
+				throw std::runtime_error("Compressed animation clip animates a node the skeleton does not have");
+			}
+			if (set->keyCount[c] == 0
+				|| static_cast<uint64_t>(set->firstKey[c]) + set->keyCount[c] > set->keyTimes.size()) {
+				throw std::runtime_error("Compressed animation clip has a channel outside its keys");
+			}
+		}
+	}
+	return clip;
+}
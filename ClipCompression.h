@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "KeyframeTracks.h"
+
+struct SkeletalClip;
+
+/**
+ * @brief The error each compressed channel is allowed to introduce when dropping keys.
+ */
+struct ClipCompressionSettings {
+	// Maximum translation error, in model units.
+	float_t translationTolerance = 0.001f;
+	// Maximum rotation error, in radians.
+	float_t rotationTolerance = 0.001f;
+	// Maximum scale error, as a factor.
+	float_t scaleTolerance = 0.001f;
+};
+
+/**
+ * @brief The result of compressing one clip: how much smaller it got, and the worst error
+ * measured at every original key after compression (including quantization error).
+ */
+struct ClipCompressionReport {
+	std::string name;
+	size_t rawKeys = 0;
+	size_t keptKeys = 0;
+	size_t rawBytes = 0;
+	size_t compressedBytes = 0;
+	float_t maxTranslationError = 0;
+	float_t maxRotationError = 0;
+	float_t maxScaleError = 0;
+
+	double ratio() const {
+		return compressedBytes > 0 ? static_cast<double>(rawBytes) / compressedBytes : 0;
+	}
+
+	/**
+	 * @brief A one-line summary of the report.
+	 */
+	std::string describe() const;
+};
+
+/**
+ * @brief A skeletal animation clip in compressed form. Redundant keys are removed within the
+ * compression tolerances; key times are quantized to 16 bits over the clip's duration;
+ * rotations are stored as 48-bit "smallest three" quaternions; translations and scales are
+ * quantized to 16 bits per component relative to the clip's range of values. The clip is
+ * sampled directly in this form, decoding only the two keys bracketing the sample time.
+ */
+class CompressedClip {
+public:
+	/**
+	 * @brief The channels animating one component, with their keys in contiguous ranges of a
+	 * shared pool. Each key has one time and three 16-bit values.
+	 */
+	struct ChannelSet {
+		std::vector<uint32_t> node;
+		std::vector<uint32_t> firstKey;
+		std::vector<uint32_t> keyCount;
+		std::vector<uint16_t> keyTimes;
+		std::vector<uint16_t> keyValues;
+
+		size_t bytes() const;
+	};
+
+private:
+	std::string m_name;
+	float_t m_duration;
+	// The per-clip quantization ranges of translations and scales.
+	glm::vec3 m_translationMin;
+	glm::vec3 m_translationExtent;
+	glm::vec3 m_scaleMin;
+	glm::vec3 m_scaleExtent;
+	ChannelSet m_translations;
+	ChannelSet m_rotations;
+	ChannelSet m_scales;
+
+	const ChannelSet& channels(TrackChannel channel) const;
+
+public:
+	CompressedClip();
+
+	/**
+	 * @brief Compresses a clip, filling in a report of the savings and the error introduced.
+	 */
+	static CompressedClip compress(const SkeletalClip& clip, const ClipCompressionSettings& settings,
+		ClipCompressionReport& report);
+
+	/**
+	 * @brief Measures the compressed clip against the raw clip it was made from: the keys and
+	 * bytes of each, and the worst error at every raw key. Throws std::runtime_error if the two
+	 * do not animate the same nodes in the same order.
+	 */
+	ClipCompressionReport measure(const SkeletalClip& clip) const;
+
+	const std::string& name() const { return m_name; }
+	float_t duration() const { return m_duration; }
+
+	/**
+	 * @brief The total size of the compressed keys and channel tables, in bytes.
+	 */
+	size_t bytes() const;
+
+	/**
+	 * @brief The skeleton node animated by each channel of the given component, which must be
+	 * Translation, Rotation, or Scale.
+	 */
+	const std::vector<uint32_t>& nodes(TrackChannel channel) const;
+
+	/**
+	 * @brief Decodes one key of the given component. Rotations are (x, y, z, w) quaternions;
+	 * translations and scales are (x, y, z, 0).
+	 */
+	glm::vec4 decodeKey(TrackChannel channel, size_t key) const;
+
+	/**
+	 * @brief Finds and decodes the two keys bracketing the given time in every channel of the
+	 * given component, for batched interpolation with lerpLanes.
+	 */
+	void gather(TrackChannel channel, float_t time, Vec4Lanes& from, Vec4Lanes& to,
+		std::vector<float_t>& alpha) const;
+
+	/**
+	 * @brief Writes the clip to a binary stream, for offline compression.
+	 */
+	void save(std::ostream& out) const;
+
+	/**
+	 * @brief Reads a clip written by save, for a skeleton with the given number of nodes.
+	 * Throws std::runtime_error if the stream is truncated or its tables are inconsistent, or
+	 * the clip animates a node outside the skeleton.
+	 */
+	static CompressedClip load(std::istream& in, size_t nodeCount);
+};
@@ -0,0 +1,252 @@
+#include "ClusteredLighting.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glad/glad.h>
+#include "FrameArena.h"
+#include "GLState.h"
+#include "SimdMath.h"
+
+using ClusterClock = std::chrono::steady_clock;
+
+ClusteredLighting::ClusteredLighting(float_t nearPlane, float_t farPlane, uint32_t tilesX,
+	uint32_t tilesY, uint32_t slices, size_t threadCount)
+	: m_tilesX(tilesX), m_tilesY(tilesY), m_slices(slices), m_near(nearPlane), m_far(farPlane),
+	m_width(1), m_height(1), m_pool(threadCount), m_projection(0), m_sliceBins(slices),
+	m_buffers{ 0, 0, 0 }, m_textures{ 0, 0, 0 } {
+}
+
+ClusteredLighting::~ClusteredLighting() {
+	if (m_buffers[0] != 0) {
+		for (uint32_t texture : m_textures) {
+			GLState::current().deleteTexture(texture);
+		}
+		glDeleteBuffers(3, m_buffers);
+	}
+}
+
+void ClusteredLighting::buildClusterBounds(const glm::mat4& projection) {
+	m_projection = projection;
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	m_clusterMin.resize(clusterCount());
+	m_clusterMax.resize(clusterCount());
+
+	// The view-space direction through each tile corner, scaled to unit depth.
+	std::vector<glm::vec3> corners((m_tilesX + 1) * (m_tilesY + 1));
+	for (uint32_t y = 0; y <= m_tilesY; y++) {
+		for (uint32_t x = 0; x <= m_tilesX; x++) {
+			glm::vec4 ndc(-1 + 2.0f * x / m_tilesX, -1 + 2.0f * y / m_tilesY, -1, 1);
+			glm::vec4 onNear = inverseProjection * ndc;
+			glm::vec3 point = glm::vec3(onNear) / onNear.w;
+			corners[y * (m_tilesX + 1) + x] = point / -point.z;
+		}
+	}
+
+	for (uint32_t slice = 0; slice < m_slices; slice++) {
+		float_t sliceNear = m_near * std::pow(m_far / m_near, static_cast<float_t>(slice) / m_slices);
+		float_t sliceFar = m_near * std::pow(m_far / m_near, static_cast<float_t>(slice + 1) / m_slices);
+		for (uint32_t y = 0; y < m_tilesY; y++) {
+			for (uint32_t x = 0; x < m_tilesX; x++) {
+				size_t cluster = (static_cast<size_t>(slice) * m_tilesY + y) * m_tilesX + x;
+				glm::vec3 low(1e30f, 1e30f, 1e30f);
+				glm::vec3 high(-1e30f, -1e30f, -1e30f);
+				for (uint32_t corner = 0; corner < 4; corner++) {
+					const glm::vec3& direction = corners[(y + corner / 2) * (m_tilesX + 1) + x + corner % 2];
+					low = glm::min(low, glm::min(direction * sliceNear, direction * sliceFar));
+					high = glm::max(high, glm::max(direction * sliceNear, direction * sliceFar));
+				}
+				m_clusterMin[cluster] = low;
+				m_clusterMax[cluster] = high;
+			}
+		}
+	}
+}
+
+void ClusteredLighting::binSlice(uint32_t slice) {
+	SliceBins& bins = m_sliceBins[slice];
+	bins.candidates.clear();
+	for (uint32_t light = 0; light < m_firstSlice.size(); light++) {
+		if (m_firstSlice[light] <= slice && slice <= m_lastSlice[light]) {
+			bins.candidates.push_back(light);
+		}
+	}
+
+	// Gather the candidates' spheres contiguously, padded to a multiple of 4 with spheres of
+	// negative squared radius, which never intersect anything.
+	size_t padded = (bins.candidates.size() + 3) & ~static_cast<size_t>(3);
+	bins.x.resize(padded);
+	bins.y.resize(padded);
+	bins.z.resize(padded);
+	bins.radiusSquared.assign(padded, -1);
+	for (size_t i = 0; i < bins.candidates.size(); i++) {
+		uint32_t light = bins.candidates[i];
+		bins.x[i] = m_centerX[light];
+		bins.y[i] = m_centerY[light];
+		bins.z[i] = m_centerZ[light];
+		bins.radiusSquared[i] = m_radiusSquared[light];
+	}
+
+	size_t tiles = static_cast<size_t>(m_tilesX) * m_tilesY;
+	bins.counts.assign(tiles, 0);
+	bins.indices.clear();
+	for (size_t tile = 0; tile < tiles; tile++) {
+		const glm::vec3& low = m_clusterMin[slice * tiles + tile];
+		const glm::vec3& high = m_clusterMax[slice * tiles + tile];
+		size_t before = bins.indices.size();
+		// A sphere reaches the box if the squared distance from its center to the box, per
+		// axis the amount the center lies outside the box's extent, is within its radius.
+#ifdef SIMD_SSE
+		__m128 lowX = _mm_set1_ps(low.x), lowY = _mm_set1_ps(low.y), lowZ = _mm_set1_ps(low.z);
+		__m128 highX = _mm_set1_ps(high.x), highY = _mm_set1_ps(high.y), highZ = _mm_set1_ps(high.z);
+		__m128 zero = _mm_setzero_ps();
+		for (size_t i = 0; i < padded; i += 4) {
+			__m128 cx = _mm_loadu_ps(&bins.x[i]);
+			__m128 cy = _mm_loadu_ps(&bins.y[i]);
+			__m128 cz = _mm_loadu_ps(&bins.z[i]);
+			__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(lowX, cx), _mm_sub_ps(cx, highX)), zero);
+			__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(lowY, cy), _mm_sub_ps(cy, highY)), zero);
+			__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(lowZ, cz), _mm_sub_ps(cz, highZ)), zero);
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			int mask = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_loadu_ps(&bins.radiusSquared[i])));
+			for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+				if (mask & 1) {
+					bins.indices.push_back(bins.candidates[i + lane]);
+				}
+			}
+		}
+#else
+		for (size_t i = 0; i < bins.candidates.size(); i++) {
+			float_t dx = std::max(std::max(low.x - bins.x[i], bins.x[i] - high.x), 0.0f);
+			float_t dy = std::max(std::max(low.y - bins.y[i], bins.y[i] - high.y), 0.0f);
+			float_t dz = std::max(std::max(low.z - bins.z[i], bins.z[i] - high.z), 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= bins.radiusSquared[i]) {
+				bins.indices.push_back(bins.candidates[i]);
+			}
+		}
+#endif
+		bins.counts[tile] = static_cast<uint32_t>(bins.indices.size() - before);
+	}
+}
+
+void ClusteredLighting::update(const glm::mat4& view, const glm::mat4& projection, uint32_t width,
+	uint32_t height, const std::vector<Light>& lights) {
+	auto start = ClusterClock::now();
+	m_width = std::max<uint32_t>(width, 1);
+	m_height = std::max<uint32_t>(height, 1);
+	if (m_clusterMin.empty() || projection != m_projection) {
+		buildClusterBounds(projection);
+	}
+
+	// Move the lights into view space, and find the depth slices each one reaches.
+	size_t count = lights.size();
+	m_centerX.resize(count);
+	m_centerY.resize(count);
+	m_centerZ.resize(count);
+	m_radiusSquared.resize(count);
+	m_firstSlice.resize(count);
+	m_lastSlice.resize(count);
+	float_t sliceScale = m_slices / std::log(m_far / m_near);
+	auto sliceOf = [&](float_t depth) {
+		float_t slice = std::floor(std::log(std::max(depth, m_near) / m_near) * sliceScale);
+		return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float_t>(m_slices - 1)));
+	};
+	m_lightData.resize(count * 3);
+	for (size_t i = 0; i < count; i++) {
+		const Light& light = lights[i];
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1));
+		m_centerX[i] = center.x;
+		m_centerY[i] = center.y;
+		m_centerZ[i] = center.z;
+		m_radiusSquared[i] = light.range * light.range;
+		float_t nearest = -center.z - light.range;
+		float_t farthest = -center.z + light.range;
+		if (farthest < m_near || nearest > m_far) {
+			m_firstSlice[i] = 1;
+			m_lastSlice[i] = 0;
+		}
+		else {
+			m_firstSlice[i] = sliceOf(nearest);
+			m_lastSlice[i] = sliceOf(farthest);
+		}
+		m_lightData[i * 3] = glm::vec4(light.position, light.range);
+		m_lightData[i * 3 + 1] = glm::vec4(light.color, light.outerCone);
+		m_lightData[i * 3 + 2] = glm::vec4(light.direction, light.innerCone);
+	}
+
+	// Each slice is binned independently, then the slices are merged in order, so the result
+	// does not depend on the number of threads.
+	m_pool.run(m_slices, [this](size_t slice, size_t) {
+		binSlice(static_cast<uint32_t>(slice));
+	});
+
+	size_t tiles = static_cast<size_t>(m_tilesX) * m_tilesY;
+	m_clusterData.resize(clusterCount() * 2);
+	m_lightIndices.clear();
+	m_stats = ClusterStats();
+	ArenaVector<uint8_t> reached(count, 0);
+	for (uint32_t slice = 0; slice < m_slices; slice++) {
+		const SliceBins& bins = m_sliceBins[slice];
+		uint32_t offset = static_cast<uint32_t>(m_lightIndices.size());
+		for (size_t tile = 0; tile < tiles; tile++) {
+			size_t cluster = slice * tiles + tile;
+			m_clusterData[cluster * 2] = offset;
+			m_clusterData[cluster * 2 + 1] = bins.counts[tile];
+			offset += bins.counts[tile];
+			m_stats.maxLightsPerCluster = std::max<size_t>(m_stats.maxLightsPerCluster, bins.counts[tile]);
+		}
+		m_lightIndices.insert(m_lightIndices.end(), bins.indices.begin(), bins.indices.end());
+		for (uint32_t light : bins.indices) {
+			reached[light] = 1;
+		}
+	}
+	m_stats.lights = count;
+	m_stats.assignments = m_lightIndices.size();
+	for (uint8_t r : reached) {
+		m_stats.visibleLights += r;
+	}
+	m_stats.binMs = std::chrono::duration<double, std::milli>(ClusterClock::now() - start).count();
+}
+
+void ClusteredLighting::bind(ShaderProgram& program) {
+	auto start = ClusterClock::now();
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	if (m_buffers[0] == 0) {
+		glGenBuffers(3, m_buffers);
+		glGenTextures(3, m_textures);
+		for (int32_t i = 0; i < 3; i++) {
+			glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]);
+			GLState::current().bindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+			glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_buffers[i]);
+		}
+	}
+
+	// Empty buffers cannot back a texture, so upload at least one element of each.
+	if (m_lightData.empty()) {
+		m_lightData.emplace_back(0, 0, 0, 0);
+	}
+	if (m_lightIndices.empty()) {
+		m_lightIndices.push_back(0);
+	}
+	const void* data[3] = { m_lightData.data(), m_clusterData.data(), m_lightIndices.data() };
+	size_t sizes[3] = { m_lightData.size() * sizeof(glm::vec4), m_clusterData.size() * sizeof(uint32_t),
+		m_lightIndices.size() * sizeof(uint32_t) };
+	const int32_t units[3] = { LIGHT_TEXTURE_UNIT, CLUSTER_TEXTURE_UNIT, LIGHT_INDEX_TEXTURE_UNIT };
+	for (int32_t i = 0; i < 3; i++) {
+		glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+		GLState::current().bindTexture(units[i], GL_TEXTURE_BUFFER, m_textures[i]);
+	}
+
+	program.setUniform("lights", LIGHT_TEXTURE_UNIT);
+	program.setUniform("clusters", CLUSTER_TEXTURE_UNIT);
+	program.setUniform("lightIndices", LIGHT_INDEX_TEXTURE_UNIT);
+	program.setUniform("clusterTilesX", static_cast<int32_t>(m_tilesX));
+	program.setUniform("clusterTilesY", static_cast<int32_t>(m_tilesY));
+	program.setUniform("clusterSlices", static_cast<int32_t>(m_slices));
+	program.setUniform("tileSize", glm::vec2(static_cast<float_t>(m_width) / m_tilesX,
+		static_cast<float_t>(m_height) / m_tilesY));
+	float_t sliceScale = m_slices / std::log(m_far / m_near);
+	program.setUniform("sliceScale", sliceScale);
+	program.setUniform("sliceBias", std::log(m_near) * sliceScale);
+	m_stats.uploadMs = std::chrono::duration<double, std::milli>(ClusterClock::now() - start).count();
+}
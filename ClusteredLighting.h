@@ -0,0 +1,116 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Light.h"
+#include "ShaderProgram.h"
+#include "WorkerPool.h"
+
+/**
+ * @brief The texture units the light, cluster and light index buffer textures are bound to;
+ * above any unit used by a mesh's own textures, and below the bone palette's.
+ */
+const int32_t LIGHT_TEXTURE_UNIT = 12;
+const int32_t CLUSTER_TEXTURE_UNIT = 13;
+const int32_t LIGHT_INDEX_TEXTURE_UNIT = 14;
+
+/**
+ * @brief Statistics of the last ClusteredLighting::update.
+ */
+struct ClusterStats {
+	size_t lights = 0;
+	// Lights reaching at least one cluster.
+	size_t visibleLights = 0;
+	// Light/cluster pairs, i.e. the length of the light index list.
+	size_t assignments = 0;
+	size_t maxLightsPerCluster = 0;
+	double binMs = 0;
+	double uploadMs = 0;
+};
+
+/**
+ * @brief Clustered forward lighting: the view frustum is divided into a grid of screen tiles
+ * and exponentially spaced depth slices, and each frame every light is assigned to the clusters
+ * its range reaches. The fragment shader then loops only over its own cluster's lights, so its
+ * cost grows with the lights per cluster rather than the total number of lights.
+ * OpenGL 3.3 has no storage buffers, so the lights, each cluster's (offset, count) into the
+ * light index list, and the list itself are uploaded as texture buffers.
+ */
+class ClusteredLighting {
+private:
+	uint32_t m_tilesX;
+	uint32_t m_tilesY;
+	uint32_t m_slices;
+	float_t m_near;
+	float_t m_far;
+	uint32_t m_width;
+	uint32_t m_height;
+	WorkerPool m_pool;
+
+	// The view-space bounds of every cluster, rebuilt when the projection changes. Clusters are
+	// ordered by slice, then tile row, then tile column.
+	glm::mat4 m_projection;
+	std::vector<glm::vec3> m_clusterMin;
+	std::vector<glm::vec3> m_clusterMax;
+
+	// The lights' view-space spheres, in structure-of-arrays form for SIMD tests, and the
+	// range of slices each reaches (empty if the light is outside the depth range).
+	std::vector<float_t> m_centerX;
+	std::vector<float_t> m_centerY;
+	std::vector<float_t> m_centerZ;
+	std::vector<float_t> m_radiusSquared;
+	std::vector<uint32_t> m_firstSlice;
+	std::vector<uint32_t> m_lastSlice;
+
+	// Per-slice binning output, written by one worker each and merged in slice order.
+	struct SliceBins {
+		// The lights whose depth range reaches the slice, and their spheres, contiguously.
+		std::vector<uint32_t> candidates;
+		std::vector<float_t> x;
+		std::vector<float_t> y;
+		std::vector<float_t> z;
+		std::vector<float_t> radiusSquared;
+		// The number of lights in each of the slice's clusters, and their indices in order.
+		std::vector<uint32_t> counts;
+		std::vector<uint32_t> indices;
+	};
+	std::vector<SliceBins> m_sliceBins;
+
+	// The data uploaded to the GPU.
+	std::vector<glm::vec4> m_lightData;
+	std::vector<uint32_t> m_clusterData;
+	std::vector<uint32_t> m_lightIndices;
+	uint32_t m_buffers[3];
+	uint32_t m_textures[3];
+	ClusterStats m_stats;
+
+	void buildClusterBounds(const glm::mat4& projection);
+	void binSlice(uint32_t slice);
+
+public:
+	/**
+	 * @brief Constructs a cluster grid for a perspective projection with the given near and far
+	 * planes, binning on the given number of threads.
+	 */
+	ClusteredLighting(float_t nearPlane, float_t farPlane, uint32_t tilesX = 16, uint32_t tilesY = 9,
+		uint32_t slices = 24, size_t threadCount = std::thread::hardware_concurrency());
+	~ClusteredLighting();
+	ClusteredLighting(const ClusteredLighting&) = delete;
+	ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+	/**
+	 * @brief Assigns the lights to clusters for the given camera, on the CPU. Does no GL calls,
+	 * so it may run on any thread.
+	 * @param width, height the size of the viewport in pixels.
+	 */
+	void update(const glm::mat4& view, const glm::mat4& projection, uint32_t width, uint32_t height,
+		const std::vector<Light>& lights);
+
+	/**
+	 * @brief Uploads the last update's results, binds them to their texture units, and sets the
+	 * program's clustering uniforms.
+	 */
+	void bind(ShaderProgram& program);
+
+	const ClusterStats& stats() const { return m_stats; }
+	size_t clusterCount() const { return static_cast<size_t>(m_tilesX) * m_tilesY * m_slices; }
+};
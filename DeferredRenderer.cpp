@@ -0,0 +1,163 @@
+#include "DeferredRenderer.h"
+#include <stdexcept>
+#include <glad/glad.h>
+#include "GLState.h"
+#include "Skeleton.h"
+
+/**
+ * @brief The internal format, format and type of a G-buffer texture.
+ */
+struct TargetFormat {
+	GLenum internalFormat;
+	GLenum format;
+	GLenum type;
+};
+
+static const TargetFormat TARGET_FORMATS[4] = {
+	{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+	{ GL_RG16, GL_RG, GL_UNSIGNED_SHORT },
+	{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+	{ GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT },
+};
+
+// The lighting pass samples G-buffer texture i from texture unit i.
+static const char* const TARGET_SAMPLERS[4] = { "gAlbedo", "gNormal", "gMaterial", "gDepth" };
+
+DeferredRenderer::DeferredRenderer(uint32_t width, uint32_t height)
+	: m_framebuffer(0), m_textures{ 0, 0, 0, 0 }, m_width(width), m_height(height),
+	m_timing(false), m_timed(false) {
+	m_geometry.load("shaders/skinned_light_perspective.vert", "shaders/gbuffer.frag");
+	m_lighting.load("shaders/fullscreen.vert", "shaders/deferred_lighting.frag");
+	m_geometry.activate();
+	m_geometry.setUniform("bonePalette", BONE_PALETTE_TEXTURE_UNIT);
+	m_lighting.activate();
+	for (int32_t i = 0; i < 4; i++) {
+		m_lighting.setUniform(TARGET_SAMPLERS[i], i);
+	}
+	// Samplers of different types may not share a unit, even while unused.
+	m_lighting.setUniform("shadowMap", SHADOW_TEXTURE_UNIT);
+
+	glGenVertexArrays(1, &m_emptyVao);
+	glGenQueries(3, m_timestampQueries);
+	createTargets();
+}
+
+DeferredRenderer::~DeferredRenderer() {
+	deleteTargets();
+	GLState::current().deleteVertexArray(m_emptyVao);
+	glDeleteQueries(3, m_timestampQueries);
+}
+
+void DeferredRenderer::createTargets() {
+	GLint previous;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+	glGenTextures(4, m_textures);
+	for (size_t i = 0; i < 4; i++) {
+		GLState::current().bindTexture(GL_TEXTURE_2D, m_textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, TARGET_FORMATS[i].internalFormat, m_width, m_height, 0,
+			TARGET_FORMATS[i].format, TARGET_FORMATS[i].type, nullptr);
+		// The lighting pass reads exactly one texel per pixel.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		GLenum attachment = i < 3 ? GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i) : GL_DEPTH_ATTACHMENT;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, m_textures[i], 0);
+	}
+	GLState::current().bindTexture(GL_TEXTURE_2D, 0);
+
+	GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, drawBuffers);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+	if (!complete) {
+		throw std::runtime_error("G-buffer framebuffer is incomplete");
+	}
+}
+
+void DeferredRenderer::deleteTargets() {
+	glDeleteFramebuffers(1, &m_framebuffer);
+	for (uint32_t texture : m_textures) {
+		GLState::current().deleteTexture(texture);
+	}
+}
+
+void DeferredRenderer::resize(uint32_t width, uint32_t height) {
+	if (width == m_width && height == m_height) {
+		return;
+	}
+	deleteTargets();
+	m_width = width;
+	m_height = height;
+	createTargets();
+}
+
+void DeferredRenderer::render(ObjectStore& objects, const glm::mat4& view,
+	const glm::mat4& projection, const glm::vec3& viewPosition, ClusteredLighting& lighting,
+	const ShadowCascades* shadows) {
+	GLint target;
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	// The G-buffer covers the target up to the far corner of the viewport, and is drawn with
+	// the same viewport, so the lighting pass reads it at the pixel it shades.
+	resize(static_cast<uint32_t>(viewport[0] + viewport[2]), static_cast<uint32_t>(viewport[1] + viewport[3]));
+	if (m_timing) {
+		glQueryCounter(m_timestampQueries[0], GL_TIMESTAMP);
+	}
+
+	// Geometry pass: no lighting, just the surface attributes of the nearest fragment.
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glEnable(GL_DEPTH_TEST);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	m_geometry.activate();
+	m_geometry.setUniform("view", view);
+	m_geometry.setUniform("projection", projection);
+	for (auto& o : objects) {
+		o.render(m_geometry);
+	}
+	if (m_timing) {
+		glQueryCounter(m_timestampQueries[1], GL_TIMESTAMP);
+	}
+
+	// Lighting pass: one full-screen triangle, shading each pixel of the G-buffer once.
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glDisable(GL_DEPTH_TEST);
+	m_lighting.activate();
+	lighting.bind(m_lighting);
+	if (shadows != nullptr) {
+		shadows->bind(m_lighting);
+	}
+	m_lighting.setUniform("view", view);
+	m_lighting.setUniform("inverseViewProjection", glm::inverse(projection * view));
+	m_lighting.setUniform("viewport", glm::vec4(viewport[0], viewport[1], viewport[2], viewport[3]));
+	m_lighting.setUniform("viewPos", viewPosition);
+	GLState& state = GLState::current();
+	for (uint32_t i = 0; i < 4; i++) {
+		state.bindTexture(i, GL_TEXTURE_2D, m_textures[i]);
+	}
+	state.bindVertexArray(m_emptyVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glEnable(GL_DEPTH_TEST);
+
+	if (m_timing) {
+		glQueryCounter(m_timestampQueries[2], GL_TIMESTAMP);
+		m_timed = true;
+	}
+}
+
+DeferredTimings DeferredRenderer::timings() const {
+	if (!m_timed) {
+		return DeferredTimings{ 0, 0 };
+	}
+	GLuint64 stamps[3];
+	for (size_t i = 0; i < 3; i++) {
+		glGetQueryObjectui64v(m_timestampQueries[i], GL_QUERY_RESULT, &stamps[i]);
+	}
+	return DeferredTimings{ (stamps[1] - stamps[0]) / 1e6, (stamps[2] - stamps[1]) / 1e6 };
+}
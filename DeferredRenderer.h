@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "ClusteredLighting.h"
+#include "ObjectStore.h"
+#include "ShaderProgram.h"
+#include "ShadowCascades.h"
+
+/**
+ * @brief Whether a scene is shaded as its fragments are rasterized (forward), or by first
+ * writing a G-buffer and then lighting each pixel once in a screen-space pass (deferred).
+ */
+enum class RenderPath {
+	Forward,
+	Deferred
+};
+
+/**
+ * @brief GPU time spent in each pass of the last deferred frame, in milliseconds.
+ */
+struct DeferredTimings {
+	double geometryMs;
+	double lightingMs;
+};
+
+/**
+ * @brief Renders scenes through a deferred pipeline. The geometry pass writes a compact
+ * G-buffer of 12 bytes per pixel plus depth:
+ * - RGBA8: albedo, and the material's ambient reflection;
+ * - RG16: the world-space normal, octahedral-encoded;
+ * - RGBA8: the material's diffuse and specular reflection, and shininess / 255.
+ * Positions are not stored; the lighting pass reconstructs them from the depth buffer. It
+ * then shades every covered pixel once, with the ambient and directional lights and the
+ * point and spot lights of its ClusteredLighting tile, so overdraw costs only G-buffer
+ * writes instead of lighting.
+ */
+class DeferredRenderer {
+private:
+	uint32_t m_framebuffer;
+	// Albedo, normal, material, and depth textures.
+	uint32_t m_textures[4];
+	uint32_t m_width;
+	uint32_t m_height;
+
+	ShaderProgram m_geometry;
+	ShaderProgram m_lighting;
+	// The full-screen pass has no vertex attributes, but core profiles still need a VAO.
+	uint32_t m_emptyVao;
+
+	// Timestamps at the start of the geometry pass, the lighting pass, and the end.
+	uint32_t m_timestampQueries[3];
+	bool m_timing;
+	bool m_timed;
+
+	void createTargets();
+	void deleteTargets();
+
+public:
+	/**
+	 * @brief Loads the deferred shaders and creates a G-buffer of the given size, in the
+	 * current context. Throws if the shaders fail to load or the G-buffer is incomplete.
+	 */
+	DeferredRenderer(uint32_t width, uint32_t height);
+	~DeferredRenderer();
+	DeferredRenderer(const DeferredRenderer&) = delete;
+	DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+	/**
+	 * @brief Recreates the G-buffer if the size changed.
+	 */
+	void resize(uint32_t width, uint32_t height);
+
+	/**
+	 * @brief The program of the geometry pass, for per-scene material uniforms.
+	 */
+	ShaderProgram& geometryProgram() { return m_geometry; }
+
+	/**
+	 * @brief The program of the lighting pass, for the ambient and directional lights.
+	 */
+	ShaderProgram& lightingProgram() { return m_lighting; }
+
+	/**
+	 * @brief Whether each frame records timestamps of its passes, for timings.
+	 */
+	void setTiming(bool enabled) { m_timing = enabled; }
+
+	/**
+	 * @brief Draws the objects into the G-buffer, then lights them into the framebuffer and
+	 * viewport that were bound when this was called, first resizing the G-buffer to fit the
+	 * viewport if it changed. Binds the lights, and the shadows if there are any, to the
+	 * lighting pass.
+	 */
+	void render(ObjectStore& objects, const glm::mat4& view, const glm::mat4& projection,
+		const glm::vec3& viewPosition, ClusteredLighting& lighting, const ShadowCascades* shadows);
+
+	/**
+	 * @brief The GPU time of each pass of the last frame rendered with timing enabled,
+	 * waiting for the GPU to finish it; or zeros if there is none.
+	 */
+	DeferredTimings timings() const;
+};
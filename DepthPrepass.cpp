@@ -0,0 +1,149 @@
+#include "DepthPrepass.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <glad/glad.h>
+#include "Skeleton.h"
+
+using PrepassClock = std::chrono::steady_clock;
+
+std::string PrepassStats::describe() const {
+	std::ostringstream out;
+	out << draws << " draws, " << shadedSamples << " samples shaded";
+	if (enabled) {
+		out.precision(3);
+		out << " of " << depthSamples << " passing the depth pre-pass (" << savedSamples()
+			<< " saved); sorted in " << sortMs << " ms";
+	}
+	else {
+		out << ", no pre-pass";
+	}
+	return out.str();
+}
+
+DepthPrepass::DepthPrepass(const ShaderProgram& shadingProgram)
+	: m_enabled(false), m_pending(false), m_pendingEnabled(false), m_pendingDraws(0),
+	m_pendingSortMs(0) {
+	m_depthProgram.load(shadingProgram.vertexShaderPath(), "shaders/depth_only.frag");
+	m_depthProgram.activate();
+	m_depthProgram.setUniform("bonePalette", BONE_PALETTE_TEXTURE_UNIT);
+	glGenQueries(2, m_queries);
+}
+
+DepthPrepass::~DepthPrepass() {
+	glDeleteQueries(2, m_queries);
+}
+
+static void drawAll(ShaderProgram& program, const ArenaVector<DrawItem>& draws) {
+	for (auto& draw : draws) {
+		program.setUniform("model", draw.model);
+		draw.mesh->render(program);
+	}
+}
+
+// Draws positions only: skinned meshes are posed, but no textures are bound or samplers set.
+static void drawAllDepth(ShaderProgram& program, const ArenaVector<DrawItem>& draws) {
+	for (auto& draw : draws) {
+		program.setUniform("model", draw.model);
+		draw.mesh->renderDepth(program);
+	}
+}
+
+void DepthPrepass::render(const ObjectStore& objects, ShaderProgram& program,
+	const glm::mat4& view, const glm::mat4& projection) {
+	// Collect the counts of an earlier frame once the GPU has them; never wait for them.
+	if (m_pending) {
+		GLint available = 0;
+		glGetQueryObjectiv(m_queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 depthSamples = 0;
+			GLuint64 shadedSamples = 0;
+			if (m_pendingEnabled) {
+				glGetQueryObjectui64v(m_queries[0], GL_QUERY_RESULT, &depthSamples);
+			}
+			glGetQueryObjectui64v(m_queries[1], GL_QUERY_RESULT, &shadedSamples);
+			m_stats = PrepassStats{ m_pendingEnabled, m_pendingDraws, depthSamples, shadedSamples, m_pendingSortMs };
+			m_pending = false;
+		}
+	}
+	bool startQueries = !m_pending;
+
+	ArenaVector<DrawItem> draws;
+	for (auto& o : objects) {
+		o.collectDraws(glm::mat4(1), draws);
+	}
+
+	if (!m_enabled) {
+		program.activate();
+		if (startQueries) {
+			glBeginQuery(GL_SAMPLES_PASSED, m_queries[1]);
+		}
+		drawAll(program, draws);
+		if (startQueries) {
+			glEndQuery(GL_SAMPLES_PASSED);
+			m_pending = true;
+			m_pendingEnabled = false;
+			m_pendingDraws = draws.size();
+			m_pendingSortMs = 0;
+		}
+		return;
+	}
+
+	// Sort front to back by the view depth of each draw's bounds center.
+	auto sortStart = PrepassClock::now();
+	ArenaVector<std::pair<float_t, uint32_t>> depthOrder(draws.size());
+	for (uint32_t i = 0; i < draws.size(); i++) {
+		const DrawItem& draw = draws[i];
+		glm::vec4 center = view * draw.model * glm::vec4(draw.mesh->boundsCenter(), 1);
+		depthOrder[i] = std::make_pair(-center.z, i);
+	}
+	std::sort(depthOrder.begin(), depthOrder.end());
+	ArenaVector<DrawItem> sorted;
+	sorted.reserve(draws.size());
+	for (auto& entry : depthOrder) {
+		sorted.push_back(draws[entry.second]);
+	}
+	double sortMs = std::chrono::duration<double, std::milli>(PrepassClock::now() - sortStart).count();
+
+	// Depth only: no color writes, and the cheapest possible fragment shader.
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	m_depthProgram.activate();
+	m_depthProgram.setUniform("view", view);
+	m_depthProgram.setUniform("projection", projection);
+	if (startQueries) {
+		glBeginQuery(GL_SAMPLES_PASSED, m_queries[0]);
+	}
+	drawAllDepth(m_depthProgram, sorted);
+	if (startQueries) {
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	// Shade only the fragments that won the depth test, grouped by GL state instead of depth.
+	// Sorting by state and then depth order keeps equal states front to back, as a stable sort
+	// would, without the stable sort's heap buffer.
+	ArenaVector<std::pair<uint64_t, uint32_t>> stateOrder(sorted.size());
+	for (uint32_t i = 0; i < sorted.size(); i++) {
+		stateOrder[i] = std::make_pair(sorted[i].sortKey, i);
+	}
+	std::sort(stateOrder.begin(), stateOrder.end());
+	for (uint32_t i = 0; i < stateOrder.size(); i++) {
+		draws[i] = sorted[stateOrder[i].second];
+	}
+	glDepthFunc(GL_EQUAL);
+	glDepthMask(GL_FALSE);
+	program.activate();
+	if (startQueries) {
+		glBeginQuery(GL_SAMPLES_PASSED, m_queries[1]);
+	}
+	drawAll(program, draws);
+	if (startQueries) {
+		glEndQuery(GL_SAMPLES_PASSED);
+		m_pending = true;
+		m_pendingEnabled = true;
+		m_pendingDraws = draws.size();
+		m_pendingSortMs = sortMs;
+	}
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "FrameArena.h"
+#include "FramePacket.h"
+#include "ObjectStore.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief Fragment counts of the last frame drawn through a DepthPrepass whose occlusion
+ * queries have completed.
+ */
+struct PrepassStats {
+	// Whether the pre-pass was on in that frame.
+	bool enabled = false;
+	size_t draws = 0;
+	// Samples passing the depth test in the depth-only pass, front to back; each of them would
+	// have been shaded without a pre-pass, even with sorted draws.
+	uint64_t depthSamples = 0;
+	// Samples shaded in the shading pass.
+	uint64_t shadedSamples = 0;
+	double sortMs = 0;
+
+	/**
+	 * @brief The fragments the pre-pass kept from being shaded.
+	 */
+	uint64_t savedSamples() const { return depthSamples > shadedSamples ? depthSamples - shadedSamples : 0; }
+
+	std::string describe() const;
+};
+
+/**
+ * @brief Draws scenes with an optional depth pre-pass. When enabled, opaque draws are sorted
+ * front to back by the view depth of their bounds and drawn depth-only, with the shading
+ * program's own vertex shader so positions match exactly; then they are drawn again, in state
+ * order, with depth writes off and GL_EQUAL depth testing, so each pixel is shaded once.
+ * Occlusion queries count the samples passing each pass.
+ */
+class DepthPrepass {
+private:
+	ShaderProgram m_depthProgram;
+	bool m_enabled;
+
+	// Sample queries of the depth and shading passes, read back a frame or more later.
+	uint32_t m_queries[2];
+	bool m_pending;
+	bool m_pendingEnabled;
+	size_t m_pendingDraws;
+	double m_pendingSortMs;
+	PrepassStats m_stats;
+
+public:
+	/**
+	 * @brief Loads a depth-only program from the shading program's vertex shader, in the
+	 * current context. Throws if it fails to load.
+	 */
+	DepthPrepass(const ShaderProgram& shadingProgram);
+	~DepthPrepass();
+	DepthPrepass(const DepthPrepass&) = delete;
+	DepthPrepass& operator=(const DepthPrepass&) = delete;
+
+	bool enabled() const { return m_enabled; }
+	void setEnabled(bool enabled) { m_enabled = enabled; }
+
+	/**
+	 * @brief Draws the objects with the shading program, which must already have all its
+	 * uniforms other than the model matrix; through the pre-pass if it is enabled.
+	 */
+	void render(const ObjectStore& objects, ShaderProgram& program, const glm::mat4& view,
+		const glm::mat4& projection);
+
+	const PrepassStats& stats() const { return m_stats; }
+};
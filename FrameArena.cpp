@@ -0,0 +1,49 @@
+#include "FrameArena.h"
+#include <algorithm>
+
+FrameArena::FrameArena(size_t blockSize)
+	: m_current(0), m_offset(0), m_blockSize(blockSize), m_used(0), m_peak(0) {
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment) {
+	while (m_current < m_blocks.size()) {
+		Block& block = m_blocks[m_current];
+		uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+		size_t aligned = ((base + m_offset + alignment - 1) & ~(alignment - 1)) - base;
+		if (aligned + bytes <= block.size) {
+			m_offset = aligned + bytes;
+			m_used += bytes;
+			m_peak = std::max(m_peak, m_used);
+			return block.data.get() + aligned;
+		}
+		// Move on to the next kept block, if any.
+		m_current++;
+		m_offset = 0;
+	}
+
+	// Out of blocks: add one big enough for this allocation, with room to align it.
+	size_t size = std::max(m_blockSize, bytes + alignment);
+	m_blocks.push_back(Block{ std::unique_ptr<std::byte[]>(new std::byte[size]), size });
+	m_current = m_blocks.size() - 1;
+	m_offset = 0;
+	return allocate(bytes, alignment);
+}
+
+void FrameArena::reset() {
+	m_current = 0;
+	m_offset = 0;
+	m_used = 0;
+}
+
+size_t FrameArena::capacity() const {
+	size_t total = 0;
+	for (auto& block : m_blocks) {
+		total += block.size;
+	}
+	return total;
+}
+
+FrameArena& FrameArena::local() {
+	thread_local FrameArena arena;
+	return arena;
+}
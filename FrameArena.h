@@ -0,0 +1,150 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief A bump allocator for data that lives for one frame. Allocation advances a pointer
+ * through large blocks; nothing is freed individually, and reset() makes all of the memory
+ * reusable at once. Blocks are kept across resets, so a frame that needs no more memory than
+ * earlier frames does no heap allocation. Not thread-safe: give each thread its own arena.
+ */
+class FrameArena {
+private:
+	struct Block {
+		std::unique_ptr<std::byte[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> m_blocks;
+	// The block currently allocated from, and the offset of its first free byte.
+	size_t m_current;
+	size_t m_offset;
+	size_t m_blockSize;
+	// Bytes handed out since the last reset, and the most handed out in any frame.
+	size_t m_used;
+	size_t m_peak;
+
+public:
+	/**
+	 * @brief Constructs an empty arena that allocates blocks of at least the given size.
+	 */
+	explicit FrameArena(size_t blockSize = 1 << 16);
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	/**
+	 * @brief Allocates uninitialized memory, valid until the next reset.
+	 * @param alignment must be a power of two.
+	 */
+	void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+	/**
+	 * @brief Allocates uninitialized space for an array of a trivially destructible type.
+	 */
+	template <typename T>
+	T* allocateArray(size_t count) {
+		static_assert(std::is_trivially_destructible<T>::value, "Arena memory is never destroyed");
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	/**
+	 * @brief Releases every allocation at once, keeping the blocks for reuse.
+	 */
+	void reset();
+
+	size_t bytesUsed() const { return m_used; }
+	size_t peakBytesUsed() const { return m_peak; }
+	size_t capacity() const;
+
+	/**
+	 * @brief The calling thread's own arena, created on first use and freed when the thread
+	 * exits. Each thread resets its arena itself: a frame's thread at the end of the frame,
+	 * and WorkerPool threads at the start of each batch, so what a batch allocates lasts until
+	 * the pool's next run.
+	 */
+	static FrameArena& local();
+};
+
+/**
+ * @brief An STL allocator handing out memory from a FrameArena, so standard containers can
+ * hold per-frame data without touching the heap once the arena has grown. Deallocation does
+ * nothing; a container that grows abandons its old storage until the arena is reset. The
+ * container must be destroyed before the arena is reset.
+ */
+template <typename T>
+class ArenaAllocator {
+private:
+	FrameArena* m_arena;
+
+public:
+	using value_type = T;
+
+	ArenaAllocator() : m_arena(&FrameArena::local()) {}
+	explicit ArenaAllocator(FrameArena& arena) : m_arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(&other.arena()) {}
+
+	T* allocate(size_t count) {
+		return static_cast<T*>(m_arena->allocate(count * sizeof(T), alignof(T)));
+	}
+	void deallocate(T*, size_t) {}
+
+	FrameArena& arena() const { return *m_arena; }
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return m_arena == &other.arena(); }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != &other.arena(); }
+};
+
+/**
+ * @brief A vector in the calling thread's frame arena, unless constructed with another
+ * arena's allocator.
+ */
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/**
+ * @brief A growable array of trivially copyable values, stored in a FrameArena. Growing it
+ * copies into a larger arena allocation, abandoning the old one until the arena is reset.
+ */
+template <typename T>
+class ArenaArray {
+private:
+	FrameArena* m_arena;
+	T* m_items;
+	size_t m_size;
+	size_t m_capacity;
+
+public:
+	explicit ArenaArray(FrameArena& arena) : m_arena(&arena), m_items(nullptr), m_size(0), m_capacity(0) {}
+
+	void push_back(const T& item) {
+		if (m_size == m_capacity) {
+			size_t capacity = m_capacity == 0 ? 64 : m_capacity * 2;
+			T* items = m_arena->allocateArray<T>(capacity);
+			std::copy(m_items, m_items + m_size, items);
+			m_items = items;
+			m_capacity = capacity;
+		}
+		m_items[m_size++] = item;
+	}
+
+	/**
+	 * @brief Empties the array. Call this whenever its arena is reset, since the arena will
+	 * hand the same memory out again.
+	 */
+	void clear() {
+		m_items = nullptr;
+		m_size = 0;
+		m_capacity = 0;
+	}
+
+	size_t size() const { return m_size; }
+	const T* data() const { return m_items; }
+	const T& operator[](size_t index) const { return m_items[index]; }
+};
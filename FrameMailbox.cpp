@@ -0,0 +1,118 @@
+#include "FrameMailbox.h"
+#include <stdexcept>
+
+FrameMailbox::FrameMailbox(size_t bufferCount, bool dropStale)
+	: m_packets(bufferCount), m_states(bufferCount, SlotState::Free), m_dropStale(dropStale),
+	m_closed(false), m_droppedFrames(0) {
+	if (bufferCount < 2) {
+		throw std::runtime_error("A FrameMailbox needs at least two packets");
+	}
+}
+
+size_t FrameMailbox::slotOf(const FramePacket* packet) const {
+	return static_cast<size_t>(packet - m_packets.data());
+}
+
+FramePacket* FrameMailbox::beginWrite() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_closed) {
+		int32_t free = -1;
+		int32_t oldestReady = -1;
+		for (size_t i = 0; i < m_states.size(); i++) {
+			if (m_states[i] == SlotState::Free && free < 0) {
+				free = static_cast<int32_t>(i);
+			}
+			else if (m_states[i] == SlotState::Ready && (oldestReady < 0
+				|| m_packets[i].frameNumber < m_packets[oldestReady].frameNumber)) {
+				oldestReady = static_cast<int32_t>(i);
+			}
+		}
+		if (free < 0 && m_dropStale && oldestReady >= 0) {
+			free = oldestReady;
+			m_droppedFrames++;
+		}
+		if (free >= 0) {
+			m_states[free] = SlotState::Writing;
+			return &m_packets[free];
+		}
+		m_changed.wait(lock);
+	}
+	return nullptr;
+}
+
+void FrameMailbox::endWrite(FramePacket* packet) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_states[slotOf(packet)] = SlotState::Ready;
+	}
+	m_changed.notify_all();
+}
+
+FramePacket* FrameMailbox::beginRead() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_closed) {
+		// Draw the oldest packet, or the newest if stale packets may be dropped.
+		int32_t next = -1;
+		for (size_t i = 0; i < m_states.size(); i++) {
+			if (m_states[i] != SlotState::Ready) {
+				continue;
+			}
+			if (next < 0 || (m_dropStale ? m_packets[i].frameNumber > m_packets[next].frameNumber
+				: m_packets[i].frameNumber < m_packets[next].frameNumber)) {
+				next = static_cast<int32_t>(i);
+			}
+		}
+		if (next >= 0) {
+			if (m_dropStale) {
+				for (size_t i = 0; i < m_states.size(); i++) {
+					if (m_states[i] == SlotState::Ready && static_cast<int32_t>(i) != next) {
+						m_states[i] = SlotState::Free;
+						m_droppedFrames++;
+					}
+				}
+			}
+			m_states[next] = SlotState::Reading;
+			lock.unlock();
+			m_changed.notify_all();
+			return &m_packets[next];
+		}
+		m_changed.wait(lock);
+	}
+	return nullptr;
+}
+
+void FrameMailbox::endRead(FramePacket* packet) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_states[slotOf(packet)] = SlotState::Free;
+	}
+	m_changed.notify_all();
+}
+
+void FrameMailbox::waitIdle() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_changed.wait(lock, [this]() {
+		if (m_closed) {
+			return true;
+		}
+		for (auto state : m_states) {
+			if (state == SlotState::Ready || state == SlotState::Reading) {
+				return false;
+			}
+		}
+		return true;
+	});
+}
+
+void FrameMailbox::close() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+	}
+	m_changed.notify_all();
+}
+
+uint64_t FrameMailbox::droppedFrames() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_droppedFrames;
+}
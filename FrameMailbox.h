@@ -0,0 +1,78 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "FramePacket.h"
+
+/**
+ * @brief A fixed ring of FramePackets handed from one producer thread to one consumer thread.
+ * With two packets the producer fills one while the consumer draws the other; a third packet
+ * lets the producer run a frame ahead when the two sides' frame times jitter.
+ */
+class FrameMailbox {
+private:
+	enum class SlotState : uint8_t {
+		Free,
+		Writing,
+		Ready,
+		Reading
+	};
+
+	std::vector<FramePacket> m_packets;
+	std::vector<SlotState> m_states;
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	bool m_dropStale;
+	bool m_closed;
+	uint64_t m_droppedFrames;
+
+	size_t slotOf(const FramePacket* packet) const;
+
+public:
+	/**
+	 * @brief Constructs a mailbox of the given number of packets, at least 2.
+	 * @param dropStale if true, the producer never waits: when no packet is free it overwrites
+	 * the oldest unread one, and the consumer always draws the newest packet. If false, the
+	 * producer waits for a free packet and every packet is drawn, in order.
+	 */
+	FrameMailbox(size_t bufferCount = 2, bool dropStale = false);
+
+	/**
+	 * @brief Claims a packet to fill, waiting for one if necessary. Returns nullptr once the
+	 * mailbox is closed.
+	 */
+	FramePacket* beginWrite();
+
+	/**
+	 * @brief Publishes a packet claimed with beginWrite to the consumer.
+	 */
+	void endWrite(FramePacket* packet);
+
+	/**
+	 * @brief Claims the next published packet to draw, waiting for one if necessary. Returns
+	 * nullptr once the mailbox is closed.
+	 */
+	FramePacket* beginRead();
+
+	/**
+	 * @brief Returns a packet claimed with beginRead to the producer.
+	 */
+	void endRead(FramePacket* packet);
+
+	/**
+	 * @brief Waits until every published packet has been drawn, so no packet references
+	 * objects the producer is about to destroy.
+	 */
+	void waitIdle();
+
+	/**
+	 * @brief Wakes both threads and makes every later claim return nullptr.
+	 */
+	void close();
+
+	/**
+	 * @brief The number of published packets that were overwritten before being drawn.
+	 */
+	uint64_t droppedFrames();
+};
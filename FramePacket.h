@@ -0,0 +1,33 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Mesh3D.h"
+
+/**
+ * @brief One mesh to draw, with the model matrix it is drawn with. The mesh is referenced, not
+ * copied: meshes hold only GL handles, which the simulation thread never changes once created.
+ */
+struct DrawItem {
+	const Mesh3D* mesh;
+	glm::mat4 model;
+	// The mesh's sortKey, cached for sorting draws.
+	uint64_t sortKey;
+};
+
+/**
+ * @brief Everything the render thread needs to draw one frame, produced by the simulation
+ * thread and never modified once submitted. Packets are recycled by the FrameMailbox, so their
+ * vectors keep their capacity from frame to frame.
+ */
+struct FramePacket {
+	uint64_t frameNumber = 0;
+	glm::mat4 view = glm::mat4(1);
+	glm::mat4 projection = glm::mat4(1);
+	std::vector<DrawItem> draws;
+
+	// When the simulation thread began and finished producing this packet.
+	std::chrono::steady_clock::time_point simulationStart;
+	std::chrono::steady_clock::time_point simulationEnd;
+};
@@ -0,0 +1,63 @@
+#include "Frustum.h"
+#include <algorithm>
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection) {
+	// Gribb and Hartmann: each plane is the fourth row of the matrix plus or minus another row.
+	glm::vec4 rows[4];
+	for (int32_t r = 0; r < 4; r++) {
+		rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	}
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	for (auto& plane : frustum.planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float_t radius) const {
+	for (auto& plane : planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::intersectsBox(const glm::vec3& low, const glm::vec3& high) const {
+	for (auto& plane : planes) {
+		// The corner farthest along the plane's normal is outside only if the whole box is.
+		glm::vec3 corner(plane.x >= 0 ? high.x : low.x, plane.y >= 0 ? high.y : low.y,
+			plane.z >= 0 ? high.z : low.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void transformSphere(const glm::mat4& model, const glm::vec3& center, float_t radius,
+	glm::vec3& worldCenter, float_t& worldRadius) {
+	worldCenter = glm::vec3(model * glm::vec4(center, 1));
+	float_t scale = std::max(glm::length(glm::vec3(model[0])),
+		std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	worldRadius = radius * scale;
+}
+
+void cullDraws(const Frustum& frustum, const std::vector<DrawItem>& draws,
+	std::vector<DrawItem>& visible) {
+	visible.clear();
+	for (auto& draw : draws) {
+		glm::vec3 center;
+		float_t radius;
+		transformSphere(draw.model, draw.mesh->boundsCenter(), draw.mesh->boundsRadius(), center, radius);
+		if (frustum.intersectsSphere(center, radius)) {
+			visible.push_back(draw);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "FramePacket.h"
+
+/**
+ * @brief The six planes bounding a camera's view volume, facing inwards, as (normal, distance)
+ * with normalized normals, so a point p is inside a plane when dot(normal, p) + distance >= 0.
+ */
+struct Frustum {
+	glm::vec4 planes[6];
+
+	/**
+	 * @brief Extracts the planes of a projection * view matrix, in world space.
+	 */
+	static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+	/**
+	 * @brief Whether any part of the sphere may be inside the frustum.
+	 */
+	bool intersectsSphere(const glm::vec3& center, float_t radius) const;
+
+	/**
+	 * @brief Whether any part of the axis-aligned box may be inside the frustum.
+	 */
+	bool intersectsBox(const glm::vec3& low, const glm::vec3& high) const;
+};
+
+/**
+ * @brief Transforms a mesh's bounding sphere by a model matrix, into a sphere that contains
+ * the transformed mesh even under non-uniform scale.
+ */
+void transformSphere(const glm::mat4& model, const glm::vec3& center, float_t radius,
+	glm::vec3& worldCenter, float_t& worldRadius);
+
+/**
+ * @brief Copies the draws whose mesh bounds intersect the frustum into visible, replacing its
+ * contents and keeping their order.
+ */
+void cullDraws(const Frustum& frustum, const std::vector<DrawItem>& draws,
+	std::vector<DrawItem>& visible);
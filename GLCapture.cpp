@@ -0,0 +1,1074 @@
+#include "GLCapture.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <glad/glad.h>
+#include "GLState.h"
+
+// 'GLCP', and the stream layout's version.
+static const uint32_t STREAM_MAGIC = 0x50434C47;
+static const uint32_t STREAM_VERSION = 1;
+// The length written for a null payload pointer.
+static const uint32_t NULL_PAYLOAD = 0xFFFFFFFF;
+
+static GLCapture* s_capture = nullptr;
+
+std::string GLCaptureStats::describe() const {
+	std::ostringstream out;
+	out.precision(3);
+	out << calls << " calls in " << frames << " frames, " << bytes / 1048576.0 << " MiB ("
+		<< payloadBytes / 1048576.0 << " MiB of payloads)";
+	return out.str();
+}
+
+/**
+ * @brief The bytes of a width x height x depth image in client memory, with rows aligned as
+ * GL_UNPACK_ALIGNMENT or GL_PACK_ALIGNMENT say.
+ */
+static size_t imageSize(int32_t width, int32_t height, int32_t depth, uint32_t format, uint32_t type,
+	int32_t alignment) {
+	size_t components;
+	switch (format) {
+	case GL_RED:
+	case GL_RED_INTEGER:
+	case GL_DEPTH_COMPONENT:
+	case GL_DEPTH_STENCIL:
+		components = 1;
+		break;
+	case GL_RG:
+	case GL_RG_INTEGER:
+		components = 2;
+		break;
+	case GL_RGB:
+	case GL_BGR:
+	case GL_RGB_INTEGER:
+		components = 3;
+		break;
+	case GL_RGBA:
+	case GL_BGRA:
+	case GL_RGBA_INTEGER:
+		components = 4;
+		break;
+	default:
+		throw std::runtime_error("Cannot capture pixels of format " + std::to_string(format));
+	}
+	size_t pixelSize;
+	switch (type) {
+	case GL_UNSIGNED_BYTE:
+	case GL_BYTE:
+		pixelSize = components;
+		break;
+	case GL_UNSIGNED_SHORT:
+	case GL_SHORT:
+	case GL_HALF_FLOAT:
+		pixelSize = components * 2;
+		break;
+	case GL_UNSIGNED_INT:
+	case GL_INT:
+	case GL_FLOAT:
+		pixelSize = components * 4;
+		break;
+	case GL_UNSIGNED_INT_24_8:
+	case GL_UNSIGNED_INT_8_8_8_8:
+	case GL_UNSIGNED_INT_8_8_8_8_REV:
+		pixelSize = 4;
+		break;
+	default:
+		throw std::runtime_error("Cannot capture pixels of type " + std::to_string(type));
+	}
+	if (width <= 0 || height <= 0 || depth <= 0) {
+		return 0;
+	}
+	size_t rowSize = width * pixelSize;
+	size_t rowStride = (rowSize + alignment - 1) / alignment * alignment;
+	// The last row is not padded, and may end exactly at the end of the client's memory.
+	return rowStride * (static_cast<size_t>(height) * depth - 1) + rowSize;
+}
+
+// The functions GLCapture replaces, saved so the recorders can call them.
+static PFNGLACTIVETEXTUREPROC realActiveTexture;
+static PFNGLATTACHSHADERPROC realAttachShader;
+static PFNGLBEGINQUERYPROC realBeginQuery;
+static PFNGLBINDBUFFERPROC realBindBuffer;
+static PFNGLBINDFRAMEBUFFERPROC realBindFramebuffer;
+static PFNGLBINDRENDERBUFFERPROC realBindRenderbuffer;
+static PFNGLBINDTEXTUREPROC realBindTexture;
+static PFNGLBINDVERTEXARRAYPROC realBindVertexArray;
+static PFNGLBUFFERDATAPROC realBufferData;
+static PFNGLBUFFERSUBDATAPROC realBufferSubData;
+static PFNGLCLEARPROC realClear;
+static PFNGLCOLORMASKPROC realColorMask;
+static PFNGLCOMPILESHADERPROC realCompileShader;
+static PFNGLCREATEPROGRAMPROC realCreateProgram;
+static PFNGLCREATESHADERPROC realCreateShader;
+static PFNGLDELETEBUFFERSPROC realDeleteBuffers;
+static PFNGLDELETEFRAMEBUFFERSPROC realDeleteFramebuffers;
+static PFNGLDELETEQUERIESPROC realDeleteQueries;
+static PFNGLDELETERENDERBUFFERSPROC realDeleteRenderbuffers;
+static PFNGLDELETESHADERPROC realDeleteShader;
+static PFNGLDELETETEXTURESPROC realDeleteTextures;
+static PFNGLDELETEVERTEXARRAYSPROC realDeleteVertexArrays;
+static PFNGLDEPTHFUNCPROC realDepthFunc;
+static PFNGLDEPTHMASKPROC realDepthMask;
+static PFNGLDISABLEPROC realDisable;
+static PFNGLDRAWARRAYSPROC realDrawArrays;
+static PFNGLDRAWBUFFERPROC realDrawBuffer;
+static PFNGLDRAWBUFFERSPROC realDrawBuffers;
+static PFNGLDRAWELEMENTSPROC realDrawElements;
+static PFNGLENABLEPROC realEnable;
+static PFNGLENABLEVERTEXATTRIBARRAYPROC realEnableVertexAttribArray;
+static PFNGLENDQUERYPROC realEndQuery;
+static PFNGLFINISHPROC realFinish;
+static PFNGLFRAMEBUFFERRENDERBUFFERPROC realFramebufferRenderbuffer;
+static PFNGLFRAMEBUFFERTEXTURE2DPROC realFramebufferTexture2D;
+static PFNGLFRAMEBUFFERTEXTURELAYERPROC realFramebufferTextureLayer;
+static PFNGLGENBUFFERSPROC realGenBuffers;
+static PFNGLGENFRAMEBUFFERSPROC realGenFramebuffers;
+static PFNGLGENQUERIESPROC realGenQueries;
+static PFNGLGENRENDERBUFFERSPROC realGenRenderbuffers;
+static PFNGLGENTEXTURESPROC realGenTextures;
+static PFNGLGENVERTEXARRAYSPROC realGenVertexArrays;
+static PFNGLGENERATEMIPMAPPROC realGenerateMipmap;
+static PFNGLGETQUERYOBJECTIVPROC realGetQueryObjectiv;
+static PFNGLGETQUERYOBJECTUI64VPROC realGetQueryObjectui64v;
+static PFNGLGETUNIFORMLOCATIONPROC realGetUniformLocation;
+static PFNGLLINKPROGRAMPROC realLinkProgram;
+static PFNGLPIXELSTOREIPROC realPixelStorei;
+static PFNGLPOLYGONOFFSETPROC realPolygonOffset;
+static PFNGLQUERYCOUNTERPROC realQueryCounter;
+static PFNGLREADBUFFERPROC realReadBuffer;
+static PFNGLREADPIXELSPROC realReadPixels;
+static PFNGLRENDERBUFFERSTORAGEPROC realRenderbufferStorage;
+static PFNGLSHADERSOURCEPROC realShaderSource;
+static PFNGLTEXBUFFERPROC realTexBuffer;
+static PFNGLTEXIMAGE2DPROC realTexImage2D;
+static PFNGLTEXIMAGE3DPROC realTexImage3D;
+static PFNGLTEXPARAMETERFVPROC realTexParameterfv;
+static PFNGLTEXPARAMETERIPROC realTexParameteri;
+static PFNGLUNIFORM1FPROC realUniform1f;
+static PFNGLUNIFORM1IPROC realUniform1i;
+static PFNGLUNIFORM2FVPROC realUniform2fv;
+static PFNGLUNIFORM3FVPROC realUniform3fv;
+static PFNGLUNIFORM4FVPROC realUniform4fv;
+static PFNGLUNIFORMMATRIX2FVPROC realUniformMatrix2fv;
+static PFNGLUNIFORMMATRIX3FVPROC realUniformMatrix3fv;
+static PFNGLUNIFORMMATRIX4FVPROC realUniformMatrix4fv;
+static PFNGLUSEPROGRAMPROC realUseProgram;
+static PFNGLVERTEXATTRIBIPOINTERPROC realVertexAttribIPointer;
+static PFNGLVERTEXATTRIBPOINTERPROC realVertexAttribPointer;
+static PFNGLVIEWPORTPROC realViewport;
+
+/**
+ * @brief Records calls whose arguments are all plain values, written as they are.
+ */
+template <auto Real, GLOp Op>
+struct PlainRecorder;
+
+template <typename... Args, void (APIENTRYP* Real)(Args...), GLOp Op>
+struct PlainRecorder<Real, Op> {
+	static void APIENTRY record(Args... args) {
+		s_capture->writeOp(Op);
+		(s_capture->write(args), ...);
+		(*Real)(args...);
+	}
+};
+
+/**
+ * @brief Records calls that create n objects, with the names GL gave them.
+ */
+template <auto Real, GLOp Op>
+struct GenRecorder {
+	static void APIENTRY record(GLsizei n, GLuint* names) {
+		(*Real)(n, names);
+		s_capture->writeOp(Op);
+		s_capture->write(n);
+		s_capture->writeBytes(names, n * sizeof(GLuint));
+	}
+};
+
+/**
+ * @brief Records calls that delete n objects.
+ */
+template <auto Real, GLOp Op>
+struct DeleteRecorder {
+	static void APIENTRY record(GLsizei n, const GLuint* names) {
+		s_capture->writeOp(Op);
+		s_capture->write(n);
+		s_capture->writeBytes(names, n * sizeof(GLuint));
+		(*Real)(n, names);
+	}
+};
+
+/**
+ * @brief Records glUniform*fv calls, with count arrays of Size floats.
+ */
+template <auto Real, GLOp Op, size_t Size>
+struct UniformRecorder {
+	static void APIENTRY record(GLint location, GLsizei count, const GLfloat* value) {
+		s_capture->writeOp(Op);
+		s_capture->write(location);
+		s_capture->write(count);
+		s_capture->writeBytes(value, count * Size * sizeof(GLfloat));
+		(*Real)(location, count, value);
+	}
+};
+
+/**
+ * @brief Records glUniformMatrix*fv calls, with count matrices of Size floats.
+ */
+template <auto Real, GLOp Op, size_t Size>
+struct UniformMatrixRecorder {
+	static void APIENTRY record(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+		s_capture->writeOp(Op);
+		s_capture->write(location);
+		s_capture->write(count);
+		s_capture->write(transpose);
+		s_capture->writeBytes(value, count * Size * sizeof(GLfloat));
+		(*Real)(location, count, transpose, value);
+	}
+};
+
+/**
+ * @brief Records glGetQueryObject* calls, which wait for the GPU when asking for a result;
+ * the result itself is not recorded.
+ */
+template <auto Real, GLOp Op, typename T>
+struct QueryRecorder {
+	static void APIENTRY record(GLuint id, GLenum pname, T* params) {
+		s_capture->writeOp(Op);
+		s_capture->write(id);
+		s_capture->write(pname);
+		(*Real)(id, pname, params);
+	}
+};
+
+static void APIENTRY recordBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+	s_capture->writeOp(GLOp::BufferData);
+	s_capture->write(target);
+	s_capture->write(static_cast<uint64_t>(size));
+	s_capture->write(usage);
+	s_capture->writePayload(data, size);
+	realBufferData(target, size, data, usage);
+}
+
+static void APIENTRY recordBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+	s_capture->writeOp(GLOp::BufferSubData);
+	s_capture->write(target);
+	s_capture->write(static_cast<uint64_t>(offset));
+	s_capture->writePayload(data, size);
+	realBufferSubData(target, offset, size, data);
+}
+
+static GLuint APIENTRY recordCreateProgram() {
+	GLuint program = realCreateProgram();
+	s_capture->writeOp(GLOp::CreateProgram);
+	s_capture->write(program);
+	return program;
+}
+
+static GLuint APIENTRY recordCreateShader(GLenum type) {
+	GLuint shader = realCreateShader(type);
+	s_capture->writeOp(GLOp::CreateShader);
+	s_capture->write(type);
+	s_capture->write(shader);
+	return shader;
+}
+
+static void APIENTRY recordDrawBuffers(GLsizei n, const GLenum* buffers) {
+	s_capture->writeOp(GLOp::DrawBuffers);
+	s_capture->write(n);
+	s_capture->writeBytes(buffers, n * sizeof(GLenum));
+	realDrawBuffers(n, buffers);
+}
+
+static void APIENTRY recordDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+	// Indices always come from the vertex array's element buffer, so this is an offset.
+	s_capture->writeOp(GLOp::DrawElements);
+	s_capture->write(mode);
+	s_capture->write(count);
+	s_capture->write(type);
+	s_capture->write(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(indices)));
+	realDrawElements(mode, count, type, indices);
+}
+
+static GLint APIENTRY recordGetUniformLocation(GLuint program, const GLchar* name) {
+	GLint location = realGetUniformLocation(program, name);
+	s_capture->writeOp(GLOp::GetUniformLocation);
+	s_capture->write(program);
+	s_capture->write(location);
+	s_capture->writePayload(name, std::strlen(name) + 1);
+	return location;
+}
+
+static void APIENTRY recordPixelStorei(GLenum pname, GLint param) {
+	if (pname == GL_UNPACK_ALIGNMENT) {
+		s_capture->setUnpackAlignment(param);
+	}
+	s_capture->writeOp(GLOp::PixelStorei);
+	s_capture->write(pname);
+	s_capture->write(param);
+	realPixelStorei(pname, param);
+}
+
+static void APIENTRY recordReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format,
+	GLenum type, void* pixels) {
+	// The pixels are read back into scratch memory when replayed, so only the call is recorded.
+	s_capture->writeOp(GLOp::ReadPixels);
+	s_capture->write(x);
+	s_capture->write(y);
+	s_capture->write(width);
+	s_capture->write(height);
+	s_capture->write(format);
+	s_capture->write(type);
+	realReadPixels(x, y, width, height, format, type, pixels);
+}
+
+static void APIENTRY recordShaderSource(GLuint shader, GLsizei count, const GLchar* const* strings,
+	const GLint* lengths) {
+	s_capture->writeOp(GLOp::ShaderSource);
+	s_capture->write(shader);
+	s_capture->write(count);
+	for (GLsizei i = 0; i < count; i++) {
+		size_t length = lengths != nullptr && lengths[i] >= 0 ? lengths[i] : std::strlen(strings[i]);
+		s_capture->writePayload(strings[i], length);
+	}
+	realShaderSource(shader, count, strings, lengths);
+}
+
+static void APIENTRY recordTexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width,
+	GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels) {
+	s_capture->writeOp(GLOp::TexImage2D);
+	s_capture->write(target);
+	s_capture->write(level);
+	s_capture->write(internalFormat);
+	s_capture->write(width);
+	s_capture->write(height);
+	s_capture->write(border);
+	s_capture->write(format);
+	s_capture->write(type);
+	s_capture->writePayload(pixels, pixels == nullptr ? 0
+		: imageSize(width, height, 1, format, type, s_capture->unpackAlignment()));
+	realTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+}
+
+static void APIENTRY recordTexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width,
+	GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels) {
+	s_capture->writeOp(GLOp::TexImage3D);
+	s_capture->write(target);
+	s_capture->write(level);
+	s_capture->write(internalFormat);
+	s_capture->write(width);
+	s_capture->write(height);
+	s_capture->write(depth);
+	s_capture->write(border);
+	s_capture->write(format);
+	s_capture->write(type);
+	s_capture->writePayload(pixels, pixels == nullptr ? 0
+		: imageSize(width, height, depth, format, type, s_capture->unpackAlignment()));
+	realTexImage3D(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+}
+
+static void APIENTRY recordTexParameterfv(GLenum target, GLenum pname, const GLfloat* params) {
+	s_capture->writeOp(GLOp::TexParameterfv);
+	s_capture->write(target);
+	s_capture->write(pname);
+	s_capture->writePayload(params, (pname == GL_TEXTURE_BORDER_COLOR ? 4 : 1) * sizeof(GLfloat));
+	realTexParameterfv(target, pname, params);
+}
+
+/**
+ * @brief Records glVertexAttrib*Pointer calls; the pointer is an offset into the bound buffer.
+ */
+static void APIENTRY recordVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+	GLsizei stride, const void* pointer) {
+	s_capture->writeOp(GLOp::VertexAttribPointer);
+	s_capture->write(index);
+	s_capture->write(size);
+	s_capture->write(type);
+	s_capture->write(normalized);
+	s_capture->write(stride);
+	s_capture->write(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer)));
+	realVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+static void APIENTRY recordVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride,
+	const void* pointer) {
+	s_capture->writeOp(GLOp::VertexAttribIPointer);
+	s_capture->write(index);
+	s_capture->write(size);
+	s_capture->write(type);
+	s_capture->write(stride);
+	s_capture->write(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer)));
+	realVertexAttribIPointer(index, size, type, stride, pointer);
+}
+
+template <typename Proc>
+void GLCapture::hook(Proc& slot, Proc& real, Proc recorder) {
+	real = slot;
+	slot = recorder;
+	m_restore.push_back([&slot, &real]() { slot = real; });
+}
+
+GLCapture::GLCapture(const std::filesystem::path& path)
+	: m_unpackAlignment(4) {
+	if (s_capture != nullptr) {
+		throw std::runtime_error("A GL capture is already running");
+	}
+	m_out.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_out) {
+		throw std::runtime_error("Failed to open " + path.string() + " for writing");
+	}
+	write(STREAM_MAGIC);
+	write(STREAM_VERSION);
+	s_capture = this;
+
+	hook(glad_glActiveTexture, realActiveTexture, PlainRecorder<&realActiveTexture, GLOp::ActiveTexture>::record);
+	hook(glad_glAttachShader, realAttachShader, PlainRecorder<&realAttachShader, GLOp::AttachShader>::record);
+	hook(glad_glBeginQuery, realBeginQuery, PlainRecorder<&realBeginQuery, GLOp::BeginQuery>::record);
+	hook(glad_glBindBuffer, realBindBuffer, PlainRecorder<&realBindBuffer, GLOp::BindBuffer>::record);
+	hook(glad_glBindFramebuffer, realBindFramebuffer, PlainRecorder<&realBindFramebuffer, GLOp::BindFramebuffer>::record);
+	hook(glad_glBindRenderbuffer, realBindRenderbuffer, PlainRecorder<&realBindRenderbuffer, GLOp::BindRenderbuffer>::record);
+	hook(glad_glBindTexture, realBindTexture, PlainRecorder<&realBindTexture, GLOp::BindTexture>::record);
+	hook(glad_glBindVertexArray, realBindVertexArray, PlainRecorder<&realBindVertexArray, GLOp::BindVertexArray>::record);
+	hook(glad_glBufferData, realBufferData, recordBufferData);
+	hook(glad_glBufferSubData, realBufferSubData, recordBufferSubData);
+	hook(glad_glClear, realClear, PlainRecorder<&realClear, GLOp::Clear>::record);
+	hook(glad_glColorMask, realColorMask, PlainRecorder<&realColorMask, GLOp::ColorMask>::record);
+	hook(glad_glCompileShader, realCompileShader, PlainRecorder<&realCompileShader, GLOp::CompileShader>::record);
+	hook(glad_glCreateProgram, realCreateProgram, recordCreateProgram);
+	hook(glad_glCreateShader, realCreateShader, recordCreateShader);
+	hook(glad_glDeleteBuffers, realDeleteBuffers, DeleteRecorder<&realDeleteBuffers, GLOp::DeleteBuffers>::record);
+	hook(glad_glDeleteFramebuffers, realDeleteFramebuffers, DeleteRecorder<&realDeleteFramebuffers, GLOp::DeleteFramebuffers>::record);
+	hook(glad_glDeleteQueries, realDeleteQueries, DeleteRecorder<&realDeleteQueries, GLOp::DeleteQueries>::record);
+	hook(glad_glDeleteRenderbuffers, realDeleteRenderbuffers, DeleteRecorder<&realDeleteRenderbuffers, GLOp::DeleteRenderbuffers>::record);
+	hook(glad_glDeleteShader, realDeleteShader, PlainRecorder<&realDeleteShader, GLOp::DeleteShader>::record);
+	hook(glad_glDeleteTextures, realDeleteTextures, DeleteRecorder<&realDeleteTextures, GLOp::DeleteTextures>::record);
+	hook(glad_glDeleteVertexArrays, realDeleteVertexArrays, DeleteRecorder<&realDeleteVertexArrays, GLOp::DeleteVertexArrays>::record);
+	hook(glad_glDepthFunc, realDepthFunc, PlainRecorder<&realDepthFunc, GLOp::DepthFunc>::record);
+	hook(glad_glDepthMask, realDepthMask, PlainRecorder<&realDepthMask, GLOp::DepthMask>::record);
+	hook(glad_glDisable, realDisable, PlainRecorder<&realDisable, GLOp::Disable>::record);
+	hook(glad_glDrawArrays, realDrawArrays, PlainRecorder<&realDrawArrays, GLOp::DrawArrays>::record);
+	hook(glad_glDrawBuffer, realDrawBuffer, PlainRecorder<&realDrawBuffer, GLOp::DrawBuffer>::record);
+	hook(glad_glDrawBuffers, realDrawBuffers, recordDrawBuffers);
+	hook(glad_glDrawElements, realDrawElements, recordDrawElements);
+	hook(glad_glEnable, realEnable, PlainRecorder<&realEnable, GLOp::Enable>::record);
+	hook(glad_glEnableVertexAttribArray, realEnableVertexAttribArray,
+		PlainRecorder<&realEnableVertexAttribArray, GLOp::EnableVertexAttribArray>::record);
+	hook(glad_glEndQuery, realEndQuery, PlainRecorder<&realEndQuery, GLOp::EndQuery>::record);
+	hook(glad_glFinish, realFinish, PlainRecorder<&realFinish, GLOp::Finish>::record);
+	hook(glad_glFramebufferRenderbuffer, realFramebufferRenderbuffer,
+		PlainRecorder<&realFramebufferRenderbuffer, GLOp::FramebufferRenderbuffer>::record);
+	hook(glad_glFramebufferTexture2D, realFramebufferTexture2D,
+		PlainRecorder<&realFramebufferTexture2D, GLOp::FramebufferTexture2D>::record);
+	hook(glad_glFramebufferTextureLayer, realFramebufferTextureLayer,
+		PlainRecorder<&realFramebufferTextureLayer, GLOp::FramebufferTextureLayer>::record);
+	hook(glad_glGenBuffers, realGenBuffers, GenRecorder<&realGenBuffers, GLOp::GenBuffers>::record);
+	hook(glad_glGenFramebuffers, realGenFramebuffers, GenRecorder<&realGenFramebuffers, GLOp::GenFramebuffers>::record);
+	hook(glad_glGenQueries, realGenQueries, GenRecorder<&realGenQueries, GLOp::GenQueries>::record);
+	hook(glad_glGenRenderbuffers, realGenRenderbuffers, GenRecorder<&realGenRenderbuffers, GLOp::GenRenderbuffers>::record);
+	hook(glad_glGenTextures, realGenTextures, GenRecorder<&realGenTextures, GLOp::GenTextures>::record);
+	hook(glad_glGenVertexArrays, realGenVertexArrays, GenRecorder<&realGenVertexArrays, GLOp::GenVertexArrays>::record);
+	hook(glad_glGenerateMipmap, realGenerateMipmap, PlainRecorder<&realGenerateMipmap, GLOp::GenerateMipmap>::record);
+	hook(glad_glGetQueryObjectiv, realGetQueryObjectiv,
+		QueryRecorder<&realGetQueryObjectiv, GLOp::GetQueryObjectiv, GLint>::record);
+	hook(glad_glGetQueryObjectui64v, realGetQueryObjectui64v,
+		QueryRecorder<&realGetQueryObjectui64v, GLOp::GetQueryObjectui64v, GLuint64>::record);
+	hook(glad_glGetUniformLocation, realGetUniformLocation, recordGetUniformLocation);
+	hook(glad_glLinkProgram, realLinkProgram, PlainRecorder<&realLinkProgram, GLOp::LinkProgram>::record);
+	hook(glad_glPixelStorei, realPixelStorei, recordPixelStorei);
+	hook(glad_glPolygonOffset, realPolygonOffset, PlainRecorder<&realPolygonOffset, GLOp::PolygonOffset>::record);
+	hook(glad_glQueryCounter, realQueryCounter, PlainRecorder<&realQueryCounter, GLOp::QueryCounter>::record);
+	hook(glad_glReadBuffer, realReadBuffer, PlainRecorder<&realReadBuffer, GLOp::ReadBuffer>::record);
+	hook(glad_glReadPixels, realReadPixels, recordReadPixels);
+	hook(glad_glRenderbufferStorage, realRenderbufferStorage,
+		PlainRecorder<&realRenderbufferStorage, GLOp::RenderbufferStorage>::record);
+	hook(glad_glShaderSource, realShaderSource, recordShaderSource);
+	hook(glad_glTexBuffer, realTexBuffer, PlainRecorder<&realTexBuffer, GLOp::TexBuffer>::record);
+	hook(glad_glTexImage2D, realTexImage2D, recordTexImage2D);
+	hook(glad_glTexImage3D, realTexImage3D, recordTexImage3D);
+	hook(glad_glTexParameterfv, realTexParameterfv, recordTexParameterfv);
+	hook(glad_glTexParameteri, realTexParameteri, PlainRecorder<&realTexParameteri, GLOp::TexParameteri>::record);
+	hook(glad_glUniform1f, realUniform1f, PlainRecorder<&realUniform1f, GLOp::Uniform1f>::record);
+	hook(glad_glUniform1i, realUniform1i, PlainRecorder<&realUniform1i, GLOp::Uniform1i>::record);
+	hook(glad_glUniform2fv, realUniform2fv, UniformRecorder<&realUniform2fv, GLOp::Uniform2fv, 2>::record);
+	hook(glad_glUniform3fv, realUniform3fv, UniformRecorder<&realUniform3fv, GLOp::Uniform3fv, 3>::record);
+	hook(glad_glUniform4fv, realUniform4fv, UniformRecorder<&realUniform4fv, GLOp::Uniform4fv, 4>::record);
+	hook(glad_glUniformMatrix2fv, realUniformMatrix2fv,
+		UniformMatrixRecorder<&realUniformMatrix2fv, GLOp::UniformMatrix2fv, 4>::record);
+	hook(glad_glUniformMatrix3fv, realUniformMatrix3fv,
+		UniformMatrixRecorder<&realUniformMatrix3fv, GLOp::UniformMatrix3fv, 9>::record);
+	hook(glad_glUniformMatrix4fv, realUniformMatrix4fv,
+		UniformMatrixRecorder<&realUniformMatrix4fv, GLOp::UniformMatrix4fv, 16>::record);
+	hook(glad_glUseProgram, realUseProgram, PlainRecorder<&realUseProgram, GLOp::UseProgram>::record);
+	hook(glad_glVertexAttribIPointer, realVertexAttribIPointer, recordVertexAttribIPointer);
+	hook(glad_glVertexAttribPointer, realVertexAttribPointer, recordVertexAttribPointer);
+	hook(glad_glViewport, realViewport, PlainRecorder<&realViewport, GLOp::Viewport>::record);
+
+	// Bindings the state cache believes are already made would never reach the stream.
+	GLState::current().invalidate();
+}
+
+GLCapture::~GLCapture() {
+	for (auto& restore : m_restore) {
+		restore();
+	}
+	s_capture = nullptr;
+
+	write(GLOp::End);
+	for (uint64_t offset : m_frameOffsets) {
+		write(offset);
+	}
+	write(static_cast<uint64_t>(m_frameOffsets.size()));
+}
+
+void GLCapture::beginFrame() {
+	m_frameOffsets.push_back(m_stats.bytes);
+	write(GLOp::FrameStart);
+	m_stats.frames++;
+}
+
+void GLCapture::writeOp(GLOp op) {
+	m_stats.calls++;
+	write(op);
+}
+
+void GLCapture::writeBytes(const void* data, size_t size) {
+	m_out.write(static_cast<const char*>(data), size);
+	m_stats.bytes += size;
+}
+
+void GLCapture::writePayload(const void* data, size_t size) {
+	if (data == nullptr) {
+		write(NULL_PAYLOAD);
+		return;
+	}
+	write(static_cast<uint32_t>(size));
+	writeBytes(data, size);
+	m_stats.payloadBytes += size;
+}
+
+GLReplay::GLReplay(const std::filesystem::path& path)
+	: m_setupEnd(0), m_recordsEnd(0), m_cursor(nullptr), m_end(nullptr), m_calls(0), m_program(0) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		throw std::runtime_error("Failed to open " + path.string());
+	}
+	m_data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+	auto corrupt = [&path]() { return std::runtime_error(path.string() + " is not a complete GL capture"); };
+	uint32_t header[2];
+	uint64_t frameCount;
+	if (m_data.size() < sizeof(header) + sizeof(uint16_t) + sizeof(frameCount)) {
+		throw corrupt();
+	}
+	std::memcpy(header, m_data.data(), sizeof(header));
+	if (header[0] != STREAM_MAGIC || header[1] != STREAM_VERSION) {
+		throw corrupt();
+	}
+	std::memcpy(&frameCount, m_data.data() + m_data.size() - sizeof(frameCount), sizeof(frameCount));
+	uint64_t indexSize = (frameCount + 1) * sizeof(uint64_t);
+	if (indexSize > m_data.size() - sizeof(header) - sizeof(uint16_t)) {
+		throw corrupt();
+	}
+	m_recordsEnd = m_data.size() - indexSize - sizeof(uint16_t);
+	m_frameOffsets.resize(frameCount);
+	std::memcpy(m_frameOffsets.data(), m_data.data() + m_recordsEnd + sizeof(uint16_t), frameCount * sizeof(uint64_t));
+	for (uint64_t offset : m_frameOffsets) {
+		if (offset < sizeof(header) || offset > m_recordsEnd) {
+			throw corrupt();
+		}
+	}
+	uint16_t end;
+	std::memcpy(&end, m_data.data() + m_recordsEnd, sizeof(end));
+	if (end != static_cast<uint16_t>(GLOp::End)) {
+		throw corrupt();
+	}
+	m_setupEnd = m_frameOffsets.empty() ? m_recordsEnd : m_frameOffsets[0];
+}
+
+void GLReplay::replaySetup() {
+	replayRange(sizeof(uint32_t) * 2, m_setupEnd);
+}
+
+void GLReplay::replayFrame(size_t frame) {
+	replayRange(m_frameOffsets[frame], frame + 1 < m_frameOffsets.size() ? m_frameOffsets[frame + 1] : m_recordsEnd);
+}
+
+const uint8_t* GLReplay::readBytes(size_t size) {
+	if (static_cast<size_t>(m_end - m_cursor) < size) {
+		throw std::runtime_error("GL capture record runs past its frame");
+	}
+	const uint8_t* bytes = m_cursor;
+	m_cursor += size;
+	return bytes;
+}
+
+template <typename T>
+T GLReplay::read() {
+	T value;
+	std::memcpy(&value, readBytes(sizeof(T)), sizeof(T));
+	return value;
+}
+
+const uint8_t* GLReplay::readPayload(size_t& size) {
+	uint32_t length = read<uint32_t>();
+	if (length == NULL_PAYLOAD) {
+		size = 0;
+		return nullptr;
+	}
+	size = length;
+	return readBytes(length);
+}
+
+uint32_t GLReplay::name(NameKind kind, uint32_t recorded) const {
+	auto found = m_names[kind].find(recorded);
+	// Names the stream did not create, like the default framebuffer, are passed through.
+	return found == m_names[kind].end() ? recorded : found->second;
+}
+
+int32_t GLReplay::location(int32_t recorded) const {
+	auto found = m_locations.find((static_cast<uint64_t>(m_program) << 32) | static_cast<uint32_t>(recorded));
+	return found == m_locations.end() ? recorded : found->second;
+}
+
+template <typename Proc>
+void GLReplay::generate(NameKind kind, Proc gen) {
+	GLsizei n = read<GLsizei>();
+	const uint8_t* recorded = readBytes(n * sizeof(GLuint));
+	std::vector<GLuint> names(n);
+	gen(n, names.data());
+	for (GLsizei i = 0; i < n; i++) {
+		GLuint original;
+		std::memcpy(&original, recorded + i * sizeof(GLuint), sizeof(GLuint));
+		m_names[kind][original] = names[i];
+	}
+}
+
+template <typename Proc>
+void GLReplay::remove(NameKind kind, Proc del) {
+	GLsizei n = read<GLsizei>();
+	const uint8_t* recorded = readBytes(n * sizeof(GLuint));
+	std::vector<GLuint> names(n);
+	for (GLsizei i = 0; i < n; i++) {
+		GLuint original;
+		std::memcpy(&original, recorded + i * sizeof(GLuint), sizeof(GLuint));
+		names[i] = name(kind, original);
+		m_names[kind].erase(original);
+	}
+	del(n, names.data());
+}
+
+void GLReplay::replayRange(uint64_t start, uint64_t end) {
+	m_cursor = m_data.data() + start;
+	m_end = m_data.data() + end;
+	while (m_cursor < m_end) {
+		GLOp op = read<GLOp>();
+		if (op != GLOp::FrameStart) {
+			replayOp(op);
+			m_calls++;
+		}
+	}
+}
+
+void GLReplay::replayOp(GLOp op) {
+	switch (op) {
+	case GLOp::ActiveTexture:
+		glActiveTexture(read<GLenum>());
+		break;
+	case GLOp::AttachShader: {
+		GLuint program = name(Program, read<GLuint>());
+		glAttachShader(program, name(Shader, read<GLuint>()));
+		break;
+	}
+	case GLOp::BeginQuery: {
+		GLenum target = read<GLenum>();
+		glBeginQuery(target, name(Query, read<GLuint>()));
+		break;
+	}
+	case GLOp::BindBuffer: {
+		GLenum target = read<GLenum>();
+		glBindBuffer(target, name(Buffer, read<GLuint>()));
+		break;
+	}
+	case GLOp::BindFramebuffer: {
+		GLenum target = read<GLenum>();
+		glBindFramebuffer(target, name(Framebuffer, read<GLuint>()));
+		break;
+	}
+	case GLOp::BindRenderbuffer: {
+		GLenum target = read<GLenum>();
+		glBindRenderbuffer(target, name(Renderbuffer, read<GLuint>()));
+		break;
+	}
+	case GLOp::BindTexture: {
+		GLenum target = read<GLenum>();
+		glBindTexture(target, name(Texture, read<GLuint>()));
+		break;
+	}
+	case GLOp::BindVertexArray:
+		glBindVertexArray(name(VertexArray, read<GLuint>()));
+		break;
+	case GLOp::BufferData: {
+		GLenum target = read<GLenum>();
+		uint64_t size = read<uint64_t>();
+		GLenum usage = read<GLenum>();
+		size_t payloadSize;
+		const uint8_t* data = readPayload(payloadSize);
+		glBufferData(target, size, data, usage);
+		break;
+	}
+	case GLOp::BufferSubData: {
+		GLenum target = read<GLenum>();
+		uint64_t offset = read<uint64_t>();
+		size_t size;
+		const uint8_t* data = readPayload(size);
+		glBufferSubData(target, offset, size, data);
+		break;
+	}
+	case GLOp::Clear:
+		glClear(read<GLbitfield>());
+		break;
+	case GLOp::ColorMask: {
+		GLboolean r = read<GLboolean>();
+		GLboolean g = read<GLboolean>();
+		GLboolean b = read<GLboolean>();
+		glColorMask(r, g, b, read<GLboolean>());
+		break;
+	}
+	case GLOp::CompileShader:
+		glCompileShader(name(Shader, read<GLuint>()));
+		break;
+	case GLOp::CreateProgram:
+		m_names[Program][read<GLuint>()] = glCreateProgram();
+		break;
+	case GLOp::CreateShader: {
+		GLenum type = read<GLenum>();
+		m_names[Shader][read<GLuint>()] = glCreateShader(type);
+		break;
+	}
+	case GLOp::DeleteBuffers:
+		remove(Buffer, glDeleteBuffers);
+		break;
+	case GLOp::DeleteFramebuffers:
+		remove(Framebuffer, glDeleteFramebuffers);
+		break;
+	case GLOp::DeleteQueries:
+		remove(Query, glDeleteQueries);
+		break;
+	case GLOp::DeleteRenderbuffers:
+		remove(Renderbuffer, glDeleteRenderbuffers);
+		break;
+	case GLOp::DeleteShader: {
+		GLuint shader = read<GLuint>();
+		glDeleteShader(name(Shader, shader));
+		m_names[Shader].erase(shader);
+		break;
+	}
+	case GLOp::DeleteTextures:
+		remove(Texture, glDeleteTextures);
+		break;
+	case GLOp::DeleteVertexArrays:
+		remove(VertexArray, glDeleteVertexArrays);
+		break;
+	case GLOp::DepthFunc:
+		glDepthFunc(read<GLenum>());
+		break;
+	case GLOp::DepthMask:
+		glDepthMask(read<GLboolean>());
+		break;
+	case GLOp::Disable:
+		glDisable(read<GLenum>());
+		break;
+	case GLOp::DrawArrays: {
+		GLenum mode = read<GLenum>();
+		GLint first = read<GLint>();
+		glDrawArrays(mode, first, read<GLsizei>());
+		break;
+	}
+	case GLOp::DrawBuffer:
+		glDrawBuffer(read<GLenum>());
+		break;
+	case GLOp::DrawBuffers: {
+		GLsizei n = read<GLsizei>();
+		std::vector<GLenum> buffers(n);
+		std::memcpy(buffers.data(), readBytes(n * sizeof(GLenum)), n * sizeof(GLenum));
+		glDrawBuffers(n, buffers.data());
+		break;
+	}
+	case GLOp::DrawElements: {
+		GLenum mode = read<GLenum>();
+		GLsizei count = read<GLsizei>();
+		GLenum type = read<GLenum>();
+		glDrawElements(mode, count, type, reinterpret_cast<const void*>(static_cast<uintptr_t>(read<uint64_t>())));
+		break;
+	}
+	case GLOp::Enable:
+		glEnable(read<GLenum>());
+		break;
+	case GLOp::EnableVertexAttribArray:
+		glEnableVertexAttribArray(read<GLuint>());
+		break;
+	case GLOp::EndQuery:
+		glEndQuery(read<GLenum>());
+		break;
+	case GLOp::Finish:
+		glFinish();
+		break;
+	case GLOp::FramebufferRenderbuffer: {
+		GLenum target = read<GLenum>();
+		GLenum attachment = read<GLenum>();
+		GLenum renderbufferTarget = read<GLenum>();
+		glFramebufferRenderbuffer(target, attachment, renderbufferTarget, name(Renderbuffer, read<GLuint>()));
+		break;
+	}
+	case GLOp::FramebufferTexture2D: {
+		GLenum target = read<GLenum>();
+		GLenum attachment = read<GLenum>();
+		GLenum textureTarget = read<GLenum>();
+		GLuint texture = name(Texture, read<GLuint>());
+		glFramebufferTexture2D(target, attachment, textureTarget, texture, read<GLint>());
+		break;
+	}
+	case GLOp::FramebufferTextureLayer: {
+		GLenum target = read<GLenum>();
+		GLenum attachment = read<GLenum>();
+		GLuint texture = name(Texture, read<GLuint>());
+		GLint level = read<GLint>();
+		glFramebufferTextureLayer(target, attachment, texture, level, read<GLint>());
+		break;
+	}
+	case GLOp::GenBuffers:
+		generate(Buffer, glGenBuffers);
+		break;
+	case GLOp::GenFramebuffers:
+		generate(Framebuffer, glGenFramebuffers);
+		break;
+	case GLOp::GenQueries:
+		generate(Query, glGenQueries);
+		break;
+	case GLOp::GenRenderbuffers:
+		generate(Renderbuffer, glGenRenderbuffers);
+		break;
+	case GLOp::GenTextures:
+		generate(Texture, glGenTextures);
+		break;
+	case GLOp::GenVertexArrays:
+		generate(VertexArray, glGenVertexArrays);
+		break;
+	case GLOp::GenerateMipmap:
+		glGenerateMipmap(read<GLenum>());
+		break;
+	// Results are asked for as the program asked for them; a replay running ahead of where the
+	// GPU was during the capture may wait where the program did not.
+	case GLOp::GetQueryObjectiv: {
+		GLuint query = name(Query, read<GLuint>());
+		GLint result;
+		glGetQueryObjectiv(query, read<GLenum>(), &result);
+		break;
+	}
+	case GLOp::GetQueryObjectui64v: {
+		GLuint query = name(Query, read<GLuint>());
+		GLuint64 result;
+		glGetQueryObjectui64v(query, read<GLenum>(), &result);
+		break;
+	}
+	case GLOp::GetUniformLocation: {
+		GLuint program = read<GLuint>();
+		GLint recorded = read<GLint>();
+		size_t size;
+		auto uniform = reinterpret_cast<const GLchar*>(readPayload(size));
+		m_locations[(static_cast<uint64_t>(program) << 32) | static_cast<uint32_t>(recorded)] =
+			glGetUniformLocation(name(Program, program), uniform);
+		break;
+	}
+	case GLOp::LinkProgram:
+		glLinkProgram(name(Program, read<GLuint>()));
+		break;
+	case GLOp::PixelStorei: {
+		GLenum pname = read<GLenum>();
+		glPixelStorei(pname, read<GLint>());
+		break;
+	}
+	case GLOp::PolygonOffset: {
+		GLfloat factor = read<GLfloat>();
+		glPolygonOffset(factor, read<GLfloat>());
+		break;
+	}
+	case GLOp::QueryCounter: {
+		GLuint query = name(Query, read<GLuint>());
+		glQueryCounter(query, read<GLenum>());
+		break;
+	}
+	case GLOp::ReadBuffer:
+		glReadBuffer(read<GLenum>());
+		break;
+	case GLOp::ReadPixels: {
+		GLint x = read<GLint>();
+		GLint y = read<GLint>();
+		GLsizei width = read<GLsizei>();
+		GLsizei height = read<GLsizei>();
+		GLenum format = read<GLenum>();
+		GLenum type = read<GLenum>();
+		GLint alignment;
+		glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+		m_scratch.resize(imageSize(width, height, 1, format, type, alignment));
+		glReadPixels(x, y, width, height, format, type, m_scratch.data());
+		break;
+	}
+	case GLOp::RenderbufferStorage: {
+		GLenum target = read<GLenum>();
+		GLenum format = read<GLenum>();
+		GLsizei width = read<GLsizei>();
+		glRenderbufferStorage(target, format, width, read<GLsizei>());
+		break;
+	}
+	case GLOp::ShaderSource: {
+		GLuint shader = name(Shader, read<GLuint>());
+		GLsizei count = read<GLsizei>();
+		std::vector<const GLchar*> strings(count);
+		std::vector<GLint> lengths(count);
+		for (GLsizei i = 0; i < count; i++) {
+			size_t size;
+			strings[i] = reinterpret_cast<const GLchar*>(readPayload(size));
+			lengths[i] = static_cast<GLint>(size);
+		}
+		glShaderSource(shader, count, strings.data(), lengths.data());
+		break;
+	}
+	case GLOp::TexBuffer: {
+		GLenum target = read<GLenum>();
+		GLenum format = read<GLenum>();
+		glTexBuffer(target, format, name(Buffer, read<GLuint>()));
+		break;
+	}
+	case GLOp::TexImage2D: {
+		GLenum target = read<GLenum>();
+		GLint level = read<GLint>();
+		GLint internalFormat = read<GLint>();
+		GLsizei width = read<GLsizei>();
+		GLsizei height = read<GLsizei>();
+		GLint border = read<GLint>();
+		GLenum format = read<GLenum>();
+		GLenum type = read<GLenum>();
+		size_t size;
+		const uint8_t* pixels = readPayload(size);
+		glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+		break;
+	}
+	case GLOp::TexImage3D: {
+		GLenum target = read<GLenum>();
+		GLint level = read<GLint>();
+		GLint internalFormat = read<GLint>();
+		GLsizei width = read<GLsizei>();
+		GLsizei height = read<GLsizei>();
+		GLsizei depth = read<GLsizei>();
+		GLint border = read<GLint>();
+		GLenum format = read<GLenum>();
+		GLenum type = read<GLenum>();
+		size_t size;
+		const uint8_t* pixels = readPayload(size);
+		glTexImage3D(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+		break;
+	}
+	case GLOp::TexParameterfv: {
+		GLenum target = read<GLenum>();
+		GLenum pname = read<GLenum>();
+		size_t size;
+		const uint8_t* bytes = readPayload(size);
+		GLfloat params[4];
+		std::memcpy(params, bytes, std::min(size, sizeof(params)));
+		glTexParameterfv(target, pname, params);
+		break;
+	}
+	case GLOp::TexParameteri: {
+		GLenum target = read<GLenum>();
+		GLenum pname = read<GLenum>();
+		glTexParameteri(target, pname, read<GLint>());
+		break;
+	}
+	case GLOp::Uniform1f: {
+		GLint uniform = location(read<GLint>());
+		glUniform1f(uniform, read<GLfloat>());
+		break;
+	}
+	case GLOp::Uniform1i: {
+		GLint uniform = location(read<GLint>());
+		glUniform1i(uniform, read<GLint>());
+		break;
+	}
+	case GLOp::Uniform2fv:
+	case GLOp::Uniform3fv:
+	case GLOp::Uniform4fv: {
+		GLint uniform = location(read<GLint>());
+		GLsizei count = read<GLsizei>();
+		size_t size = op == GLOp::Uniform2fv ? 2 : op == GLOp::Uniform3fv ? 3 : 4;
+		m_scratch.resize(count * size * sizeof(GLfloat));
+		std::memcpy(m_scratch.data(), readBytes(m_scratch.size()), m_scratch.size());
+		auto values = reinterpret_cast<const GLfloat*>(m_scratch.data());
+		if (op == GLOp::Uniform2fv) {
+			glUniform2fv(uniform, count, values);
+		}
+		else if (op == GLOp::Uniform3fv) {
+			glUniform3fv(uniform, count, values);
+		}
+		else {
+			glUniform4fv(uniform, count, values);
+		}
+		break;
+	}
+	case GLOp::UniformMatrix2fv:
+	case GLOp::UniformMatrix3fv:
+	case GLOp::UniformMatrix4fv: {
+		GLint uniform = location(read<GLint>());
+		GLsizei count = read<GLsizei>();
+		GLboolean transpose = read<GLboolean>();
+		size_t size = op == GLOp::UniformMatrix2fv ? 4 : op == GLOp::UniformMatrix3fv ? 9 : 16;
+		m_scratch.resize(count * size * sizeof(GLfloat));
+		std::memcpy(m_scratch.data(), readBytes(m_scratch.size()), m_scratch.size());
+		auto values = reinterpret_cast<const GLfloat*>(m_scratch.data());
+		if (op == GLOp::UniformMatrix2fv) {
+			glUniformMatrix2fv(uniform, count, transpose, values);
+		}
+		else if (op == GLOp::UniformMatrix3fv) {
+			glUniformMatrix3fv(uniform, count, transpose, values);
+		}
+		else {
+			glUniformMatrix4fv(uniform, count, transpose, values);
+		}
+		break;
+	}
+	case GLOp::UseProgram:
+		m_program = read<GLuint>();
+		glUseProgram(name(Program, m_program));
+		break;
+	case GLOp::VertexAttribIPointer: {
+		GLuint index = read<GLuint>();
+		GLint size = read<GLint>();
+		GLenum type = read<GLenum>();
+		GLsizei stride = read<GLsizei>();
+		glVertexAttribIPointer(index, size, type, stride,
+			reinterpret_cast<const void*>(static_cast<uintptr_t>(read<uint64_t>())));
+		break;
+	}
+	case GLOp::VertexAttribPointer: {
+		GLuint index = read<GLuint>();
+		GLint size = read<GLint>();
+		GLenum type = read<GLenum>();
+		GLboolean normalized = read<GLboolean>();
+		GLsizei stride = read<GLsizei>();
+		glVertexAttribPointer(index, size, type, normalized, stride,
+			reinterpret_cast<const void*>(static_cast<uintptr_t>(read<uint64_t>())));
+		break;
+	}
+	case GLOp::Viewport: {
+		GLint x = read<GLint>();
+		GLint y = read<GLint>();
+		GLsizei width = read<GLsizei>();
+		glViewport(x, y, width, read<GLsizei>());
+		break;
+	}
+	default:
+		throw std::runtime_error("Unknown GL capture operation " + std::to_string(static_cast<uint16_t>(op)));
+	}
+}
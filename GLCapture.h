@@ -0,0 +1,235 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The GL calls a capture stream records, one record per call: the operation, then its
+ * arguments as they were passed, then any memory they point to.
+ */
+enum class GLOp : uint16_t {
+	FrameStart,
+	ActiveTexture,
+	AttachShader,
+	BeginQuery,
+	BindBuffer,
+	BindFramebuffer,
+	BindRenderbuffer,
+	BindTexture,
+	BindVertexArray,
+	BufferData,
+	BufferSubData,
+	Clear,
+	ColorMask,
+	CompileShader,
+	CreateProgram,
+	CreateShader,
+	DeleteBuffers,
+	DeleteFramebuffers,
+	DeleteQueries,
+	DeleteRenderbuffers,
+	DeleteShader,
+	DeleteTextures,
+	DeleteVertexArrays,
+	DepthFunc,
+	DepthMask,
+	Disable,
+	DrawArrays,
+	DrawBuffer,
+	DrawBuffers,
+	DrawElements,
+	Enable,
+	EnableVertexAttribArray,
+	EndQuery,
+	Finish,
+	FramebufferRenderbuffer,
+	FramebufferTexture2D,
+	FramebufferTextureLayer,
+	GenBuffers,
+	GenFramebuffers,
+	GenQueries,
+	GenRenderbuffers,
+	GenTextures,
+	GenVertexArrays,
+	GenerateMipmap,
+	GetQueryObjectiv,
+	GetQueryObjectui64v,
+	GetUniformLocation,
+	LinkProgram,
+	PixelStorei,
+	PolygonOffset,
+	QueryCounter,
+	ReadBuffer,
+	ReadPixels,
+	RenderbufferStorage,
+	ShaderSource,
+	TexBuffer,
+	TexImage2D,
+	TexImage3D,
+	TexParameterfv,
+	TexParameteri,
+	Uniform1f,
+	Uniform1i,
+	Uniform2fv,
+	Uniform3fv,
+	Uniform4fv,
+	UniformMatrix2fv,
+	UniformMatrix3fv,
+	UniformMatrix4fv,
+	UseProgram,
+	VertexAttribIPointer,
+	VertexAttribPointer,
+	Viewport,
+	End
+};
+
+/**
+ * @brief The size of a GLCapture stream so far.
+ */
+struct GLCaptureStats {
+	uint64_t calls = 0;
+	uint64_t frames = 0;
+	uint64_t bytes = 0;
+	// Bytes of buffer and texture contents, included in bytes.
+	uint64_t payloadBytes = 0;
+
+	std::string describe() const;
+};
+
+/**
+ * @brief Records the GL calls the program makes into a binary stream that GLReplay can
+ * re-issue without the program, separating driver and GPU cost from the CPU-side code that
+ * decided on the calls. While it exists, the GL functions in GLOp are routed through a
+ * recorder that writes each call and its payloads (buffer and texture contents, shader
+ * sources, uniform values) before making it. Queries that only read state, such as
+ * glGetIntegerv, are not recorded.
+ * Replays only work if every object they use was created in the stream, so a capture should
+ * start right after the context is created. Only one capture may exist at a time, and only the
+ * thread the context is current on may make GL calls while it does.
+ */
+class GLCapture {
+private:
+	std::ofstream m_out;
+	GLCaptureStats m_stats;
+	// The offset of each frame's FrameStart record, written at the end as the frame index.
+	std::vector<uint64_t> m_frameOffsets;
+	// Puts the GL function pointers the capture replaced back.
+	std::vector<std::function<void()>> m_restore;
+	int32_t m_unpackAlignment;
+
+	template <typename Proc>
+	void hook(Proc& slot, Proc& real, Proc recorder);
+
+public:
+	/**
+	 * @brief Starts recording into a file, replacing it. Throws if it cannot be written, or
+	 * another capture is running.
+	 */
+	GLCapture(const std::filesystem::path& path);
+	/**
+	 * @brief Stops recording, and completes the stream.
+	 */
+	~GLCapture();
+	GLCapture(const GLCapture&) = delete;
+	GLCapture& operator=(const GLCapture&) = delete;
+
+	/**
+	 * @brief Marks the start of a frame. Calls before the first frame are the stream's setup,
+	 * which replays once before any frame.
+	 */
+	void beginFrame();
+
+	const GLCaptureStats& stats() const { return m_stats; }
+
+	// Used by the recorders.
+	void writeOp(GLOp op);
+	void writeBytes(const void* data, size_t size);
+	template <typename T>
+	void write(const T& value) { writeBytes(&value, sizeof(value)); }
+	void writePayload(const void* data, size_t size);
+	int32_t unpackAlignment() const { return m_unpackAlignment; }
+	void setUnpackAlignment(int32_t alignment) { m_unpackAlignment = alignment; }
+};
+
+/**
+ * @brief Re-issues a stream recorded by GLCapture in the current context. Objects get the
+ * names GL gives them now, and uniforms the locations GL gives them now; calls referring to
+ * the recorded names and locations are translated.
+ */
+class GLReplay {
+private:
+	// The kinds of object names, which GL numbers independently.
+	enum NameKind {
+		Buffer,
+		Framebuffer,
+		Program,
+		Query,
+		Renderbuffer,
+		Shader,
+		Texture,
+		VertexArray,
+		NameKindCount
+	};
+
+	std::vector<uint8_t> m_data;
+	// Where the setup ends, where each frame starts, and where the records end.
+	uint64_t m_setupEnd;
+	std::vector<uint64_t> m_frameOffsets;
+	uint64_t m_recordsEnd;
+
+	const uint8_t* m_cursor;
+	const uint8_t* m_end;
+	uint64_t m_calls;
+	// Recorded names and their replayed equivalents, by kind.
+	std::unordered_map<uint32_t, uint32_t> m_names[NameKindCount];
+	// Replayed uniform locations, by recorded program and location.
+	std::unordered_map<uint64_t, int32_t> m_locations;
+	// The recorded name of the program in use, to translate uniform locations.
+	uint32_t m_program;
+	// Scratch memory that readbacks are written to.
+	std::vector<uint8_t> m_scratch;
+
+	void replayRange(uint64_t start, uint64_t end);
+	void replayOp(GLOp op);
+
+	const uint8_t* readBytes(size_t size);
+	template <typename T>
+	T read();
+	// A payload's bytes and size, or nullptr for a null pointer.
+	const uint8_t* readPayload(size_t& size);
+	uint32_t name(NameKind kind, uint32_t recorded) const;
+	int32_t location(int32_t recorded) const;
+	// Replays glGen* and glDelete* calls, and updates the names of the kind.
+	template <typename Proc>
+	void generate(NameKind kind, Proc gen);
+	template <typename Proc>
+	void remove(NameKind kind, Proc del);
+
+public:
+	/**
+	 * @brief Loads a stream. Throws if it cannot be read or is not a complete capture.
+	 */
+	GLReplay(const std::filesystem::path& path);
+
+	size_t frameCount() const { return m_frameOffsets.size(); }
+
+	/**
+	 * @brief Replays the calls before the first frame, creating the stream's objects. Must be
+	 * called once, before any frame.
+	 */
+	void replaySetup();
+
+	/**
+	 * @brief Replays one frame's calls. Frames may be replayed repeatedly, in order.
+	 */
+	void replayFrame(size_t frame);
+
+	/**
+	 * @brief The number of calls replayed so far.
+	 */
+	uint64_t calls() const { return m_calls; }
+};
@@ -0,0 +1,174 @@
+#include "GLState.h"
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <glad/glad.h>
+
+static const char* CALL_NAMES[static_cast<size_t>(GLCall::Count)] = {
+	"program", "vertex array", "active texture", "texture", "uniform", "uniform location"
+};
+
+uint64_t GLCallCounts::totalIssued() const {
+	uint64_t total = 0;
+	for (uint64_t n : issued) {
+		total += n;
+	}
+	return total;
+}
+
+uint64_t GLCallCounts::totalElided() const {
+	uint64_t total = 0;
+	for (uint64_t n : elided) {
+		total += n;
+	}
+	return total;
+}
+
+std::string GLCallCounts::describe() const {
+	std::ostringstream out;
+	out << totalIssued() << " calls issued, " << totalElided() << " elided (";
+	for (size_t i = 0; i < static_cast<size_t>(GLCall::Count); i++) {
+		out << (i > 0 ? ", " : "") << CALL_NAMES[i] << " " << issued[i] << "/" << issued[i] + elided[i];
+	}
+	out << ")";
+	return out.str();
+}
+
+size_t GLState::targetIndex(uint32_t target) {
+	switch (target) {
+	case GL_TEXTURE_2D:
+		return 0;
+	case GL_TEXTURE_2D_ARRAY:
+		return 1;
+	case GL_TEXTURE_BUFFER:
+		return 2;
+	default:
+		return TARGET_COUNT;
+	}
+}
+
+GLState::GLState() {
+	invalidate();
+}
+
+GLState& GLState::current() {
+	static GLState state;
+	return state;
+}
+
+bool GLState::count(GLCall call, bool changed) {
+	(changed ? m_counts.issued : m_counts.elided)[static_cast<size_t>(call)]++;
+	return changed;
+}
+
+void GLState::invalidate() {
+	m_program = UNKNOWN;
+	m_vertexArray = UNKNOWN;
+	m_activeUnit = UNKNOWN;
+	m_textures.assign(m_textures.size(), UNKNOWN);
+	// Uniform values and locations live in the programs, which nothing else should be
+	// changing; but a program may have been relinked, or the lookups may need to be seen.
+	m_uniforms.clear();
+	m_locations.clear();
+}
+
+void GLState::forgetProgram(uint32_t program) {
+	for (auto i = m_uniforms.begin(); i != m_uniforms.end();) {
+		i = (i->first >> 32) == program ? m_uniforms.erase(i) : std::next(i);
+	}
+	m_locations.erase(program);
+	if (m_program == program) {
+		m_program = UNKNOWN;
+	}
+}
+
+void GLState::useProgram(uint32_t program) {
+	if (count(GLCall::UseProgram, program != m_program)) {
+		glUseProgram(program);
+		m_program = program;
+	}
+}
+
+void GLState::bindVertexArray(uint32_t vertexArray) {
+	if (count(GLCall::BindVertexArray, vertexArray != m_vertexArray)) {
+		glBindVertexArray(vertexArray);
+		m_vertexArray = vertexArray;
+	}
+}
+
+void GLState::deleteVertexArray(uint32_t vertexArray) {
+	glDeleteVertexArrays(1, &vertexArray);
+	if (m_vertexArray == vertexArray) {
+		m_vertexArray = 0;
+	}
+}
+
+void GLState::deleteTexture(uint32_t texture) {
+	glDeleteTextures(1, &texture);
+	for (uint32_t& bound : m_textures) {
+		if (bound == texture) {
+			bound = 0;
+		}
+	}
+}
+
+void GLState::bindTexture(uint32_t target, uint32_t texture) {
+	if (m_activeUnit == UNKNOWN) {
+		// The unit must be known to record the binding against it.
+		bindTexture(0, target, texture);
+		return;
+	}
+	bindTexture(m_activeUnit, target, texture);
+}
+
+void GLState::bindTexture(uint32_t unit, uint32_t target, uint32_t texture) {
+	size_t index = targetIndex(target);
+	size_t slot = unit * TARGET_COUNT + index;
+	if (index < TARGET_COUNT) {
+		if (slot >= m_textures.size()) {
+			m_textures.resize((unit + 1) * TARGET_COUNT, UNKNOWN);
+		}
+		if (!count(GLCall::BindTexture, m_textures[slot] != texture)) {
+			return;
+		}
+	}
+	else {
+		count(GLCall::BindTexture, true);
+	}
+
+	if (count(GLCall::ActiveTexture, unit != m_activeUnit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		m_activeUnit = unit;
+	}
+	glBindTexture(target, texture);
+	if (index < TARGET_COUNT) {
+		m_textures[slot] = texture;
+	}
+}
+
+int32_t GLState::uniformLocation(uint32_t program, std::string_view name) {
+	auto& locations = m_locations[program];
+	auto found = locations.find(name);
+	if (!count(GLCall::UniformLocation, found == locations.end())) {
+		return found->second;
+	}
+	// GL wants a terminated name; only the first lookup of each pays for the copy.
+	std::string key(name);
+	int32_t location = glGetUniformLocation(program, key.c_str());
+	locations.emplace(std::move(key), location);
+	return location;
+}
+
+bool GLState::uniformChanged(uint32_t program, int32_t location, const void* value, size_t size) {
+	if (location < 0) {
+		return count(GLCall::Uniform, false);
+	}
+	uint64_t key = (static_cast<uint64_t>(program) << 32) | static_cast<uint32_t>(location);
+	auto& cached = m_uniforms[key];
+	bool changed = cached.size() != size || std::memcmp(cached.data(), value, size) != 0;
+	if (count(GLCall::Uniform, changed)) {
+		auto bytes = static_cast<const uint8_t*>(value);
+		cached.assign(bytes, bytes + size);
+	}
+	return changed;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The kinds of state-changing GL calls a GLState filters.
+ */
+enum class GLCall {
+	UseProgram,
+	BindVertexArray,
+	ActiveTexture,
+	BindTexture,
+	Uniform,
+	UniformLocation,
+	Count
+};
+
+/**
+ * @brief How many calls of each kind a GLState passed to the driver, and how many it dropped
+ * because they would not have changed anything, since the counts were last reset.
+ */
+struct GLCallCounts {
+	uint64_t issued[static_cast<size_t>(GLCall::Count)] = {};
+	uint64_t elided[static_cast<size_t>(GLCall::Count)] = {};
+
+	uint64_t totalIssued() const;
+	uint64_t totalElided() const;
+
+	std::string describe() const;
+};
+
+/**
+ * @brief A shadow copy of the GL state that rendering code changes most often: the program,
+ * the vertex array, the active texture unit and the textures bound to each unit, the value of
+ * every uniform of every program, and uniform locations. Calls that would set what is already
+ * set are never made.
+ * The shadow is only right if every change to that state goes through it; code that changes
+ * it behind its back (another library drawing into the context) must call invalidate after.
+ * There is one GLState for the program's one GL context. Like the context, it may only be
+ * used by the thread the context is current on.
+ */
+class GLState {
+private:
+	// Texture targets tracked per unit.
+	static constexpr size_t TARGET_COUNT = 3;
+	// Stands for a binding that is not known, so the next call to set it is always made.
+	static constexpr uint32_t UNKNOWN = 0xFFFFFFFF;
+
+	uint32_t m_program;
+	uint32_t m_vertexArray;
+	uint32_t m_activeUnit;
+	// The texture bound to each target of each unit, TARGET_COUNT per unit.
+	std::vector<uint32_t> m_textures;
+	// Uniform values by program and location, as the bytes they were last set to.
+	std::unordered_map<uint64_t, std::vector<uint8_t>> m_uniforms;
+	// Uniform locations by program and name; GL never moves them once a program is linked.
+	// Ordered by a transparent comparison, so names are found without building a string.
+	std::unordered_map<uint32_t, std::map<std::string, int32_t, std::less<>>> m_locations;
+	GLCallCounts m_counts;
+
+	GLState();
+
+	// The index of a tracked texture target, or TARGET_COUNT if it is not tracked.
+	static size_t targetIndex(uint32_t target);
+	bool count(GLCall call, bool changed);
+
+public:
+	GLState(const GLState&) = delete;
+	GLState& operator=(const GLState&) = delete;
+
+	/**
+	 * @brief The state of the context.
+	 */
+	static GLState& current();
+
+	/**
+	 * @brief Forgets everything known about the context's state, so every call is made until
+	 * it is known again.
+	 */
+	void invalidate();
+
+	/**
+	 * @brief Forgets the cached uniforms and locations of a program, before it is deleted or
+	 * relinked, so a later program with the same name does not inherit them.
+	 */
+	void forgetProgram(uint32_t program);
+
+	void useProgram(uint32_t program);
+	uint32_t program() const { return m_program; }
+
+	void bindVertexArray(uint32_t vertexArray);
+
+	/**
+	 * @brief Deletes a vertex array or texture. GL unbinds deleted objects, so the shadow
+	 * must see deletions, or a later object given the same name would seem bound already.
+	 */
+	void deleteVertexArray(uint32_t vertexArray);
+	void deleteTexture(uint32_t texture);
+
+	/**
+	 * @brief Binds a texture to a target of the active unit, as during texture creation.
+	 * Targets other than GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY and GL_TEXTURE_BUFFER are not
+	 * tracked, and always bound.
+	 */
+	void bindTexture(uint32_t target, uint32_t texture);
+
+	/**
+	 * @brief Binds a texture to a target of a unit, only switching the active unit if the
+	 * binding changes.
+	 */
+	void bindTexture(uint32_t unit, uint32_t target, uint32_t texture);
+
+	/**
+	 * @brief The location of a uniform in a program, asking GL only the first time.
+	 */
+	int32_t uniformLocation(uint32_t program, std::string_view name);
+
+	/**
+	 * @brief Whether setting the uniform at a location of a program to a value would change
+	 * it; if so, the value is remembered, and the caller must set it, with the program active.
+	 * Inactive uniforms (location -1) never need setting.
+	 */
+	bool uniformChanged(uint32_t program, int32_t location, const void* value, size_t size);
+
+	const GLCallCounts& counts() const { return m_counts; }
+
+	/**
+	 * @brief Starts counting calls again, as at the start of a frame.
+	 */
+	void resetCounts() { m_counts = GLCallCounts(); }
+};
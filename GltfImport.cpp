@@ -0,0 +1,1302 @@
+#include "GltfImport.h"
+#include "Json.h"
+#include "MappedFile.h"
+#include "Skeleton.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+static const uint32_t GLB_MAGIC = 0x46546C67;
+static const uint32_t GLB_JSON_CHUNK = 0x4E4F534A;
+static const uint32_t GLB_BIN_CHUNK = 0x004E4942;
+
+/**
+ * @brief The elements of an array member, or none if it is absent.
+ */
+static const std::vector<JsonValue>& jsonArray(const JsonValue& object, std::string_view name) {
+	static const std::vector<JsonValue> none;
+	const JsonValue* member = object.find(name);
+	if (member == nullptr) {
+		return none;
+	}
+	if (member->type != JsonValue::Type::Array) {
+		throw std::runtime_error("glTF: \"" + std::string(name) + "\" is not an array");
+	}
+	return member->elements;
+}
+
+/**
+ * @brief A value that must be a non-negative integer, such as an index or a count.
+ */
+static size_t jsonSize(const JsonValue& value, const std::string& what) {
+	if (value.type != JsonValue::Type::Number || value.number < 0 || value.number != std::floor(value.number)
+		|| value.number > static_cast<double>(std::numeric_limits<uint32_t>::max())) {
+		throw std::runtime_error("glTF: " + what + " is not a non-negative integer");
+	}
+	return static_cast<size_t>(value.number);
+}
+
+/**
+ * @brief A non-negative integer member; the fallback if it is absent, which is an error
+ * without one.
+ */
+static size_t jsonSize(const JsonValue& object, std::string_view name, const std::string& what,
+	std::optional<size_t> fallback = std::nullopt) {
+	const JsonValue* member = object.find(name);
+	if (member == nullptr) {
+		if (!fallback.has_value()) {
+			throw std::runtime_error("glTF: " + what + " has no \"" + std::string(name) + "\"");
+		}
+		return *fallback;
+	}
+	return jsonSize(*member, what + "'s \"" + std::string(name) + "\"");
+}
+
+/**
+ * @brief An index that must be below count.
+ */
+static size_t jsonIndex(const JsonValue& value, size_t count, const std::string& what) {
+	size_t index = jsonSize(value, what);
+	if (index >= count) {
+		throw std::runtime_error("glTF: " + what + " " + std::to_string(index) + " is out of range");
+	}
+	return index;
+}
+
+static size_t jsonIndex(const JsonValue& object, std::string_view name, size_t count, const std::string& what) {
+	const JsonValue* member = object.find(name);
+	if (member == nullptr) {
+		throw std::runtime_error("glTF: " + what + " has no \"" + std::string(name) + "\"");
+	}
+	return jsonIndex(*member, count, what + "'s \"" + std::string(name) + "\"");
+}
+
+static const std::string& jsonString(const JsonValue& object, std::string_view name) {
+	static const std::string none;
+	const JsonValue* member = object.find(name);
+	return member != nullptr && member->type == JsonValue::Type::String ? member->string : none;
+}
+
+/**
+ * @brief Reads an array of count numbers into out, leaving out as it was if the array is
+ * absent (nullptr).
+ */
+static void jsonFloats(const JsonValue* array, float_t* out, size_t count, const std::string& what) {
+	if (array == nullptr) {
+		return;
+	}
+	if (array->type != JsonValue::Type::Array || array->elements.size() != count) {
+		throw std::runtime_error("glTF: " + what + " needs " + std::to_string(count) + " numbers");
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (array->elements[i].type != JsonValue::Type::Number) {
+			throw std::runtime_error("glTF: " + what + " needs numbers");
+		}
+		out[i] = static_cast<float_t>(array->elements[i].number);
+	}
+}
+
+static void jsonFloats(const JsonValue& object, std::string_view name, float_t* out, size_t count,
+	const std::string& what) {
+	jsonFloats(object.find(name), out, count, what + "'s \"" + std::string(name) + "\"");
+}
+
+static std::vector<uint8_t> decodeBase64(std::string_view text) {
+	std::vector<uint8_t> bytes;
+	bytes.reserve(text.size() / 4 * 3);
+	uint32_t bits = 0;
+	uint32_t bitCount = 0;
+	for (char c : text) {
+		uint32_t value;
+		if (c >= 'A' && c <= 'Z') {
+			value = c - 'A';
+		}
+		else if (c >= 'a' && c <= 'z') {
+			value = c - 'a' + 26;
+		}
+		else if (c >= '0' && c <= '9') {
+			value = c - '0' + 52;
+		}
+		else if (c == '+' || c == '-') {
+			value = 62;
+		}
+		else if (c == '/' || c == '_') {
+			value = 63;
+		}
+		else if (c == '=') {
+			break;
+		}
+		else {
+			throw std::runtime_error("glTF: bad character in base64 data");
+		}
+		bits = ((bits << 6) | value) & 0xFFFF;
+		bitCount += 6;
+		if (bitCount >= 8) {
+			bitCount -= 8;
+			bytes.push_back(static_cast<uint8_t>(bits >> bitCount));
+		}
+	}
+	return bytes;
+}
+
+static bool isDataUri(const std::string& uri) {
+	return uri.compare(0, 5, "data:") == 0;
+}
+
+/**
+ * @brief Decodes a data URI's contents, which glTF requires to be base64.
+ */
+static std::vector<uint8_t> decodeDataUri(const std::string& uri) {
+	size_t comma = uri.find(',');
+	if (comma == std::string::npos || comma < 7 || uri.compare(comma - 7, 7, ";base64") != 0) {
+		throw std::runtime_error("glTF: data URIs must be base64");
+	}
+	return decodeBase64(std::string_view(uri).substr(comma + 1));
+}
+
+/**
+ * @brief The file a relative URI names, with its percent escapes decoded.
+ */
+static std::filesystem::path uriPath(const std::filesystem::path& directory, const std::string& uri) {
+	std::string decoded;
+	for (size_t i = 0; i < uri.size(); i++) {
+		uint32_t code = 0;
+		if (uri[i] == '%' && i + 2 < uri.size()
+			&& std::from_chars(uri.data() + i + 1, uri.data() + i + 3, code, 16).ptr == uri.data() + i + 3) {
+			decoded += static_cast<char>(code);
+			i += 2;
+		}
+		else {
+			decoded += uri[i];
+		}
+	}
+	return directory / decoded;
+}
+
+/**
+ * @brief A glTF buffer's bytes: mapped from its own file, in the .glb's binary chunk, or
+ * decoded from a data URI.
+ */
+struct GltfBuffer {
+	std::unique_ptr<MappedFile> file;
+	std::vector<uint8_t> decoded;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+struct GltfBufferView {
+	const uint8_t* data;
+	size_t size;
+	// 0 if the elements are tightly packed.
+	size_t stride;
+};
+
+/**
+ * @brief An accessor, resolved to where its elements lie in the mapped buffers.
+ */
+struct GltfAccessor {
+	// The first element, or nullptr if the accessor has no buffer view and reads as zeros.
+	const uint8_t* data = nullptr;
+	size_t count = 0;
+	// A GL type: GL_BYTE through GL_FLOAT, as glTF uses GL's values.
+	uint32_t componentType = 0;
+	size_t components = 0;
+	size_t elementSize = 0;
+	size_t stride = 0;
+	bool normalized = false;
+	// Elements that replace those of the dense data, by index.
+	size_t sparseCount = 0;
+	uint32_t sparseIndexType = 0;
+	const uint8_t* sparseIndices = nullptr;
+	const uint8_t* sparseValues = nullptr;
+	const JsonValue* min = nullptr;
+	const JsonValue* max = nullptr;
+};
+
+/**
+ * @brief A glTF file being imported: its JSON, its buffers, and its accessors.
+ */
+struct GltfFile {
+	std::filesystem::path directory;
+	std::unique_ptr<MappedFile> file;
+	JsonValue json;
+	std::vector<GltfBuffer> buffers;
+	std::vector<GltfBufferView> views;
+	std::vector<GltfAccessor> accessors;
+};
+
+static size_t componentSize(uint32_t componentType) {
+	switch (componentType) {
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+		return 2;
+	case GL_UNSIGNED_INT:
+	case GL_FLOAT:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static size_t typeComponents(const std::string& type) {
+	if (type == "SCALAR") {
+		return 1;
+	}
+	if (type == "VEC2") {
+		return 2;
+	}
+	if (type == "VEC3") {
+		return 3;
+	}
+	if (type == "VEC4" || type == "MAT2") {
+		return 4;
+	}
+	if (type == "MAT3") {
+		return 9;
+	}
+	return type == "MAT4" ? 16 : 0;
+}
+
+static bool isIndexType(uint32_t componentType) {
+	return componentType == GL_UNSIGNED_BYTE || componentType == GL_UNSIGNED_SHORT
+		|| componentType == GL_UNSIGNED_INT;
+}
+
+/**
+ * @brief Whether count elements of the given size and stride, starting offset bytes into a
+ * range of size bytes, lie within it.
+ */
+static bool fits(size_t size, size_t offset, size_t count, size_t elementSize, size_t stride) {
+	return count == 0 || (offset <= size && size - offset >= elementSize
+		&& (size - offset - elementSize) / stride >= count - 1);
+}
+
+/**
+ * @brief Resolves the buffer view named by an object's "bufferView" and "byteOffset" members to
+ * where they point, checking that count elements fit.
+ */
+static const uint8_t* viewData(const GltfFile& gltf, const JsonValue& object, size_t count, size_t elementSize,
+	size_t stride, const std::string& what) {
+	const GltfBufferView& view = gltf.views[jsonIndex(object, "bufferView", gltf.views.size(), what)];
+	size_t offset = jsonSize(object, "byteOffset", what, 0);
+	if (!fits(view.size, offset, count, elementSize, stride)) {
+		throw std::runtime_error("glTF: " + what + " runs past the end of its buffer view");
+	}
+	return view.data + offset;
+}
+
+static void resolveAccessors(GltfFile& gltf) {
+	auto& accessors = jsonArray(gltf.json, "accessors");
+	gltf.accessors.reserve(accessors.size());
+	for (size_t i = 0; i < accessors.size(); i++) {
+		const JsonValue& accessor = accessors[i];
+		std::string what = "accessor " + std::to_string(i);
+		GltfAccessor& a = gltf.accessors.emplace_back();
+		a.count = jsonSize(accessor, "count", what);
+		a.componentType = static_cast<uint32_t>(jsonSize(accessor, "componentType", what));
+		a.components = typeComponents(jsonString(accessor, "type"));
+		a.elementSize = componentSize(a.componentType) * a.components;
+		if (a.elementSize == 0) {
+			throw std::runtime_error("glTF: " + what + " has an unknown type or component type");
+		}
+		const JsonValue* normalized = accessor.find("normalized");
+		a.normalized = normalized != nullptr && normalized->boolean;
+		a.min = accessor.find("min");
+		a.max = accessor.find("max");
+
+		if (accessor.find("bufferView") != nullptr) {
+			const GltfBufferView& view = gltf.views[jsonIndex(accessor, "bufferView", gltf.views.size(), what)];
+			a.stride = view.stride != 0 ? view.stride : a.elementSize;
+			a.data = viewData(gltf, accessor, a.count, a.elementSize, a.stride, what);
+		}
+
+		const JsonValue* sparse = accessor.find("sparse");
+		if (sparse != nullptr) {
+			a.sparseCount = jsonSize(*sparse, "count", what + "'s sparse");
+			const JsonValue* indices = sparse->find("indices");
+			const JsonValue* values = sparse->find("values");
+			if (indices == nullptr || values == nullptr) {
+				throw std::runtime_error("glTF: " + what + "'s sparse needs indices and values");
+			}
+			a.sparseIndexType = static_cast<uint32_t>(jsonSize(*indices, "componentType", what + "'s sparse indices"));
+			if (!isIndexType(a.sparseIndexType)) {
+				throw std::runtime_error("glTF: " + what + "'s sparse indices have a bad component type");
+			}
+			size_t indexSize = componentSize(a.sparseIndexType);
+			a.sparseIndices = viewData(gltf, *indices, a.sparseCount, indexSize, indexSize, what + "'s sparse indices");
+			a.sparseValues = viewData(gltf, *values, a.sparseCount, a.elementSize, a.elementSize,
+				what + "'s sparse values");
+		}
+	}
+}
+
+/**
+ * @brief Maps a .gltf or .glb file and the buffers it refers to, parses its JSON, and resolves
+ * its buffer views and accessors.
+ */
+static GltfFile readGltf(const std::filesystem::path& path) {
+	GltfFile gltf;
+	gltf.directory = path.parent_path();
+	gltf.file = std::make_unique<MappedFile>(path);
+	const uint8_t* data = gltf.file->data();
+	size_t size = gltf.file->size();
+
+	const char* json = reinterpret_cast<const char*>(data);
+	const char* jsonEnd = json + size;
+	const uint8_t* binary = nullptr;
+	size_t binarySize = 0;
+	uint32_t magic = 0;
+	if (size >= 4) {
+		std::memcpy(&magic, data, 4);
+	}
+	if (magic == GLB_MAGIC) {
+		// A header of the magic, the version and the length, then chunks of a length, a type and
+		// the data, padded to 4 bytes: the JSON, then optionally the binary buffer.
+		uint32_t header[3];
+		if (size < sizeof(header)) {
+			throw std::runtime_error("glTF: binary file is truncated");
+		}
+		std::memcpy(header, data, sizeof(header));
+		if (header[1] != 2) {
+			throw std::runtime_error("glTF: only version 2 binary files are supported");
+		}
+		size_t length = std::min<size_t>(header[2], size);
+		json = nullptr;
+		for (size_t offset = sizeof(header); offset + 8 <= length;) {
+			uint32_t chunk[2];
+			std::memcpy(chunk, data + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+			if (chunk[0] > length - offset) {
+				throw std::runtime_error("glTF: binary chunk runs past the end of the file");
+			}
+			if (chunk[1] == GLB_JSON_CHUNK && json == nullptr) {
+				json = reinterpret_cast<const char*>(data + offset);
+				jsonEnd = json + chunk[0];
+			}
+			else if (chunk[1] == GLB_BIN_CHUNK && binary == nullptr) {
+				binary = data + offset;
+				binarySize = chunk[0];
+			}
+			offset += (static_cast<size_t>(chunk[0]) + 3) & ~static_cast<size_t>(3);
+		}
+		if (json == nullptr) {
+			throw std::runtime_error("glTF: binary file has no JSON chunk");
+		}
+	}
+
+	try {
+		gltf.json = parseJson(json, jsonEnd);
+	}
+	catch (std::runtime_error& e) {
+		throw std::runtime_error(std::string("glTF ") + e.what());
+	}
+	if (gltf.json.type != JsonValue::Type::Object) {
+		throw std::runtime_error("glTF JSON: the file is not one JSON object");
+	}
+	const JsonValue* asset = gltf.json.find("asset");
+	if (asset == nullptr || jsonString(*asset, "version").compare(0, 2, "2.") != 0) {
+		throw std::runtime_error("glTF: only version 2.0 files are supported");
+	}
+
+	auto& buffers = jsonArray(gltf.json, "buffers");
+	for (size_t i = 0; i < buffers.size(); i++) {
+		std::string what = "buffer " + std::to_string(i);
+		size_t length = jsonSize(buffers[i], "byteLength", what);
+		GltfBuffer& buffer = gltf.buffers.emplace_back();
+		const JsonValue* uri = buffers[i].find("uri");
+		if (uri == nullptr) {
+			// Only the first buffer of a .glb may leave out its URI, for the binary chunk.
+			if (i != 0 || binary == nullptr) {
+				throw std::runtime_error("glTF: " + what + " has no uri");
+			}
+			buffer.data = binary;
+			buffer.size = binarySize;
+		}
+		else if (isDataUri(uri->string)) {
+			buffer.decoded = decodeDataUri(uri->string);
+			buffer.data = buffer.decoded.data();
+			buffer.size = buffer.decoded.size();
+		}
+		else {
+			buffer.file = std::make_unique<MappedFile>(uriPath(gltf.directory, uri->string));
+			buffer.data = buffer.file->data();
+			buffer.size = buffer.file->size();
+		}
+		if (buffer.size < length) {
+			throw std::runtime_error("glTF: " + what + " is shorter than its byteLength");
+		}
+		buffer.size = length;
+	}
+
+	auto& views = jsonArray(gltf.json, "bufferViews");
+	for (size_t i = 0; i < views.size(); i++) {
+		std::string what = "buffer view " + std::to_string(i);
+		const GltfBuffer& buffer = gltf.buffers[jsonIndex(views[i], "buffer", gltf.buffers.size(), what)];
+		size_t offset = jsonSize(views[i], "byteOffset", what, 0);
+		size_t length = jsonSize(views[i], "byteLength", what);
+		if (offset > buffer.size || buffer.size - offset < length) {
+			throw std::runtime_error("glTF: " + what + " runs past the end of its buffer");
+		}
+		gltf.views.push_back(GltfBufferView{ buffer.data + offset, length, jsonSize(views[i], "byteStride", what, 0) });
+	}
+
+	resolveAccessors(gltf);
+	return gltf;
+}
+
+/**
+ * @brief Converts one stored component; integer components the accessor marks normalized map
+ * to [0, 1], or [-1, 1] if signed.
+ */
+template <typename Out, typename In>
+static Out convertComponent(In value, bool normalized) {
+	if constexpr (std::is_floating_point_v<Out> && std::is_integral_v<In>) {
+		if (normalized) {
+			return std::max(static_cast<Out>(value) / std::numeric_limits<In>::max(), static_cast<Out>(-1));
+		}
+	}
+	return static_cast<Out>(value);
+}
+
+template <typename Out, typename In>
+static void readElements(const uint8_t* data, size_t stride, size_t count, size_t components, bool normalized,
+	Out* out, size_t outComponents) {
+	components = std::min(components, outComponents);
+	for (size_t i = 0; i < count; i++) {
+		const uint8_t* element = data + i * stride;
+		for (size_t c = 0; c < components; c++) {
+			In value;
+			std::memcpy(&value, element + c * sizeof(In), sizeof(In));
+			out[i * outComponents + c] = convertComponent<Out>(value, normalized);
+		}
+	}
+}
+
+template <typename Out>
+static void readElements(uint32_t componentType, const uint8_t* data, size_t stride, size_t count,
+	size_t components, bool normalized, Out* out, size_t outComponents) {
+	switch (componentType) {
+	case GL_BYTE:
+		readElements<Out, int8_t>(data, stride, count, components, normalized, out, outComponents);
+		break;
+	case GL_UNSIGNED_BYTE:
+		readElements<Out, uint8_t>(data, stride, count, components, normalized, out, outComponents);
+		break;
+	case GL_SHORT:
+		readElements<Out, int16_t>(data, stride, count, components, normalized, out, outComponents);
+		break;
+	case GL_UNSIGNED_SHORT:
+		readElements<Out, uint16_t>(data, stride, count, components, normalized, out, outComponents);
+		break;
+	case GL_UNSIGNED_INT:
+		readElements<Out, uint32_t>(data, stride, count, components, normalized, out, outComponents);
+		break;
+	case GL_FLOAT:
+		readElements<Out, float>(data, stride, count, components, normalized, out, outComponents);
+		break;
+	}
+}
+
+/**
+ * @brief Reads every element of an accessor, with its sparse substitutions, into out, which
+ * holds outComponents values per element; components the accessor lacks are left as they were.
+ */
+template <typename Out>
+static void readAccessor(const GltfAccessor& accessor, Out* out, size_t outComponents) {
+	size_t components = std::min(accessor.components, outComponents);
+	if (accessor.data != nullptr) {
+		readElements(accessor.componentType, accessor.data, accessor.stride, accessor.count, accessor.components,
+			accessor.normalized, out, outComponents);
+	}
+	else {
+		for (size_t i = 0; i < accessor.count; i++) {
+			std::fill(out + i * outComponents, out + i * outComponents + components, static_cast<Out>(0));
+		}
+	}
+	if (accessor.sparseCount == 0) {
+		return;
+	}
+
+	std::vector<uint32_t> indices(accessor.sparseCount);
+	size_t indexSize = componentSize(accessor.sparseIndexType);
+	readElements(accessor.sparseIndexType, accessor.sparseIndices, indexSize, accessor.sparseCount, 1, false,
+		indices.data(), 1);
+	std::vector<Out> values(accessor.sparseCount * outComponents);
+	readElements(accessor.componentType, accessor.sparseValues, accessor.elementSize, accessor.sparseCount,
+		accessor.components, accessor.normalized, values.data(), outComponents);
+	for (size_t i = 0; i < accessor.sparseCount; i++) {
+		if (indices[i] >= accessor.count) {
+			throw std::runtime_error("glTF: sparse accessor index out of range");
+		}
+		std::copy(values.begin() + i * outComponents, values.begin() + i * outComponents + components,
+			out + indices[i] * outComponents);
+	}
+}
+
+/**
+ * @brief Whether the GPU can read an accessor where it lies, as a float attribute with the
+ * given number of components.
+ */
+static bool readableInPlace(const GltfAccessor* accessor, size_t components) {
+	return accessor != nullptr && accessor->data != nullptr && accessor->sparseCount == 0
+		&& accessor->componentType == GL_FLOAT && accessor->components == components
+		&& accessor->stride % 4 == 0 && reinterpret_cast<uintptr_t>(accessor->data) % 4 == 0;
+}
+
+/**
+ * @brief A node's local transform, from its matrix or its translation, rotation and scale, and
+ * the transform split into those parts.
+ */
+static glm::mat4 nodeTransform(const JsonValue& node, const std::string& what, glm::vec3& translation,
+	glm::quat& rotation, glm::vec3& scale) {
+	float_t t[3] = { 0, 0, 0 };
+	float_t r[4] = { 0, 0, 0, 1 };
+	float_t s[3] = { 1, 1, 1 };
+	jsonFloats(node, "translation", t, 3, what);
+	jsonFloats(node, "rotation", r, 4, what);
+	jsonFloats(node, "scale", s, 3, what);
+	translation = glm::vec3(t[0], t[1], t[2]);
+	rotation = glm::quat(r[3], r[0], r[1], r[2]);
+	scale = glm::vec3(s[0], s[1], s[2]);
+	if (node.find("matrix") == nullptr) {
+		return glm::translate(glm::mat4(1), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1), scale);
+	}
+
+	// glTF matrices are column-major, as glm's are.
+	glm::mat4 matrix;
+	jsonFloats(node, "matrix", &matrix[0][0], 16, what);
+	translation = glm::vec3(matrix[3]);
+	glm::mat3 axes(matrix);
+	scale = glm::vec3(glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]));
+	if (glm::determinant(axes) < 0) {
+		scale.x = -scale.x;
+	}
+	for (auto i = 0; i < 3; i++) {
+		if (scale[i] != 0) {
+			axes[i] /= scale[i];
+		}
+	}
+	rotation = glm::quat_cast(axes);
+	return matrix;
+}
+
+/**
+ * @brief One primitive of one node's mesh: the accessors it draws, and, unless it is uploaded
+ * in place, its vertices and indices converted and processed in staging memory.
+ */
+struct GltfPrimitive {
+	size_t node;
+	const JsonValue* material = nullptr;
+	// GL_TRIANGLES, GL_TRIANGLE_STRIP or GL_TRIANGLE_FAN, as glTF uses GL's values.
+	size_t mode = GL_TRIANGLES;
+	const GltfAccessor* positions = nullptr;
+	const GltfAccessor* normals = nullptr;
+	const GltfAccessor* texCoords = nullptr;
+	const GltfAccessor* indices = nullptr;
+	const GltfAccessor* joints = nullptr;
+	const GltfAccessor* weights = nullptr;
+	bool inPlace = false;
+	bool skinned = false;
+	uint32_t skin = 0;
+	size_t jointCount = 0;
+
+	std::vector<VertexBoneData> influences;
+	Vertex3D* vertices = nullptr;
+	size_t vertexCount = 0;
+	uint32_t* indexData = nullptr;
+	size_t indexCount = 0;
+	// Time spent converting and in each step, on whichever thread prepared the primitive.
+	double convertMs = 0;
+	double stepMs[IMPORT_STEP_COUNT] = {};
+	// Why preparing the primitive failed, if it did; thrown once every primitive is done.
+	std::string error;
+
+	explicit GltfPrimitive(size_t node) : node(node) {}
+};
+
+/**
+ * @brief An import in progress: the file, the skeleton node of each glTF node (-1 for nodes
+ * outside the skeleton), the primitives in the order they are uploaded, and the textures
+ * loaded so far.
+ */
+struct GltfLoad {
+	GltfFile gltf;
+	const ImportSettings& settings;
+	ImportReport* report;
+	std::shared_ptr<Skeleton> skeleton;
+	std::vector<int32_t> skeletonNodes;
+	std::vector<GltfPrimitive> primitives;
+	size_t nextPrimitive = 0;
+	std::unordered_map<size_t, Texture> images;
+	std::unordered_map<std::filesystem::path, Texture> loadedTextures;
+
+	GltfLoad(GltfFile&& gltf, const ImportSettings& settings, ImportReport* report)
+		: gltf(std::move(gltf)), settings(settings), report(report) {}
+};
+
+/**
+ * @brief Adds a node and its descendants to the skeleton, parents first.
+ */
+static void addGltfNodes(GltfLoad& load, size_t node, int32_t parent) {
+	const JsonValue& n = jsonArray(load.gltf.json, "nodes")[node];
+	std::string what = "node " + std::to_string(node);
+	if (load.skeletonNodes[node] >= 0) {
+		throw std::runtime_error("glTF: " + what + " is in the scene twice");
+	}
+	glm::vec3 translation, scale;
+	glm::quat rotation;
+	nodeTransform(n, what, translation, rotation, scale);
+	uint32_t index = load.skeleton->addNode(jsonString(n, "name"), parent, translation, rotation, scale);
+	load.skeletonNodes[node] = static_cast<int32_t>(index);
+	size_t nodeCount = load.skeletonNodes.size();
+	for (auto& child : jsonArray(n, "children")) {
+		addGltfNodes(load, jsonIndex(child, nodeCount, what + "'s child"), static_cast<int32_t>(index));
+	}
+}
+
+/**
+ * @brief Imports the file's animations as clips of the skeleton. Channels of nodes outside the
+ * scene, and of morph target weights, are skipped. Cubic spline keys keep only their values,
+ * and step keys are held until just before the next key, as the skeleton interpolates
+ * linearly.
+ */
+static void addGltfAnimations(GltfLoad& load) {
+	auto& animations = jsonArray(load.gltf.json, "animations");
+	for (size_t a = 0; a < animations.size(); a++) {
+		std::string what = "animation " + std::to_string(a);
+		auto& samplers = jsonArray(animations[a], "samplers");
+		SkeletalClip clip;
+		clip.name = jsonString(animations[a], "name");
+		clip.duration = 0;
+		for (auto& channel : jsonArray(animations[a], "channels")) {
+			const JsonValue* target = channel.find("target");
+			if (target == nullptr || target->find("node") == nullptr) {
+				continue;
+			}
+			size_t node = jsonIndex(*target, "node", load.skeletonNodes.size(), what + "'s channel");
+			const std::string& path = jsonString(*target, "path");
+			SkeletalClip::ChannelSet* set = path == "translation" ? &clip.translations
+				: path == "rotation" ? &clip.rotations : path == "scale" ? &clip.scales : nullptr;
+			if (load.skeletonNodes[node] < 0 || set == nullptr) {
+				continue;
+			}
+
+			const JsonValue& sampler = samplers[jsonIndex(channel, "sampler", samplers.size(), what + "'s channel")];
+			const GltfAccessor& input = load.gltf.accessors[jsonIndex(sampler, "input", load.gltf.accessors.size(),
+				what + "'s sampler")];
+			const GltfAccessor& output = load.gltf.accessors[jsonIndex(sampler, "output", load.gltf.accessors.size(),
+				what + "'s sampler")];
+			const std::string& interpolation = jsonString(sampler, "interpolation");
+			size_t keyCount = input.count;
+			size_t components = set == &clip.rotations ? 4 : 3;
+			// Cubic spline keys are an in-tangent, a value and an out-tangent.
+			size_t perKey = interpolation == "CUBICSPLINE" ? 3 : 1;
+			if (keyCount == 0) {
+				continue;
+			}
+			if (output.count < keyCount * perKey) {
+				throw std::runtime_error("glTF: " + what + " has a sampler with fewer outputs than inputs");
+			}
+
+			std::vector<float_t> inputTimes(keyCount);
+			readAccessor(input, inputTimes.data(), 1);
+			std::vector<float_t> outputValues(output.count * components, 0);
+			readAccessor(output, outputValues.data(), components);
+			std::vector<float_t> times;
+			std::vector<glm::vec4> values;
+			for (size_t k = 0; k < keyCount; k++) {
+				const float_t* v = &outputValues[(k * perKey + perKey / 2) * components];
+				glm::vec4 value(v[0], v[1], v[2], components == 4 ? v[3] : 0);
+				if (interpolation == "STEP" && k > 0) {
+					times.push_back(std::nextafter(inputTimes[k], -std::numeric_limits<float_t>::infinity()));
+					values.push_back(values.back());
+				}
+				times.push_back(inputTimes[k]);
+				values.push_back(value);
+			}
+			set->addChannel(static_cast<uint32_t>(load.skeletonNodes[node]), times, values);
+			clip.duration = std::max(clip.duration, inputTimes.back());
+		}
+		load.skeleton->addClip(std::move(clip));
+	}
+}
+
+/**
+ * @brief Adds a skin to the skeleton for the meshes of the given node: its joints, and their
+ * inverse bind matrices, or identities if the file gives none.
+ */
+static uint32_t addGltfSkin(GltfLoad& load, size_t node, size_t skinIndex, size_t& jointCount) {
+	const JsonValue& skin = jsonArray(load.gltf.json, "skins")[skinIndex];
+	std::string what = "skin " + std::to_string(skinIndex);
+	std::vector<uint32_t> boneNodes;
+	for (auto& joint : jsonArray(skin, "joints")) {
+		int32_t bone = load.skeletonNodes[jsonIndex(joint, load.skeletonNodes.size(), what + "'s joint")];
+		if (bone < 0) {
+			throw std::runtime_error("glTF: " + what + " has a joint outside the scene");
+		}
+		boneNodes.push_back(static_cast<uint32_t>(bone));
+	}
+	jointCount = boneNodes.size();
+
+	std::vector<glm::mat4> offsets(jointCount, glm::mat4(1));
+	if (skin.find("inverseBindMatrices") != nullptr) {
+		const GltfAccessor& matrices = load.gltf.accessors[jsonIndex(skin, "inverseBindMatrices",
+			load.gltf.accessors.size(), what)];
+		if (matrices.components != 16 || matrices.count < jointCount) {
+			throw std::runtime_error("glTF: " + what + " needs a 4x4 inverse bind matrix per joint");
+		}
+		std::vector<float_t> values(matrices.count * 16);
+		readAccessor(matrices, values.data(), 16);
+		for (size_t j = 0; j < jointCount; j++) {
+			std::memcpy(&offsets[j][0][0], &values[j * 16], sizeof(glm::mat4));
+		}
+	}
+	return load.skeleton->addSkin(static_cast<uint32_t>(load.skeletonNodes[node]), std::move(boneNodes),
+		std::move(offsets));
+}
+
+/**
+ * @brief The accessor a primitive attribute names, or nullptr if the primitive lacks it; it
+ * must have the given number of components, and one element per vertex.
+ */
+static const GltfAccessor* attributeAccessor(const GltfFile& gltf, const JsonValue& attributes, std::string_view name,
+	size_t components, const GltfAccessor* positions, const std::string& what) {
+	if (attributes.find(name) == nullptr) {
+		return nullptr;
+	}
+	const GltfAccessor* accessor = &gltf.accessors[jsonIndex(attributes, name, gltf.accessors.size(), what)];
+	if (accessor->components != components || (positions != nullptr && accessor->count != positions->count)) {
+		throw std::runtime_error("glTF: " + what + "'s " + std::string(name) + " has the wrong type or count");
+	}
+	return accessor;
+}
+
+/**
+ * @brief Lists the triangle primitives under a node, depth first, adding a skin to the
+ * skeleton for each skinned mesh, and decides which can be uploaded in place. Points and
+ * lines are skipped.
+ */
+static void collectPrimitives(GltfLoad& load, size_t node) {
+	const JsonValue& n = jsonArray(load.gltf.json, "nodes")[node];
+	std::string what = "node " + std::to_string(node);
+	auto& meshes = jsonArray(load.gltf.json, "meshes");
+	if (n.find("mesh") != nullptr) {
+		size_t meshIndex = jsonIndex(n, "mesh", meshes.size(), what);
+		std::optional<uint32_t> skin;
+		size_t jointCount = 0;
+		if (n.find("skin") != nullptr && load.skeleton != nullptr) {
+			skin = addGltfSkin(load, node, jsonIndex(n, "skin", jsonArray(load.gltf.json, "skins").size(), what),
+				jointCount);
+		}
+
+		auto& primitives = jsonArray(meshes[meshIndex], "primitives");
+		for (size_t i = 0; i < primitives.size(); i++) {
+			const JsonValue& primitive = primitives[i];
+			std::string primitiveWhat = "mesh " + std::to_string(meshIndex) + "'s primitive " + std::to_string(i);
+			size_t mode = jsonSize(primitive, "mode", primitiveWhat, GL_TRIANGLES);
+			const JsonValue* attributes = primitive.find("attributes");
+			if ((mode != GL_TRIANGLES && mode != GL_TRIANGLE_STRIP && mode != GL_TRIANGLE_FAN)
+				|| attributes == nullptr) {
+				continue;
+			}
+			const GltfAccessor* positions = attributeAccessor(load.gltf, *attributes, "POSITION", 3, nullptr,
+				primitiveWhat);
+			if (positions == nullptr || positions->count == 0) {
+				continue;
+			}
+
+			GltfPrimitive& p = load.primitives.emplace_back(node);
+			p.mode = mode;
+			p.positions = positions;
+			p.normals = attributeAccessor(load.gltf, *attributes, "NORMAL", 3, positions, primitiveWhat);
+			p.texCoords = attributeAccessor(load.gltf, *attributes, "TEXCOORD_0", 2, positions, primitiveWhat);
+			p.joints = attributeAccessor(load.gltf, *attributes, "JOINTS_0", 4, positions, primitiveWhat);
+			p.weights = attributeAccessor(load.gltf, *attributes, "WEIGHTS_0", 4, positions, primitiveWhat);
+			if (primitive.find("indices") != nullptr) {
+				p.indices = &load.gltf.accessors[jsonIndex(primitive, "indices", load.gltf.accessors.size(),
+					primitiveWhat)];
+				if (p.indices->components != 1 || !isIndexType(p.indices->componentType)) {
+					throw std::runtime_error("glTF: " + primitiveWhat + "'s indices have the wrong type");
+				}
+			}
+			if (primitive.find("material") != nullptr) {
+				auto& materials = jsonArray(load.gltf.json, "materials");
+				p.material = &materials[jsonIndex(primitive, "material", materials.size(), primitiveWhat)];
+			}
+			p.skinned = skin.has_value() && p.joints != nullptr && p.weights != nullptr;
+			p.skin = skin.value_or(0);
+			p.jointCount = jointCount;
+
+			// Skinned meshes keep Vertex3D copies for CPU skinning, so are always converted.
+			p.inPlace = mode == GL_TRIANGLES && !p.skinned && p.indices != nullptr && p.indices->data != nullptr
+				&& p.indices->sparseCount == 0 && p.indices->stride == p.indices->elementSize
+				&& readableInPlace(p.positions, 3) && readableInPlace(p.normals, 3)
+				&& (p.texCoords == nullptr || (readableInPlace(p.texCoords, 2) && load.settings.flipTextureCoords));
+		}
+	}
+	for (auto& child : jsonArray(n, "children")) {
+		collectPrimitives(load, jsonIndex(child, load.skeletonNodes.size(), what + "'s child"));
+	}
+}
+
+/**
+ * @brief Converts a primitive into the mesh arena, as indexed triangles, and runs the settings'
+ * mesh steps on it, with scratch memory from the scratch arena. The pool, if given, is used
+ * within steps, so this must not be called from one of its tasks.
+ */
+static void prepareGltfPrimitive(GltfPrimitive& p, const ImportSettings& settings, FrameArena& meshArena,
+	FrameArena& scratch, WorkerPool* pool) {
+	auto start = ImportClock::now();
+	size_t count = p.positions->count;
+	float_t* positions = scratch.allocateArray<float_t>(count * 3);
+	readAccessor(*p.positions, positions, 3);
+	float_t* normals = nullptr;
+	if (p.normals != nullptr) {
+		normals = scratch.allocateArray<float_t>(count * 3);
+		readAccessor(*p.normals, normals, 3);
+	}
+	float_t* texCoords = scratch.allocateArray<float_t>(count * 2);
+	std::fill(texCoords, texCoords + count * 2, 0.0f);
+	if (p.texCoords != nullptr) {
+		readAccessor(*p.texCoords, texCoords, 2);
+	}
+	p.vertices = meshArena.allocateArray<Vertex3D>(count);
+	for (size_t i = 0; i < count; i++) {
+		const float_t* position = positions + i * 3;
+		const float_t* normal = normals != nullptr ? normals + i * 3 : nullptr;
+		float_t v = texCoords[i * 2 + 1];
+		new (&p.vertices[i]) Vertex3D(position[0], position[1], position[2], normal != nullptr ? normal[0] : 0,
+			normal != nullptr ? normal[1] : 0, normal != nullptr ? normal[2] : 1, texCoords[i * 2],
+			settings.flipTextureCoords ? v : 1 - v);
+	}
+
+	if (p.skinned) {
+		uint32_t* joints = scratch.allocateArray<uint32_t>(count * 4);
+		float_t* weights = scratch.allocateArray<float_t>(count * 4);
+		readAccessor(*p.joints, joints, 4);
+		readAccessor(*p.weights, weights, 4);
+		p.influences.assign(count, VertexBoneData());
+		for (size_t i = 0; i < count; i++) {
+			VertexBoneData& influence = p.influences[i];
+			for (size_t k = 0; k < 4; k++) {
+				if (weights[i * 4 + k] > 0 && joints[i * 4 + k] >= p.jointCount) {
+					throw std::runtime_error("glTF: vertex influenced by a joint outside its skin");
+				}
+				influence.ids[k] = weights[i * 4 + k] > 0 ? joints[i * 4 + k] : 0;
+				influence.weights[k] = std::max(weights[i * 4 + k], 0.0f);
+			}
+			influence.normalize();
+		}
+	}
+
+	// Strips and fans become lists; glTF strips alternate their winding.
+	size_t sourceCount = p.indices != nullptr ? p.indices->count : count;
+	uint32_t* source = nullptr;
+	if (p.indices != nullptr) {
+		source = scratch.allocateArray<uint32_t>(sourceCount);
+		readAccessor(*p.indices, source, 1);
+		for (size_t i = 0; i < sourceCount; i++) {
+			if (source[i] >= count) {
+				throw std::runtime_error("glTF: primitive index out of range");
+			}
+		}
+	}
+	auto at = [&](size_t i) { return source != nullptr ? source[i] : static_cast<uint32_t>(i); };
+	size_t triangles = p.mode == GL_TRIANGLES ? sourceCount / 3 : sourceCount >= 3 ? sourceCount - 2 : 0;
+	p.indexCount = triangles * 3;
+	p.indexData = meshArena.allocateArray<uint32_t>(p.indexCount);
+	for (size_t t = 0; t < triangles; t++) {
+		uint32_t* triangle = p.indexData + t * 3;
+		if (p.mode == GL_TRIANGLES) {
+			triangle[0] = at(t * 3);
+			triangle[1] = at(t * 3 + 1);
+			triangle[2] = at(t * 3 + 2);
+		}
+		else if (p.mode == GL_TRIANGLE_STRIP) {
+			triangle[0] = at(t % 2 == 0 ? t : t + 1);
+			triangle[1] = at(t % 2 == 0 ? t + 1 : t);
+			triangle[2] = at(t + 2);
+		}
+		else {
+			triangle[0] = at(t + 1);
+			triangle[1] = at(t + 2);
+			triangle[2] = at(0);
+		}
+	}
+	scratch.reset();
+	p.convertMs += std::chrono::duration<double, std::milli>(ImportClock::now() - start).count();
+
+	p.vertexCount = runMeshSteps(p.vertices, count, p.indexData, p.indexCount, p.normals != nullptr, settings,
+		scratch, pool, p.skinned ? p.influences.data() : nullptr, p.stepMs);
+	if (p.skinned) {
+		p.influences.resize(p.vertexCount);
+	}
+}
+
+/**
+ * @brief Loads an image into a texture, or returns the texture already loaded from it, bound
+ * to the given sampler.
+ */
+static Texture loadGltfImage(GltfLoad& load, size_t imageIndex, const std::string& samplerName) {
+	auto existing = load.images.find(imageIndex);
+	if (existing != load.images.end()) {
+		Texture texture = existing->second;
+		texture.samplerName = samplerName;
+		return texture;
+	}
+
+	const JsonValue& image = jsonArray(load.gltf.json, "images")[imageIndex];
+	std::string what = "image " + std::to_string(imageIndex);
+	Texture texture;
+	const JsonValue* uri = image.find("uri");
+	if (uri != nullptr && isDataUri(uri->string)) {
+		std::vector<uint8_t> data = decodeDataUri(uri->string);
+		texture = loadTextureData(data.data(), data.size(), samplerName, load.report);
+	}
+	else if (uri != nullptr) {
+		texture = loadTextureFile(uriPath(load.gltf.directory, uri->string), samplerName, load.loadedTextures,
+			load.report);
+	}
+	else {
+		const GltfBufferView& view = load.gltf.views[jsonIndex(image, "bufferView", load.gltf.views.size(), what)];
+		texture = loadTextureData(view.data, view.size, samplerName, load.report);
+	}
+	load.images.emplace(imageIndex, texture);
+	texture.samplerName = samplerName;
+	return texture;
+}
+
+/**
+ * @brief Loads a material's textures, in the order the Assimp importer gives them: the base
+ * color (or, for specular-glossiness materials, diffuse) map, the specular map, then the
+ * normal map. Textures with no image of their own, such as those only given by an extension,
+ * are skipped.
+ */
+static std::vector<Texture> loadGltfTextures(GltfLoad& load, const JsonValue* material) {
+	std::vector<Texture> textures;
+	if (material == nullptr) {
+		return textures;
+	}
+	auto& fileTextures = jsonArray(load.gltf.json, "textures");
+	size_t imageCount = jsonArray(load.gltf.json, "images").size();
+	auto add = [&](const JsonValue* info, const std::string& samplerName) {
+		if (info == nullptr) {
+			return;
+		}
+		const JsonValue& texture = fileTextures[jsonIndex(*info, "index", fileTextures.size(), "texture reference")];
+		if (texture.find("source") != nullptr) {
+			textures.push_back(loadGltfImage(load, jsonIndex(texture, "source", imageCount, "texture"), samplerName));
+		}
+	};
+
+	const JsonValue* metallicRoughness = material->find("pbrMetallicRoughness");
+	const JsonValue* baseColor = metallicRoughness != nullptr ? metallicRoughness->find("baseColorTexture") : nullptr;
+	const JsonValue* extensions = material->find("extensions");
+	const JsonValue* specularGlossiness = extensions != nullptr
+		? extensions->find("KHR_materials_pbrSpecularGlossiness") : nullptr;
+	if (baseColor == nullptr && specularGlossiness != nullptr) {
+		baseColor = specularGlossiness->find("diffuseTexture");
+	}
+	add(baseColor, "baseTexture");
+	if (specularGlossiness != nullptr) {
+		add(specularGlossiness->find("specularGlossinessTexture"), "specMap");
+	}
+	add(material->find("normalTexture"), "normalMap");
+	return textures;
+}
+
+/**
+ * @brief Where the buffer ranges holding an in-place primitive's attributes go in its vertex
+ * buffer: ranges that overlap, as interleaved attributes do, are merged and uploaded once.
+ */
+static VertexStreams inPlaceStreams(const GltfPrimitive& p) {
+	VertexStreams streams;
+	streams.layout.position.stride = p.positions->stride;
+	streams.layout.normal.stride = p.normals->stride;
+	if (p.texCoords != nullptr) {
+		streams.layout.texCoord = VertexStream{ 0, p.texCoords->stride };
+	}
+
+	struct Span {
+		const uint8_t* begin;
+		const uint8_t* end;
+		VertexStream* stream;
+	};
+	std::vector<Span> spans;
+	auto add = [&](const GltfAccessor* accessor, VertexStream* stream) {
+		spans.push_back(Span{ accessor->data, accessor->data + (accessor->count - 1) * accessor->stride
+			+ accessor->elementSize, stream });
+	};
+	add(p.positions, &streams.layout.position);
+	add(p.normals, &streams.layout.normal);
+	if (p.texCoords != nullptr) {
+		add(p.texCoords, &*streams.layout.texCoord);
+	}
+	std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+		return std::less<const uint8_t*>()(a.begin, b.begin);
+	});
+
+	size_t offset = 0;
+	for (size_t first = 0; first < spans.size();) {
+		const uint8_t* begin = spans[first].begin;
+		const uint8_t* end = spans[first].end;
+		size_t last = first + 1;
+		while (last < spans.size() && std::less<const uint8_t*>()(spans[last].begin, end)) {
+			end = std::max(end, spans[last].end, std::less<const uint8_t*>());
+			last++;
+		}
+		for (size_t s = first; s < last; s++) {
+			spans[s].stream->offset = offset + (spans[s].begin - begin);
+		}
+		streams.ranges.emplace_back(begin, static_cast<size_t>(end - begin));
+		offset += end - begin;
+		first = last;
+	}
+	return streams;
+}
+
+/**
+ * @brief The box containing an accessor's 3-component elements: from its min and max if it has
+ * them, as glTF requires of positions, or else from reading the elements.
+ */
+static void accessorBounds(const GltfAccessor& accessor, glm::vec3& low, glm::vec3& high) {
+	if (accessor.min != nullptr && accessor.max != nullptr && accessor.sparseCount == 0) {
+		jsonFloats(accessor.min, &low[0], 3, "position accessor's min");
+		jsonFloats(accessor.max, &high[0], 3, "position accessor's max");
+		return;
+	}
+	std::vector<float_t> values(accessor.count * 3);
+	readAccessor(accessor, values.data(), 3);
+	low = high = glm::vec3(values[0], values[1], values[2]);
+	for (size_t i = 1; i < accessor.count; i++) {
+		glm::vec3 value(values[i * 3], values[i * 3 + 1], values[i * 3 + 2]);
+		low = glm::min(low, value);
+		high = glm::max(high, value);
+	}
+}
+
+/**
+ * @brief Loads a primitive's textures and uploads it: in place, straight from the mapped
+ * buffers, or from staging memory.
+ */
+static Mesh3D uploadGltfPrimitive(GltfLoad& load, GltfPrimitive& p) {
+	std::vector<Texture> textures = loadGltfTextures(load, p.material);
+	ImportReport* report = load.report;
+	if (p.inPlace) {
+		// The indices are read, not copied, to check them: the GPU must not be sent any that
+		// are out of range.
+		size_t vertexCount = p.positions->count;
+		size_t indexCount = p.indices->count / 3 * 3;
+		size_t indexSize = componentSize(p.indices->componentType);
+		for (size_t i = 0; i < indexCount; i++) {
+			uint32_t index = 0;
+			std::memcpy(&index, p.indices->data + i * indexSize, indexSize);
+			if (index >= vertexCount) {
+				throw std::runtime_error("glTF: primitive index out of range");
+			}
+		}
+		glm::vec3 low, high;
+		accessorBounds(*p.positions, low, high);
+		VertexStreams streams = inPlaceStreams(p);
+		size_t vertexBytes = 0;
+		for (auto& range : streams.ranges) {
+			vertexBytes += range.second;
+		}
+
+		if (report != nullptr) {
+			report->meshCount++;
+			report->vertexCount += vertexCount;
+			report->convertedVertexCount += vertexCount;
+			report->triangleCount += indexCount / 3;
+			report->vertexBytes += vertexBytes;
+			report->indexBytes += indexCount * indexSize;
+			report->inPlaceBytes += vertexBytes + indexCount * indexSize;
+		}
+		auto start = ImportClock::now();
+		Mesh3D mesh(streams, vertexCount, p.indices->data, p.indices->componentType, indexCount, low, high,
+			std::move(textures));
+		addImportTime(report, &ImportReport::meshUploadMs, start);
+		return mesh;
+	}
+
+	if (report != nullptr) {
+		report->meshCount++;
+		report->vertexCount += p.vertexCount;
+		report->convertedVertexCount += p.positions->count;
+		report->triangleCount += p.indexCount / 3;
+		report->vertexBytes += p.vertexCount * sizeof(Vertex3D) + p.influences.size() * sizeof(VertexBoneData);
+		report->indexBytes += p.indexCount * sizeof(uint32_t);
+	}
+	auto start = ImportClock::now();
+	Mesh3D mesh(p.vertices, p.vertexCount, p.indexData, p.indexCount, std::move(textures));
+	if (p.skinned) {
+		// Rigged meshes keep a copy of their bind-pose vertices for CPU skinning.
+		std::vector<Vertex3D> bindVertices(p.vertices, p.vertices + p.vertexCount);
+		mesh.setSkin(load.skeleton, p.skin, std::move(bindVertices), std::move(p.influences));
+	}
+	addImportTime(report, &ImportReport::meshUploadMs, start);
+	return mesh;
+}
+
+/**
+ * @brief Builds a node's object and its children's, uploading their primitives, which are
+ * consumed in the order collectPrimitives listed them.
+ */
+static Object3D buildGltfNode(GltfLoad& load, size_t node) {
+	const JsonValue& n = jsonArray(load.gltf.json, "nodes")[node];
+	std::string what = "node " + std::to_string(node);
+	std::vector<Mesh3D> meshes;
+	while (load.nextPrimitive < load.primitives.size() && load.primitives[load.nextPrimitive].node == node) {
+		meshes.emplace_back(uploadGltfPrimitive(load, load.primitives[load.nextPrimitive++]));
+	}
+
+	glm::vec3 translation, scale;
+	glm::quat rotation;
+	Object3D object(std::move(meshes), nodeTransform(n, what, translation, rotation, scale));
+	object.setName(jsonString(n, "name"));
+	for (auto& child : jsonArray(n, "children")) {
+		object.addChild(buildGltfNode(load, jsonIndex(child, load.skeletonNodes.size(), what + "'s child")));
+	}
+	return object;
+}
+
+Object3D gltfLoad(const std::string& path, const ImportSettings& settings, ImportReport* report) {
+	auto loadStart = ImportClock::now();
+	GltfLoad load(readGltf(path), settings, report);
+	addImportTime(report, &ImportReport::parseMs, loadStart);
+
+	// The scene's root nodes; files without scenes show every node that has no parent.
+	auto& nodes = jsonArray(load.gltf.json, "nodes");
+	std::vector<int32_t> parents(nodes.size(), -1);
+	for (size_t i = 0; i < nodes.size(); i++) {
+		for (auto& child : jsonArray(nodes[i], "children")) {
+			size_t c = jsonIndex(child, nodes.size(), "node " + std::to_string(i) + "'s child");
+			if (parents[c] >= 0 || c == i) {
+				throw std::runtime_error("glTF: node " + std::to_string(c) + " has more than one parent");
+			}
+			parents[c] = static_cast<int32_t>(i);
+		}
+	}
+	std::vector<size_t> roots;
+	auto& scenes = jsonArray(load.gltf.json, "scenes");
+	if (!scenes.empty()) {
+		size_t scene = jsonSize(load.gltf.json, "scene", "file", 0);
+		if (scene >= scenes.size()) {
+			throw std::runtime_error("glTF: the default scene is out of range");
+		}
+		for (auto& root : jsonArray(scenes[scene], "nodes")) {
+			size_t r = jsonIndex(root, nodes.size(), "scene's node");
+			if (parents[r] >= 0) {
+				throw std::runtime_error("glTF: the scene's node " + std::to_string(r) + " has a parent");
+			}
+			roots.push_back(r);
+		}
+	}
+	else {
+		for (size_t i = 0; i < nodes.size(); i++) {
+			if (parents[i] < 0) {
+				roots.push_back(i);
+			}
+		}
+	}
+
+	// Rigged or animated models get a skeleton mirroring the scene's node hierarchy, under a
+	// root of its own if the scene has several, as with Assimp. Nodes outside the scene are
+	// left out; they stay -1 in skeletonNodes, which otherwise only checks for repeats.
+	auto start = ImportClock::now();
+	load.skeletonNodes.assign(nodes.size(), -1);
+	if (!jsonArray(load.gltf.json, "skins").empty() || !jsonArray(load.gltf.json, "animations").empty()) {
+		load.skeleton = std::make_shared<Skeleton>();
+		int32_t parent = -1;
+		if (roots.size() != 1) {
+			parent = static_cast<int32_t>(load.skeleton->addNode("ROOT", -1, glm::vec3(0), glm::quat(1, 0, 0, 0),
+				glm::vec3(1)));
+		}
+		for (size_t root : roots) {
+			addGltfNodes(load, root, parent);
+		}
+		addGltfAnimations(load);
+	}
+	for (size_t root : roots) {
+		collectPrimitives(load, root);
+	}
+	if (load.skeleton != nullptr) {
+		load.skeleton->evaluate();
+	}
+	addImportTime(report, &ImportReport::skeletonMs, start);
+
+	// Primitives that cannot be uploaded in place are converted on a pool started for them.
+	std::vector<GltfPrimitive*> converted;
+	for (auto& p : load.primitives) {
+		if (!p.inPlace) {
+			converted.push_back(&p);
+		}
+	}
+	std::unique_ptr<WorkerPool> pool;
+	std::unique_ptr<ImportStaging> staging;
+	if (!converted.empty()) {
+		start = ImportClock::now();
+		pool = std::make_unique<WorkerPool>();
+		staging = std::make_unique<ImportStaging>(settings, pool.get());
+		prepareMeshesInParallel(*staging, converted.size(),
+			[&](size_t p) { return converted[p]->positions->count; },
+			[&](size_t p, FrameArena& meshArena, FrameArena& scratch, WorkerPool* stepPool) {
+				// Bad indices or joints are found while converting, on the pool's threads; each
+				// primitive keeps its own error, so the first in file order is reported.
+				try {
+					prepareGltfPrimitive(*converted[p], settings, meshArena, scratch, stepPool);
+				}
+				catch (std::exception& e) {
+					converted[p]->error = e.what();
+				}
+			});
+		for (GltfPrimitive* p : converted) {
+			if (!p->error.empty()) {
+				throw std::runtime_error(p->error);
+			}
+		}
+		addImportTime(report, &ImportReport::processMs, start);
+		if (report != nullptr) {
+			for (GltfPrimitive* p : converted) {
+				report->convertMs += p->convertMs;
+				for (size_t s = 0; s < IMPORT_STEP_COUNT; s++) {
+					report->stepMs[s] += p->stepMs[s];
+				}
+			}
+		}
+	}
+
+	std::vector<Mesh3D> noMeshes;
+	Object3D result = roots.size() == 1 ? buildGltfNode(load, roots[0]) : Object3D(std::move(noMeshes));
+	if (roots.size() != 1) {
+		for (size_t root : roots) {
+			result.addChild(buildGltfNode(load, root));
+		}
+	}
+	result.setSkeleton(load.skeleton);
+
+	if (report != nullptr) {
+		if (staging != nullptr) {
+			report->stagingBytes = std::max(report->stagingBytes, staging->capacity());
+		}
+		report->fileBytes += load.gltf.file->size();
+	}
+	addImportTime(report, &ImportReport::totalMs, loadStart);
+	return result;
+}
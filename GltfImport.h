@@ -0,0 +1,18 @@
+#pragma once
+#include "ImportPipeline.h"
+#include "Object3D.h"
+#include <string>
+
+/**
+ * @brief Imports a glTF 2.0 model without Assimp: a .gltf file, with buffers in files or data
+ * URIs, or a binary .glb. The file and its buffers are mapped, not read, and the node hierarchy
+ * is built straight into objects, each primitive a mesh of its node's object.
+ * Primitives the GPU can read as stored (indexed triangles with float positions, normals and
+ * texture coordinates, and no skin) are uploaded straight from the mapping, without the mesh
+ * steps, as glTF geometry is already indexed for drawing. glTF texture coordinates have their
+ * origin at the top left, as flipTextureCoords asks for, so without it they are converted too.
+ * Converted primitives run the settings' mesh steps, in parallel on a pool started for them.
+ * Skins and animations become a skeleton, as with Assimp. Throws std::runtime_error if the file
+ * is malformed or refers outside its buffers.
+ */
+Object3D gltfLoad(const std::string& path, const ImportSettings& settings, ImportReport* report = nullptr);
@@ -0,0 +1,102 @@
+#include "HeadlessContext.h"
+#include <stdexcept>
+#include <glad/glad.h>
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+/**
+ * @brief Opens Mesa's surfaceless EGL display if the platform is available, or else the
+ * default display.
+ */
+static EGLDisplay openDisplay() {
+	auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+		eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	if (getPlatformDisplay != nullptr) {
+		EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display != EGL_NO_DISPLAY) {
+			return display;
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+HeadlessContext::HeadlessContext() : m_display(nullptr), m_context(nullptr) {
+	EGLDisplay display = openDisplay();
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		throw std::runtime_error("Could not initialize an EGL display");
+	}
+	m_display = display;
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		throw std::runtime_error("EGL does not support desktop OpenGL");
+	}
+
+	// Rendering goes to framebuffer objects, so the config's own buffers do not matter; but
+	// the surface type defaults to windows, which a surfaceless display has none of.
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+		throw std::runtime_error("No EGL config supports OpenGL rendering");
+	}
+
+	// Prefer a compatibility context, like the one SFML creates for the window; fall back to core.
+	EGLint profiles[] = {
+		EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+		EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT
+	};
+	EGLContext context = EGL_NO_CONTEXT;
+	for (EGLint profile : profiles) {
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, profile,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+		if (context != EGL_NO_CONTEXT) {
+			break;
+		}
+	}
+	if (context == EGL_NO_CONTEXT) {
+		throw std::runtime_error("Could not create an OpenGL 3.3 context through EGL");
+	}
+	m_context = context;
+
+	// Surfaceless: the context renders only into framebuffer objects.
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		throw std::runtime_error("Could not make the headless context current");
+	}
+	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+		throw std::runtime_error("Could not load OpenGL functions for the headless context");
+	}
+	m_renderer = std::string(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) + ", OpenGL "
+		+ reinterpret_cast<const char*>(glGetString(GL_VERSION));
+}
+
+HeadlessContext::~HeadlessContext() {
+	if (m_context != nullptr) {
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(m_display, m_context);
+	}
+	if (m_display != nullptr) {
+		eglTerminate(m_display);
+	}
+}
+
+#else
+
+HeadlessContext::HeadlessContext() : m_display(nullptr), m_context(nullptr) {
+	throw std::runtime_error("Headless rendering requires EGL, which is only supported on Linux");
+}
+
+HeadlessContext::~HeadlessContext() {
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+
+/**
+ * @brief An OpenGL context with no window or display server, for rendering on build machines.
+ * It is created through EGL on Mesa's surfaceless platform, so it works with the llvmpipe
+ * software rasterizer (set LIBGL_ALWAYS_SOFTWARE=1 to force it). The context has no default
+ * framebuffer; render into an OffscreenTarget. Constructing one makes it current on the calling
+ * thread and loads the GL functions through glad.
+ */
+class HeadlessContext {
+private:
+	void* m_display;
+	void* m_context;
+	std::string m_renderer;
+
+public:
+	/**
+	 * @brief Creates the context and makes it current. Throws if EGL is unavailable or no
+	 * OpenGL 3.3 context can be created.
+	 */
+	HeadlessContext();
+	~HeadlessContext();
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	/**
+	 * @brief The GL_RENDERER and GL_VERSION strings of the context, for reports.
+	 */
+	const std::string& renderer() const { return m_renderer; }
+};
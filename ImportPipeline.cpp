@@ -0,0 +1,225 @@
+#include "ImportPipeline.h"
+#include "MeshProcessing.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+static const char* IMPORT_STEP_NAMES[IMPORT_STEP_COUNT] = {
+	"validate", "remove-redundant-materials", "optimize-meshes", "remove-degenerates", "generate-uvs",
+	"triangulate", "sort-by-type", "find-invalid-data", "limit-bone-weights", "normals", "weld",
+	"optimize-cache"
+};
+
+const char* importStepName(ImportStep step) {
+	return IMPORT_STEP_NAMES[static_cast<size_t>(step)];
+}
+
+ImportSettings& ImportSettings::add(ImportStep step) {
+	steps |= 1u << static_cast<uint32_t>(step);
+	return *this;
+}
+
+ImportSettings& ImportSettings::remove(ImportStep step) {
+	steps &= ~(1u << static_cast<uint32_t>(step));
+	return *this;
+}
+
+std::string ImportSettings::describe() const {
+	std::string names;
+	for (size_t i = 0; i < IMPORT_STEP_COUNT; i++) {
+		if (has(static_cast<ImportStep>(i))) {
+			names += (names.empty() ? "" : ",") + std::string(IMPORT_STEP_NAMES[i]);
+		}
+	}
+	return names;
+}
+
+ImportSettings ImportSettings::profile(ImportProfile profile) {
+	ImportSettings settings;
+	settings.add(ImportStep::Triangulate).add(ImportStep::SortByType).add(ImportStep::GenerateNormals)
+		.add(ImportStep::Weld);
+	if (profile == ImportProfile::Fast) {
+		return settings;
+	}
+	settings.add(ImportStep::GenerateUVs).add(ImportStep::LimitBoneWeights).add(ImportStep::OptimizeCache);
+	if (profile == ImportProfile::Balanced) {
+		return settings;
+	}
+	settings.add(ImportStep::Validate).add(ImportStep::RemoveDegenerates).add(ImportStep::FindInvalidData)
+		.add(ImportStep::RemoveRedundantMaterials).add(ImportStep::OptimizeMeshes);
+	return settings;
+}
+
+ImportSettings ImportSettings::parse(const std::string& text) {
+	if (text == "fast") {
+		return profile(ImportProfile::Fast);
+	}
+	if (text == "balanced") {
+		return profile(ImportProfile::Balanced);
+	}
+	if (text == "max") {
+		return profile(ImportProfile::Max);
+	}
+	ImportSettings settings;
+	std::istringstream list(text);
+	std::string name;
+	while (std::getline(list, name, ',')) {
+		auto found = std::find_if(std::begin(IMPORT_STEP_NAMES), std::end(IMPORT_STEP_NAMES),
+			[&](const char* step) { return name == step; });
+		if (found == std::end(IMPORT_STEP_NAMES)) {
+			throw std::runtime_error("Unknown import profile or step: " + name);
+		}
+		settings.add(static_cast<ImportStep>(found - std::begin(IMPORT_STEP_NAMES)));
+	}
+	return settings;
+}
+
+ImportStaging::ImportStaging(const ImportSettings& settings, WorkerPool* pool) : settings(settings), pool(pool) {
+	size_t workers = pool != nullptr ? pool->threadCount() : 1;
+	for (size_t i = 0; i < workers; i++) {
+		meshArenas.push_back(std::make_unique<FrameArena>(1 << 20));
+		scratchArenas.push_back(std::make_unique<FrameArena>(1 << 20));
+	}
+}
+
+size_t ImportStaging::capacity() const {
+	size_t total = 0;
+	for (size_t i = 0; i < meshArenas.size(); i++) {
+		total += meshArenas[i]->capacity() + scratchArenas[i]->capacity();
+	}
+	return total;
+}
+
+void ImportStaging::reset() {
+	for (size_t i = 0; i < meshArenas.size(); i++) {
+		meshArenas[i]->reset();
+		scratchArenas[i]->reset();
+	}
+}
+
+double ImportReport::otherMs() const {
+	return totalMs - parseMs - postProcessMs - skeletonMs - processMs - textureDecodeMs
+		- textureUploadMs - meshUploadMs;
+}
+
+std::string ImportReport::describe() const {
+	std::ostringstream out;
+	out.precision(4);
+	out << totalMs << " ms: parse " << parseMs << ", post-process " << postProcessMs
+		<< ", skeleton " << skeletonMs << ", process " << processMs << ", texture decode "
+		<< textureDecodeMs << ", texture upload " << textureUploadMs << ", mesh upload "
+		<< meshUploadMs << ", other " << otherMs() << "; steps: convert " << convertMs;
+	for (size_t i = 0; i < IMPORT_STEP_COUNT; i++) {
+		if (stepMs[i] > 0) {
+			out << ", " << IMPORT_STEP_NAMES[i] << " " << stepMs[i];
+		}
+	}
+	out << "; " << meshCount << " meshes, " << vertexCount << " vertices (converted "
+		<< convertedVertexCount << "), " << triangleCount << " triangles, " << textureCount
+		<< " textures; file " << fileBytes / 1024 << " KiB, texture files " << textureFileBytes / 1024
+		<< " KiB, uploaded " << (vertexBytes + indexBytes + textureBytes) / 1024 << " KiB ("
+		<< inPlaceBytes / 1024 << " KiB in place), staged in "
+		<< stagingBytes / 1024 << " KiB";
+	return out.str();
+}
+
+void addImportTime(ImportReport* report, double ImportReport::* phase, ImportClock::time_point start) {
+	if (report != nullptr) {
+		report->*phase += std::chrono::duration<double, std::milli>(ImportClock::now() - start).count();
+	}
+}
+
+Texture loadTextureFile(const std::filesystem::path& path, const std::string& samplerName,
+	std::unordered_map<std::filesystem::path, Texture>& loadedTextures, ImportReport* report) {
+	auto existing = loadedTextures.find(path);
+	if (existing != loadedTextures.end()) {
+		return existing->second;
+	}
+
+	auto start = ImportClock::now();
+	sf::Image image;
+	image.loadFromFile(path.string());
+	addImportTime(report, &ImportReport::textureDecodeMs, start);
+
+	start = ImportClock::now();
+	Texture tex = Texture::loadImage(image, samplerName, path.string());
+	addImportTime(report, &ImportReport::textureUploadMs, start);
+	loadedTextures.insert(std::make_pair(path, tex));
+
+	if (report != nullptr) {
+		std::error_code error;
+		auto bytes = std::filesystem::file_size(path, error);
+		report->textureFileBytes += error ? 0 : bytes;
+		report->textureBytes += static_cast<size_t>(image.getSize().x) * image.getSize().y * 4;
+		report->textureCount++;
+	}
+	return tex;
+}
+
+Texture loadTextureData(const uint8_t* data, size_t size, const std::string& samplerName, ImportReport* report) {
+	auto start = ImportClock::now();
+	sf::Image image;
+	image.loadFromMemory(data, size);
+	addImportTime(report, &ImportReport::textureDecodeMs, start);
+
+	start = ImportClock::now();
+	Texture tex = Texture::loadImage(image, samplerName);
+	addImportTime(report, &ImportReport::textureUploadMs, start);
+
+	if (report != nullptr) {
+		report->textureFileBytes += size;
+		report->textureBytes += static_cast<size_t>(image.getSize().x) * image.getSize().y * 4;
+		report->textureCount++;
+	}
+	return tex;
+}
+
+size_t runMeshSteps(Vertex3D* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount,
+	bool hasNormals, const ImportSettings& settings, FrameArena& scratch, WorkerPool* pool,
+	VertexBoneData* influences, double* stepMs) {
+	auto step = [&](ImportStep step, auto run) {
+		if (settings.has(step)) {
+			auto start = ImportClock::now();
+			run();
+			scratch.reset();
+			stepMs[static_cast<size_t>(step)] += std::chrono::duration<double, std::milli>(
+				ImportClock::now() - start).count();
+		}
+	};
+	if (!hasNormals) {
+		step(ImportStep::GenerateNormals, [&]() {
+			generateNormals(vertices, vertexCount, indices, indexCount, scratch);
+		});
+	}
+	step(ImportStep::Weld, [&]() {
+		vertexCount = weldVertices(vertices, vertexCount, indices, indexCount, settings.weld, scratch, pool, influences);
+	});
+	step(ImportStep::OptimizeCache, [&]() {
+		vertexCount = optimizeVertexCache(vertices, vertexCount, indices, indexCount, scratch, influences);
+	});
+	return vertexCount;
+}
+
+void prepareMeshesInParallel(ImportStaging& staging, size_t meshCount, const std::function<size_t(size_t)>& vertexCount,
+	const std::function<void(size_t, FrameArena&, FrameArena&, WorkerPool*)>& prepare) {
+	WorkerPool* pool = staging.pool;
+	std::vector<size_t> small;
+	for (size_t i = 0; i < meshCount; i++) {
+		if (pool != nullptr && vertexCount(i) >= staging.settings.weld.parallelThreshold) {
+			prepare(i, *staging.meshArenas[0], *staging.scratchArenas[0], pool);
+		}
+		else {
+			small.push_back(i);
+		}
+	}
+	if (pool != nullptr && small.size() > 1) {
+		pool->run(small.size(), [&](size_t index, size_t worker) {
+			prepare(small[index], *staging.meshArenas[worker], *staging.scratchArenas[worker], nullptr);
+		});
+	}
+	else {
+		for (size_t i : small) {
+			prepare(i, *staging.meshArenas[0], *staging.scratchArenas[0], nullptr);
+		}
+	}
+}
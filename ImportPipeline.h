@@ -0,0 +1,201 @@
+#pragma once
+#include "FrameArena.h"
+#include "Mesh3D.h"
+#include "Texture.h"
+#include "VertexWeld.h"
+#include "WorkerPool.h"
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief A post-processing step of an import. Assimp's steps come first, run on the whole
+ * scene in this order before any mesh is converted, and only when Assimp reads the file; the
+ * rest are ours, run on each converted mesh in this order, with meshes processed in parallel.
+ * Triangulate and SortByType always run, as the conversion reads triangles only. There is no
+ * tangent step: no shader uses tangents.
+ */
+enum class ImportStep {
+	// Assimp's ValidateDataStructure, FindDegenerates and the others of the same names.
+	Validate,
+	RemoveRedundantMaterials,
+	OptimizeMeshes,
+	RemoveDegenerates,
+	GenerateUVs,
+	Triangulate,
+	SortByType,
+	FindInvalidData,
+	LimitBoneWeights,
+	// Smooth normals, for meshes the file gives none; see generateNormals.
+	GenerateNormals,
+	// See weldVertices.
+	Weld,
+	// See optimizeVertexCache.
+	OptimizeCache,
+	Count
+};
+
+const size_t IMPORT_STEP_COUNT = static_cast<size_t>(ImportStep::Count);
+
+/**
+ * @brief The step's name in ImportSettings::parse lists, such as "remove-degenerates".
+ */
+const char* importStepName(ImportStep step);
+
+/**
+ * @brief Preset step lists. Fast only triangulates, generates missing normals and welds;
+ * balanced also generates texture coordinates from other mappings, limits bone weights and
+ * optimizes for the vertex cache; max also validates the scene and removes degenerate
+ * triangles, invalid data, redundant materials and needless mesh splits.
+ */
+enum class ImportProfile {
+	Fast,
+	Balanced,
+	Max
+};
+
+/**
+ * @brief The steps an import runs, and how.
+ */
+struct ImportSettings {
+	// A bit per ImportStep.
+	uint32_t steps = 0;
+	bool flipTextureCoords = false;
+	// Whether formats with a loader of our own (OBJ, glTF) bypass Assimp.
+	bool nativeLoaders = true;
+	WeldSettings weld;
+
+	bool has(ImportStep step) const { return (steps & (1u << static_cast<uint32_t>(step))) != 0; }
+	ImportSettings& add(ImportStep step);
+	ImportSettings& remove(ImportStep step);
+
+	/**
+	 * @brief The steps as a comma-separated list of their names.
+	 */
+	std::string describe() const;
+
+	static ImportSettings profile(ImportProfile profile);
+
+	/**
+	 * @brief Reads a profile name ("fast", "balanced" or "max") or a comma-separated list of
+	 * step names. Throws std::runtime_error naming anything it does not recognize.
+	 */
+	static ImportSettings parse(const std::string& text);
+};
+
+/**
+ * @brief Where the time of one import went, and how much data it moved. The GL upload times
+ * are the CPU cost of the upload calls; a driver may finish the copies later.
+ */
+struct ImportReport {
+	// Phase times, in milliseconds.
+	// Reading and parsing the file, before any post-processing.
+	double parseMs = 0;
+	// Assimp's post-processing steps.
+	double postProcessMs = 0;
+	// Building the skeleton and importing animation clips.
+	double skeletonMs = 0;
+	// Converting meshes and running our steps on them, with meshes in parallel.
+	double processMs = 0;
+	// Decoding texture image files.
+	double textureDecodeMs = 0;
+	double textureUploadMs = 0;
+	// Creating vertex arrays and uploading vertex and index buffers.
+	double meshUploadMs = 0;
+	double totalMs = 0;
+
+	// Copying parsed data into vertex, index and bone influence arrays, and the time of each
+	// step. The times of our steps, like the conversion's, are summed over the threads that
+	// ran them, so they can add up to more than processMs.
+	double convertMs = 0;
+	double stepMs[IMPORT_STEP_COUNT] = {};
+
+	// The size of the file named by the path, not counting buffers or images it references.
+	size_t fileBytes = 0;
+	size_t textureFileBytes = 0;
+	// Decoded RGBA texture bytes uploaded.
+	size_t textureBytes = 0;
+	size_t vertexBytes = 0;
+	size_t indexBytes = 0;
+	// The part of those uploaded straight from the file's buffers, with no conversion.
+	size_t inPlaceBytes = 0;
+	size_t meshCount = 0;
+	// Vertices after processing, and as converted.
+	size_t vertexCount = 0;
+	size_t convertedVertexCount = 0;
+	size_t triangleCount = 0;
+	size_t textureCount = 0;
+	// The staging memory meshes were converted and processed in, reused from mesh to mesh.
+	size_t stagingBytes = 0;
+
+	/**
+	 * @brief Time not spent in any measured phase, such as building the object hierarchy.
+	 */
+	double otherMs() const;
+
+	std::string describe() const;
+};
+
+/**
+ * @brief What an import converts and processes meshes with: its settings, the workers meshes
+ * are processed on, and per worker, an arena holding the meshes it converted until they are
+ * uploaded and one for its steps' scratch memory. The arenas are reset after each upload, so
+ * they serve every mesh of an import and grow only to the largest batch.
+ */
+struct ImportStaging {
+	ImportSettings settings;
+	WorkerPool* pool;
+	std::vector<std::unique_ptr<FrameArena>> meshArenas;
+	std::vector<std::unique_ptr<FrameArena>> scratchArenas;
+
+	explicit ImportStaging(const ImportSettings& settings = ImportSettings::profile(ImportProfile::Balanced),
+		WorkerPool* pool = nullptr);
+
+	size_t capacity() const;
+	void reset();
+};
+
+using ImportClock = std::chrono::steady_clock;
+
+/**
+ * @brief Adds the time since start to a report's phase, if there is a report.
+ */
+void addImportTime(ImportReport* report, double ImportReport::* phase, ImportClock::time_point start);
+
+/**
+ * @brief Loads an image file into a texture, or returns the texture already loaded from the
+ * same path, adding decode and upload times and sizes to the report.
+ */
+Texture loadTextureFile(const std::filesystem::path& path, const std::string& samplerName,
+	std::unordered_map<std::filesystem::path, Texture>& loadedTextures, ImportReport* report = nullptr);
+
+/**
+ * @brief Loads an image file's contents, already in memory, such as an image embedded in a
+ * model file, into a texture with no source path, adding its times and sizes to the report.
+ */
+Texture loadTextureData(const uint8_t* data, size_t size, const std::string& samplerName,
+	ImportReport* report = nullptr);
+
+/**
+ * @brief Runs the settings' mesh steps on a converted mesh in place, adding each step's time to
+ * stepMs, which has IMPORT_STEP_COUNT entries. Normals are generated only for meshes without
+ * them. Scratch memory is reset after each step. The pool, if given, is used within steps, so
+ * this must not be called from one of its tasks.
+ * @return the number of vertices kept.
+ */
+size_t runMeshSteps(Vertex3D* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount,
+	bool hasNormals, const ImportSettings& settings, FrameArena& scratch, WorkerPool* pool,
+	VertexBoneData* influences, double* stepMs);
+
+/**
+ * @brief Calls prepare(mesh, meshArena, scratchArena, pool) for every mesh index below
+ * meshCount. Meshes with at least the weld's parallel threshold of vertices are prepared one at
+ * a time, with the staging's pool to use within their steps; the rest side by side on the
+ * pool, with worker arenas and no pool.
+ */
+void prepareMeshesInParallel(ImportStaging& staging, size_t meshCount, const std::function<size_t(size_t)>& vertexCount,
+	const std::function<void(size_t, FrameArena&, FrameArena&, WorkerPool*)>& prepare);
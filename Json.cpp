@@ -0,0 +1,215 @@
+#include "Json.h"
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+
+// Deeper documents are rejected rather than risking the stack.
+static const size_t MAX_JSON_DEPTH = 256;
+
+[[noreturn]] static void jsonError(const std::string& what) {
+	throw std::runtime_error("JSON: " + what);
+}
+
+static void skipJsonSpace(const char*& at, const char* end) {
+	while (at < end && (*at == ' ' || *at == '\t' || *at == '\n' || *at == '\r')) {
+		at++;
+	}
+}
+
+static uint32_t parseJsonHex(const char*& at, const char* end) {
+	uint32_t code = 0;
+	if (end - at < 4 || std::from_chars(at, at + 4, code, 16).ptr != at + 4) {
+		jsonError("bad \\u escape");
+	}
+	at += 4;
+	return code;
+}
+
+static void appendUtf8(std::string& out, uint32_t code) {
+	if (code < 0x80) {
+		out += static_cast<char>(code);
+	}
+	else if (code < 0x800) {
+		out += static_cast<char>(0xC0 | (code >> 6));
+		out += static_cast<char>(0x80 | (code & 0x3F));
+	}
+	else if (code < 0x10000) {
+		out += static_cast<char>(0xE0 | (code >> 12));
+		out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (code & 0x3F));
+	}
+	else {
+		out += static_cast<char>(0xF0 | (code >> 18));
+		out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+		out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (code & 0x3F));
+	}
+}
+
+/**
+ * @brief Parses the string starting at the opening quote under at.
+ */
+static std::string parseJsonString(const char*& at, const char* end) {
+	std::string result;
+	at++;
+	while (true) {
+		const char* run = at;
+		while (at < end && *at != '"' && *at != '\\') {
+			at++;
+		}
+		result.append(run, at);
+		if (at >= end) {
+			jsonError("unterminated string");
+		}
+		if (*at++ == '"') {
+			return result;
+		}
+		if (at >= end) {
+			jsonError("unterminated string");
+		}
+		switch (*at++) {
+		case '"': result += '"'; break;
+		case '\\': result += '\\'; break;
+		case '/': result += '/'; break;
+		case 'b': result += '\b'; break;
+		case 'f': result += '\f'; break;
+		case 'n': result += '\n'; break;
+		case 'r': result += '\r'; break;
+		case 't': result += '\t'; break;
+		case 'u': {
+			uint32_t code = parseJsonHex(at, end);
+			// Characters outside the basic plane are escaped as surrogate pairs; unpaired
+			// surrogates have no UTF-8 encoding.
+			if (code >= 0xDC00 && code < 0xE000) {
+				jsonError("unpaired surrogate in \\u escape");
+			}
+			if (code >= 0xD800 && code < 0xDC00) {
+				if (end - at < 2 || at[0] != '\\' || at[1] != 'u') {
+					jsonError("unpaired surrogate in \\u escape");
+				}
+				at += 2;
+				uint32_t low = parseJsonHex(at, end);
+				if (low < 0xDC00 || low >= 0xE000) {
+					jsonError("unpaired surrogate in \\u escape");
+				}
+				code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+			}
+			appendUtf8(result, code);
+			break;
+		}
+		default:
+			jsonError("bad escape in string");
+		}
+	}
+}
+
+static bool matchJsonLiteral(const char*& at, const char* end, std::string_view literal) {
+	if (static_cast<size_t>(end - at) < literal.size() || std::string_view(at, literal.size()) != literal) {
+		return false;
+	}
+	at += literal.size();
+	return true;
+}
+
+static JsonValue parseJsonValue(const char*& at, const char* end, size_t depth) {
+	if (depth > MAX_JSON_DEPTH) {
+		jsonError("nested too deeply");
+	}
+	skipJsonSpace(at, end);
+	if (at >= end) {
+		jsonError("unexpected end");
+	}
+
+	JsonValue value;
+	if (*at == '{') {
+		value.type = JsonValue::Type::Object;
+		at++;
+		skipJsonSpace(at, end);
+		if (at < end && *at == '}') {
+			at++;
+			return value;
+		}
+		while (true) {
+			skipJsonSpace(at, end);
+			if (at >= end || *at != '"') {
+				jsonError("expected a member name");
+			}
+			std::string name = parseJsonString(at, end);
+			skipJsonSpace(at, end);
+			if (at >= end || *at != ':') {
+				jsonError("expected ':' after \"" + name + "\"");
+			}
+			at++;
+			value.members.emplace_back(std::move(name), parseJsonValue(at, end, depth + 1));
+			skipJsonSpace(at, end);
+			if (at < end && *at == ',') {
+				at++;
+			}
+			else if (at < end && *at == '}') {
+				at++;
+				return value;
+			}
+			else {
+				jsonError("expected ',' or '}'");
+			}
+		}
+	}
+	if (*at == '[') {
+		value.type = JsonValue::Type::Array;
+		at++;
+		skipJsonSpace(at, end);
+		if (at < end && *at == ']') {
+			at++;
+			return value;
+		}
+		while (true) {
+			value.elements.push_back(parseJsonValue(at, end, depth + 1));
+			skipJsonSpace(at, end);
+			if (at < end && *at == ',') {
+				at++;
+			}
+			else if (at < end && *at == ']') {
+				at++;
+				return value;
+			}
+			else {
+				jsonError("expected ',' or ']'");
+			}
+		}
+	}
+	if (*at == '"') {
+		value.type = JsonValue::Type::String;
+		value.string = parseJsonString(at, end);
+	}
+	else if (matchJsonLiteral(at, end, "true")) {
+		value.type = JsonValue::Type::Boolean;
+		value.boolean = true;
+	}
+	else if (matchJsonLiteral(at, end, "false")) {
+		value.type = JsonValue::Type::Boolean;
+	}
+	else if (matchJsonLiteral(at, end, "null")) {
+		value.type = JsonValue::Type::Null;
+	}
+	else {
+		auto parsed = std::from_chars(at, end, value.number);
+		if (parsed.ec != std::errc()) {
+			jsonError("unexpected character '" + std::string(1, *at) + "'");
+		}
+		value.type = JsonValue::Type::Number;
+		at = parsed.ptr;
+	}
+	return value;
+}
+
+JsonValue parseJson(const char* begin, const char* end) {
+	if (end - begin >= 3 && begin[0] == '\xEF' && begin[1] == '\xBB' && begin[2] == '\xBF') {
+		begin += 3;
+	}
+	JsonValue value = parseJsonValue(begin, end, 0);
+	skipJsonSpace(begin, end);
+	if (begin != end) {
+		jsonError("unexpected text after the document");
+	}
+	return value;
+}
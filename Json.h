@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A parsed JSON value. Documents are parsed into a tree; objects keep their members in
+ * file order, and are searched linearly, as the documents read here are small.
+ */
+struct JsonValue {
+	enum class Type {
+		Null,
+		Boolean,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0;
+	std::string string;
+	std::vector<JsonValue> elements;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	/**
+	 * @brief The member with the given name, or nullptr if there is none.
+	 */
+	const JsonValue* find(std::string_view name) const {
+		for (auto& member : members) {
+			if (member.first == name) {
+				return &member.second;
+			}
+		}
+		return nullptr;
+	}
+};
+
+/**
+ * @brief Parses a whole JSON document, which may start with a UTF-8 byte order mark. Throws
+ * std::runtime_error if the text is not exactly one valid JSON value, or nests too deeply.
+ */
+JsonValue parseJson(const char* begin, const char* end);
@@ -0,0 +1,348 @@
+#include "KeyframeTracks.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "SimdMath.h"
+
+/**
+ * @brief out[i] = a[i] + (b[i] - a[i]) * alpha[i], four floats at a time.
+ */
+static void lerpArray(const float_t* a, const float_t* b, const float_t* alpha, float_t* out,
+	size_t count) {
+	size_t i = 0;
+#ifdef SIMD_SSE
+	for (; i + 4 <= count; i += 4) {
+		__m128 va = _mm_loadu_ps(a + i);
+		__m128 vb = _mm_loadu_ps(b + i);
+		__m128 vt = _mm_loadu_ps(alpha + i);
+		_mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vt)));
+	}
+#endif
+	for (; i < count; i++) {
+		out[i] = a[i] + (b[i] - a[i]) * alpha[i];
+	}
+}
+
+void lerpLanes(const Vec4Lanes& a, const Vec4Lanes& b, const std::vector<float_t>& alpha,
+	Vec4Lanes& out) {
+	size_t count = alpha.size();
+	out.resize(count);
+	lerpArray(a.x.data(), b.x.data(), alpha.data(), out.x.data(), count);
+	lerpArray(a.y.data(), b.y.data(), alpha.data(), out.y.data(), count);
+	lerpArray(a.z.data(), b.z.data(), alpha.data(), out.z.data(), count);
+	lerpArray(a.w.data(), b.w.data(), alpha.data(), out.w.data(), count);
+}
+
+void normalizeLanes(Vec4Lanes& lanes) {
+	const float_t minLengthSquared = 1e-12f;
+	float_t* x = lanes.x.data();
+	float_t* y = lanes.y.data();
+	float_t* z = lanes.z.data();
+	float_t* w = lanes.w.data();
+	size_t count = lanes.size();
+	size_t i = 0;
+#ifdef SIMD_SSE
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 minimum = _mm_set1_ps(minLengthSquared);
+	for (; i + 4 <= count; i += 4) {
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+		__m128 vz = _mm_loadu_ps(z + i);
+		__m128 vw = _mm_loadu_ps(w + i);
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)),
+			_mm_add_ps(_mm_mul_ps(vz, vz), _mm_mul_ps(vw, vw)));
+		__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(lengthSquared, minimum)));
+		_mm_storeu_ps(x + i, _mm_mul_ps(vx, inverse));
+		_mm_storeu_ps(y + i, _mm_mul_ps(vy, inverse));
+		_mm_storeu_ps(z + i, _mm_mul_ps(vz, inverse));
+		_mm_storeu_ps(w + i, _mm_mul_ps(vw, inverse));
+	}
+#endif
+	for (; i < count; i++) {
+		float_t lengthSquared = x[i] * x[i] + y[i] * y[i] + z[i] * z[i] + w[i] * w[i];
+		float_t inverse = 1.0f / std::sqrt(std::max(lengthSquared, minLengthSquared));
+		x[i] *= inverse;
+		y[i] *= inverse;
+		z[i] *= inverse;
+		w[i] *= inverse;
+	}
+}
+
+uint32_t KeyframeTracks::targetIndex(ObjectHandle target) {
+	auto existing = m_targetIndices.find(target.value());
+	if (existing != m_targetIndices.end()) {
+		return existing->second;
+	}
+	uint32_t index = static_cast<uint32_t>(m_targets.size());
+	m_targets.push_back(target);
+	m_poses.emplace_back();
+	m_poses.back().dirty = false;
+	m_resolved.push_back(nullptr);
+	m_targetIndices.insert(std::make_pair(target.value(), index));
+	return index;
+}
+
+uint32_t KeyframeTracks::addTrack(ObjectHandle target, float_t delay, bool looping, bool additive) {
+	uint32_t track = static_cast<uint32_t>(m_trackTarget.size());
+	m_trackTarget.push_back(targetIndex(target));
+	m_trackTime.push_back(0);
+	m_trackDelay.push_back(delay);
+	m_trackDuration.push_back(0);
+	m_trackLooping.push_back(looping);
+	m_trackAdditive.push_back(additive);
+	m_trackState.push_back(0);
+	m_trackSampleTime.push_back(-1);
+	m_trackStarting.push_back(0);
+	return track;
+}
+
+void KeyframeTracks::setChannel(uint32_t track, TrackChannel channel,
+	const std::vector<float_t>& times, const std::vector<glm::vec4>& values) {
+	if (times.empty() || times.size() != values.size()) {
+		throw std::runtime_error("Keyframe channel needs one value per key time");
+	}
+	ChannelSet& set = m_channels[static_cast<size_t>(channel)];
+	if (std::find(set.track.begin(), set.track.end(), track) != set.track.end()) {
+		throw std::runtime_error("Keyframe track already has a channel of this kind");
+	}
+
+	// Append the keys to the end of the pool, so they are contiguous for this channel.
+	uint32_t first = static_cast<uint32_t>(set.keyTimes.size());
+	set.keyTimes.insert(set.keyTimes.end(), times.begin(), times.end());
+	set.keyValues.resize(set.keyTimes.size());
+	for (size_t i = 0; i < values.size(); i++) {
+		set.keyValues.set(first + i, values[i]);
+	}
+
+	set.track.push_back(track);
+	set.firstKey.push_back(first);
+	set.keyCount.push_back(static_cast<uint32_t>(times.size()));
+	set.cursor.push_back(0);
+	set.applied.emplace_back();
+
+	// A track lasts as long as its longest channel.
+	m_trackDuration[track] = std::max(m_trackDuration[track], times.back());
+}
+
+KeyframeTrack KeyframeTracks::track(uint32_t index) const {
+	KeyframeTrack track{ m_targets[m_trackTarget[index]], m_trackDelay[index], m_trackLooping[index] != 0,
+		m_trackAdditive[index] != 0 };
+	for (size_t c = 0; c < static_cast<size_t>(TrackChannel::Count); c++) {
+		const ChannelSet& set = m_channels[c];
+		for (size_t i = 0; i < set.track.size(); i++) {
+			if (set.track[i] != index) {
+				continue;
+			}
+			KeyframeChannel channel{ static_cast<TrackChannel>(c) };
+			for (uint32_t key = set.firstKey[i]; key < set.firstKey[i] + set.keyCount[i]; key++) {
+				channel.times.push_back(set.keyTimes[key]);
+				channel.values.push_back(set.keyValues.get(key));
+			}
+			track.channels.push_back(std::move(channel));
+		}
+	}
+	return track;
+}
+
+uint32_t KeyframeTracks::addRotation(ObjectHandle target, float_t duration,
+	const glm::vec3& totalRotation, float_t delay) {
+	uint32_t track = addTrack(target, delay, false, true);
+	setChannel(track, TrackChannel::Orientation, { 0, duration },
+		{ glm::vec4(0, 0, 0, 0), glm::vec4(totalRotation, 0) });
+	return track;
+}
+
+uint32_t KeyframeTracks::addTranslation(ObjectHandle target, float_t duration,
+	const glm::vec3& totalMovement, float_t delay) {
+	uint32_t track = addTrack(target, delay, false, true);
+	setChannel(track, TrackChannel::Translation, { 0, duration },
+		{ glm::vec4(0, 0, 0, 0), glm::vec4(totalMovement, 0) });
+	return track;
+}
+
+void KeyframeTracks::gatherKeys(ChannelSet& set, bool quaternion) {
+	size_t count = set.track.size();
+	set.from.resize(count);
+	set.to.resize(count);
+	set.alpha.resize(count);
+
+	for (size_t c = 0; c < count; c++) {
+		float_t t = m_trackSampleTime[set.track[c]];
+		if (t < 0) {
+			// Not sampled this tick; fill with a harmless identity so the batch stays valid.
+			set.from.set(c, glm::vec4(0, 0, 0, 1));
+			set.to.set(c, glm::vec4(0, 0, 0, 1));
+			set.alpha[c] = 0;
+			continue;
+		}
+
+		// Move the cursor to the key at or before t. Playback is usually forward by less than
+		// one key per tick, so this is amortized O(1).
+		uint32_t first = set.firstKey[c];
+		uint32_t keys = set.keyCount[c];
+		uint32_t k = set.cursor[c];
+		while (k + 1 < keys && set.keyTimes[first + k + 1] <= t) {
+			++k;
+		}
+		while (k > 0 && set.keyTimes[first + k] > t) {
+			--k;
+		}
+		set.cursor[c] = k;
+
+		uint32_t a = first + k;
+		uint32_t b = k + 1 < keys ? a + 1 : a;
+		float_t ta = set.keyTimes[a];
+		float_t tb = set.keyTimes[b];
+		float_t alpha = (b == a || tb <= ta) ? 0 : std::clamp((t - ta) / (tb - ta), 0.0f, 1.0f);
+
+		glm::vec4 from = set.keyValues.get(a);
+		glm::vec4 to = set.keyValues.get(b);
+		// Interpolate quaternions along the shorter arc.
+		if (quaternion && glm::dot(from, to) < 0) {
+			to = -1.0f * to;
+		}
+		set.from.set(c, from);
+		set.to.set(c, to);
+		set.alpha[c] = alpha;
+	}
+}
+
+void KeyframeTracks::applySamples(TrackChannel channel) {
+	ChannelSet& set = m_channels[static_cast<size_t>(channel)];
+	for (size_t c = 0; c < set.track.size(); c++) {
+		uint32_t track = set.track[c];
+		if (m_trackSampleTime[track] < 0) {
+			continue;
+		}
+
+		uint32_t target = m_trackTarget[track];
+		Pose& pose = m_poses[target];
+		if (!pose.dirty) {
+			const Object3D& object = *m_resolved[target];
+			pose = Pose{ object.getPosition(), object.getOrientation(), object.getRotation(),
+				object.getScale(), true };
+		}
+
+		glm::vec4 value = set.sampled.get(c);
+		glm::vec3 vector(value);
+		if (!m_trackAdditive[track]) {
+			switch (channel) {
+			case TrackChannel::Translation:
+				pose.position = vector;
+				break;
+			case TrackChannel::Orientation:
+				pose.orientation = vector;
+				break;
+			case TrackChannel::Rotation:
+				pose.rotation = glm::quat(value.w, value.x, value.y, value.z);
+				break;
+			case TrackChannel::Scale:
+				pose.scale = vector;
+				break;
+			default:
+				break;
+			}
+			continue;
+		}
+
+		// Additive channels apply the change in their value since the last tick, on top of
+		// whatever the other tracks did, starting from the channel's identity.
+		glm::vec4& applied = set.applied[c];
+		if (m_trackStarting[track]) {
+			applied = channel == TrackChannel::Rotation ? glm::vec4(0, 0, 0, 1)
+				: channel == TrackChannel::Scale ? glm::vec4(1, 1, 1, 0) : glm::vec4(0);
+		}
+		glm::vec3 previous(applied);
+		switch (channel) {
+		case TrackChannel::Translation:
+			pose.position += vector - previous;
+			break;
+		case TrackChannel::Orientation:
+			pose.orientation += vector - previous;
+			break;
+		case TrackChannel::Rotation: {
+			glm::quat rotation(value.w, value.x, value.y, value.z);
+			glm::quat previousRotation(applied.w, applied.x, applied.y, applied.z);
+			pose.rotation = pose.rotation * glm::inverse(previousRotation) * rotation;
+			break;
+		}
+		case TrackChannel::Scale:
+			// A zero scale cannot be divided back out, so its axis restarts from the key.
+			for (auto axis = 0; axis < 3; axis++) {
+				pose.scale[axis] = previous[axis] != 0 ? pose.scale[axis] / previous[axis] * vector[axis]
+					: vector[axis];
+			}
+			break;
+		default:
+			break;
+		}
+		applied = value;
+	}
+}
+
+void KeyframeTracks::tick(ObjectStore& store, float_t dt) {
+	for (size_t i = 0; i < m_targets.size(); i++) {
+		m_resolved[i] = store.find(m_targets[i]);
+	}
+
+	// Advance every track's clock, and decide which tracks are sampled this tick.
+	for (size_t t = 0; t < m_trackTarget.size(); t++) {
+		m_trackSampleTime[t] = -1;
+		m_trackStarting[t] = 0;
+		if (m_trackState[t] == 2) {
+			continue;
+		}
+		if (m_resolved[m_trackTarget[t]] == nullptr) {
+			m_trackState[t] = 2;
+			continue;
+		}
+		m_trackTime[t] += dt;
+		float_t local = m_trackTime[t] - m_trackDelay[t];
+		if (local < 0) {
+			continue;
+		}
+
+		if (m_trackState[t] == 0) {
+			m_trackState[t] = 1;
+			m_trackStarting[t] = 1;
+		}
+
+		float_t duration = m_trackDuration[t];
+		if (m_trackLooping[t] && duration > 0) {
+			local = std::fmod(local, duration);
+		}
+		else if (local >= duration) {
+			// Sample the final key once, then stop touching the object.
+			local = duration;
+			m_trackState[t] = 2;
+		}
+		m_trackSampleTime[t] = local;
+	}
+
+	for (auto& pose : m_poses) {
+		pose.dirty = false;
+	}
+
+	// Sample each channel kind in one batch, then fold the results into the target poses.
+	for (size_t i = 0; i < static_cast<size_t>(TrackChannel::Count); i++) {
+		ChannelSet& set = m_channels[i];
+		if (set.track.empty()) {
+			continue;
+		}
+		bool quaternion = static_cast<TrackChannel>(i) == TrackChannel::Rotation;
+		gatherKeys(set, quaternion);
+		lerpLanes(set.from, set.to, set.alpha, set.sampled);
+		if (quaternion) {
+			normalizeLanes(set.sampled);
+		}
+		applySamples(static_cast<TrackChannel>(i));
+	}
+
+	// Write each animated object's transform once.
+	for (size_t i = 0; i < m_targets.size(); i++) {
+		const Pose& pose = m_poses[i];
+		if (pose.dirty) {
+			m_resolved[i]->setTransform(pose.position, pose.orientation, pose.rotation, pose.scale);
+		}
+	}
+}
@@ -0,0 +1,213 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <glm/gtc/quaternion.hpp>
+#include "Object3D.h"
+#include "ObjectStore.h"
+
+/**
+ * @brief A structure-of-arrays batch of 4-component values, one per lane. Keeping each
+ * component in its own contiguous array lets the sampling kernels process 4 lanes per
+ * SIMD instruction.
+ */
+struct Vec4Lanes {
+	std::vector<float_t> x;
+	std::vector<float_t> y;
+	std::vector<float_t> z;
+	std::vector<float_t> w;
+
+	size_t size() const { return x.size(); }
+
+	void resize(size_t count) {
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+		w.resize(count);
+	}
+
+	void set(size_t lane, const glm::vec4& value) {
+		x[lane] = value.x;
+		y[lane] = value.y;
+		z[lane] = value.z;
+		w[lane] = value.w;
+	}
+
+	glm::vec4 get(size_t lane) const {
+		return glm::vec4(x[lane], y[lane], z[lane], w[lane]);
+	}
+};
+
+/**
+ * @brief Linearly interpolates every lane of a towards b by the lane's alpha, writing into out.
+ * All four batches and the alpha array must have the same size.
+ */
+void lerpLanes(const Vec4Lanes& a, const Vec4Lanes& b, const std::vector<float_t>& alpha,
+	Vec4Lanes& out);
+
+/**
+ * @brief Normalizes every lane of the batch as a 4-component vector. Used to turn lerped
+ * quaternions into a normalized lerp (nlerp).
+ */
+void normalizeLanes(Vec4Lanes& lanes);
+
+/**
+ * @brief The transform component a keyframe channel animates.
+ */
+enum class TrackChannel : uint8_t {
+	// Position; keys are (x, y, z, 0).
+	Translation,
+	// Euler orientation, as in Object3D::setOrientation; keys are (x, y, z, 0).
+	Orientation,
+	// Quaternion rotation; keys are (x, y, z, w).
+	Rotation,
+	// Scale; keys are (x, y, z, 0).
+	Scale,
+	Count
+};
+
+/**
+ * @brief A copy of the keys of one channel of a KeyframeTracks track.
+ */
+struct KeyframeChannel {
+	TrackChannel channel;
+	std::vector<float_t> times;
+	std::vector<glm::vec4> values;
+};
+
+/**
+ * @brief A copy of one track of a KeyframeTracks, as it was added: its target, playback
+ * settings, and channels.
+ */
+struct KeyframeTrack {
+	ObjectHandle target;
+	float_t delay;
+	bool looping;
+	bool additive;
+	std::vector<KeyframeChannel> channels;
+};
+
+/**
+ * @brief A data-oriented keyframe animation system. Each track animates one object through
+ * up to one channel of each TrackChannel kind. Keys and per-channel state are stored in
+ * contiguous arrays grouped by channel kind, so a tick samples every channel of a kind with
+ * one batched SIMD pass, then writes each animated object's transform exactly once.
+ */
+class KeyframeTracks {
+private:
+	/**
+	 * @brief All channels of one TrackChannel kind, in structure-of-arrays form.
+	 */
+	struct ChannelSet {
+		// The key pool: each channel owns a contiguous range of it.
+		std::vector<float_t> keyTimes;
+		Vec4Lanes keyValues;
+
+		// Per-channel state, indexed by channel.
+		std::vector<uint32_t> track;
+		std::vector<uint32_t> firstKey;
+		std::vector<uint32_t> keyCount;
+		std::vector<uint32_t> cursor;
+		// For channels of additive tracks, the part of the channel's value already applied to
+		// its target; each tick applies only the change since.
+		std::vector<glm::vec4> applied;
+
+		// Per-tick scratch: the two keys bracketing each channel's time, and the result.
+		Vec4Lanes from;
+		Vec4Lanes to;
+		std::vector<float_t> alpha;
+		Vec4Lanes sampled;
+	};
+
+	/**
+	 * @brief The current transform of an animated object, accumulated from all tracks
+	 * targeting it during a tick.
+	 */
+	struct Pose {
+		glm::vec3 position;
+		glm::vec3 orientation;
+		glm::quat rotation;
+		glm::vec3 scale;
+		bool dirty;
+	};
+
+	ChannelSet m_channels[static_cast<size_t>(TrackChannel::Count)];
+
+	// Per-track state, indexed by track.
+	std::vector<uint32_t> m_trackTarget;
+	std::vector<float_t> m_trackTime;
+	std::vector<float_t> m_trackDelay;
+	std::vector<float_t> m_trackDuration;
+	std::vector<uint8_t> m_trackLooping;
+	std::vector<uint8_t> m_trackAdditive;
+	// 0 = waiting for its delay, 1 = playing, 2 = finished.
+	std::vector<uint8_t> m_trackState;
+	// The local time sampled by the current tick, or negative if the track is not sampled.
+	std::vector<float_t> m_trackSampleTime;
+	// Whether the track began playing this tick, so its additive channels have applied nothing.
+	std::vector<uint8_t> m_trackStarting;
+
+	// The distinct objects animated by the tracks; several tracks may share one target.
+	std::vector<ObjectHandle> m_targets;
+	std::vector<Pose> m_poses;
+	std::unordered_map<uint32_t, uint32_t> m_targetIndices;
+	// The targets resolved from their handles for the current tick; nullptr if removed.
+	std::vector<Object3D*> m_resolved;
+
+	uint32_t targetIndex(ObjectHandle target);
+	void gatherKeys(ChannelSet& set, bool quaternion);
+	void applySamples(TrackChannel channel);
+
+public:
+	KeyframeTracks() = default;
+
+	/**
+	 * @brief Adds an empty track animating the given object, and returns its index.
+	 * @param delay how long after the first tick the track begins playing, in seconds.
+	 * @param looping whether the track restarts when it reaches its last key.
+	 * @param additive whether key values are relative to the object's transform when the
+	 * track begins (added to position/orientation, multiplied into rotation/scale). Each tick
+	 * applies the change in an additive channel's value since the last tick, so additive tracks
+	 * on one channel add up, and one that starts as another ends continues from where it left
+	 * the object.
+	 */
+	uint32_t addTrack(ObjectHandle target, float_t delay = 0, bool looping = false,
+		bool additive = false);
+
+	/**
+	 * @brief Sets the keys of one channel of a track. Times must be ascending, in seconds
+	 * relative to the start of the track. A track may have at most one channel of each kind.
+	 */
+	void setChannel(uint32_t track, TrackChannel channel, const std::vector<float_t>& times,
+		const std::vector<glm::vec4>& values);
+
+	/**
+	 * @brief Adds a two-key additive track that rotates the object's Euler orientation by the
+	 * given total amount over the duration; the track equivalent of a RotationAnimation.
+	 */
+	uint32_t addRotation(ObjectHandle target, float_t duration, const glm::vec3& totalRotation,
+		float_t delay = 0);
+
+	/**
+	 * @brief Adds a two-key additive track that moves the object by the given total offset
+	 * over the duration; the track equivalent of a TranslationAnimation.
+	 */
+	uint32_t addTranslation(ObjectHandle target, float_t duration, const glm::vec3& totalMovement,
+		float_t delay = 0);
+
+	/**
+	 * @brief The number of tracks in the system.
+	 */
+	size_t trackCount() const { return m_trackTarget.size(); }
+
+	/**
+	 * @brief Copies out the settings and keys of a track, as for saving it.
+	 */
+	KeyframeTrack track(uint32_t index) const;
+
+	/**
+	 * @brief Advances every track by the given interval, in seconds, and writes the sampled
+	 * transforms into their objects in the given store. Tracks whose object has been removed
+	 * from the store finish immediately.
+	 */
+	void tick(ObjectStore& store, float_t dt);
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <cmath>
+#include <glm/glm.hpp>
+
+/**
+ * @brief A point or spot light in world space. Its influence fades smoothly to nothing at its
+ * range, so it only needs to be shaded in the clusters its range reaches.
+ */
+struct Light {
+	glm::vec3 position;
+	float_t range;
+	glm::vec3 color;
+	// For spot lights, the direction the cone points, and the cosines of the angles where the
+	// cone begins to fade and where it ends. Point lights keep the defaults, which no direction
+	// falls outside of.
+	glm::vec3 direction = glm::vec3(0, -1, 0);
+	float_t innerCone = -1;
+	float_t outerCone = -2;
+
+	static Light point(const glm::vec3& position, const glm::vec3& color, float_t range) {
+		return Light{ position, range, color };
+	}
+
+	static Light spot(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color,
+		float_t range, float_t innerAngle, float_t outerAngle) {
+		return Light{ position, range, color, glm::normalize(direction), std::cos(innerAngle), std::cos(outerAngle) };
+	}
+};
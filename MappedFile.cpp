@@ -0,0 +1,84 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+	: m_data(nullptr), m_size(0), m_file(nullptr), m_mapping(nullptr) {
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open " + path.string());
+	}
+	m_file = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to read the size of " + path.string());
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+	// Empty files cannot be mapped; they map to nothing.
+	if (m_size == 0) {
+		return;
+	}
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (view == nullptr) {
+		if (mapping != nullptr) {
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map " + path.string());
+	}
+	m_mapping = mapping;
+	m_data = static_cast<const uint8_t*>(view);
+}
+
+MappedFile::~MappedFile() {
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mapping);
+	}
+	CloseHandle(m_file);
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+	: m_data(nullptr), m_size(0), m_file(nullptr), m_mapping(nullptr) {
+	int descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0) {
+		throw std::runtime_error("Failed to open " + path.string());
+	}
+	struct stat status;
+	if (fstat(descriptor, &status) != 0) {
+		close(descriptor);
+		throw std::runtime_error("Failed to read the size of " + path.string());
+	}
+	m_size = static_cast<size_t>(status.st_size);
+	if (m_size > 0) {
+		void* view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (view == MAP_FAILED) {
+			close(descriptor);
+			throw std::runtime_error("Failed to map " + path.string());
+		}
+		m_data = static_cast<const uint8_t*>(view);
+	}
+	// The mapping keeps the file alive on its own.
+	close(descriptor);
+}
+
+MappedFile::~MappedFile() {
+	if (m_data != nullptr) {
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+}
+
+#endif
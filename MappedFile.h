@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+
+/**
+ * @brief A whole file mapped read-only into memory, so its contents can be used in place; the
+ * operating system pages it in as it is read. The mapping lasts as long as the object.
+ */
+class MappedFile {
+private:
+	const uint8_t* m_data;
+	size_t m_size;
+	// The file and mapping handles, on platforms that keep them open while mapped.
+	void* m_file;
+	void* m_mapping;
+
+public:
+	/**
+	 * @brief Maps the file. Throws if it cannot be opened or mapped.
+	 */
+	MappedFile(const std::filesystem::path& path);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+};
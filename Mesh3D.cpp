@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 #include "Mesh3D.h"
+#include "GLState.h"
+#include "Skeleton.h"
 #include <glad/glad.h>
 #include <GL/GL.h>
 
@@ -9,28 +14,57 @@ using sf::Vector2u;
 using glm::mat4;
 using glm::vec4;
 
+/**
+ * @brief The size of one index of the given GL type.
+ */
+static size_t indexSize(uint32_t indexType) {
+	return indexType == GL_UNSIGNED_BYTE ? 1 : indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
 Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 	Texture texture) 
 	: Mesh3D(std::move(vertices), std::move(faces), std::vector<Texture>{texture}) {
 }
 
 Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, std::vector<Texture>&& textures)
- : m_vertexCount(vertices.size()), m_faceCount(faces.size()), m_textures(textures) {
+	: Mesh3D(vertices.data(), vertices.size(), faces.data(), faces.size(), std::move(textures)) {
+}
+
+Mesh3D::Mesh3D(const Vertex3D* vertices, size_t vertexCount, const uint32_t* faces, size_t indexCount,
+	std::vector<Texture>&& textures)
+ : m_vertexCount(vertexCount), m_faceCount(indexCount), m_indexType(GL_UNSIGNED_INT),
+ m_layout(VertexLayout::interleaved()), m_textures(std::move(textures)), m_vbo(0), m_ebo(0), m_boundsCenter(0),
+ m_boundsRadius(0) {
+
+	// Bound the vertices by a sphere around the center of their bounding box.
+	if (vertexCount > 0) {
+		glm::vec3 low(vertices[0].x, vertices[0].y, vertices[0].z);
+		glm::vec3 high = low;
+		for (size_t i = 0; i < vertexCount; i++) {
+			const Vertex3D& v = vertices[i];
+			low = glm::min(low, glm::vec3(v.x, v.y, v.z));
+			high = glm::max(high, glm::vec3(v.x, v.y, v.z));
+		}
+		m_boundsCenter = (low + high) * 0.5f;
+		for (size_t i = 0; i < vertexCount; i++) {
+			const Vertex3D& v = vertices[i];
+			m_boundsRadius = std::max(m_boundsRadius, glm::length(glm::vec3(v.x, v.y, v.z) - m_boundsCenter));
+		}
+	}
 
 	// Generate a vertex array object on the GPU.
 	glGenVertexArrays(1, &m_vao);
 	// "Bind" the newly-generated vao, which makes future functions operate on that specific object.
-	glBindVertexArray(m_vao);
+	GLState::current().bindVertexArray(m_vao);
 
 	// Generate a vertex buffer object on the GPU.
-	uint32_t vbo;
-	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &m_vbo);
 
 	// "Bind" the newly-generated vbo, which makes future functions operate on that specific object.
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 	// This vbo is now associated with m_vao.
 	// Copy the contents of the vertices list to the buffer that lives on the GPU.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex3D), &vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex3D), vertices, GL_STATIC_DRAW);
 
 	// Inform OpenGL how to interpret the buffer. Each vertex now has TWO attributes; a position and a color.
 	// Atrribute 0 is position: 3 contiguous floats (x/y/z)...
@@ -46,13 +80,52 @@ Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 	glEnableVertexAttribArray(2);
 
 	// Generate a second buffer, to store the indices of each triangle in the mesh.
-	uint32_t ebo;
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(uint32_t), &faces[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &m_ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint32_t), faces, GL_STATIC_DRAW);
 
 	// Unbind the vertex array, so no one else can accidentally mess with it.
-	glBindVertexArray(0);
+	GLState::current().bindVertexArray(0);
+}
+
+Mesh3D::Mesh3D(const VertexStreams& vertices, size_t vertexCount, const void* indices, uint32_t indexType,
+	size_t indexCount, const glm::vec3& low, const glm::vec3& high, std::vector<Texture>&& textures)
+	: m_vertexCount(vertexCount), m_faceCount(indexCount), m_indexType(indexType), m_layout(vertices.layout),
+	m_textures(std::move(textures)), m_vbo(0), m_ebo(0), m_boundsCenter((low + high) * 0.5f),
+	m_boundsRadius(glm::length(high - low) * 0.5f) {
+	glGenVertexArrays(1, &m_vao);
+	GLState::current().bindVertexArray(m_vao);
+
+	// Size the buffer for every range, then copy each straight from the caller's memory.
+	size_t bytes = 0;
+	for (auto& range : vertices.ranges) {
+		bytes += range.second;
+	}
+	glGenBuffers(1, &m_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+	size_t offset = 0;
+	for (auto& range : vertices.ranges) {
+		glBufferSubData(GL_ARRAY_BUFFER, offset, range.second, range.first);
+		offset += range.second;
+	}
+
+	// The same attributes as Vertex3D's, wherever the layout puts them.
+	glVertexAttribPointer(0, 3, GL_FLOAT, false, m_layout.position.stride, (void*)m_layout.position.offset);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, false, m_layout.normal.stride, (void*)m_layout.normal.offset);
+	glEnableVertexAttribArray(1);
+	// Without texture coordinates, attribute 2 is left disabled and reads as (0, 0).
+	if (m_layout.texCoord.has_value()) {
+		glVertexAttribPointer(2, 2, GL_FLOAT, false, m_layout.texCoord->stride, (void*)m_layout.texCoord->offset);
+		glEnableVertexAttribArray(2);
+	}
+
+	glGenBuffers(1, &m_ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize(indexType), indices, GL_STATIC_DRAW);
+
+	GLState::current().bindVertexArray(0);
 }
 
 void Mesh3D::addTexture(Texture texture)
@@ -60,20 +133,142 @@ void Mesh3D::addTexture(Texture texture)
 	m_textures.push_back(texture);
 }
 
-void Mesh3D::render(sf::RenderWindow& window, ShaderProgram& program) const {
-	// Activate the mesh's vertex array.
-	glBindVertexArray(m_vao);
+void Mesh3D::readGeometry(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces) const {
+	if (m_skin != nullptr) {
+		vertices = m_skin->bindVertices;
+	}
+	else if (m_layout == VertexLayout::interleaved()) {
+		vertices.assign(m_vertexCount, Vertex3D(0, 0, 0, 0, 0, 0, 0, 0));
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		glGetBufferSubData(GL_ARRAY_BUFFER, 0, m_vertexCount * sizeof(Vertex3D), vertices.data());
+	}
+	else {
+		// Read the whole buffer back, and gather each vertex from its streams.
+		int32_t bytes = 0;
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &bytes);
+		std::vector<uint8_t> data(bytes);
+		glGetBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data.data());
+		vertices.clear();
+		vertices.reserve(m_vertexCount);
+		for (size_t i = 0; i < m_vertexCount; i++) {
+			float_t position[3], normal[3], uv[2] = { 0, 0 };
+			std::memcpy(position, &data[m_layout.position.offset + i * m_layout.position.stride], sizeof(position));
+			std::memcpy(normal, &data[m_layout.normal.offset + i * m_layout.normal.stride], sizeof(normal));
+			if (m_layout.texCoord.has_value()) {
+				std::memcpy(uv, &data[m_layout.texCoord->offset + i * m_layout.texCoord->stride], sizeof(uv));
+			}
+			vertices.emplace_back(position[0], position[1], position[2], normal[0], normal[1], normal[2], uv[0], uv[1]);
+		}
+	}
+	faces.resize(m_faceCount);
+	glBindBuffer(GL_COPY_READ_BUFFER, m_ebo);
+	if (m_indexType == GL_UNSIGNED_INT) {
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, m_faceCount * sizeof(uint32_t), faces.data());
+	}
+	else {
+		// Narrower indices are widened to 32 bits.
+		size_t size = indexSize(m_indexType);
+		std::vector<uint8_t> narrow(m_faceCount * size);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, narrow.size(), narrow.data());
+		for (size_t i = 0; i < m_faceCount; i++) {
+			uint16_t index = 0;
+			std::memcpy(&index, &narrow[i * size], size);
+			faces[i] = size == 1 ? narrow[i] : index;
+		}
+	}
+}
+
+void Mesh3D::release() {
+	GLState::current().deleteVertexArray(m_vao);
+	glDeleteBuffers(1, &m_vbo);
+	glDeleteBuffers(1, &m_ebo);
+	m_vao = m_vbo = m_ebo = 0;
+	if (m_skin != nullptr) {
+		glDeleteBuffers(1, &m_skin->influenceVbo);
+		m_skin->influenceVbo = 0;
+	}
+}
+
+uint64_t Mesh3D::sortKey() const {
+	uint64_t texture = m_textures.empty() ? 0 : m_textures[0].textureId;
+	return (texture << 32) | m_vao;
+}
+
+void Mesh3D::setSkin(std::shared_ptr<Skeleton> skeleton, uint32_t skinIndex,
+	std::vector<Vertex3D>&& bindVertices, std::vector<VertexBoneData>&& influences) {
+	// CPU skinning re-uploads the vertices as Vertex3D.
+	if (!(m_layout == VertexLayout::interleaved())) {
+		throw std::runtime_error("Only meshes of Vertex3D vertices can be skinned");
+	}
+	GLState::current().bindVertexArray(m_vao);
+
+	// The influences live in their own buffer, so unskinned meshes don't pay for them.
+	uint32_t influenceVbo;
+	glGenBuffers(1, &influenceVbo);
+	glBindBuffer(GL_ARRAY_BUFFER, influenceVbo);
+	glBufferData(GL_ARRAY_BUFFER, influences.size() * sizeof(VertexBoneData), &influences[0], GL_STATIC_DRAW);
+
+	// Attribute 3 is the bone indices: 4 unsigned integers, which must not be converted to float.
+	glVertexAttribIPointer(3, 4, GL_UNSIGNED_INT, sizeof(VertexBoneData), 0);
+	glEnableVertexAttribArray(3);
+
+	// Attribute 4 is the bone weights: 4 floats, starting 16 bytes after the bone indices.
+	glVertexAttribPointer(4, 4, GL_FLOAT, false, sizeof(VertexBoneData), (void*)16);
+	glEnableVertexAttribArray(4);
+
+	GLState::current().bindVertexArray(0);
+
+	m_skin = std::make_shared<Skin>();
+	m_skin->skeleton = std::move(skeleton);
+	m_skin->skinIndex = skinIndex;
+	m_skin->influenceVbo = influenceVbo;
+	m_skin->bindVertices = std::move(bindVertices);
+	m_skin->influences = std::move(influences);
+	m_skin->skinnedVertices = m_skin->bindVertices;
+}
+
+void Mesh3D::applySkin(ShaderProgram& program) const {
+	// Skinned meshes either deform on the GPU using the skeleton's bone palette, or are
+	// deformed on the CPU and re-uploaded, leaving the shader's skinning disabled.
+	bool gpuSkinned = false;
+	if (m_skin != nullptr) {
+		Skeleton& skeleton = *m_skin->skeleton;
+		if (skeleton.skinningMode() == SkinningMode::Gpu) {
+			skeleton.bindPalette(program, m_skin->skinIndex);
+			gpuSkinned = true;
+		}
+		else if (skeleton.publishedVersion() != m_skin->skinnedVersion) {
+			m_skin->skinnedVersion = skeleton.skinVertices(m_skin->skinIndex, m_skin->bindVertices.data(),
+				m_skin->influences.data(), m_skin->bindVertices.size(), m_skin->skinnedVertices.data());
+			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, m_skin->skinnedVertices.size() * sizeof(Vertex3D),
+				m_skin->skinnedVertices.data());
+		}
+	}
+	program.setUniform("skinned", gpuSkinned);
+}
+
+void Mesh3D::render(ShaderProgram& program) const {
+	// Activate the mesh's vertex array. Bindings are left in place after drawing, so
+	// consecutive draws of the same mesh or texture don't rebind them.
+	GLState& state = GLState::current();
+	state.bindVertexArray(m_vao);
+	applySkin(program);
+
 	for (auto i = 0; i < m_textures.size(); i++) {
 		program.setUniform(m_textures[i].samplerName, i);
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textures[i].textureId);
+		state.bindTexture(i, GL_TEXTURE_2D, m_textures[i].textureId);
 	}
 
 	// Draw the vertex array, using its "element buffer" to identify the faces.
-	glDrawElements(GL_TRIANGLES, m_faceCount, GL_UNSIGNED_INT, nullptr);
-	// Deactivate the mesh's vertex array and texture.
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	glDrawElements(GL_TRIANGLES, m_faceCount, m_indexType, nullptr);
+}
+
+void Mesh3D::renderDepth(ShaderProgram& program) const {
+	GLState::current().bindVertexArray(m_vao);
+	applySkin(program);
+	glDrawElements(GL_TRIANGLES, m_faceCount, m_indexType, nullptr);
 }
 
 Mesh3D Mesh3D::square(const std::vector<Texture> &textures) {
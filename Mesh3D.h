@@ -2,6 +2,11 @@
 #include <SFML/Graphics.hpp>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 #include "ShaderProgram.h"
 #include "Texture.h"
 
@@ -22,16 +27,125 @@ struct Vertex3D {
 		x(px), y(py), z(pz), nx(normX), ny(normY), nz(normZ), u(texU), v(texV) {}
 };
 
+/**
+ * @brief The bones influencing a skinned vertex, and the weight of each influence. Unused
+ * influences have a weight of 0.
+ */
+struct VertexBoneData {
+	uint32_t ids[4];
+	float_t weights[4];
+
+	VertexBoneData() : ids{ 0, 0, 0, 0 }, weights{ 0, 0, 0, 0 } {}
+
+	/**
+	 * @brief Adds an influence, replacing the weakest existing one if all four are in use.
+	 */
+	void add(uint32_t bone, float_t weight) {
+		size_t weakest = 0;
+		for (size_t i = 1; i < 4; i++) {
+			if (weights[i] < weights[weakest]) {
+				weakest = i;
+			}
+		}
+		if (weight > weights[weakest]) {
+			ids[weakest] = bone;
+			weights[weakest] = weight;
+		}
+	}
+
+	/**
+	 * @brief Rescales the weights to sum to 1.
+	 */
+	void normalize() {
+		float_t total = weights[0] + weights[1] + weights[2] + weights[3];
+		if (total > 0) {
+			for (auto& w : weights) {
+				w /= total;
+			}
+		}
+	}
+};
+
+/**
+ * @brief Where one attribute of every vertex lies in a vertex buffer: the byte offset of the
+ * first vertex's value, and the bytes from one vertex's value to the next's.
+ */
+struct VertexStream {
+	size_t offset;
+	size_t stride;
+
+	bool operator==(const VertexStream&) const = default;
+};
+
+/**
+ * @brief Where the float positions, normals and texture coordinates of a mesh's vertices lie in
+ * its vertex buffer. Meshes without texture coordinates read them as (0, 0).
+ */
+struct VertexLayout {
+	VertexStream position;
+	VertexStream normal;
+	std::optional<VertexStream> texCoord;
+
+	bool operator==(const VertexLayout&) const = default;
+
+	/**
+	 * @brief The layout of an array of Vertex3D.
+	 */
+	static VertexLayout interleaved() {
+		return VertexLayout{ { 0, sizeof(Vertex3D) }, { 12, sizeof(Vertex3D) }, VertexStream{ 24, sizeof(Vertex3D) } };
+	}
+};
+
+/**
+ * @brief Vertices to upload as they lie in memory, such as a mapped model file: byte ranges
+ * that are placed back to back in the vertex buffer, and the layout of the result.
+ */
+struct VertexStreams {
+	std::vector<std::pair<const uint8_t*, size_t>> ranges;
+	VertexLayout layout;
+};
+
+class Skeleton;
+
 /**
  * @brief Represents a mesh whose vertices have positions, normal vectors, and texture coordinates;
  * as well as a list of Textures to bind when rendering the mesh.
  */
 class Mesh3D {
 private:
+	/**
+	 * @brief The bind-pose data of a skinned mesh, shared between copies of the mesh.
+	 */
+	struct Skin {
+		std::shared_ptr<Skeleton> skeleton;
+		uint32_t skinIndex;
+		// The buffer of influences the vertex array reads bone attributes from.
+		uint32_t influenceVbo = 0;
+		// CPU copies of the vertices and their influences, used when skinning on the CPU.
+		std::vector<Vertex3D> bindVertices;
+		std::vector<VertexBoneData> influences;
+		std::vector<Vertex3D> skinnedVertices;
+		// The skeleton's palette version skinnedVertices were uploaded for, so CPU skinning
+		// runs once per pose rather than once per draw.
+		uint64_t skinnedVersion = std::numeric_limits<uint64_t>::max();
+	};
+
 	uint32_t m_vao;
+	uint32_t m_vbo;
+	uint32_t m_ebo;
 	std::vector<Texture> m_textures;
 	size_t m_vertexCount;
 	size_t m_faceCount;
+	// GL_UNSIGNED_INT, unless the indices were uploaded as they lay in a file.
+	uint32_t m_indexType;
+	VertexLayout m_layout;
+	// A sphere containing every vertex, in model space.
+	glm::vec3 m_boundsCenter;
+	float_t m_boundsRadius;
+	std::shared_ptr<Skin> m_skin;
+
+	// Poses a skinned mesh for drawing with the program, and sets its "skinned" uniform.
+	void applySkin(ShaderProgram& program) const;
 
 public:
 	Mesh3D() = delete;
@@ -46,7 +160,63 @@ public:
 	Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 		std::vector<Texture>&& textures);
 
+	/**
+	 * @brief Constructs a Mesh3D by uploading vertices and faces straight from memory the
+	 * caller keeps, such as a mapped scene file.
+	 */
+	Mesh3D(const Vertex3D* vertices, size_t vertexCount, const uint32_t* faces, size_t indexCount,
+		std::vector<Texture>&& textures);
+
+	/**
+	 * @brief Constructs a Mesh3D by uploading vertex streams and indices as they lie in memory
+	 * the caller keeps, with no conversion. Indices are GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or
+	 * GL_UNSIGNED_INT; every position must lie in the box from low to high, which the bounds
+	 * are taken from, so the vertices are never read on the CPU.
+	 */
+	Mesh3D(const VertexStreams& vertices, size_t vertexCount, const void* indices, uint32_t indexType,
+		size_t indexCount, const glm::vec3& low, const glm::vec3& high, std::vector<Texture>&& textures);
+
 	void addTexture(Texture texture);
+	const std::vector<Texture>& textures() const { return m_textures; }
+
+	/**
+	 * @brief Reads the mesh's vertices and indices back from the GPU, as Vertex3D and 32-bit
+	 * indices whatever their layout there; for skinned meshes, the bind-pose vertices.
+	 */
+	void readGeometry(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces) const;
+
+	/**
+	 * @brief Deletes the mesh's vertex array and buffers, which its copies share; none of them
+	 * may be drawn after. Textures are not deleted, as other meshes may use them.
+	 */
+	void release();
+
+	/**
+	 * @brief A key that groups meshes sharing GL state when draws are sorted: the first texture,
+	 * then the vertex array.
+	 */
+	uint64_t sortKey() const;
+
+	// The mesh's vertex array, which its copies share, so it identifies their geometry.
+	uint32_t vertexArray() const { return m_vao; }
+	size_t vertexCount() const { return m_vertexCount; }
+	// The number of indices drawn; three per triangle.
+	size_t indexCount() const { return m_faceCount; }
+
+	/**
+	 * @brief A sphere containing every bind-pose vertex of the mesh, in model space.
+	 */
+	const glm::vec3& boundsCenter() const { return m_boundsCenter; }
+	float_t boundsRadius() const { return m_boundsRadius; }
+
+	/**
+	 * @brief Makes the mesh skinned by one skin of the given skeleton. The bone influences
+	 * become vertex attributes 3 (bone indices) and 4 (weights); bindVertices must be the
+	 * vertices the mesh was constructed from, kept for CPU skinning. Only meshes constructed
+	 * from Vertex3D can be skinned.
+	 */
+	void setSkin(std::shared_ptr<Skeleton> skeleton, uint32_t skinIndex,
+		std::vector<Vertex3D>&& bindVertices, std::vector<VertexBoneData>&& influences);
 
 	/**
 	 * @brief Constructs a 1x1 square centered at the origin in world space.
@@ -62,8 +232,14 @@ public:
 	static Mesh3D triangle(Texture texture);
 
 	/**
-	 * @brief Renders the mesh to the given context.
+	 * @brief Renders the mesh to the current OpenGL context.
+	 */
+	void render(ShaderProgram& program) const;
+
+	/**
+	 * @brief Draws only the mesh's triangles, posed as render would pose them but binding no
+	 * textures, for depth-only passes. The program must declare render's skinning uniforms.
 	 */
-	void render(sf::RenderWindow& window, ShaderProgram& program) const;
+	void renderDepth(ShaderProgram& program) const;
 	
 };
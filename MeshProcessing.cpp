@@ -0,0 +1,203 @@
+#include "MeshProcessing.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+static const uint32_t NO_VERTEX = 0xFFFFFFFF;
+
+static uint64_t hashPosition(const Vertex3D& vertex) {
+	uint32_t bits[3];
+	std::memcpy(&bits[0], &vertex.x, sizeof(uint32_t));
+	std::memcpy(&bits[1], &vertex.y, sizeof(uint32_t));
+	std::memcpy(&bits[2], &vertex.z, sizeof(uint32_t));
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (uint32_t b : bits) {
+		hash = (hash ^ b) * 0x9E3779B97F4A7C15ull;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+void generateNormals(Vertex3D* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+	FrameArena& scratch) {
+	if (vertexCount == 0) {
+		return;
+	}
+	// group[i] is the first vertex at vertex i's position, found through an open-addressed
+	// table of at least twice as many slots as vertices.
+	size_t slots = 16;
+	while (slots < 2 * vertexCount) {
+		slots *= 2;
+	}
+	uint32_t* table = scratch.allocateArray<uint32_t>(slots);
+	std::fill(table, table + slots, NO_VERTEX);
+	uint32_t* group = scratch.allocateArray<uint32_t>(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) {
+		size_t slot = hashPosition(vertices[i]) & (slots - 1);
+		group[i] = static_cast<uint32_t>(i);
+		while (table[slot] != NO_VERTEX) {
+			const Vertex3D& other = vertices[table[slot]];
+			if (other.x == vertices[i].x && other.y == vertices[i].y && other.z == vertices[i].z) {
+				group[i] = table[slot];
+				break;
+			}
+			slot = (slot + 1) & (slots - 1);
+		}
+		if (group[i] == i) {
+			table[slot] = static_cast<uint32_t>(i);
+		}
+	}
+
+	// Unnormalized cross products weigh each triangle by its area.
+	glm::vec3* sums = scratch.allocateArray<glm::vec3>(vertexCount);
+	std::fill(sums, sums + vertexCount, glm::vec3(0, 0, 0));
+	for (size_t t = 0; t + 2 < indexCount; t += 3) {
+		const Vertex3D& a = vertices[indices[t]];
+		const Vertex3D& b = vertices[indices[t + 1]];
+		const Vertex3D& c = vertices[indices[t + 2]];
+		glm::vec3 normal = glm::cross(glm::vec3(b.x - a.x, b.y - a.y, b.z - a.z),
+			glm::vec3(c.x - a.x, c.y - a.y, c.z - a.z));
+		sums[group[indices[t]]] += normal;
+		sums[group[indices[t + 1]]] += normal;
+		sums[group[indices[t + 2]]] += normal;
+	}
+	for (size_t i = 0; i < vertexCount; i++) {
+		glm::vec3 sum = sums[group[i]];
+		float_t length = glm::length(sum);
+		glm::vec3 normal = length > 0 ? sum / length : glm::vec3(0, 0, 1);
+		vertices[i].nx = normal.x;
+		vertices[i].ny = normal.y;
+		vertices[i].nz = normal.z;
+	}
+}
+
+size_t optimizeVertexCache(Vertex3D* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount,
+	FrameArena& scratch, VertexBoneData* influences) {
+	// Trailing indices would keep the old numbering while the vertices were renumbered.
+	if (indexCount % 3 != 0) {
+		throw std::runtime_error("Cannot optimize a mesh whose index count is not a multiple of 3");
+	}
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return vertexCount;
+	}
+
+	// The triangles around each vertex: those of vertex v are
+	// adjacency[adjacencyStart[v]] up to adjacencyStart[v + 1].
+	uint32_t* adjacencyStart = scratch.allocateArray<uint32_t>(vertexCount + 1);
+	std::fill(adjacencyStart, adjacencyStart + vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacencyStart[indices[i] + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyStart[v + 1] += adjacencyStart[v];
+	}
+	uint32_t* adjacency = scratch.allocateArray<uint32_t>(triangleCount * 3);
+	uint32_t* fill = scratch.allocateArray<uint32_t>(vertexCount);
+	std::copy(adjacencyStart, adjacencyStart + vertexCount, fill);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	// Tipsify: fan out from one vertex at a time, emitting every triangle around it, then move
+	// to the vertex emitted in this fan that will still be in the cache once its remaining
+	// triangles are emitted, and has been there longest; with none, back to a vertex emitted
+	// earlier that still has triangles left, then on in input order.
+	uint32_t* live = fill;
+	for (size_t v = 0; v < vertexCount; v++) {
+		live[v] = adjacencyStart[v + 1] - adjacencyStart[v];
+	}
+	// The time each vertex last entered the cache; vertices more than VERTEX_CACHE_SIZE ago are
+	// out of it.
+	size_t* cacheTime = scratch.allocateArray<size_t>(vertexCount);
+	std::fill(cacheTime, cacheTime + vertexCount, 0);
+	bool* emitted = scratch.allocateArray<bool>(triangleCount);
+	std::fill(emitted, emitted + triangleCount, false);
+	uint32_t* output = scratch.allocateArray<uint32_t>(triangleCount * 3);
+	uint32_t* deadEnds = scratch.allocateArray<uint32_t>(triangleCount * 3);
+	size_t deadEndCount = 0;
+	size_t outputCount = 0;
+	size_t time = VERTEX_CACHE_SIZE + 1;
+	size_t cursor = 0;
+	uint32_t fan = indices[0];
+	while (fan != NO_VERTEX) {
+		size_t fanStart = outputCount;
+		for (uint32_t a = adjacencyStart[fan]; a < adjacencyStart[fan + 1]; a++) {
+			uint32_t t = adjacency[a];
+			if (emitted[t]) {
+				continue;
+			}
+			emitted[t] = true;
+			for (size_t k = 0; k < 3; k++) {
+				uint32_t v = indices[t * 3 + k];
+				output[outputCount++] = v;
+				deadEnds[deadEndCount++] = v;
+				live[v]--;
+				if (time - cacheTime[v] > VERTEX_CACHE_SIZE) {
+					cacheTime[v] = time++;
+				}
+			}
+		}
+
+		fan = NO_VERTEX;
+		size_t bestPriority = 0;
+		bool found = false;
+		for (size_t o = fanStart; o < outputCount; o++) {
+			uint32_t v = output[o];
+			if (live[v] == 0) {
+				continue;
+			}
+			size_t priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= VERTEX_CACHE_SIZE) {
+				priority = time - cacheTime[v];
+			}
+			if (!found || priority > bestPriority) {
+				found = true;
+				bestPriority = priority;
+				fan = v;
+			}
+		}
+		while (fan == NO_VERTEX && deadEndCount > 0) {
+			uint32_t v = deadEnds[--deadEndCount];
+			if (live[v] > 0) {
+				fan = v;
+			}
+		}
+		while (fan == NO_VERTEX && cursor < vertexCount) {
+			if (live[cursor] > 0) {
+				fan = static_cast<uint32_t>(cursor);
+			}
+			cursor++;
+		}
+	}
+
+	// Number the vertices in the order the new triangles first use them.
+	uint32_t* remap = adjacencyStart;
+	std::fill(remap, remap + vertexCount, NO_VERTEX);
+	size_t kept = 0;
+	for (size_t i = 0; i < outputCount; i++) {
+		uint32_t v = output[i];
+		if (remap[v] == NO_VERTEX) {
+			remap[v] = static_cast<uint32_t>(kept++);
+		}
+		indices[i] = remap[v];
+	}
+	Vertex3D* moved = scratch.allocateArray<Vertex3D>(kept);
+	for (size_t v = 0; v < vertexCount; v++) {
+		if (remap[v] != NO_VERTEX) {
+			new (&moved[remap[v]]) Vertex3D(vertices[v]);
+		}
+	}
+	std::copy(moved, moved + kept, vertices);
+	if (influences != nullptr) {
+		VertexBoneData* movedInfluences = scratch.allocateArray<VertexBoneData>(kept);
+		for (size_t v = 0; v < vertexCount; v++) {
+			if (remap[v] != NO_VERTEX) {
+				movedInfluences[remap[v]] = influences[v];
+			}
+		}
+		std::copy(movedInfluences, movedInfluences + kept, influences);
+	}
+	return kept;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include "FrameArena.h"
+#include "Mesh3D.h"
+
+/**
+ * @brief Replaces every vertex's normal with the area-weighted average of the normals of the
+ * triangles around its position, so vertices at the same position, split by differing texture
+ * coordinates, get the same smooth normal. Vertices in no triangle get +Z. Scratch memory comes
+ * from the arena, which the caller resets.
+ */
+void generateNormals(Vertex3D* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+	FrameArena& scratch);
+
+/**
+ * @brief The number of vertices an optimizeVertexCache pass assumes the GPU's post-transform
+ * cache holds.
+ */
+const size_t VERTEX_CACHE_SIZE = 16;
+
+/**
+ * @brief Reorders triangles so consecutive ones share vertices while they are still in the
+ * post-transform cache (Tipsify, Sander et al. 2007), then renumbers the vertices in the order
+ * the triangles first use them, so vertex fetches walk the buffer forward. Vertices no
+ * triangle uses are dropped. If influences are given, one per vertex, they are moved with the
+ * vertices. Scratch memory comes from the arena, which the caller resets. Throws
+ * std::runtime_error if the index count is not a multiple of 3.
+ * @return the number of vertices kept.
+ */
+size_t optimizeVertexCache(Vertex3D* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount,
+	FrameArena& scratch, VertexBoneData* influences = nullptr);
@@ -0,0 +1,529 @@
+#include "ObjImport.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @brief A face corner's position, texture coordinate and normal indices, zero-based, or -1
+ * where the corner has none. Until chunks are merged, indices the file counts back from the
+ * end of the lists are relative to the start of the chunk's own lists, and flagged as such.
+ */
+struct ObjCorner {
+	int32_t index[3];
+	uint32_t relative;
+};
+
+static const uint32_t CORNER_POSITION = 0;
+static const uint32_t CORNER_TEXCOORD = 1;
+static const uint32_t CORNER_NORMAL = 2;
+// Chunks are at least this large, so small files are not split needlessly.
+static const size_t MIN_CHUNK_BYTES = 1 << 18;
+
+/**
+ * @brief What one line-aligned chunk of the file holds.
+ */
+struct ObjChunk {
+	const char* begin;
+	const char* end;
+	std::vector<float_t> positions;
+	std::vector<float_t> texCoords;
+	std::vector<float_t> normals;
+	// Three per triangle.
+	std::vector<ObjCorner> corners;
+	// The first triangle of the chunk each usemtl applies from.
+	std::vector<std::pair<size_t, std::string_view>> materialSwitches;
+	std::vector<std::string_view> libraries;
+	// The first line that could not be parsed, if any.
+	std::string_view malformed;
+	// Set when merging: the chunk's first position, texture coordinate and normal overall,
+	// and whether an index fell outside the lists.
+	size_t offsets[3] = {};
+	bool outOfRange = false;
+};
+
+static const char* skipSpaces(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	return p;
+}
+
+static bool parseFloat(const char*& p, const char* end, float_t& value) {
+	p = skipSpaces(p, end);
+	if (p < end && *p == '+') {
+		p++;
+	}
+	auto result = std::from_chars(p, end, value);
+	if (result.ec != std::errc()) {
+		return false;
+	}
+	p = result.ptr;
+	return true;
+}
+
+static std::string_view restOfLine(const char* p, const char* end) {
+	p = skipSpaces(p, end);
+	const char* last = end;
+	while (last > p && (last[-1] == ' ' || last[-1] == '\t')) {
+		last--;
+	}
+	return std::string_view(p, last - p);
+}
+
+/**
+ * @brief Parses one "v", "v/vt", "v//vn" or "v/vt/vn" corner.
+ */
+static bool parseCorner(const char*& p, const char* end, const ObjChunk& chunk, ObjCorner& corner) {
+	const size_t counts[3] = { chunk.positions.size() / 3, chunk.texCoords.size() / 2, chunk.normals.size() / 3 };
+	corner.relative = 0;
+	for (uint32_t k = 0; k < 3; k++) {
+		corner.index[k] = -1;
+		if (k > 0) {
+			if (p >= end || *p != '/') {
+				continue;
+			}
+			p++;
+			if (p < end && (*p == '/' || *p == ' ' || *p == '\t')) {
+				continue;
+			}
+		}
+		// Indices must fit an int32_t once made 0-based or resolved against the chunk, or
+		// they would wrap to the -1 of an absent component, or into range.
+		const int64_t limit = std::numeric_limits<int32_t>::max();
+		int64_t value;
+		auto result = std::from_chars(p, end, value);
+		if (result.ec != std::errc() || value == 0 || value > limit || value < -limit) {
+			return false;
+		}
+		p = result.ptr;
+		if (value > 0) {
+			corner.index[k] = static_cast<int32_t>(value - 1);
+		}
+		else {
+			int64_t resolved = static_cast<int64_t>(counts[k]) + value;
+			if (resolved > limit) {
+				return false;
+			}
+			corner.index[k] = static_cast<int32_t>(resolved);
+			corner.relative |= 1u << k;
+		}
+	}
+	return true;
+}
+
+static void parseChunk(ObjChunk& chunk) {
+	std::vector<ObjCorner> polygon;
+	const char* p = chunk.begin;
+	while (p < chunk.end) {
+		const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+		lineEnd = lineEnd != nullptr ? lineEnd : chunk.end;
+		const char* next = lineEnd + (lineEnd < chunk.end ? 1 : 0);
+		if (lineEnd > p && lineEnd[-1] == '\r') {
+			lineEnd--;
+		}
+		const char* q = skipSpaces(p, lineEnd);
+		size_t length = lineEnd - q;
+		bool ok = true;
+		auto keyword = [&](const char* word) {
+			size_t n = std::strlen(word);
+			return length > n && std::memcmp(q, word, n) == 0 && (q[n] == ' ' || q[n] == '\t');
+		};
+
+		if (keyword("v")) {
+			q += 1;
+			float_t x, y, z;
+			ok = parseFloat(q, lineEnd, x) && parseFloat(q, lineEnd, y) && parseFloat(q, lineEnd, z);
+			chunk.positions.insert(chunk.positions.end(), { x, y, z });
+		}
+		else if (keyword("vt")) {
+			q += 2;
+			float_t u, v = 0;
+			ok = parseFloat(q, lineEnd, u);
+			const char* rest = skipSpaces(q, lineEnd);
+			if (ok && rest < lineEnd) {
+				ok = parseFloat(q, lineEnd, v);
+			}
+			chunk.texCoords.insert(chunk.texCoords.end(), { u, v });
+		}
+		else if (keyword("vn")) {
+			q += 2;
+			float_t x, y, z;
+			ok = parseFloat(q, lineEnd, x) && parseFloat(q, lineEnd, y) && parseFloat(q, lineEnd, z);
+			chunk.normals.insert(chunk.normals.end(), { x, y, z });
+		}
+		else if (keyword("f")) {
+			q += 1;
+			polygon.clear();
+			while (ok && (q = skipSpaces(q, lineEnd)) < lineEnd) {
+				ObjCorner corner;
+				ok = parseCorner(q, lineEnd, chunk, corner);
+				polygon.push_back(corner);
+			}
+			ok = ok && polygon.size() >= 3;
+			// Polygons become fans around their first corner.
+			for (size_t i = 2; ok && i < polygon.size(); i++) {
+				chunk.corners.insert(chunk.corners.end(), { polygon[0], polygon[i - 1], polygon[i] });
+			}
+		}
+		else if (keyword("usemtl")) {
+			chunk.materialSwitches.emplace_back(chunk.corners.size() / 3, restOfLine(q + 6, lineEnd));
+		}
+		else if (keyword("mtllib")) {
+			chunk.libraries.push_back(restOfLine(q + 6, lineEnd));
+		}
+		// Comments, objects, groups, smoothing groups, points and lines are skipped.
+
+		if (!ok && chunk.malformed.empty()) {
+			chunk.malformed = std::string_view(p, lineEnd - p);
+		}
+		p = next;
+	}
+}
+
+/**
+ * @brief Reads the texture maps of every material in an MTL file. Options before a map's file
+ * name are skipped; the name is the line's last word.
+ */
+static void readMaterialLibrary(const std::filesystem::path& path, std::vector<ObjMaterial>& materials) {
+	std::ifstream file(path);
+	std::string line;
+	ObjMaterial* material = nullptr;
+	while (std::getline(file, line)) {
+		std::istringstream words(line);
+		std::string keyword;
+		words >> keyword;
+		if (keyword == "newmtl") {
+			std::string name;
+			std::getline(words >> std::ws, name);
+			while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) {
+				name.pop_back();
+			}
+			material = &materials.emplace_back(ObjMaterial{ name, {} });
+			continue;
+		}
+		const char* sampler = nullptr;
+		if (keyword == "map_Kd") {
+			sampler = "baseTexture";
+		}
+		else if (keyword == "map_Ks") {
+			sampler = "specMap";
+		}
+		else if (keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump" || keyword == "norm") {
+			sampler = "normalMap";
+		}
+		std::string fileName, word;
+		while (words >> word) {
+			fileName = word;
+		}
+		if (material != nullptr && sampler != nullptr && !fileName.empty()) {
+			material->textures.emplace_back(sampler, path.parent_path() / fileName);
+		}
+	}
+	// Diffuse maps first, then specular, then bump and normal maps, as Assimp orders them.
+	auto rank = [](const std::pair<std::string, std::filesystem::path>& texture) {
+		return texture.first == "baseTexture" ? 0 : texture.first == "specMap" ? 1 : 2;
+	};
+	for (auto& m : materials) {
+		std::stable_sort(m.textures.begin(), m.textures.end(),
+			[&](const auto& a, const auto& b) { return rank(a) < rank(b); });
+	}
+}
+
+static uint64_t hashCorner(const ObjCorner& corner) {
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (int32_t i : corner.index) {
+		hash = (hash ^ static_cast<uint32_t>(i)) * 0x9E3779B97F4A7C15ull;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+/**
+ * @brief Builds one material's vertices and indices from its corners, one vertex per distinct
+ * triplet in order of first use, then runs the mesh steps on them.
+ */
+static void prepareMesh(ObjMesh& mesh, const ObjCorner* corners, size_t cornerCount, const std::vector<float_t>& positions,
+	const std::vector<float_t>& texCoords, const std::vector<float_t>& normals, const ImportSettings& settings,
+	FrameArena& meshArena, FrameArena& scratch, WorkerPool* pool) {
+	auto start = ImportClock::now();
+	size_t slots = 16;
+	while (slots < 2 * cornerCount) {
+		slots *= 2;
+	}
+	const uint32_t empty = 0xFFFFFFFF;
+	uint32_t* table = scratch.allocateArray<uint32_t>(slots);
+	std::fill(table, table + slots, empty);
+	// The first corner of each distinct triplet.
+	uint32_t* firstCorners = scratch.allocateArray<uint32_t>(cornerCount);
+	mesh.indexCount = cornerCount;
+	mesh.indices = meshArena.allocateArray<uint32_t>(cornerCount);
+	size_t distinct = 0;
+	bool hasNormals = true;
+	for (size_t c = 0; c < cornerCount; c++) {
+		const ObjCorner& corner = corners[c];
+		hasNormals = hasNormals && corner.index[CORNER_NORMAL] >= 0;
+		size_t slot = hashCorner(corner) & (slots - 1);
+		while (table[slot] != empty) {
+			const ObjCorner& other = corners[firstCorners[table[slot]]];
+			if (std::memcmp(other.index, corner.index, sizeof(corner.index)) == 0) {
+				break;
+			}
+			slot = (slot + 1) & (slots - 1);
+		}
+		if (table[slot] == empty) {
+			table[slot] = static_cast<uint32_t>(distinct);
+			firstCorners[distinct++] = static_cast<uint32_t>(c);
+		}
+		mesh.indices[c] = table[slot];
+	}
+
+	mesh.vertices = meshArena.allocateArray<Vertex3D>(distinct);
+	for (size_t v = 0; v < distinct; v++) {
+		const ObjCorner& corner = corners[firstCorners[v]];
+		const float_t* position = &positions[static_cast<size_t>(corner.index[CORNER_POSITION]) * 3];
+		float_t u = 0, t = 0, nx = 0, ny = 0, nz = 1;
+		if (corner.index[CORNER_TEXCOORD] >= 0) {
+			u = texCoords[static_cast<size_t>(corner.index[CORNER_TEXCOORD]) * 2];
+			t = texCoords[static_cast<size_t>(corner.index[CORNER_TEXCOORD]) * 2 + 1];
+			t = settings.flipTextureCoords ? 1 - t : t;
+		}
+		if (corner.index[CORNER_NORMAL] >= 0) {
+			const float_t* normal = &normals[static_cast<size_t>(corner.index[CORNER_NORMAL]) * 3];
+			nx = normal[0];
+			ny = normal[1];
+			nz = normal[2];
+		}
+		new (&mesh.vertices[v]) Vertex3D(position[0], position[1], position[2], nx, ny, nz, u, t);
+	}
+	mesh.vertexCount = distinct;
+	mesh.convertedCount = distinct;
+	scratch.reset();
+	mesh.convertMs += std::chrono::duration<double, std::milli>(ImportClock::now() - start).count();
+
+	mesh.vertexCount = runMeshSteps(mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount, hasNormals,
+		settings, scratch, pool, nullptr, mesh.stepMs);
+}
+
+ObjGeometry readObj(const std::filesystem::path& path, ImportStaging& staging, ImportReport* report) {
+	auto start = ImportClock::now();
+	MappedFile file(path);
+	const char* text = reinterpret_cast<const char*>(file.data());
+	const char* textEnd = text + file.size();
+	WorkerPool* pool = staging.pool;
+
+	// Split at the first line break after each even share of the file.
+	size_t workers = pool != nullptr ? pool->threadCount() : 1;
+	size_t chunkCount = std::clamp<size_t>(file.size() / MIN_CHUNK_BYTES, 1, workers * 4);
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* begin = text;
+	for (size_t i = 0; i < chunkCount; i++) {
+		const char* end = i + 1 == chunkCount ? textEnd : std::max(begin, text + file.size() * (i + 1) / chunkCount);
+		const char* lineEnd = static_cast<const char*>(std::memchr(end, '\n', textEnd - end));
+		end = lineEnd != nullptr ? lineEnd + 1 : textEnd;
+		chunks[i].begin = begin;
+		chunks[i].end = end;
+		begin = end;
+	}
+	if (pool != nullptr && chunkCount > 1) {
+		pool->run(chunkCount, [&](size_t chunk, size_t) { parseChunk(chunks[chunk]); });
+	}
+	else {
+		for (auto& chunk : chunks) {
+			parseChunk(chunk);
+		}
+	}
+
+	// Chunks refer back to earlier chunks' lists; find where each chunk's lists start overall.
+	size_t totals[3] = {};
+	size_t triangleCount = 0;
+	for (auto& chunk : chunks) {
+		if (!chunk.malformed.empty()) {
+			throw std::runtime_error("Malformed line in " + path.string() + ": " + std::string(chunk.malformed));
+		}
+		chunk.offsets[CORNER_POSITION] = totals[CORNER_POSITION];
+		chunk.offsets[CORNER_TEXCOORD] = totals[CORNER_TEXCOORD];
+		chunk.offsets[CORNER_NORMAL] = totals[CORNER_NORMAL];
+		totals[CORNER_POSITION] += chunk.positions.size() / 3;
+		totals[CORNER_TEXCOORD] += chunk.texCoords.size() / 2;
+		totals[CORNER_NORMAL] += chunk.normals.size() / 3;
+		triangleCount += chunk.corners.size() / 3;
+	}
+
+	// Materials, in order of first use; triangles before any usemtl use a default material.
+	ObjGeometry geometry;
+	std::vector<ObjMaterial> library;
+	for (auto& chunk : chunks) {
+		for (auto name : chunk.libraries) {
+			readMaterialLibrary(path.parent_path() / std::string(name), library);
+		}
+	}
+	std::unordered_map<std::string_view, size_t> materialIds;
+	auto materialId = [&](std::string_view name) {
+		auto found = materialIds.find(name);
+		if (found != materialIds.end()) {
+			return found->second;
+		}
+		auto defined = std::find_if(library.begin(), library.end(), [&](const ObjMaterial& m) { return m.name == name; });
+		geometry.materials.push_back(defined != library.end() ? *defined : ObjMaterial{ std::string(name), {} });
+		materialIds.emplace(name, geometry.materials.size() - 1);
+		return geometry.materials.size() - 1;
+	};
+	// Each chunk's runs of triangles of one material: first triangle, end, material.
+	struct MaterialRun {
+		size_t first;
+		size_t end;
+		size_t material;
+	};
+	std::vector<std::vector<MaterialRun>> runs(chunkCount);
+	std::vector<size_t> materialTriangles;
+	std::string_view current;
+	for (size_t i = 0; i < chunkCount; i++) {
+		size_t triangles = chunks[i].corners.size() / 3;
+		size_t first = 0;
+		for (size_t s = 0; s <= chunks[i].materialSwitches.size(); s++) {
+			size_t end = s < chunks[i].materialSwitches.size() ? chunks[i].materialSwitches[s].first : triangles;
+			if (end > first) {
+				size_t id = materialId(current);
+				materialTriangles.resize(geometry.materials.size(), 0);
+				runs[i].push_back(MaterialRun{ first, end, id });
+				materialTriangles[id] += end - first;
+			}
+			if (s < chunks[i].materialSwitches.size()) {
+				current = chunks[i].materialSwitches[s].second;
+				first = end;
+			}
+		}
+	}
+
+	// Gather every list into one, and each material's corners together, resolving indices.
+	std::vector<float_t> positions(totals[CORNER_POSITION] * 3);
+	std::vector<float_t> texCoords(totals[CORNER_TEXCOORD] * 2);
+	std::vector<float_t> normals(totals[CORNER_NORMAL] * 3);
+	std::vector<size_t> materialStart(geometry.materials.size() + 1, 0);
+	for (size_t m = 0; m < geometry.materials.size(); m++) {
+		materialStart[m + 1] = materialStart[m] + materialTriangles[m] * 3;
+	}
+	// Where each chunk's runs go: after the same material's corners from earlier chunks.
+	std::vector<std::vector<size_t>> runTargets(chunkCount);
+	std::vector<size_t> fill(materialStart.begin(), materialStart.end() - 1);
+	for (size_t i = 0; i < chunkCount; i++) {
+		for (auto& run : runs[i]) {
+			runTargets[i].push_back(fill[run.material]);
+			fill[run.material] += (run.end - run.first) * 3;
+		}
+	}
+	std::vector<ObjCorner> corners(triangleCount * 3);
+	auto gather = [&](size_t i) {
+		ObjChunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.offsets[CORNER_POSITION] * 3);
+		std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + chunk.offsets[CORNER_TEXCOORD] * 2);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.offsets[CORNER_NORMAL] * 3);
+		for (size_t r = 0; r < runs[i].size(); r++) {
+			ObjCorner* target = &corners[runTargets[i][r]];
+			for (size_t c = runs[i][r].first * 3; c < runs[i][r].end * 3; c++) {
+				ObjCorner corner = chunk.corners[c];
+				for (uint32_t k = 0; k < 3; k++) {
+					int64_t index = corner.index[k];
+					bool relative = (corner.relative & (1u << k)) != 0;
+					if (!relative && index == -1) {
+						// An absent texture coordinate or normal.
+						continue;
+					}
+					if (relative) {
+						index += static_cast<int64_t>(chunk.offsets[k]);
+					}
+					// Relative or absolute, every index is checked against the whole file's.
+					if (index < 0 || index >= static_cast<int64_t>(totals[k])) {
+						chunk.outOfRange = true;
+						index = 0;
+					}
+					corner.index[k] = static_cast<int32_t>(index);
+				}
+				corner.relative = 0;
+				*target++ = corner;
+			}
+		}
+	};
+	if (pool != nullptr && chunkCount > 1) {
+		pool->run(chunkCount, [&](size_t chunk, size_t) { gather(chunk); });
+	}
+	else {
+		for (size_t i = 0; i < chunkCount; i++) {
+			gather(i);
+		}
+	}
+	for (auto& chunk : chunks) {
+		if (chunk.outOfRange) {
+			throw std::runtime_error("Face index out of range in " + path.string());
+		}
+	}
+	chunks.clear();
+	addImportTime(report, &ImportReport::parseMs, start);
+
+	start = ImportClock::now();
+	geometry.meshes.resize(geometry.materials.size());
+	prepareMeshesInParallel(staging, geometry.meshes.size(),
+		[&](size_t mesh) { return materialStart[mesh + 1] - materialStart[mesh]; },
+		[&](size_t mesh, FrameArena& meshArena, FrameArena& scratch, WorkerPool* meshPool) {
+			geometry.meshes[mesh].material = mesh;
+			prepareMesh(geometry.meshes[mesh], &corners[materialStart[mesh]], materialStart[mesh + 1] - materialStart[mesh],
+				positions, texCoords, normals, staging.settings, meshArena, scratch, meshPool);
+		});
+	addImportTime(report, &ImportReport::processMs, start);
+	if (report != nullptr) {
+		for (auto& mesh : geometry.meshes) {
+			report->convertMs += mesh.convertMs;
+			for (size_t s = 0; s < IMPORT_STEP_COUNT; s++) {
+				report->stepMs[s] += mesh.stepMs[s];
+			}
+		}
+	}
+	return geometry;
+}
+
+Object3D objLoad(const std::string& path, const ImportSettings& settings, ImportReport* report) {
+	auto loadStart = ImportClock::now();
+	WorkerPool pool;
+	ImportStaging staging(settings, &pool);
+	ObjGeometry geometry = readObj(path, staging, report);
+
+	std::unordered_map<std::filesystem::path, Texture> loadedTextures;
+	std::vector<Mesh3D> meshes;
+	meshes.reserve(geometry.meshes.size());
+	for (auto& mesh : geometry.meshes) {
+		std::vector<Texture> textures;
+		for (auto& texture : geometry.materials[mesh.material].textures) {
+			textures.push_back(loadTextureFile(texture.second, texture.first, loadedTextures, report));
+		}
+		auto start = ImportClock::now();
+		meshes.emplace_back(mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount, std::move(textures));
+		addImportTime(report, &ImportReport::meshUploadMs, start);
+
+		if (report != nullptr) {
+			report->meshCount++;
+			report->vertexCount += mesh.vertexCount;
+			report->convertedVertexCount += mesh.convertedCount;
+			report->triangleCount += mesh.indexCount / 3;
+			report->vertexBytes += mesh.vertexCount * sizeof(Vertex3D);
+			report->indexBytes += mesh.indexCount * sizeof(uint32_t);
+		}
+	}
+	if (report != nullptr) {
+		report->stagingBytes = std::max(report->stagingBytes, staging.capacity());
+		std::error_code error;
+		auto bytes = std::filesystem::file_size(path, error);
+		report->fileBytes += error ? 0 : bytes;
+	}
+	staging.reset();
+	Object3D object(std::move(meshes));
+	addImportTime(report, &ImportReport::totalMs, loadStart);
+	return object;
+}
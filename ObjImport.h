@@ -0,0 +1,57 @@
+#pragma once
+#include "ImportPipeline.h"
+#include "Object3D.h"
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief An OBJ material's texture files, with the sampler each binds to, in the order the
+ * Assimp importer gives them: diffuse, specular, bump, then normal maps.
+ */
+struct ObjMaterial {
+	std::string name;
+	std::vector<std::pair<std::string, std::filesystem::path>> textures;
+};
+
+/**
+ * @brief The triangles of one material, converted and processed in staging memory.
+ */
+struct ObjMesh {
+	// Index into ObjGeometry::materials.
+	size_t material = 0;
+	Vertex3D* vertices = nullptr;
+	size_t vertexCount = 0;
+	// Distinct position/texture coordinate/normal triplets, before the mesh steps.
+	size_t convertedCount = 0;
+	uint32_t* indices = nullptr;
+	size_t indexCount = 0;
+	// Time spent converting and in each step, on whichever thread prepared the mesh.
+	double convertMs = 0;
+	double stepMs[IMPORT_STEP_COUNT] = {};
+};
+
+/**
+ * @brief An OBJ file's meshes, one per material used, in the order materials are first used.
+ */
+struct ObjGeometry {
+	std::vector<ObjMaterial> materials;
+	std::vector<ObjMesh> meshes;
+};
+
+/**
+ * @brief Reads an OBJ file and the material libraries it names, and builds each material's
+ * vertices and indices in the staging's arenas, valid until the staging is reset. The file is
+ * mapped and split into line-aligned chunks parsed in parallel on the staging's pool; faces
+ * are fan-triangulated, and each distinct position/texture coordinate/normal triplet becomes
+ * one vertex. The staging settings' mesh steps then run on each mesh. Throws
+ * std::runtime_error on malformed lines and out-of-range indices.
+ */
+ObjGeometry readObj(const std::filesystem::path& path, ImportStaging& staging, ImportReport* report = nullptr);
+
+/**
+ * @brief Imports an OBJ file without Assimp, into one object with a mesh per material.
+ * Assimp's steps are not run; the settings' mesh steps are, on a pool started for the import.
+ */
+Object3D objLoad(const std::string& path, const ImportSettings& settings, ImportReport* report = nullptr);
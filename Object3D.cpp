@@ -11,6 +11,7 @@ void Object3D::rebuildModelMatrix() {
 	m = glm::rotate(m, m_orientation[2], glm::vec3(0, 0, 1));
 	m = glm::rotate(m, m_orientation[0], glm::vec3(1, 0, 0));
 	m = glm::rotate(m, m_orientation[1], glm::vec3(0, 1, 0));
+	m = m * glm::mat4_cast(m_rotation);
 	m = glm::scale(m, m_scale);
 	m = glm::translate(m, -m_center);
 	m = m * m_baseTransform;
@@ -23,8 +24,8 @@ Object3D::Object3D(std::vector<Mesh3D>&& meshes)
 }
 
 Object3D::Object3D(std::vector<Mesh3D>&& meshes, const glm::mat4& baseTransform)
-	: m_meshes(meshes), m_position(), m_orientation(), m_scale(1.0),
-	m_center(), m_baseTransform(baseTransform)
+	: m_meshes(meshes), m_position(), m_orientation(), m_rotation(1, 0, 0, 0), m_scale(1.0),
+	m_center(), m_baseTransform(baseTransform), m_static(false)
 {
 	rebuildModelMatrix();
 }
@@ -37,6 +38,14 @@ const glm::vec3& Object3D::getOrientation() const {
 	return m_orientation;
 }
 
+/**
+ * @brief Gets the quaternion rotation applied after the Euler orientation, used by
+ * keyframe animation tracks.
+ */
+const glm::quat& Object3D::getRotation() const {
+	return m_rotation;
+}
+
 const glm::vec3& Object3D::getScale() const {
 	return m_scale;
 }
@@ -52,6 +61,38 @@ const std::string& Object3D::getName() const {
 	return m_name;
 }
 
+/**
+ * @brief Gets the skeleton animating the object's skinned meshes, if it is a rigged model.
+ */
+const std::shared_ptr<Skeleton>& Object3D::getSkeleton() const {
+	return m_skeleton;
+}
+
+/**
+ * @brief Gets the object's local->parent transformation matrix.
+ */
+const glm::mat4& Object3D::getModelMatrix() const {
+	return m_modelMatrix;
+}
+
+/**
+ * @brief Gets the transformation applied before the object's own, such as an imported node's.
+ */
+const glm::mat4& Object3D::getBaseTransform() const {
+	return m_baseTransform;
+}
+
+const std::vector<Mesh3D>& Object3D::getMeshes() const {
+	return m_meshes;
+}
+
+/**
+ * @brief Whether the object has been marked as never moving; see setStatic.
+ */
+bool Object3D::isStatic() const {
+	return m_static;
+}
+
 size_t Object3D::numberOfChildren() const {
 	return m_children.size();
 }
@@ -74,6 +115,11 @@ void Object3D::setOrientation(const glm::vec3& orientation) {
 	rebuildModelMatrix();
 }
 
+void Object3D::setRotation(const glm::quat& rotation) {
+	m_rotation = rotation;
+	rebuildModelMatrix();
+}
+
 void Object3D::setScale(const glm::vec3& scale) {
 	m_scale = scale;
 	rebuildModelMatrix();
@@ -92,6 +138,31 @@ void Object3D::setName(const std::string& name) {
 	m_name = name;
 }
 
+void Object3D::setSkeleton(std::shared_ptr<Skeleton> skeleton) {
+	m_skeleton = std::move(skeleton);
+}
+
+/**
+ * @brief Marks the object and its children as never moving or deforming once the scene
+ * starts, which lets ShadowCascades cache their shadows in its far cascades.
+ */
+void Object3D::setStatic(bool isStatic) {
+	m_static = isStatic;
+}
+
+/**
+ * @brief Sets the position, orientation, rotation, and scale together, rebuilding the model
+ * matrix only once.
+ */
+void Object3D::setTransform(const glm::vec3& position, const glm::vec3& orientation,
+	const glm::quat& rotation, const glm::vec3& scale) {
+	m_position = position;
+	m_orientation = orientation;
+	m_rotation = rotation;
+	m_scale = scale;
+	rebuildModelMatrix();
+}
+
 void Object3D::move(const glm::vec3& offset) {
 	m_position = m_position + offset;
 	rebuildModelMatrix();
@@ -112,24 +183,24 @@ void Object3D::addChild(Object3D&& child)
 	m_children.emplace_back(child);
 }
 
-void Object3D::render(sf::RenderWindow& window, ShaderProgram& shaderProgram) const {
-	renderRecursive(window, shaderProgram, glm::mat4(1));
+void Object3D::render(ShaderProgram& shaderProgram) const {
+	renderRecursive(shaderProgram, glm::mat4(1));
 }
 
 /**
  * @brief Renders the object and its children, recursively.
  * @param parentMatrix the model matrix of this object's parent in the model hierarchy.
  */
-void Object3D::renderRecursive(sf::RenderWindow& window, ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const {
+void Object3D::renderRecursive(ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const {
 	// This object's true model matrix is the combination of its parent's matrix and the object's matrix.
 	glm::mat4 trueModel = parentMatrix * m_modelMatrix;
 	shaderProgram.setUniform("model", trueModel);
 	// Render each mesh in the object.
 	for (auto& mesh : m_meshes) {
-		mesh.render(window, shaderProgram);
+		mesh.render(shaderProgram);
 	}
 	// Render the children of the object.
 	for (auto& child : m_children) {
-		child.renderRecursive(window, shaderProgram, trueModel);
+		child.renderRecursive(shaderProgram, trueModel);
 	}
 }
@@ -1,8 +1,12 @@
 #pragma once
 #include <memory>
 #include <vector>
+#include <glm/gtc/quaternion.hpp>
+#include "FramePacket.h"
 #include "Mesh3D.h"
 #include "ShaderProgram.h"
+
+class Skeleton;
 /**
  * @brief Represents an object placed in a 3D scene. The object is a node in an hierarchy of
  * objects representing a single 3D model. Each object in the hierarchy has its own position,
@@ -17,6 +21,7 @@ private:
 	// The object's position, orientation, and scale in world space.
 	glm::vec3 m_position;
 	glm::vec3 m_orientation;
+	glm::quat m_rotation;
 	glm::vec3 m_scale;
 	glm::vec3 m_center;
 
@@ -27,6 +32,12 @@ private:
 	// Some objects from Assimp imports have a "name" field, useful for debugging.
 	std::string m_name;
 
+	// The skeleton of a rigged model, set on the root object of an Assimp import.
+	std::shared_ptr<Skeleton> m_skeleton;
+
+	// Whether the object and its children never move or deform, so their shadows can be cached.
+	bool m_static;
+
 	// Recomputes the local->world transformation matrix.
 	void rebuildModelMatrix();
 
@@ -40,9 +51,15 @@ public:
 	// Simple accessors.
 	const glm::vec3& getPosition() const;
 	const glm::vec3& getOrientation() const;
+	const glm::quat& getRotation() const;
 	const glm::vec3& getScale() const;
 	const glm::vec3& getCenter() const;
 	const std::string& getName() const;
+	const std::shared_ptr<Skeleton>& getSkeleton() const;
+	const glm::mat4& getModelMatrix() const;
+	const glm::mat4& getBaseTransform() const;
+	const std::vector<Mesh3D>& getMeshes() const;
+	bool isStatic() const;
 
 	// Child management.
 	size_t numberOfChildren() const;
@@ -52,9 +69,14 @@ public:
 	// Simple mutators.
 	void setPosition(const glm::vec3& position);
 	void setOrientation(const glm::vec3& orientation);
+	void setRotation(const glm::quat& rotation);
 	void setScale(const glm::vec3& scale);
 	void setCenter(const glm::vec3& center);
 	void setName(const std::string& name);
+	void setSkeleton(std::shared_ptr<Skeleton> skeleton);
+	void setStatic(bool isStatic);
+	void setTransform(const glm::vec3& position, const glm::vec3& orientation,
+		const glm::quat& rotation, const glm::vec3& scale);
 
 	// Transformations.
 	void move(const glm::vec3& offset);
@@ -63,7 +85,26 @@ public:
 	void addChild(Object3D&& child);
 
 	// Rendering.
-	void render(sf::RenderWindow& window, ShaderProgram& shaderProgram) const;
-	void renderRecursive(sf::RenderWindow& window, ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const;
+	void render(ShaderProgram& shaderProgram) const;
+	void renderRecursive(ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const;
+	template <typename Allocator>
+	void collectDraws(const glm::mat4& parentMatrix, std::vector<DrawItem, Allocator>& draws) const;
 
-};
\ No newline at end of file
+};
+
+/**
+ * @brief Appends a draw of each mesh of the object and its children, recursively, with the same
+ * model matrices renderRecursive would use; for building a FramePacket, or a pass's draw list in
+ * a FrameArena.
+ * @param parentMatrix the model matrix of this object's parent in the model hierarchy.
+ */
+template <typename Allocator>
+void Object3D::collectDraws(const glm::mat4& parentMatrix, std::vector<DrawItem, Allocator>& draws) const {
+	glm::mat4 trueModel = parentMatrix * m_modelMatrix;
+	for (auto& mesh : m_meshes) {
+		draws.push_back(DrawItem{ &mesh, trueModel, mesh.sortKey() });
+	}
+	for (auto& child : m_children) {
+		child.collectDraws(trueModel, draws);
+	}
+}
\ No newline at end of file
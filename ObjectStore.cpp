@@ -0,0 +1,190 @@
+#include "ObjectStore.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+/**
+ * @brief The key identifying a child slot in m_childSlots.
+ */
+static uint64_t childKey(uint32_t parentSlot, uint32_t childIndex) {
+	return (static_cast<uint64_t>(parentSlot) << 32) | childIndex;
+}
+
+ObjectStore::ObjectStore() : m_epoch(0) {
+}
+
+uint32_t ObjectStore::allocateSlot() {
+	uint32_t slot;
+	if (!m_freeSlots.empty()) {
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else {
+		if (m_slots.size() > ObjectHandle::INDEX_MASK) {
+			throw std::runtime_error("ObjectStore is out of handle slots");
+		}
+		slot = static_cast<uint32_t>(m_slots.size());
+		// Generations start at 1, so no valid handle is ever 0.
+		m_slots.push_back(Slot{ 1, false, false, 0, 0, nullptr, 0 });
+	}
+	m_slots[slot].live = true;
+	m_slots[slot].cached = nullptr;
+	return slot;
+}
+
+void ObjectStore::releaseSlot(uint32_t slot) {
+	Slot& s = m_slots[slot];
+	s.live = false;
+	s.cached = nullptr;
+	// Skip generation 0 when wrapping around, to keep the zero handle invalid.
+	s.generation = (s.generation + 1) & ObjectHandle::GENERATION_MASK;
+	if (s.generation == 0) {
+		s.generation = 1;
+	}
+	m_freeSlots.push_back(slot);
+}
+
+const ObjectStore::Slot* ObjectStore::liveSlot(ObjectHandle handle) const {
+	if (handle.index() >= m_slots.size()) {
+		return nullptr;
+	}
+	const Slot& slot = m_slots[handle.index()];
+	return slot.live && slot.generation == handle.generation() ? &slot : nullptr;
+}
+
+Object3D* ObjectStore::resolve(uint32_t slot) {
+	Slot& s = m_slots[slot];
+	if (s.isRoot) {
+		return &m_objects[s.target];
+	}
+	if (s.cached == nullptr || s.cachedEpoch != m_epoch) {
+		Object3D* parent = resolve(s.target);
+		s.cached = s.childIndex < parent->numberOfChildren() ? &parent->getChild(s.childIndex) : nullptr;
+		s.cachedEpoch = m_epoch;
+	}
+	return s.cached;
+}
+
+ObjectHandle ObjectStore::insert(Object3D&& object) {
+	uint32_t slot = allocateSlot();
+	Slot& s = m_slots[slot];
+	s.isRoot = true;
+	s.target = static_cast<uint32_t>(m_objects.size());
+	m_objects.emplace_back(std::move(object));
+	m_objectSlots.push_back(slot);
+	++m_epoch;
+	return ObjectHandle(slot, s.generation);
+}
+
+void ObjectStore::erase(ObjectHandle handle) {
+	const Slot* s = liveSlot(handle);
+	if (s == nullptr || !s->isRoot) {
+		throw std::runtime_error("Only live root objects can be erased from an ObjectStore");
+	}
+	uint32_t slot = handle.index();
+
+	// Release the slots of every descendant with a handle.
+	std::function<uint32_t(uint32_t)> rootOf = [&](uint32_t child) {
+		return m_slots[child].isRoot ? child : rootOf(m_slots[child].target);
+	};
+	for (auto it = m_childSlots.begin(); it != m_childSlots.end();) {
+		if (rootOf(it->second) == slot) {
+			releaseSlot(it->second);
+			it = m_childSlots.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+
+	// Swap the last object into the erased object's place to keep the array dense.
+	uint32_t position = s->target;
+	uint32_t last = static_cast<uint32_t>(m_objects.size() - 1);
+	if (position != last) {
+		m_objects[position] = std::move(m_objects[last]);
+		m_objectSlots[position] = m_objectSlots[last];
+		m_slots[m_objectSlots[position]].target = position;
+	}
+	m_objects.pop_back();
+	m_objectSlots.pop_back();
+	releaseSlot(slot);
+	++m_epoch;
+}
+
+bool ObjectStore::contains(ObjectHandle handle) const {
+	return liveSlot(handle) != nullptr;
+}
+
+Object3D* ObjectStore::find(ObjectHandle handle) {
+	return liveSlot(handle) != nullptr ? resolve(handle.index()) : nullptr;
+}
+
+Object3D& ObjectStore::get(ObjectHandle handle) {
+	Object3D* object = find(handle);
+	if (object == nullptr) {
+		throw std::runtime_error("Stale or null ObjectHandle");
+	}
+	return *object;
+}
+
+ObjectHandle ObjectStore::child(ObjectHandle parent, size_t index) {
+	Object3D& parentObject = get(parent);
+	if (index >= parentObject.numberOfChildren()) {
+		throw std::runtime_error("ObjectStore::child index out of range");
+	}
+
+	uint64_t key = childKey(parent.index(), static_cast<uint32_t>(index));
+	auto existing = m_childSlots.find(key);
+	if (existing != m_childSlots.end()) {
+		return ObjectHandle(existing->second, m_slots[existing->second].generation);
+	}
+
+	uint32_t slot = allocateSlot();
+	Slot& s = m_slots[slot];
+	s.isRoot = false;
+	s.target = parent.index();
+	s.childIndex = static_cast<uint32_t>(index);
+	m_childSlots.insert(std::make_pair(key, slot));
+	return ObjectHandle(slot, s.generation);
+}
+
+ObjectHandle ObjectStore::addChild(ObjectHandle parent, Object3D&& child) {
+	Object3D& parentObject = get(parent);
+	size_t index = parentObject.numberOfChildren();
+	parentObject.addChild(std::move(child));
+	// The parent's children may have been reallocated.
+	++m_epoch;
+	return this->child(parent, index);
+}
+
+void ObjectStore::compact() {
+	// Order the objects by slot, so objects created together stay together.
+	std::vector<uint32_t> order(m_objects.size());
+	for (uint32_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+		return m_objectSlots[a] < m_objectSlots[b];
+	});
+
+	std::vector<Object3D> objects;
+	std::vector<uint32_t> objectSlots;
+	objects.reserve(m_objects.size());
+	objectSlots.reserve(m_objects.size());
+	for (uint32_t position : order) {
+		m_slots[m_objectSlots[position]].target = static_cast<uint32_t>(objects.size());
+		objects.emplace_back(std::move(m_objects[position]));
+		objectSlots.push_back(m_objectSlots[position]);
+	}
+	m_objects = std::move(objects);
+	m_objectSlots = std::move(objectSlots);
+
+	// Free slots are popped from the back, so the lowest index must be last.
+	std::sort(m_freeSlots.begin(), m_freeSlots.end(), std::greater<uint32_t>());
+	++m_epoch;
+}
+
+ObjectHandle ObjectStore::handleAt(size_t position) const {
+	uint32_t slot = m_objectSlots[position];
+	return ObjectHandle(slot, m_slots[slot].generation);
+}
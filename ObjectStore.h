@@ -0,0 +1,133 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Object3D.h"
+
+/**
+ * @brief A generational handle to an object in an ObjectStore, packed in 32 bits: the low 20
+ * bits index a slot, and the high 12 bits hold the slot's generation when the handle was
+ * issued. Removing an object bumps its slot's generation, so stale handles are detected
+ * instead of dangling. The zero handle is never issued, and means "no object".
+ */
+class ObjectHandle {
+private:
+	uint32_t m_value;
+
+public:
+	static const uint32_t INDEX_BITS = 20;
+	static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static const uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+	ObjectHandle() : m_value(0) {}
+	ObjectHandle(uint32_t index, uint32_t generation)
+		: m_value((generation << INDEX_BITS) | (index & INDEX_MASK)) {}
+
+	uint32_t index() const { return m_value & INDEX_MASK; }
+	uint32_t generation() const { return m_value >> INDEX_BITS; }
+	uint32_t value() const { return m_value; }
+	bool isNull() const { return m_value == 0; }
+
+	bool operator==(const ObjectHandle& other) const { return m_value == other.m_value; }
+	bool operator!=(const ObjectHandle& other) const { return m_value != other.m_value; }
+};
+
+/**
+ * @brief Owns the root objects of a scene in a slot map: the objects themselves live in one
+ * dense, contiguous array that may be reordered or compacted at any time, while handles stay
+ * valid through a level of indirection. Handles can also name descendants of a root object;
+ * those are resolved through the root by their child indices, and the result is cached until
+ * the store next moves its objects, so lookups are O(1) amortized.
+ */
+class ObjectStore {
+private:
+	struct Slot {
+		uint32_t generation;
+		bool live;
+		bool isRoot;
+		// For a root, its index in m_objects; for a descendant, the slot of its parent.
+		uint32_t target;
+		// For a descendant, its index among its parent's children.
+		uint32_t childIndex;
+		// For a descendant, the resolved object and the epoch it was resolved in.
+		Object3D* cached;
+		uint64_t cachedEpoch;
+	};
+
+	std::vector<Object3D> m_objects;
+	std::vector<uint32_t> m_objectSlots;
+	std::vector<Slot> m_slots;
+	std::vector<uint32_t> m_freeSlots;
+	// Maps (parent slot, child index) to the slot already issued for that child.
+	std::unordered_map<uint64_t, uint32_t> m_childSlots;
+	// Incremented whenever objects may have moved in memory, invalidating cached descendants.
+	uint64_t m_epoch;
+
+	uint32_t allocateSlot();
+	void releaseSlot(uint32_t slot);
+	const Slot* liveSlot(ObjectHandle handle) const;
+	Object3D* resolve(uint32_t slot);
+
+public:
+	ObjectStore();
+
+	/**
+	 * @brief Moves a root object into the store, and returns its handle.
+	 */
+	ObjectHandle insert(Object3D&& object);
+
+	/**
+	 * @brief Removes a root object; its handle, and the handles of its descendants, become stale.
+	 */
+	void erase(ObjectHandle handle);
+
+	/**
+	 * @brief Whether the handle names an object that is still in the store.
+	 */
+	bool contains(ObjectHandle handle) const;
+
+	/**
+	 * @brief The object named by the handle, or nullptr if the handle is stale.
+	 */
+	Object3D* find(ObjectHandle handle);
+
+	/**
+	 * @brief The object named by the handle. Throws if the handle is stale.
+	 */
+	Object3D& get(ObjectHandle handle);
+
+	/**
+	 * @brief A handle to the given child of the object named by the handle. Asking for the same
+	 * child again returns the same handle.
+	 */
+	ObjectHandle child(ObjectHandle parent, size_t index);
+
+	/**
+	 * @brief Adds a child to the object named by the handle, and returns the child's handle.
+	 * Children must be added through the store (not Object3D::addChild) once their parent is in
+	 * the store, so cached descendants are re-resolved.
+	 */
+	ObjectHandle addChild(ObjectHandle parent, Object3D&& child);
+
+	/**
+	 * @brief Rebuilds the dense object array in slot order with no spare capacity, and sorts
+	 * the free list so new objects reuse the lowest slots. All handles stay valid.
+	 */
+	void compact();
+
+	/**
+	 * @brief The number of root objects in the store.
+	 */
+	size_t size() const { return m_objects.size(); }
+
+	/**
+	 * @brief The handle of the root object at the given position in iteration order.
+	 */
+	ObjectHandle handleAt(size_t position) const;
+
+	// Iteration over the root objects, in their dense storage order.
+	std::vector<Object3D>::iterator begin() { return m_objects.begin(); }
+	std::vector<Object3D>::iterator end() { return m_objects.end(); }
+	std::vector<Object3D>::const_iterator begin() const { return m_objects.begin(); }
+	std::vector<Object3D>::const_iterator end() const { return m_objects.end(); }
+};
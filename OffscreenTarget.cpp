@@ -0,0 +1,67 @@
+#include "OffscreenTarget.h"
+#include <stdexcept>
+#include <glad/glad.h>
+#include <SFML/Graphics.hpp>
+
+OffscreenTarget::OffscreenTarget(uint32_t width, uint32_t height)
+	: m_width(width), m_height(height) {
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+	glGenRenderbuffers(1, &m_colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::runtime_error("Offscreen framebuffer is incomplete");
+	}
+	// Unlike a window's, a framebuffer object has only one color buffer to draw into.
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+}
+
+OffscreenTarget::~OffscreenTarget() {
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteRenderbuffers(1, &m_colorBuffer);
+	glDeleteRenderbuffers(1, &m_depthBuffer);
+}
+
+void OffscreenTarget::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+}
+
+void OffscreenTarget::readPixels(std::vector<uint8_t>& pixels) const {
+	size_t rowBytes = static_cast<size_t>(m_width) * 4;
+	pixels.resize(rowBytes * m_height);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	// OpenGL's rows start at the bottom of the image.
+	std::vector<uint8_t> row(rowBytes);
+	for (uint32_t y = 0; y < m_height / 2; y++) {
+		uint8_t* top = pixels.data() + y * rowBytes;
+		uint8_t* bottom = pixels.data() + (m_height - 1 - y) * rowBytes;
+		std::copy(top, top + rowBytes, row.data());
+		std::copy(bottom, bottom + rowBytes, top);
+		std::copy(row.data(), row.data() + rowBytes, bottom);
+	}
+}
+
+void OffscreenTarget::save(const std::filesystem::path& path) const {
+	std::vector<uint8_t> pixels;
+	readPixels(pixels);
+	sf::Image image;
+	image.create(m_width, m_height, pixels.data());
+	if (!image.saveToFile(path.string())) {
+		throw std::runtime_error("Could not save frame to " + path.string());
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/**
+ * @brief A framebuffer object with an RGBA8 color buffer and a 24-bit depth, 8-bit stencil
+ * buffer, for rendering without a window.
+ */
+class OffscreenTarget {
+private:
+	uint32_t m_framebuffer;
+	uint32_t m_colorBuffer;
+	uint32_t m_depthBuffer;
+	uint32_t m_width;
+	uint32_t m_height;
+
+public:
+	/**
+	 * @brief Creates the framebuffer in the current context. Throws if it is incomplete.
+	 */
+	OffscreenTarget(uint32_t width, uint32_t height);
+	~OffscreenTarget();
+	OffscreenTarget(const OffscreenTarget&) = delete;
+	OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+	uint32_t width() const { return m_width; }
+	uint32_t height() const { return m_height; }
+
+	/**
+	 * @brief Directs rendering to this target, and sets the viewport to cover it.
+	 */
+	void bind() const;
+
+	/**
+	 * @brief Reads the color buffer into RGBA8 pixels, top row first.
+	 */
+	void readPixels(std::vector<uint8_t>& pixels) const;
+
+	/**
+	 * @brief Saves the color buffer to an image file; the format follows the extension (.png).
+	 */
+	void save(const std::filesystem::path& path) const;
+};
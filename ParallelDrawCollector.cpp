@@ -0,0 +1,86 @@
+#include "ParallelDrawCollector.h"
+#include <algorithm>
+
+ParallelDrawCollector::ParallelDrawCollector(size_t threadCount, size_t targetUnits)
+	: m_pool(threadCount), m_targetUnits(std::max<size_t>(targetUnits, 1)) {
+	for (size_t i = 0; i < m_pool.threadCount(); i++) {
+		m_workers.push_back(std::make_unique<Worker>());
+	}
+}
+
+void ParallelDrawCollector::split(const ObjectStore& objects) {
+	m_units.clear();
+	for (auto& root : objects) {
+		m_units.push_back(WorkUnit{ &root, glm::mat4(1), true, 0, 0, 0 });
+	}
+
+	// Split every recursive unit with children into its own meshes followed by one unit per
+	// child, a level at a time, until there are enough units. This keeps the units in the
+	// same depth-first order a serial traversal would draw them in.
+	bool splittable = true;
+	while (m_units.size() < m_targetUnits && splittable) {
+		splittable = false;
+		m_splitScratch.clear();
+		for (auto& unit : m_units) {
+			if (!unit.recursive || unit.object->numberOfChildren() == 0) {
+				m_splitScratch.push_back(unit);
+				continue;
+			}
+			glm::mat4 model = unit.parentMatrix * unit.object->getModelMatrix();
+			m_splitScratch.push_back(WorkUnit{ unit.object, unit.parentMatrix, false, 0, 0, 0 });
+			for (size_t i = 0; i < unit.object->numberOfChildren(); i++) {
+				m_splitScratch.push_back(WorkUnit{ &unit.object->getChild(i), model, true, 0, 0, 0 });
+			}
+			splittable = true;
+		}
+		std::swap(m_units, m_splitScratch);
+	}
+}
+
+void ParallelDrawCollector::traverse(Worker& worker, const Object3D& object,
+	const glm::mat4& parentMatrix, bool recursive) {
+	glm::mat4 trueModel = parentMatrix * object.getModelMatrix();
+	for (auto& mesh : object.getMeshes()) {
+		worker.bucket.push_back(DrawItem{ &mesh, trueModel, mesh.sortKey() });
+	}
+	if (recursive) {
+		for (size_t i = 0; i < object.numberOfChildren(); i++) {
+			traverse(worker, object.getChild(i), trueModel, true);
+		}
+	}
+}
+
+void ParallelDrawCollector::collect(const ObjectStore& objects, std::vector<DrawItem>& draws) {
+	split(objects);
+
+	for (auto& worker : m_workers) {
+		worker->arena.reset();
+		worker->bucket.clear();
+	}
+	m_pool.run(m_units.size(), [this](size_t index, size_t worker) {
+		Worker& w = *m_workers[worker];
+		WorkUnit& unit = m_units[index];
+		unit.worker = static_cast<uint32_t>(worker);
+		unit.first = w.bucket.size();
+		traverse(w, *unit.object, unit.parentMatrix, unit.recursive);
+		unit.count = w.bucket.size() - unit.first;
+	});
+
+	// Merge the buckets in unit order, then group the draws by GL state. Sorting by state and
+	// then merged position keeps equal keys in hierarchy order, as a stable sort would,
+	// without the stable sort's heap buffer.
+	ArenaVector<DrawItem> merged;
+	for (auto& unit : m_units) {
+		const DrawItem* items = m_workers[unit.worker]->bucket.data() + unit.first;
+		merged.insert(merged.end(), items, items + unit.count);
+	}
+	ArenaVector<std::pair<uint64_t, uint32_t>> order(merged.size());
+	for (uint32_t i = 0; i < merged.size(); i++) {
+		order[i] = std::make_pair(merged[i].sortKey, i);
+	}
+	std::sort(order.begin(), order.end());
+	draws.resize(merged.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		draws[i] = merged[order[i].second];
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "FrameArena.h"
+#include "FramePacket.h"
+#include "ObjectStore.h"
+#include "WorkerPool.h"
+
+/**
+ * @brief Builds a frame's draw list by traversing the object hierarchy on several threads.
+ * The hierarchy is split into subtree work units, which worker threads claim one at a time and
+ * traverse into their own arena-allocated bucket. The buckets are then merged in work unit
+ * order and sorted by mesh state, so the result is identical for any number of threads.
+ */
+class ParallelDrawCollector {
+private:
+	/**
+	 * @brief A part of the hierarchy to traverse: either an object and all its descendants, or
+	 * only the object's own meshes, when its children were split into units of their own.
+	 */
+	struct WorkUnit {
+		const Object3D* object;
+		glm::mat4 parentMatrix;
+		bool recursive;
+		// Where the unit's draws were written: which worker's bucket, and the range in it.
+		uint32_t worker;
+		size_t first;
+		size_t count;
+	};
+
+	struct Worker {
+		FrameArena arena;
+		ArenaArray<DrawItem> bucket;
+
+		Worker() : bucket(arena) {}
+	};
+
+	WorkerPool m_pool;
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	size_t m_targetUnits;
+	std::vector<WorkUnit> m_units;
+	std::vector<WorkUnit> m_splitScratch;
+
+	void split(const ObjectStore& objects);
+	void traverse(Worker& worker, const Object3D& object, const glm::mat4& parentMatrix, bool recursive);
+
+public:
+	/**
+	 * @brief Starts the worker threads.
+	 * @param threadCount the number of threads traversing, including the one calling collect.
+	 * @param targetUnits roughly how many work units to split the hierarchy into. It does not
+	 * depend on the thread count, so neither does the order of the draws.
+	 */
+	explicit ParallelDrawCollector(size_t threadCount = std::thread::hardware_concurrency(),
+		size_t targetUnits = 256);
+	ParallelDrawCollector(const ParallelDrawCollector&) = delete;
+	ParallelDrawCollector& operator=(const ParallelDrawCollector&) = delete;
+
+	/**
+	 * @brief Replaces the contents of draws with a draw of every mesh of every object in the
+	 * store, sorted by Mesh3D::sortKey and, among equal keys, in hierarchy order.
+	 */
+	void collect(const ObjectStore& objects, std::vector<DrawItem>& draws);
+
+	size_t threadCount() const { return m_pool.threadCount(); }
+
+	/**
+	 * @brief The number of work units the last collect split the hierarchy into.
+	 */
+	size_t unitCount() const { return m_units.size(); }
+};
@@ -0,0 +1,118 @@
+#include "RenderThread.h"
+#include <sstream>
+#include <glad/glad.h>
+#include "FrameArena.h"
+#include "GLState.h"
+
+using FrameClock = std::chrono::steady_clock;
+
+static double millisecondsBetween(FrameClock::time_point start, FrameClock::time_point end) {
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+std::string RenderStats::describe() const {
+	std::ostringstream out;
+	out.precision(3);
+	out << frames << " frames (" << droppedFrames << " dropped): simulation " << simulationMs
+		<< " ms, render " << renderMs << " ms, frame " << frameMs << " ms, latency " << latencyMs
+		<< " ms, overlap " << overlap() << "x; " << glCallsIssued << " GL calls issued, "
+		<< glCallsElided << " elided per frame";
+	return out.str();
+}
+
+RenderThread::RenderThread(sf::RenderWindow& window, ShaderProgram& program, size_t bufferCount,
+	bool dropStale)
+	: m_window(window), m_program(program), m_mailbox(bufferCount, dropStale), m_nextFrame(0) {
+	// A context may only be current on one thread at a time.
+	m_window.setActive(false);
+	m_thread = std::thread(&RenderThread::run, this);
+}
+
+RenderThread::~RenderThread() {
+	stop();
+}
+
+void RenderThread::run() {
+	m_window.setActive(true);
+	bool first = true;
+	FrameClock::time_point lastSwap;
+	while (FramePacket* packet = m_mailbox.beginRead()) {
+		auto renderStart = FrameClock::now();
+		GLState& state = GLState::current();
+		state.resetCounts();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		m_program.activate();
+		m_program.setUniform("view", packet->view);
+		m_program.setUniform("projection", packet->projection);
+		for (auto& draw : packet->draws) {
+			m_program.setUniform("model", draw.model);
+			draw.mesh->render(m_program);
+		}
+		m_window.display();
+		auto swap = FrameClock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(m_statsMutex);
+			m_totals.frames++;
+			m_totals.simulationMs += millisecondsBetween(packet->simulationStart, packet->simulationEnd);
+			m_totals.renderMs += millisecondsBetween(renderStart, swap);
+			m_totals.latencyMs += millisecondsBetween(packet->simulationStart, swap);
+			m_totals.glCallsIssued += static_cast<double>(state.counts().totalIssued());
+			m_totals.glCallsElided += static_cast<double>(state.counts().totalElided());
+			// The first frame has no previous swap; count it as taking its own render time.
+			m_totals.frameMs += first ? millisecondsBetween(renderStart, swap) : millisecondsBetween(lastSwap, swap);
+		}
+		first = false;
+		lastSwap = swap;
+		m_mailbox.endRead(packet);
+		FrameArena::local().reset();
+	}
+	m_window.setActive(false);
+}
+
+FramePacket* RenderThread::beginFrame() {
+	FramePacket* packet = m_mailbox.beginWrite();
+	if (packet != nullptr) {
+		packet->simulationStart = FrameClock::now();
+	}
+	return packet;
+}
+
+void RenderThread::submitFrame(FramePacket* packet) {
+	packet->frameNumber = m_nextFrame++;
+	packet->simulationEnd = FrameClock::now();
+	m_mailbox.endWrite(packet);
+}
+
+void RenderThread::waitIdle() {
+	m_mailbox.waitIdle();
+}
+
+void RenderThread::stop() {
+	if (m_thread.joinable()) {
+		m_mailbox.close();
+		m_thread.join();
+		m_window.setActive(true);
+	}
+}
+
+RenderStats RenderThread::takeStats() {
+	RenderStats totals;
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		totals = m_totals;
+		m_totals = RenderStats();
+	}
+	RenderStats average;
+	average.frames = totals.frames;
+	average.droppedFrames = m_mailbox.droppedFrames();
+	if (totals.frames > 0) {
+		average.simulationMs = totals.simulationMs / totals.frames;
+		average.renderMs = totals.renderMs / totals.frames;
+		average.frameMs = totals.frameMs / totals.frames;
+		average.latencyMs = totals.latencyMs / totals.frames;
+		average.glCallsIssued = totals.glCallsIssued / totals.frames;
+		average.glCallsElided = totals.glCallsElided / totals.frames;
+	}
+	return average;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <mutex>
+#include <string>
+#include <thread>
+#include <SFML/Graphics.hpp>
+#include "FrameMailbox.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief Average timings of the frames drawn by a RenderThread, in milliseconds.
+ */
+struct RenderStats {
+	uint64_t frames = 0;
+	// Packets dropped since the render thread started.
+	uint64_t droppedFrames = 0;
+	// Time the simulation thread spent producing a packet.
+	double simulationMs = 0;
+	// Time the render thread spent submitting a packet, including the buffer swap.
+	double renderMs = 0;
+	// Time between consecutive buffer swaps.
+	double frameMs = 0;
+	// Time from the start of a packet's simulation to its buffer swap.
+	double latencyMs = 0;
+	// State-changing GL calls made, and skipped as redundant, per frame; see GLState.
+	double glCallsIssued = 0;
+	double glCallsElided = 0;
+
+	/**
+	 * @brief How much the two threads overlapped: (simulation + render) / frame time. 1 means
+	 * no overlap, as in the single-threaded loop; 2 means both threads were always busy.
+	 */
+	double overlap() const { return frameMs > 0 ? (simulationMs + renderMs) / frameMs : 0; }
+
+	std::string describe() const;
+};
+
+/**
+ * @brief A dedicated thread that owns the window's GL context and draws the FramePackets
+ * submitted by the simulation thread, so simulation and GL submission overlap.
+ * While the render thread runs, no other thread may issue GL calls, and objects referenced by
+ * in-flight packets may only be destroyed after waitIdle.
+ */
+class RenderThread {
+private:
+	sf::RenderWindow& m_window;
+	ShaderProgram& m_program;
+	FrameMailbox m_mailbox;
+	std::thread m_thread;
+	uint64_t m_nextFrame;
+
+	// Sums of the timings since the last takeStats.
+	std::mutex m_statsMutex;
+	RenderStats m_totals;
+
+	void run();
+
+public:
+	/**
+	 * @brief Deactivates the window's context on the calling thread and starts the render thread.
+	 * @param bufferCount the number of packets in flight: 2 for double, 3 for triple buffering.
+	 * @param dropStale whether to skip frames rather than make the simulation wait; see FrameMailbox.
+	 */
+	RenderThread(sf::RenderWindow& window, ShaderProgram& program, size_t bufferCount = 2,
+		bool dropStale = false);
+	~RenderThread();
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	/**
+	 * @brief Claims a packet to fill for the next frame. Returns nullptr once stopped.
+	 */
+	FramePacket* beginFrame();
+
+	/**
+	 * @brief Stamps the packet's frame number and simulation end time, and hands it to the
+	 * render thread.
+	 */
+	void submitFrame(FramePacket* packet);
+
+	/**
+	 * @brief Waits until every submitted packet has been drawn.
+	 */
+	void waitIdle();
+
+	/**
+	 * @brief Stops and joins the render thread, and reactivates the window's context on the
+	 * calling thread.
+	 */
+	void stop();
+
+	/**
+	 * @brief The average timings since the last call.
+	 */
+	RenderStats takeStats();
+};
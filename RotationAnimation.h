@@ -1,6 +1,7 @@
 #pragma once
 #include "Object3D.h"
 #include "Animation.h"
+#include "KeyframeTracks.h"
 /**
  * @brief Rotates an object at a continuous rate over an interval.
  */
@@ -14,8 +15,8 @@ private:
 	/**
 	 * @brief Advance the animation by the given time interval.
 	 */
-	void applyAnimation(float_t dt) override {
-		object().rotate(m_perSecond * dt);
+	void applyAnimation(Object3D& object, float_t dt) override {
+		object.rotate(m_perSecond * dt);
 	}
 
 public:
@@ -23,7 +24,14 @@ public:
 	 * @brief Constructs a animation of a constant rotation by the given total rotation 
 	 * angle, linearly interpolated across the given duration.
 	 */
-	RotationAnimation(Object3D& object, float_t duration, const glm::vec3& totalRotation) : 
+	RotationAnimation(ObjectHandle object, float_t duration, const glm::vec3& totalRotation) : 
 		Animation(object, duration), m_perSecond(totalRotation / duration) {}
+
+	bool hasTrack() const override { return true; }
+
+	bool appendTrack(KeyframeTracks& tracks, float_t delay) const override {
+		tracks.addRotation(object(), duration(), m_perSecond * duration(), delay);
+		return true;
+	}
 };
 
@@ -0,0 +1,468 @@
+#include "SceneFile.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <glm/gtc/type_ptr.hpp>
+
+static_assert(std::is_trivially_copyable_v<Vertex3D> && sizeof(Vertex3D) == 8 * sizeof(float),
+	"Vertex3D is stored in scene files as it is laid out in memory");
+
+const size_t SECTION_ALIGNMENT = 16;
+
+template <typename T>
+const T* SceneFile::section(const SceneFileSection& section) const {
+	if (section.count == 0) {
+		return nullptr;
+	}
+	if (section.offset % SECTION_ALIGNMENT != 0 || section.offset > m_file.size()
+		|| section.count > (m_file.size() - section.offset) / sizeof(T)) {
+		throw std::runtime_error("Scene file section is out of bounds");
+	}
+	return reinterpret_cast<const T*>(m_file.data() + section.offset);
+}
+
+void SceneFile::checkString(const SceneFileString& string) const {
+	if (static_cast<uint64_t>(string.offset) + string.length > m_header->strings.count) {
+		throw std::runtime_error("Scene file string is out of bounds");
+	}
+}
+
+/**
+ * @brief Whether a range of records lies within a section of the given length.
+ */
+static bool inRange(uint64_t first, uint64_t count, uint64_t length) {
+	return first <= length && count <= length - first;
+}
+
+SceneFile::SceneFile(const std::filesystem::path& path) : m_file(path) {
+	if (m_file.size() < sizeof(SceneFileHeader)) {
+		throw std::runtime_error(path.string() + " is not a scene file");
+	}
+	m_header = reinterpret_cast<const SceneFileHeader*>(m_file.data());
+	if (m_header->magic != SCENE_FILE_MAGIC) {
+		throw std::runtime_error(path.string() + " is not a scene file");
+	}
+	if (m_header->version != SCENE_FILE_VERSION) {
+		throw std::runtime_error(path.string() + " is scene file version " + std::to_string(m_header->version)
+			+ "; expected " + std::to_string(SCENE_FILE_VERSION));
+	}
+	m_nodes = section<SceneFileNode>(m_header->nodes);
+	m_meshes = section<SceneFileMesh>(m_header->meshes);
+	m_meshTextures = section<uint32_t>(m_header->meshTextures);
+	m_textures = section<SceneFileTexture>(m_header->textures);
+	m_vertices = section<Vertex3D>(m_header->vertices);
+	m_indices = section<uint32_t>(m_header->indices);
+	m_tracks = section<SceneFileTrack>(m_header->tracks);
+	m_channels = section<SceneFileChannel>(m_header->channels);
+	m_keyTimes = section<float>(m_header->keyTimes);
+	m_keyValues = section<glm::vec4>(m_header->keyValues);
+	m_strings = section<char>(m_header->strings);
+
+	// Check every reference once here, so nothing needs checking as the scene is instantiated.
+	checkString(m_header->shader);
+	for (size_t i = 0; i < m_header->textures.count; i++) {
+		checkString(m_textures[i].path);
+		checkString(m_textures[i].sampler);
+	}
+	for (size_t i = 0; i < m_header->meshTextures.count; i++) {
+		if (m_meshTextures[i] >= m_header->textures.count) {
+			throw std::runtime_error("Scene file mesh refers to a missing texture");
+		}
+	}
+	for (size_t i = 0; i < m_header->meshes.count; i++) {
+		const SceneFileMesh& mesh = m_meshes[i];
+		if (!inRange(mesh.firstVertex, mesh.vertexCount, m_header->vertices.count)
+			|| !inRange(mesh.firstIndex, mesh.indexCount, m_header->indices.count)
+			|| !inRange(mesh.firstTexture, mesh.textureCount, m_header->meshTextures.count)) {
+			throw std::runtime_error("Scene file mesh is out of bounds");
+		}
+	}
+
+	// Recover each node's parent from the depth-first order: the open nodes still expecting
+	// children, and how many each has been given so far.
+	std::vector<std::pair<uint32_t, uint32_t>> open;
+	m_parents.resize(m_header->nodes.count);
+	m_childIndices.resize(m_header->nodes.count);
+	for (uint32_t i = 0; i < m_header->nodes.count; i++) {
+		const SceneFileNode& node = m_nodes[i];
+		checkString(node.name);
+		if (!inRange(node.firstMesh, node.meshCount, m_header->meshes.count)) {
+			throw std::runtime_error("Scene file node refers to a missing mesh");
+		}
+		while (!open.empty() && open.back().second == m_nodes[open.back().first].childCount) {
+			open.pop_back();
+		}
+		m_parents[i] = open.empty() ? NO_PARENT : open.back().first;
+		m_childIndices[i] = open.empty() ? 0 : open.back().second++;
+		open.push_back({ i, 0 });
+	}
+	while (!open.empty() && open.back().second == m_nodes[open.back().first].childCount) {
+		open.pop_back();
+	}
+	if (!open.empty()) {
+		throw std::runtime_error("Scene file hierarchy is truncated");
+	}
+
+	if (m_header->keyValues.count != m_header->keyTimes.count) {
+		throw std::runtime_error("Scene file has mismatched key times and values");
+	}
+	for (size_t i = 0; i < m_header->channels.count; i++) {
+		const SceneFileChannel& channel = m_channels[i];
+		if (channel.channel >= static_cast<uint32_t>(TrackChannel::Count) || channel.keyCount == 0
+			|| !inRange(channel.firstKey, channel.keyCount, m_header->keyTimes.count)) {
+			throw std::runtime_error("Scene file channel is invalid");
+		}
+	}
+	for (size_t i = 0; i < m_header->tracks.count; i++) {
+		const SceneFileTrack& track = m_tracks[i];
+		if (track.node >= m_header->nodes.count
+			|| !inRange(track.firstChannel, track.channelCount, m_header->channels.count)) {
+			throw std::runtime_error("Scene file track is invalid");
+		}
+	}
+}
+
+std::string_view SceneFile::string(const SceneFileString& string) const {
+	return string.length == 0 ? std::string_view() : std::string_view(m_strings + string.offset, string.length);
+}
+
+void SceneFile::instantiate(ObjectStore& objects, KeyframeTracks& tracks) const {
+	SceneInstancer instancer(*this);
+	while (!instancer.step(objects, tracks)) {
+	}
+}
+
+/**
+ * @brief The GPU memory an image takes up as an RGBA texture, with a third again for its
+ * mipmaps.
+ */
+static uint64_t imageBytes(const sf::Image& image) {
+	return static_cast<uint64_t>(image.getSize().x) * image.getSize().y * 4 * 4 / 3;
+}
+
+SceneInstancer::SceneInstancer(const SceneFile& file)
+	: m_file(file), m_images(file.m_header->textures.count), m_textures(file.m_header->textures.count),
+	m_nextTexture(0), m_imageBytes(0), m_done(false) {
+}
+
+void SceneInstancer::prepare() {
+	for (size_t t = 0; t < m_images.size(); t++) {
+		std::string_view path = m_file.string(m_file.m_textures[t].path);
+		if (path.empty() || m_images[t].has_value()) {
+			continue;
+		}
+		sf::Image image;
+		if (!image.loadFromFile(std::string(path))) {
+			throw std::runtime_error("Failed to load image " + std::string(path));
+		}
+		m_imageBytes += imageBytes(image);
+		m_images[t] = std::move(image);
+	}
+
+	// Touch a byte of every page of the geometry, so the uploads do not fault them in.
+	const size_t PAGE_SIZE = 4096;
+	volatile uint8_t sink = 0;
+	auto touch = [&sink](const void* data, size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+			sink = sink + bytes[offset];
+		}
+	};
+	touch(m_file.m_vertices, m_file.m_header->vertices.count * sizeof(Vertex3D));
+	touch(m_file.m_indices, m_file.m_header->indices.count * sizeof(uint32_t));
+}
+
+bool SceneInstancer::step(ObjectStore& objects, KeyframeTracks& tracks) {
+	if (m_done) {
+		return true;
+	}
+	const SceneFileHeader& header = *m_file.m_header;
+
+	// Textures first, skipping those with no image file.
+	while (m_nextTexture < m_textures.size() && m_file.m_textures[m_nextTexture].path.length == 0) {
+		m_nextTexture++;
+	}
+	if (m_nextTexture < m_textures.size()) {
+		size_t t = m_nextTexture++;
+		std::string path(m_file.string(m_file.m_textures[t].path));
+		if (!m_images[t].has_value()) {
+			sf::Image image;
+			if (!image.loadFromFile(path)) {
+				throw std::runtime_error("Failed to load image " + path);
+			}
+			m_imageBytes += imageBytes(image);
+			m_images[t] = std::move(image);
+		}
+		m_textures[t] = Texture::loadImage(*m_images[t], std::string(m_file.string(m_file.m_textures[t].sampler)), path);
+		m_images[t].reset();
+		return false;
+	}
+
+	if (m_meshes.size() < header.meshes.count) {
+		const SceneFileMesh& mesh = m_file.m_meshes[m_meshes.size()];
+		std::vector<Texture> meshTextures;
+		for (uint32_t t = mesh.firstTexture; t < mesh.firstTexture + mesh.textureCount; t++) {
+			auto& texture = m_textures[m_file.m_meshTextures[t]];
+			if (texture.has_value()) {
+				meshTextures.push_back(*texture);
+			}
+		}
+		m_meshes.emplace_back(m_file.m_vertices + mesh.firstVertex, mesh.vertexCount,
+			m_file.m_indices + mesh.firstIndex, mesh.indexCount, std::move(meshTextures));
+		return false;
+	}
+
+	// Handles of the nodes tracks animate, resolved as they are needed.
+	std::vector<ObjectHandle> handles(header.nodes.count);
+	size_t index = 0;
+	while (index < header.nodes.count) {
+		size_t root = index;
+		Object3D object = buildObject(index);
+		handles[root] = objects.insert(std::move(object));
+		m_roots.push_back(handles[root]);
+	}
+
+	for (size_t i = 0; i < header.tracks.count; i++) {
+		const SceneFileTrack& track = m_file.m_tracks[i];
+		// Walk up to the nearest node with a handle, then back down through the store.
+		std::vector<uint32_t> path;
+		for (uint32_t node = track.node; handles[node].isNull(); node = m_file.m_parents[node]) {
+			path.push_back(node);
+		}
+		for (auto node = path.rbegin(); node != path.rend(); node++) {
+			handles[*node] = objects.child(handles[m_file.m_parents[*node]], m_file.m_childIndices[*node]);
+		}
+
+		uint32_t added = tracks.addTrack(handles[track.node], track.delay,
+			(track.flags & SCENE_TRACK_LOOPING) != 0, (track.flags & SCENE_TRACK_ADDITIVE) != 0);
+		for (uint32_t c = track.firstChannel; c < track.firstChannel + track.channelCount; c++) {
+			const SceneFileChannel& channel = m_file.m_channels[c];
+			const float* times = m_file.m_keyTimes + channel.firstKey;
+			const glm::vec4* values = m_file.m_keyValues + channel.firstKey;
+			tracks.setChannel(added, static_cast<TrackChannel>(channel.channel),
+				std::vector<float_t>(times, times + channel.keyCount),
+				std::vector<glm::vec4>(values, values + channel.keyCount));
+		}
+	}
+	m_done = true;
+	return true;
+}
+
+Object3D SceneInstancer::buildObject(size_t& index) const {
+	const SceneFileNode& node = m_file.m_nodes[index++];
+	std::vector<Mesh3D> meshes(m_meshes.begin() + node.firstMesh, m_meshes.begin() + node.firstMesh + node.meshCount);
+	Object3D object(std::move(meshes), glm::make_mat4(node.baseTransform));
+	object.setPosition(glm::make_vec3(node.position));
+	object.setOrientation(glm::make_vec3(node.orientation));
+	object.setRotation(glm::quat(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]));
+	object.setScale(glm::make_vec3(node.scale));
+	object.setCenter(glm::make_vec3(node.center));
+	object.setName(std::string(m_file.string(node.name)));
+	object.setStatic((node.flags & SCENE_NODE_STATIC) != 0);
+	for (uint32_t c = 0; c < node.childCount; c++) {
+		object.addChild(buildObject(index));
+	}
+	return object;
+}
+
+uint64_t SceneInstancer::gpuBytes() const {
+	const SceneFileHeader& header = *m_file.m_header;
+	return header.vertices.count * sizeof(Vertex3D) + header.indices.count * sizeof(uint32_t) + m_imageBytes;
+}
+
+void SceneInstancer::release() {
+	for (auto& mesh : m_meshes) {
+		mesh.release();
+	}
+	m_meshes.clear();
+	for (auto& texture : m_textures) {
+		if (texture.has_value()) {
+			GLState::current().deleteTexture(texture->textureId);
+			texture.reset();
+		}
+	}
+	m_roots.clear();
+	m_nextTexture = 0;
+	m_imageBytes = 0;
+	m_done = false;
+}
+
+/**
+ * @brief The records of a scene file as they are gathered, before they are written.
+ */
+struct SceneFileWriter {
+	std::vector<SceneFileNode> nodes;
+	std::vector<SceneFileMesh> meshes;
+	std::vector<uint32_t> meshTextures;
+	std::vector<SceneFileTexture> textures;
+	std::vector<Vertex3D> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<SceneFileTrack> tracks;
+	std::vector<SceneFileChannel> channels;
+	std::vector<float> keyTimes;
+	std::vector<glm::vec4> keyValues;
+	std::string strings;
+
+	std::unordered_map<std::string, SceneFileString> stringIndex;
+	// Textures by path and sampler name.
+	std::unordered_map<std::string, uint32_t> textureIndex;
+	// The node each object was written as.
+	std::unordered_map<const Object3D*, uint32_t> nodeIndex;
+	// The mesh record first written for each vertex array, whose geometry later copies of the
+	// mesh refer to rather than writing it again.
+	std::unordered_map<uint32_t, SceneFileMesh> geometryIndex;
+
+	SceneFileString addString(const std::string& string) {
+		auto found = stringIndex.find(string);
+		if (found != stringIndex.end()) {
+			return found->second;
+		}
+		SceneFileString added{ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(string.size()) };
+		strings += string;
+		stringIndex.emplace(string, added);
+		return added;
+	}
+
+	uint32_t addTexture(const Texture& texture) {
+		std::string key = texture.sourcePath + '\0' + texture.samplerName;
+		auto found = textureIndex.find(key);
+		if (found != textureIndex.end()) {
+			return found->second;
+		}
+		uint32_t added = static_cast<uint32_t>(textures.size());
+		textures.push_back({ addString(texture.sourcePath), addString(texture.samplerName) });
+		textureIndex.emplace(key, added);
+		return added;
+	}
+
+	void addObject(const Object3D& object) {
+		uint32_t index = static_cast<uint32_t>(nodes.size());
+		nodeIndex.emplace(&object, index);
+		SceneFileNode node{};
+		std::memcpy(node.position, glm::value_ptr(object.getPosition()), sizeof(node.position));
+		std::memcpy(node.orientation, glm::value_ptr(object.getOrientation()), sizeof(node.orientation));
+		const glm::quat& rotation = object.getRotation();
+		node.rotation[0] = rotation.x;
+		node.rotation[1] = rotation.y;
+		node.rotation[2] = rotation.z;
+		node.rotation[3] = rotation.w;
+		std::memcpy(node.scale, glm::value_ptr(object.getScale()), sizeof(node.scale));
+		std::memcpy(node.center, glm::value_ptr(object.getCenter()), sizeof(node.center));
+		std::memcpy(node.baseTransform, glm::value_ptr(object.getBaseTransform()), sizeof(node.baseTransform));
+		node.name = addString(object.getName());
+		node.firstMesh = static_cast<uint32_t>(meshes.size());
+		node.meshCount = static_cast<uint32_t>(object.getMeshes().size());
+		node.childCount = static_cast<uint32_t>(object.numberOfChildren());
+		node.flags = object.isStatic() ? SCENE_NODE_STATIC : 0;
+		nodes.push_back(node);
+
+		std::vector<Vertex3D> meshVertices;
+		std::vector<uint32_t> meshIndices;
+		for (auto& mesh : object.getMeshes()) {
+			SceneFileMesh record;
+			auto shared = geometryIndex.find(mesh.vertexArray());
+			if (shared != geometryIndex.end()) {
+				record = shared->second;
+			}
+			else {
+				mesh.readGeometry(meshVertices, meshIndices);
+				record = { vertices.size(), indices.size(), static_cast<uint32_t>(meshVertices.size()),
+					static_cast<uint32_t>(meshIndices.size()), 0, 0 };
+				vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+				indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+				geometryIndex.emplace(mesh.vertexArray(), record);
+			}
+			record.firstTexture = static_cast<uint32_t>(meshTextures.size());
+			record.textureCount = static_cast<uint32_t>(mesh.textures().size());
+			for (auto& texture : mesh.textures()) {
+				meshTextures.push_back(addTexture(texture));
+			}
+			meshes.push_back(record);
+		}
+		for (size_t c = 0; c < object.numberOfChildren(); c++) {
+			addObject(object.getChild(c));
+		}
+	}
+};
+
+/**
+ * @brief Places a section of records at the next aligned offset, and returns where it went.
+ */
+template <typename T>
+static SceneFileSection placeSection(uint64_t& offset, const T& records) {
+	offset = (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+	SceneFileSection placed{ offset, records.size() };
+	offset += records.size() * sizeof(records[0]);
+	return placed;
+}
+
+template <typename T>
+static void writeSection(std::ofstream& out, const SceneFileSection& section, const T& records) {
+	static const char padding[SECTION_ALIGNMENT] = {};
+	out.write(padding, section.offset - static_cast<uint64_t>(out.tellp()));
+	out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(records[0]));
+}
+
+void saveSceneFile(const std::filesystem::path& path, const std::string& shaderName,
+	ObjectStore& objects, const KeyframeTracks& tracks) {
+	SceneFileWriter writer;
+	for (size_t i = 0; i < objects.size(); i++) {
+		writer.addObject(objects.get(objects.handleAt(i)));
+	}
+	for (uint32_t i = 0; i < tracks.trackCount(); i++) {
+		KeyframeTrack track = tracks.track(i);
+		Object3D* target = objects.find(track.target);
+		auto node = target != nullptr ? writer.nodeIndex.find(target) : writer.nodeIndex.end();
+		if (node == writer.nodeIndex.end()) {
+			throw std::runtime_error("A track animates an object that is not in the scene");
+		}
+		writer.tracks.push_back({ node->second, track.delay,
+			(track.looping ? SCENE_TRACK_LOOPING : 0) | (track.additive ? SCENE_TRACK_ADDITIVE : 0),
+			static_cast<uint32_t>(writer.channels.size()), static_cast<uint32_t>(track.channels.size()) });
+		for (auto& channel : track.channels) {
+			writer.channels.push_back({ static_cast<uint32_t>(channel.channel),
+				static_cast<uint32_t>(writer.keyTimes.size()), static_cast<uint32_t>(channel.times.size()) });
+			writer.keyTimes.insert(writer.keyTimes.end(), channel.times.begin(), channel.times.end());
+			writer.keyValues.insert(writer.keyValues.end(), channel.values.begin(), channel.values.end());
+		}
+	}
+
+	SceneFileHeader header{};
+	header.magic = SCENE_FILE_MAGIC;
+	header.version = SCENE_FILE_VERSION;
+	header.shader = writer.addString(shaderName);
+	uint64_t offset = sizeof(SceneFileHeader);
+	header.nodes = placeSection(offset, writer.nodes);
+	header.meshes = placeSection(offset, writer.meshes);
+	header.meshTextures = placeSection(offset, writer.meshTextures);
+	header.textures = placeSection(offset, writer.textures);
+	header.vertices = placeSection(offset, writer.vertices);
+	header.indices = placeSection(offset, writer.indices);
+	header.tracks = placeSection(offset, writer.tracks);
+	header.channels = placeSection(offset, writer.channels);
+	header.keyTimes = placeSection(offset, writer.keyTimes);
+	header.keyValues = placeSection(offset, writer.keyValues);
+	header.strings = placeSection(offset, writer.strings);
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		throw std::runtime_error("Failed to open " + path.string() + " for writing");
+	}
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writeSection(out, header.nodes, writer.nodes);
+	writeSection(out, header.meshes, writer.meshes);
+	writeSection(out, header.meshTextures, writer.meshTextures);
+	writeSection(out, header.textures, writer.textures);
+	writeSection(out, header.vertices, writer.vertices);
+	writeSection(out, header.indices, writer.indices);
+	writeSection(out, header.tracks, writer.tracks);
+	writeSection(out, header.channels, writer.channels);
+	writeSection(out, header.keyTimes, writer.keyTimes);
+	writeSection(out, header.keyValues, writer.keyValues);
+	writeSection(out, header.strings, writer.strings);
+	if (!out) {
+		throw std::runtime_error("Failed to write " + path.string());
+	}
+}
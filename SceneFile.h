@@ -0,0 +1,249 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <glm/glm.hpp>
+#include "KeyframeTracks.h"
+#include "MappedFile.h"
+#include "Mesh3D.h"
+#include "ObjectStore.h"
+
+/**
+ * @brief 'SCNE', and the layout version of the records below.
+ */
+const uint32_t SCENE_FILE_MAGIC = 0x454E4353;
+const uint32_t SCENE_FILE_VERSION = 1;
+
+/**
+ * @brief A string in the file's string table.
+ */
+struct SceneFileString {
+	uint32_t offset;
+	uint32_t length;
+};
+
+/**
+ * @brief An array of records in the file: its byte offset, 16-byte aligned, and its length.
+ */
+struct SceneFileSection {
+	uint64_t offset;
+	uint64_t count;
+};
+
+/**
+ * @brief The start of a scene file, locating every section. All values are little-endian.
+ */
+struct SceneFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	// The name of the shader program the scene is drawn with, as main's scenes name them.
+	SceneFileString shader;
+	// SceneFileNode, SceneFileMesh, uint32_t (texture indices of meshes), SceneFileTexture.
+	SceneFileSection nodes;
+	SceneFileSection meshes;
+	SceneFileSection meshTextures;
+	SceneFileSection textures;
+	// Vertex3D and uint32_t, uploaded straight from the file.
+	SceneFileSection vertices;
+	SceneFileSection indices;
+	// SceneFileTrack, SceneFileChannel, float key times, and 4-float key values.
+	SceneFileSection tracks;
+	SceneFileSection channels;
+	SceneFileSection keyTimes;
+	SceneFileSection keyValues;
+	// The bytes of every string.
+	SceneFileSection strings;
+};
+
+/**
+ * @brief One Object3D. Nodes are stored depth first: each node is followed by its children's
+ * subtrees, in child order.
+ */
+struct SceneFileNode {
+	float position[3];
+	float orientation[3];
+	// x, y, z, w.
+	float rotation[4];
+	float scale[3];
+	float center[3];
+	// Column-major.
+	float baseTransform[16];
+	SceneFileString name;
+	uint32_t firstMesh;
+	uint32_t meshCount;
+	uint32_t childCount;
+	// SCENE_NODE_STATIC, or 0.
+	uint32_t flags;
+};
+
+const uint32_t SCENE_NODE_STATIC = 1;
+
+struct SceneFileMesh {
+	uint64_t firstVertex;
+	uint64_t firstIndex;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	// A range of the meshTextures section.
+	uint32_t firstTexture;
+	uint32_t textureCount;
+};
+
+/**
+ * @brief An image file, loaded once however many meshes use it. Textures whose image was not
+ * loaded from a file have an empty path, and are left out when the scene is loaded.
+ */
+struct SceneFileTexture {
+	SceneFileString path;
+	SceneFileString sampler;
+};
+
+/**
+ * @brief A KeyframeTracks track, and the node it animates.
+ */
+struct SceneFileTrack {
+	uint32_t node;
+	float delay;
+	// SCENE_TRACK_LOOPING and SCENE_TRACK_ADDITIVE.
+	uint32_t flags;
+	uint32_t firstChannel;
+	uint32_t channelCount;
+};
+
+const uint32_t SCENE_TRACK_LOOPING = 1;
+const uint32_t SCENE_TRACK_ADDITIVE = 2;
+
+struct SceneFileChannel {
+	// A TrackChannel.
+	uint32_t channel;
+	uint32_t firstKey;
+	uint32_t keyCount;
+};
+
+/**
+ * @brief A scene file mapped into memory. Scene files hold an Object3D hierarchy with its
+ * transforms, the geometry of every mesh and the image files of its textures, the shader the
+ * scene is drawn with, and its animations as keyframe tracks, in flat arrays of fixed-size
+ * records that refer to each other by index. Nothing is parsed or copied to read it: the
+ * records are used where they are mapped, and vertices and indices are uploaded to the GPU
+ * straight from the mapping.
+ * Skeletons are not stored; rigged meshes are saved in their bind pose.
+ */
+class SceneFile {
+private:
+	MappedFile m_file;
+	const SceneFileHeader* m_header;
+	const SceneFileNode* m_nodes;
+	const SceneFileMesh* m_meshes;
+	const uint32_t* m_meshTextures;
+	const SceneFileTexture* m_textures;
+	const Vertex3D* m_vertices;
+	const uint32_t* m_indices;
+	const SceneFileTrack* m_tracks;
+	const SceneFileChannel* m_channels;
+	const float* m_keyTimes;
+	const glm::vec4* m_keyValues;
+	const char* m_strings;
+	// Each node's parent, or NO_PARENT for roots, and its index among the parent's children.
+	std::vector<uint32_t> m_parents;
+	std::vector<uint32_t> m_childIndices;
+
+	static const uint32_t NO_PARENT = UINT32_MAX;
+
+	template <typename T>
+	const T* section(const SceneFileSection& section) const;
+	void checkString(const SceneFileString& string) const;
+
+	friend class SceneInstancer;
+
+public:
+	/**
+	 * @brief Maps a scene file and checks that every record refers only to records in the
+	 * file. Throws if it cannot be read, or is not a valid scene file.
+	 */
+	SceneFile(const std::filesystem::path& path);
+
+	std::string_view string(const SceneFileString& string) const;
+	std::string_view shaderName() const { return string(m_header->shader); }
+
+	size_t nodeCount() const { return m_header->nodes.count; }
+	const SceneFileNode* nodes() const { return m_nodes; }
+	size_t meshCount() const { return m_header->meshes.count; }
+	const SceneFileMesh* meshes() const { return m_meshes; }
+	size_t textureCount() const { return m_header->textures.count; }
+	const SceneFileTexture* textures() const { return m_textures; }
+	size_t trackCount() const { return m_header->tracks.count; }
+
+	/**
+	 * @brief Creates the scene's objects in the current GL context and inserts the root objects
+	 * into the store, then adds the scene's tracks, aimed at those objects. Throws if an image
+	 * fails to load.
+	 */
+	void instantiate(ObjectStore& objects, KeyframeTracks& tracks) const;
+};
+
+/**
+ * @brief Instantiates a scene file in steps of one GL upload each, so a load can be spread
+ * over frames: each texture, then each mesh, then all the objects and tracks at once, which
+ * needs no uploads. The file must outlive the instancer.
+ */
+class SceneInstancer {
+private:
+	const SceneFile& m_file;
+	// Images decoded ahead of their upload, by texture; released once uploaded.
+	std::vector<std::optional<sf::Image>> m_images;
+	std::vector<std::optional<Texture>> m_textures;
+	std::vector<Mesh3D> m_meshes;
+	std::vector<ObjectHandle> m_roots;
+	size_t m_nextTexture;
+	// The GPU memory of the images decoded so far.
+	uint64_t m_imageBytes;
+	bool m_done;
+
+	// Builds the node at the index and its subtree, advancing the index past them.
+	Object3D buildObject(size_t& index) const;
+
+public:
+	SceneInstancer(const SceneFile& file);
+
+	/**
+	 * @brief Decodes every image, and reads the mapped geometry through so it is paged in,
+	 * leaving only uploads for the steps. May run on any thread, before the first step.
+	 * Throws if an image fails to load.
+	 */
+	void prepare();
+
+	/**
+	 * @brief Makes the next upload, in the current GL context; the last step inserts the root
+	 * objects into the store and adds the tracks. Returns whether the scene is complete.
+	 * Images that were not prepared are loaded as they are needed.
+	 */
+	bool step(ObjectStore& objects, KeyframeTracks& tracks);
+
+	bool done() const { return m_done; }
+	const std::vector<ObjectHandle>& roots() const { return m_roots; }
+
+	/**
+	 * @brief The GPU memory the scene's geometry and the images decoded so far take up, in
+	 * bytes, counting mipmaps.
+	 */
+	uint64_t gpuBytes() const;
+
+	/**
+	 * @brief Deletes the meshes and textures the steps so far have created. The objects they
+	 * were given to must have been removed from their store.
+	 */
+	void release();
+};
+
+/**
+ * @brief Writes the objects of a store, and tracks animating them, to a scene file. Mesh
+ * geometry is read back from the GPU in the current GL context, once for all the copies of a
+ * mesh: their records share one range of vertices and indices. Loading uploads each record
+ * on its own, so copies are shared in the file but not on the GPU. Throws if the file cannot be
+ * written, or a track animates an object that is not in the store.
+ */
+void saveSceneFile(const std::filesystem::path& path, const std::string& shaderName,
+	ObjectStore& objects, const KeyframeTracks& tracks);
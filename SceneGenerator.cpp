@@ -0,0 +1,113 @@
+#include "SceneGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+Mesh3D generateGridMesh(size_t triangles, std::vector<Texture>&& textures) {
+	// A square grid of quads, two triangles each.
+	size_t cells = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(triangles / 2.0))));
+	std::vector<Vertex3D> vertices;
+	std::vector<uint32_t> faces;
+	vertices.reserve((cells + 1) * (cells + 1));
+	faces.reserve(cells * cells * 6);
+	for (size_t row = 0; row <= cells; row++) {
+		for (size_t column = 0; column <= cells; column++) {
+			float_t u = static_cast<float_t>(column) / cells;
+			float_t v = static_cast<float_t>(row) / cells;
+			float_t height = 0.05f * std::sin(u * 6.28f) * std::cos(v * 6.28f);
+			vertices.emplace_back(u - 0.5f, v - 0.5f, height, 0, 0, 1, u, 1 - v);
+		}
+	}
+	for (uint32_t row = 0; row < cells; row++) {
+		for (uint32_t column = 0; column < cells; column++) {
+			uint32_t topLeft = row * static_cast<uint32_t>(cells + 1) + column;
+			uint32_t bottomLeft = topLeft + static_cast<uint32_t>(cells + 1);
+			faces.insert(faces.end(), { topLeft, bottomLeft, topLeft + 1, topLeft + 1, bottomLeft, bottomLeft + 1 });
+		}
+	}
+	return Mesh3D(std::move(vertices), std::move(faces), std::move(textures));
+}
+
+/**
+ * @brief Builds an object with the given number of levels beneath it, stopping once the budget
+ * of objects is spent.
+ */
+static Object3D generateNode(const SyntheticSceneSettings& settings, const std::vector<Mesh3D>& meshes,
+	size_t levels, size_t& budget, std::mt19937& random, size_t& triangles) {
+	std::uniform_int_distribution<size_t> anyMesh(0, meshes.size() - 1);
+	std::vector<Mesh3D> nodeMeshes;
+	for (size_t m = 0; m < settings.meshesPerNode; m++) {
+		nodeMeshes.push_back(meshes[anyMesh(random)]);
+		triangles += nodeMeshes.back().indexCount() / 3;
+	}
+	Object3D node(std::move(nodeMeshes));
+	budget--;
+
+	std::uniform_real_distribution<float_t> offset(-1, 1);
+	for (size_t c = 0; c < settings.fanout && levels > 1 && budget > 0; c++) {
+		Object3D child = generateNode(settings, meshes, levels - 1, budget, random, triangles);
+		child.setPosition(glm::vec3(offset(random), offset(random), offset(random)));
+		child.setScale(glm::vec3(0.7f, 0.7f, 0.7f));
+		node.addChild(std::move(child));
+	}
+	return node;
+}
+
+/**
+ * @brief Adds a looping rotation track to a random share of the object and its descendants.
+ */
+static void animateNodes(SyntheticScene& scene, ObjectHandle handle, float_t fraction, std::mt19937& random) {
+	std::uniform_real_distribution<float_t> chance(0, 1);
+	if (chance(random) < fraction) {
+		float_t period = 2 + 8 * chance(random);
+		uint32_t track = scene.tracks.addTrack(handle, 0, true, true);
+		scene.tracks.setChannel(track, TrackChannel::Orientation, { 0, period },
+			{ glm::vec4(0, 0, 0, 0), glm::vec4(0, 6.28f, 0, 0) });
+		scene.animatedCount++;
+	}
+	size_t children = scene.objects.get(handle).numberOfChildren();
+	for (size_t c = 0; c < children; c++) {
+		animateNodes(scene, scene.objects.child(handle, c), fraction, random);
+	}
+}
+
+SyntheticScene generateScene(const SyntheticSceneSettings& settings) {
+	SyntheticScene scene;
+	std::mt19937 random(settings.seed);
+
+	// Small solid-color textures; their content does not matter, only their count.
+	for (size_t t = 0; t < std::max<size_t>(settings.uniqueTextures, 1); t++) {
+		std::vector<uint8_t> pixels(4 * 4 * 4);
+		for (size_t p = 0; p < pixels.size(); p += 4) {
+			pixels[p] = static_cast<uint8_t>(random());
+			pixels[p + 1] = static_cast<uint8_t>(random());
+			pixels[p + 2] = static_cast<uint8_t>(random());
+			pixels[p + 3] = 255;
+		}
+		sf::Image image;
+		image.create(4, 4, pixels.data());
+		scene.textures.push_back(Texture::loadImage(image, "baseTexture"));
+	}
+	std::vector<Mesh3D> meshes;
+	for (size_t m = 0; m < std::max<size_t>(settings.uniqueMeshes, 1); m++) {
+		meshes.push_back(generateGridMesh(settings.trianglesPerMesh,
+			{ scene.textures[m % scene.textures.size()] }));
+	}
+
+	// Hierarchies are generated until the object budget is spent, with their roots scattered
+	// through a box wider than the camera's view.
+	std::uniform_real_distribution<float_t> across(-40, 40);
+	std::uniform_real_distribution<float_t> deep(-60, -5);
+	size_t budget = settings.objectCount;
+	while (budget > 0) {
+		Object3D root = generateNode(settings, meshes, std::max<size_t>(settings.depth, 1), budget,
+			random, scene.triangleCount);
+		root.setPosition(glm::vec3(across(random), across(random) * 0.5f, deep(random)));
+		ObjectHandle handle = scene.objects.insert(std::move(root));
+		if (settings.animatedFraction > 0) {
+			animateNodes(scene, handle, settings.animatedFraction, random);
+		}
+	}
+	scene.objectCount = settings.objectCount;
+	return scene;
+}
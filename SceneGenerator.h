@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "KeyframeTracks.h"
+#include "ObjectStore.h"
+#include "Texture.h"
+
+/**
+ * @brief The parameters of a procedurally generated scene.
+ */
+struct SyntheticSceneSettings {
+	// The total number of objects, across every hierarchy.
+	size_t objectCount = 1000;
+	// The number of levels in each hierarchy, counting its root, and the children per object.
+	size_t depth = 3;
+	size_t fanout = 4;
+	size_t meshesPerNode = 1;
+	size_t trianglesPerMesh = 128;
+	// The number of distinct meshes (geometry and texture pairs) that objects draw.
+	size_t uniqueMeshes = 32;
+	size_t uniqueTextures = 8;
+	// The fraction of objects with a looping rotation track.
+	float_t animatedFraction = 0.1f;
+	uint32_t seed = 1;
+};
+
+/**
+ * @brief A generated scene: its objects, their animation tracks, and the GL resources they share.
+ */
+struct SyntheticScene {
+	ObjectStore objects;
+	KeyframeTracks tracks;
+	std::vector<Texture> textures;
+	size_t objectCount = 0;
+	size_t animatedCount = 0;
+	// Triangles drawn per frame if every object is visible.
+	size_t triangleCount = 0;
+};
+
+/**
+ * @brief Constructs a wavy grid mesh of at least the given number of triangles, in a unit
+ * square around the origin.
+ */
+Mesh3D generateGridMesh(size_t triangles, std::vector<Texture>&& textures);
+
+/**
+ * @brief Generates a scene of hierarchies of objects drawing generated meshes, scattered in
+ * front of and around a camera at the origin looking down -z. Objects are spread widely
+ * enough that a typical view culls a fair share of them. Requires a current GL context.
+ * The same settings always generate the same scene.
+ */
+SyntheticScene generateScene(const SyntheticSceneSettings& settings);
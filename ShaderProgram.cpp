@@ -1,4 +1,5 @@
 #include "ShaderProgram.h"
+#include "GLState.h"
 #include <glad/glad.h>
 #include <fstream>
 #include <sstream>
@@ -77,6 +78,8 @@ void ShaderProgram::load(const std::string& vertexShaderPath, const std::string&
     glAttachShader(m_programId, vertex);
     glAttachShader(m_programId, fragment);
     glLinkProgram(m_programId);
+    // GL may reuse the name of a deleted program; nothing cached about that one applies.
+    GLState::current().forgetProgram(m_programId);
     // print linking errors if any
     glGetProgramiv(m_programId, GL_LINK_STATUS, &success);
     if (!success)
@@ -88,54 +91,90 @@ void ShaderProgram::load(const std::string& vertexShaderPath, const std::string&
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    m_vertexShaderPath = vertexShaderPath;
 }
 
 void ShaderProgram::activate()
 {
-    glUseProgram(m_programId);
+    GLState::current().useProgram(m_programId);
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, bool value)
+template <typename T>
+int32_t ShaderProgram::changedLocation(std::string_view uniformName, const T& value)
 {
-    glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), (int32_t)value);
+    GLState& state = GLState::current();
+    int32_t location = state.uniformLocation(m_programId, uniformName);
+    return state.uniformChanged(m_programId, location, &value, sizeof(value)) ? location : -1;
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, int32_t value)
+void ShaderProgram::setUniform(std::string_view uniformName, bool value)
 {
-    glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), value);
+    int32_t location = changedLocation(uniformName, value);
+    if (location >= 0) {
+        glUniform1i(location, (int32_t)value);
+    }
+}
+
+void ShaderProgram::setUniform(std::string_view uniformName, int32_t value)
+{
+    int32_t location = changedLocation(uniformName, value);
+    if (location >= 0) {
+        glUniform1i(location, value);
+    }
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, float_t value)
+void ShaderProgram::setUniform(std::string_view uniformName, float_t value)
 {
-    glUniform1f(glGetUniformLocation(m_programId, uniformName.c_str()), (int)value);
+    int32_t location = changedLocation(uniformName, value);
+    if (location >= 0) {
+        glUniform1f(location, value);
+    }
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec2& value)
+void ShaderProgram::setUniform(std::string_view uniformName, const glm::vec2& value)
 {
-    glUniform2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    int32_t location = changedLocation(uniformName, value);
+    if (location >= 0) {
+        glUniform2fv(location, 1, &value[0]);
+    }
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec3& value)
+void ShaderProgram::setUniform(std::string_view uniformName, const glm::vec3& value)
 {
-    glUniform3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    int32_t location = changedLocation(uniformName, value);
+    if (location >= 0) {
+        glUniform3fv(location, 1, &value[0]);
+    }
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec4& value)
+void ShaderProgram::setUniform(std::string_view uniformName, const glm::vec4& value)
 {
-    glUniform4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    int32_t location = changedLocation(uniformName, value);
+    if (location >= 0) {
+        glUniform4fv(location, 1, &value[0]);
+    }
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat2& value)
+void ShaderProgram::setUniform(std::string_view uniformName, const glm::mat2& value)
 {
-    glUniformMatrix2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    int32_t location = changedLocation(uniformName, value);
+    if (location >= 0) {
+        glUniformMatrix2fv(location, 1, false, &value[0][0]);
+    }
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat3& value)
+void ShaderProgram::setUniform(std::string_view uniformName, const glm::mat3& value)
 {
-    glUniformMatrix3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    int32_t location = changedLocation(uniformName, value);
+    if (location >= 0) {
+        glUniformMatrix3fv(location, 1, false, &value[0][0]);
+    }
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat4& value)
+void ShaderProgram::setUniform(std::string_view uniformName, const glm::mat4& value)
 {
-    glUniformMatrix4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    int32_t location = changedLocation(uniformName, value);
+    if (location >= 0) {
+        glUniformMatrix4fv(location, 1, false, &value[0][0]);
+    }
 }
@@ -1,8 +1,15 @@
 #pragma once
 #include <glm/ext.hpp>
 #include <string>
+#include <string_view>
 class ShaderProgram {
 	uint32_t m_programId;
+	std::string m_vertexShaderPath;
+
+	// The location of a uniform of this program, or -1 if setting it to the value would not
+	// change it; see GLState. The program must be active.
+	template <typename T>
+	int32_t changedLocation(std::string_view uniformName, const T& value);
 
 public:
 	ShaderProgram();
@@ -10,13 +17,20 @@ public:
 
 	void activate();
 
-	void setUniform(const std::string& uniformName, bool value);
-	void setUniform(const std::string& uniformName, int32_t value);
-	void setUniform(const std::string& uniformName, float_t value);
-	void setUniform(const std::string& uniformName, const glm::vec2& value);
-	void setUniform(const std::string& uniformName, const glm::vec3& value);
-	void setUniform(const std::string& uniformName, const glm::vec4& value);
-	void setUniform(const std::string& uniformName, const glm::mat2& value);
-	void setUniform(const std::string& uniformName, const glm::mat3& value);
-	void setUniform(const std::string& uniformName, const glm::mat4& value);
+	/**
+	 * @brief The path the vertex shader was loaded from, so other passes can transform
+	 * vertices exactly as this program does.
+	 */
+	const std::string& vertexShaderPath() const { return m_vertexShaderPath; }
+
+	// Names are looked up without being copied, so setting a uniform allocates nothing.
+	void setUniform(std::string_view uniformName, bool value);
+	void setUniform(std::string_view uniformName, int32_t value);
+	void setUniform(std::string_view uniformName, float_t value);
+	void setUniform(std::string_view uniformName, const glm::vec2& value);
+	void setUniform(std::string_view uniformName, const glm::vec3& value);
+	void setUniform(std::string_view uniformName, const glm::vec4& value);
+	void setUniform(std::string_view uniformName, const glm::mat2& value);
+	void setUniform(std::string_view uniformName, const glm::mat3& value);
+	void setUniform(std::string_view uniformName, const glm::mat4& value);
 };
\ No newline at end of file
@@ -0,0 +1,336 @@
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <glad/glad.h>
+#include <glm/ext.hpp>
+#include "Frustum.h"
+#include "GLState.h"
+#include "Skeleton.h"
+
+using ShadowClock = std::chrono::steady_clock;
+
+std::string CascadeStats::describe() const {
+	std::ostringstream out;
+	out.precision(3);
+	out << "to " << splitFar << (cached ? " (cached)" : "") << ": " << renders << " redraws, every "
+		<< updateInterval << " frames; last drew " << castersDrawn << " of " << castersTested
+		<< " casters, " << triangles << " triangles, in " << cpuMs << " ms CPU, " << gpuMs << " ms GPU";
+	return out.str();
+}
+
+ShadowCascades::ShadowCascades(const ShadowSettings& settings)
+	: m_settings(settings), m_lightDirection(0, -1, 0), m_frame(0) {
+	m_settings.cascadeCount = std::clamp<uint32_t>(m_settings.cascadeCount, 1, MAX_SHADOW_CASCADES);
+	m_depthProgram.load("shaders/depth_only.vert", "shaders/depth_only.frag");
+
+	m_cascades.resize(m_settings.cascadeCount);
+	for (size_t i = 0; i < m_cascades.size(); i++) {
+		Cascade& cascade = m_cascades[i];
+		cascade.viewProjection = glm::mat4(1);
+		cascade.center = glm::vec3(0);
+		cascade.radius = 0;
+		cascade.valid = false;
+		cascade.queryPending = false;
+		cascade.stats.cached = i >= m_settings.firstCachedCascade;
+		glGenQueries(2, cascade.queries);
+	}
+
+	glGenTextures(1, &m_depthTexture);
+	GLState::current().bindTexture(GL_TEXTURE_2D_ARRAY, m_depthTexture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_settings.resolution,
+		m_settings.resolution, m_settings.cascadeCount, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+	// Hardware depth comparison with linear filtering gives 2x2 percentage-closer filtering.
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	// Anything outside a cascade's map is lit.
+	const float_t border[4] = { 1, 1, 1, 1 };
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+	GLState::current().bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	GLint previous;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+	if (!complete) {
+		throw std::runtime_error("Shadow map framebuffer is incomplete");
+	}
+}
+
+ShadowCascades::~ShadowCascades() {
+	for (auto& cascade : m_cascades) {
+		glDeleteQueries(2, cascade.queries);
+	}
+	glDeleteFramebuffers(1, &m_framebuffer);
+	GLState::current().deleteTexture(m_depthTexture);
+}
+
+/**
+ * @brief Appends the draws of an object and its children, recursively, to the static or dynamic
+ * list: an object is static if it or any ancestor is marked so. The palette versions of the
+ * skeletons of static objects are appended to staticPoses, as their casters deform with them.
+ */
+static void collectCasters(const Object3D& object, const glm::mat4& parentMatrix, bool parentStatic,
+	ArenaVector<DrawItem>& staticDraws, ArenaVector<DrawItem>& dynamicDraws,
+	ArenaVector<uint64_t>& staticPoses) {
+	bool isStatic = parentStatic || object.isStatic();
+	glm::mat4 trueModel = parentMatrix * object.getModelMatrix();
+	if (isStatic && object.getSkeleton() != nullptr) {
+		staticPoses.push_back(object.getSkeleton()->publishedVersion());
+	}
+	for (auto& mesh : object.getMeshes()) {
+		(isStatic ? staticDraws : dynamicDraws).push_back(DrawItem{ &mesh, trueModel, mesh.sortKey() });
+	}
+	for (size_t i = 0; i < object.numberOfChildren(); i++) {
+		collectCasters(object.getChild(i), trueModel, isStatic, staticDraws, dynamicDraws, staticPoses);
+	}
+}
+
+void ShadowCascades::setLightDirection(const glm::vec3& direction) {
+	glm::vec3 normalized = glm::normalize(direction);
+	if (glm::dot(normalized, m_lightDirection) < 0.99999f) {
+		m_lightDirection = normalized;
+		invalidateStatic();
+	}
+}
+
+void ShadowCascades::invalidateStatic() {
+	for (auto& cascade : m_cascades) {
+		cascade.valid = false;
+	}
+}
+
+glm::mat4 ShadowCascades::fitCascade(const glm::vec3& center, float_t radius) const {
+	glm::vec3 up = std::abs(m_lightDirection.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+	// Back the light off past the sphere, so casters between it and the light are drawn too.
+	float_t backOff = radius + m_settings.casterDistance;
+	glm::mat4 lightView = glm::lookAt(center - m_lightDirection * backOff, center, up);
+	glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, backOff + radius);
+
+	// Move the map by less than a texel so the world origin falls on a texel corner. The map's
+	// texels then stay put in the world as the sphere follows the camera.
+	float_t texelsPerUnit = m_settings.resolution / 2.0f;
+	glm::vec4 origin = lightProjection * lightView * glm::vec4(0, 0, 0, 1);
+	glm::vec2 scaled = glm::vec2(origin) * texelsPerUnit;
+	glm::vec2 offset = (glm::round(scaled) - scaled) / texelsPerUnit;
+	lightProjection[3][0] += offset.x;
+	lightProjection[3][1] += offset.y;
+	return lightProjection * lightView;
+}
+
+void ShadowCascades::renderCascade(size_t index, const ArenaVector<DrawItem>& staticDraws,
+	const ArenaVector<DrawItem>* dynamicDraws) {
+	auto start = ShadowClock::now();
+	Cascade& cascade = m_cascades[index];
+	CascadeStats& stats = cascade.stats;
+	Frustum frustum = Frustum::fromMatrix(cascade.viewProjection);
+
+	ArenaVector<DrawItem> visible;
+	stats.castersTested = 0;
+	auto cull = [&](const ArenaVector<DrawItem>& draws) {
+		for (auto& draw : draws) {
+			glm::vec3 center;
+			float_t radius;
+			transformSphere(draw.model, draw.mesh->boundsCenter(), draw.mesh->boundsRadius(), center, radius);
+			if (frustum.intersectsSphere(center, radius)) {
+				visible.push_back(draw);
+			}
+		}
+		stats.castersTested += draws.size();
+	};
+	cull(staticDraws);
+	if (dynamicDraws != nullptr) {
+		cull(*dynamicDraws);
+	}
+
+	glQueryCounter(cascade.queries[0], GL_TIMESTAMP);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0,
+		static_cast<GLint>(index));
+	glClear(GL_DEPTH_BUFFER_BIT);
+	m_depthProgram.setUniform("viewProjection", cascade.viewProjection);
+	stats.triangles = 0;
+	for (auto& draw : visible) {
+		m_depthProgram.setUniform("model", draw.model);
+		draw.mesh->renderDepth(m_depthProgram);
+		stats.triangles += draw.mesh->indexCount() / 3;
+	}
+	glQueryCounter(cascade.queries[1], GL_TIMESTAMP);
+	cascade.queryPending = true;
+
+	stats.castersDrawn = visible.size();
+	stats.rendered = true;
+	stats.renders++;
+	stats.cpuMs = std::chrono::duration<double, std::milli>(ShadowClock::now() - start).count();
+	cascade.valid = true;
+}
+
+void ShadowCascades::update(const glm::mat4& view, const glm::mat4& projection,
+	const ObjectStore& objects) {
+	m_frame++;
+	// Every caster, split by mobility.
+	ArenaVector<DrawItem> staticDraws;
+	ArenaVector<DrawItem> dynamicDraws;
+	ArenaVector<uint64_t> staticPoses;
+	for (auto& o : objects) {
+		collectCasters(o, glm::mat4(1), false, staticDraws, dynamicDraws, staticPoses);
+	}
+
+	// A static caster that moved, appeared, disappeared or was reposed since the last update
+	// invalidates the cached cascades.
+	auto sameCaster = [](const DrawItem& a, const DrawItem& b) {
+		return a.mesh == b.mesh && a.model == b.model;
+	};
+	if (!std::equal(staticDraws.begin(), staticDraws.end(), m_staticCasters.begin(), m_staticCasters.end(), sameCaster)
+		|| !std::equal(staticPoses.begin(), staticPoses.end(), m_staticPoses.begin(), m_staticPoses.end())) {
+		invalidateStatic();
+		m_staticCasters.assign(staticDraws.begin(), staticDraws.end());
+		m_staticPoses.assign(staticPoses.begin(), staticPoses.end());
+	}
+
+	// The redraws of earlier frames have usually finished by now; never wait for them.
+	for (auto& cascade : m_cascades) {
+		cascade.stats.rendered = false;
+		GLint available = 0;
+		if (cascade.queryPending) {
+			glGetQueryObjectiv(cascade.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		}
+		if (available) {
+			GLuint64 begin, end;
+			glGetQueryObjectui64v(cascade.queries[0], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(cascade.queries[1], GL_QUERY_RESULT, &end);
+			cascade.stats.gpuMs = (end - begin) / 1e6;
+			cascade.queryPending = false;
+		}
+	}
+
+	// The near and far planes of a perspective projection, and the view-space rays through
+	// the corners of the near plane, scaled to unit depth.
+	float_t nearPlane = projection[3][2] / (projection[2][2] - 1);
+	float_t farPlane = std::min(projection[3][2] / (projection[2][2] + 1), m_settings.maxDistance);
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	glm::mat4 inverseView = glm::inverse(view);
+	glm::vec3 rays[4];
+	for (int32_t corner = 0; corner < 4; corner++) {
+		glm::vec4 ndc(corner % 2 == 0 ? -1 : 1, corner / 2 == 0 ? -1 : 1, -1, 1);
+		glm::vec4 onNear = inverseProjection * ndc;
+		glm::vec3 point = glm::vec3(onNear) / onNear.w;
+		rays[corner] = point / -point.z;
+	}
+
+	GLint previousFramebuffer;
+	GLint previousViewport[4];
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_settings.resolution, m_settings.resolution);
+	glEnable(GL_DEPTH_TEST);
+	// Push depths away from the light, against self-shadowing "acne".
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2, 4);
+	m_depthProgram.activate();
+
+	float_t splitNear = nearPlane;
+	bool refittedCached = false;
+	for (size_t i = 0; i < m_cascades.size(); i++) {
+		Cascade& cascade = m_cascades[i];
+		CascadeStats& stats = cascade.stats;
+		float_t fraction = static_cast<float_t>(i + 1) / m_cascades.size();
+		float_t uniformSplit = nearPlane + (farPlane - nearPlane) * fraction;
+		float_t logSplit = nearPlane * std::pow(farPlane / nearPlane, fraction);
+		float_t splitFar = uniformSplit + (logSplit - uniformSplit) * m_settings.splitLambda;
+		stats.splitFar = splitFar;
+
+		// The slice's bounding sphere; its radius is rounded up so it stays the same size,
+		// and the map's texels the same size, as the camera turns.
+		glm::vec3 corners[8];
+		glm::vec3 center(0);
+		for (int32_t corner = 0; corner < 8; corner++) {
+			float_t depth = corner < 4 ? splitNear : splitFar;
+			corners[corner] = glm::vec3(inverseView * glm::vec4(rays[corner % 4] * depth, 1));
+			center += corners[corner] / 8.0f;
+		}
+		float_t radius = 0;
+		for (auto& corner : corners) {
+			radius = std::max(radius, glm::length(corner - center));
+		}
+		radius = std::ceil(radius * 16) / 16;
+		splitNear = splitFar;
+
+		// Cascades over their budget give up frames; cached ones also wait for another cached
+		// cascade refitted in the same frame, to spread out the cost of refitting.
+		bool allowed = m_frame % stats.updateInterval == 0;
+		bool redraw;
+		if (stats.cached) {
+			bool covered = cascade.valid && glm::length(center - cascade.center) + radius <= cascade.radius;
+			redraw = !covered && allowed && !refittedCached;
+			if (redraw) {
+				cascade.center = center;
+				cascade.radius = radius * m_settings.cacheMargin;
+				refittedCached = true;
+			}
+		}
+		else {
+			redraw = allowed;
+			cascade.center = center;
+			cascade.radius = radius;
+		}
+		if (!redraw) {
+			continue;
+		}
+		cascade.viewProjection = fitCascade(cascade.center, cascade.radius);
+		renderCascade(i, staticDraws, stats.cached ? nullptr : &dynamicDraws);
+
+		double cost = stats.cpuMs + stats.gpuMs;
+		float_t budget = m_settings.budgetMs[i];
+		if (cost > budget) {
+			stats.updateInterval = std::min<uint32_t>(stats.updateInterval * 2, 8);
+		}
+		else if (cost < budget / 2) {
+			stats.updateInterval = std::max<uint32_t>(stats.updateInterval / 2, 1);
+		}
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
+
+// Spelled out rather than built each frame.
+static const char* SHADOW_MATRIX_NAMES[MAX_SHADOW_CASCADES] = {
+	"shadowMatrices[0]", "shadowMatrices[1]", "shadowMatrices[2]", "shadowMatrices[3]"
+};
+
+void ShadowCascades::bind(ShaderProgram& program) const {
+	GLState::current().bindTexture(SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, m_depthTexture);
+
+	// Maps clip space [-1, 1] to the map's texture coordinates and depths, [0, 1].
+	glm::mat4 bias = glm::translate(glm::mat4(1), glm::vec3(0.5f)) * glm::scale(glm::mat4(1), glm::vec3(0.5f));
+	glm::vec4 splits(0);
+	for (size_t i = 0; i < m_cascades.size(); i++) {
+		program.setUniform(SHADOW_MATRIX_NAMES[i], bias * m_cascades[i].viewProjection);
+		splits[static_cast<int32_t>(i)] = m_cascades[i].stats.splitFar;
+	}
+	program.setUniform("shadowsEnabled", true);
+	program.setUniform("shadowMap", SHADOW_TEXTURE_UNIT);
+	program.setUniform("cascadeCount", static_cast<int32_t>(m_cascades.size()));
+	program.setUniform("cascadeFar", splits);
+}
+
+std::vector<CascadeStats> ShadowCascades::stats() const {
+	std::vector<CascadeStats> stats;
+	for (auto& cascade : m_cascades) {
+		stats.push_back(cascade.stats);
+	}
+	return stats;
+}
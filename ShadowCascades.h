@@ -0,0 +1,144 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "FrameArena.h"
+#include "FramePacket.h"
+#include "ObjectStore.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief The texture unit the shadow map array is bound to, below the clustered lighting's.
+ */
+const int32_t SHADOW_TEXTURE_UNIT = 11;
+
+/**
+ * @brief The most cascades a ShadowCascades can have; the shaders declare arrays of this size.
+ */
+const uint32_t MAX_SHADOW_CASCADES = 4;
+
+/**
+ * @brief How a ShadowCascades splits the view and spends its time.
+ */
+struct ShadowSettings {
+	uint32_t cascadeCount = 4;
+	// The width and height of each cascade's depth map.
+	uint32_t resolution = 1024;
+	// Shadows end this far from the camera, or at the far plane if it is nearer.
+	float_t maxDistance = 60;
+	// Blends split distances from uniform (0) to logarithmic (1).
+	float_t splitLambda = 0.75f;
+	// Cascades from this one on hold only static casters, and are cached between frames.
+	uint32_t firstCachedCascade = 2;
+	// Cached cascades cover this much more than their slice, so the camera can move within
+	// them before they must be refitted.
+	float_t cacheMargin = 1.5f;
+	// How far behind a cascade, towards the light, casters are still drawn.
+	float_t casterDistance = 50;
+	// The time each cascade may take per update, CPU and GPU, in milliseconds. A cascade that
+	// runs over is updated less often; see CascadeStats::updateInterval.
+	float_t budgetMs[MAX_SHADOW_CASCADES] = { 1, 1, 2, 2 };
+};
+
+/**
+ * @brief The state and cost of one cascade in the last ShadowCascades::update.
+ */
+struct CascadeStats {
+	// The view-space depth where the cascade ends.
+	float_t splitFar = 0;
+	bool cached = false;
+	// Whether the cascade was redrawn this frame, and how many times since it was created.
+	bool rendered = false;
+	size_t renders = 0;
+	// The cascade is redrawn at most every this many frames.
+	uint32_t updateInterval = 1;
+	size_t castersTested = 0;
+	size_t castersDrawn = 0;
+	size_t triangles = 0;
+	// The CPU time of the last redraw, and its GPU time once the GPU reports it.
+	double cpuMs = 0;
+	double gpuMs = 0;
+
+	std::string describe() const;
+};
+
+/**
+ * @brief Directional light shadows with cascaded shadow maps. The camera frustum, up to a
+ * maximum distance, is split into depth slices; each slice gets an orthographic depth map
+ * from the light, fitted to the slice's bounding sphere and snapped to whole texels so
+ * shadows do not shimmer as the camera moves. Casters are culled per cascade against the
+ * light's frustum and drawn with a depth-only shader, posed as they are when shaded.
+ * Near cascades are redrawn every frame with all casters. Far cascades hold only static
+ * objects (Object3D::setStatic, on the object or any ancestor), and are redrawn only when the
+ * light direction or static content changes, or the camera leaves the region they cover.
+ * Static content is compared each update, so moving, adding or removing a static object is
+ * noticed without invalidateStatic.
+ */
+class ShadowCascades {
+private:
+	struct Cascade {
+		glm::mat4 viewProjection;
+		// The world-space sphere the depth map covers.
+		glm::vec3 center;
+		float_t radius;
+		bool valid;
+		// GPU timestamps of the last redraw, and whether they are still to be read.
+		uint32_t queries[2];
+		bool queryPending;
+		CascadeStats stats;
+	};
+
+	ShadowSettings m_settings;
+	std::vector<Cascade> m_cascades;
+	uint32_t m_depthTexture;
+	uint32_t m_framebuffer;
+	ShaderProgram m_depthProgram;
+
+	glm::vec3 m_lightDirection;
+	uint64_t m_frame;
+	// The static casters the cached cascades were last checked against, and the palette
+	// versions of the skeletons posing them; any difference redraws the cached cascades.
+	std::vector<DrawItem> m_staticCasters;
+	std::vector<uint64_t> m_staticPoses;
+
+	glm::mat4 fitCascade(const glm::vec3& center, float_t radius) const;
+	// Draws the casters in a cascade: the static ones, and the dynamic ones unless null.
+	void renderCascade(size_t index, const ArenaVector<DrawItem>& staticDraws,
+		const ArenaVector<DrawItem>* dynamicDraws);
+
+public:
+	/**
+	 * @brief Creates the depth maps and loads the depth shader, in the current context. Throws
+	 * if the shader fails to load or the framebuffer is incomplete.
+	 */
+	ShadowCascades(const ShadowSettings& settings = {});
+	~ShadowCascades();
+	ShadowCascades(const ShadowCascades&) = delete;
+	ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+	/**
+	 * @brief Sets the direction the light travels in. Cached cascades are redrawn if it changed.
+	 */
+	void setLightDirection(const glm::vec3& direction);
+
+	/**
+	 * @brief Marks the static casters as changed, so cached cascades are redrawn. Changes to
+	 * objects and their poses are detected by update; this is for changes it cannot see, such
+	 * as a mesh's vertices being rewritten.
+	 */
+	void invalidateStatic();
+
+	/**
+	 * @brief Fits the cascades to a perspective camera and redraws the ones that need it,
+	 * restoring the framebuffer and viewport bound before the call.
+	 */
+	void update(const glm::mat4& view, const glm::mat4& projection, const ObjectStore& objects);
+
+	/**
+	 * @brief Binds the depth maps and sets the program's shadow uniforms. The program must be
+	 * active.
+	 */
+	void bind(ShaderProgram& program) const;
+
+	std::vector<CascadeStats> stats() const;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <cmath>
+#include <glm/glm.hpp>
+
+// SSE2 is always available on x64, and MSVC reports it through _M_X64 rather than __SSE2__.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+static_assert(sizeof(float_t) == sizeof(float), "SSE paths require float_t to be float");
+#endif
+
+/**
+ * @brief Computes out = a * b for column-major 4x4 matrices. out may alias a or b.
+ */
+inline void multiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#ifdef SIMD_SSE
+	const float* pa = &a[0][0];
+	const float* pb = &b[0][0];
+	float* po = &out[0][0];
+	__m128 a0 = _mm_loadu_ps(pa);
+	__m128 a1 = _mm_loadu_ps(pa + 4);
+	__m128 a2 = _mm_loadu_ps(pa + 8);
+	__m128 a3 = _mm_loadu_ps(pa + 12);
+	// Each column of the result is a combination of a's columns, weighted by a column of b.
+	for (int j = 0; j < 4; j++) {
+		const float* column = pb + 4 * j;
+		__m128 result = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(column[0])), _mm_mul_ps(a1, _mm_set1_ps(column[1]))),
+			_mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(column[2])), _mm_mul_ps(a3, _mm_set1_ps(column[3]))));
+		_mm_storeu_ps(po + 4 * j, result);
+	}
+#else
+	out = a * b;
+#endif
+}
@@ -0,0 +1,485 @@
+#include "Skeleton.h"
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <glad/glad.h>
+#include "GLState.h"
+#include "SimdMath.h"
+
+/**
+ * @brief Converts Assimp's row-major matrix to glm's column-major layout.
+ */
+static glm::mat4 toGlm(const aiMatrix4x4& m) {
+	glm::mat4 result;
+	for (auto i = 0; i < 4; i++) {
+		for (auto j = 0; j < 4; j++) {
+			result[i][j] = m[j][i];
+		}
+	}
+	return result;
+}
+
+void SkeletalClip::ChannelSet::addChannel(uint32_t nodeIndex, const std::vector<float_t>& times,
+	const std::vector<glm::vec4>& values) {
+	if (times.empty() || times.size() != values.size()) {
+		throw std::runtime_error("Skeletal channel needs one value per key time");
+	}
+	uint32_t first = static_cast<uint32_t>(keyTimes.size());
+	keyTimes.insert(keyTimes.end(), times.begin(), times.end());
+	keyValues.resize(keyTimes.size());
+	for (size_t i = 0; i < values.size(); i++) {
+		keyValues.set(first + i, values[i]);
+	}
+	node.push_back(nodeIndex);
+	firstKey.push_back(first);
+	keyCount.push_back(static_cast<uint32_t>(times.size()));
+}
+
+void SkeletalClip::ChannelSet::clear() {
+	*this = ChannelSet();
+}
+
+Skeleton::Skeleton()
+	: m_activeClip(-1), m_time(0), m_looping(true), m_skinningMode(SkinningMode::Gpu),
+	m_publishedVersion(0), m_paletteBuffer(0), m_paletteTexture(0), m_paletteUploaded(false) {
+}
+
+Skeleton::~Skeleton() {
+	if (m_paletteTexture != 0) {
+		GLState::current().deleteTexture(m_paletteTexture);
+	}
+	if (m_paletteBuffer != 0) {
+		glDeleteBuffers(1, &m_paletteBuffer);
+	}
+}
+
+/**
+ * @brief Adds the given node and its descendants to the skeleton, parents first.
+ */
+static void addAssimpNodes(Skeleton& skeleton, const aiNode* node, int32_t parent) {
+	aiVector3D scale, position;
+	aiQuaternion rotation;
+	node->mTransformation.Decompose(scale, rotation, position);
+	uint32_t index = skeleton.addNode(node->mName.C_Str(), parent,
+		glm::vec3(position.x, position.y, position.z),
+		glm::quat(rotation.w, rotation.x, rotation.y, rotation.z),
+		glm::vec3(scale.x, scale.y, scale.z));
+	for (auto i = 0; i < node->mNumChildren; i++) {
+		addAssimpNodes(skeleton, node->mChildren[i], static_cast<int32_t>(index));
+	}
+}
+
+std::shared_ptr<Skeleton> Skeleton::fromAssimp(const aiScene* scene) {
+	auto skeleton = std::make_shared<Skeleton>();
+	addAssimpNodes(*skeleton, scene->mRootNode, -1);
+
+	for (auto a = 0; a < scene->mNumAnimations; a++) {
+		const aiAnimation* animation = scene->mAnimations[a];
+		// Assimp keys are in "ticks"; files that don't say how long a tick is assume 25 per second.
+		double ticksPerSecond = animation->mTicksPerSecond != 0 ? animation->mTicksPerSecond : 25.0;
+
+		SkeletalClip clip;
+		clip.name = animation->mName.C_Str();
+		clip.duration = static_cast<float_t>(animation->mDuration / ticksPerSecond);
+
+		for (auto c = 0; c < animation->mNumChannels; c++) {
+			const aiNodeAnim* channel = animation->mChannels[c];
+			int32_t node = skeleton->nodeIndex(channel->mNodeName.C_Str());
+			if (node < 0) {
+				continue;
+			}
+
+			std::vector<float_t> times;
+			std::vector<glm::vec4> values;
+			for (auto k = 0; k < channel->mNumPositionKeys; k++) {
+				auto& key = channel->mPositionKeys[k];
+				times.push_back(static_cast<float_t>(key.mTime / ticksPerSecond));
+				values.emplace_back(key.mValue.x, key.mValue.y, key.mValue.z, 0);
+			}
+			if (!times.empty()) {
+				clip.translations.addChannel(node, times, values);
+			}
+
+			times.clear();
+			values.clear();
+			for (auto k = 0; k < channel->mNumRotationKeys; k++) {
+				auto& key = channel->mRotationKeys[k];
+				times.push_back(static_cast<float_t>(key.mTime / ticksPerSecond));
+				values.emplace_back(key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w);
+			}
+			if (!times.empty()) {
+				clip.rotations.addChannel(node, times, values);
+			}
+
+			times.clear();
+			values.clear();
+			for (auto k = 0; k < channel->mNumScalingKeys; k++) {
+				auto& key = channel->mScalingKeys[k];
+				times.push_back(static_cast<float_t>(key.mTime / ticksPerSecond));
+				values.emplace_back(key.mValue.x, key.mValue.y, key.mValue.z, 0);
+			}
+			if (!times.empty()) {
+				clip.scales.addChannel(node, times, values);
+			}
+		}
+		skeleton->addClip(std::move(clip));
+	}
+
+	skeleton->evaluate();
+	return skeleton;
+}
+
+uint32_t Skeleton::addNode(const std::string& name, int32_t parent, const glm::vec3& position,
+	const glm::quat& rotation, const glm::vec3& scale) {
+	uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	if (parent >= static_cast<int32_t>(index)) {
+		throw std::runtime_error("Skeleton nodes must be added after their parents");
+	}
+	m_nodes.push_back(SkeletonNode{ name, parent, position, rotation, scale });
+	// Assimp node names are not guaranteed unique; the first node with a name wins.
+	m_nodeIndices.insert(std::make_pair(name, index));
+	return index;
+}
+
+uint32_t Skeleton::addSkin(uint32_t meshNode, std::vector<uint32_t>&& boneNodes,
+	std::vector<glm::mat4>&& offsets) {
+	if (boneNodes.size() != offsets.size()) {
+		throw std::runtime_error("Skin needs one offset matrix per bone");
+	}
+	uint32_t offset = static_cast<uint32_t>(m_palette.size());
+	m_palette.resize(m_palette.size() + boneNodes.size(), glm::mat4(1));
+	m_skins.push_back(SkinBinding{ meshNode, std::move(boneNodes), std::move(offsets), offset });
+	m_paletteUploaded = false;
+	return static_cast<uint32_t>(m_skins.size() - 1);
+}
+
+uint32_t Skeleton::addSkin(const aiMesh* mesh, const aiNode* meshNode,
+	std::vector<VertexBoneData>& influences) {
+	int32_t attachedTo = nodeIndex(meshNode->mName.C_Str());
+	if (attachedTo < 0) {
+		throw std::runtime_error("Skinned mesh is attached to a node outside the skeleton");
+	}
+
+	std::vector<uint32_t> boneNodes;
+	std::vector<glm::mat4> offsets;
+	influences.assign(mesh->mNumVertices, VertexBoneData());
+	for (auto b = 0; b < mesh->mNumBones; b++) {
+		const aiBone* bone = mesh->mBones[b];
+		int32_t node = nodeIndex(bone->mName.C_Str());
+		if (node < 0) {
+			throw std::runtime_error(std::string("Bone has no skeleton node: ") + bone->mName.C_Str());
+		}
+		boneNodes.push_back(node);
+		offsets.push_back(toGlm(bone->mOffsetMatrix));
+		for (auto w = 0; w < bone->mNumWeights; w++) {
+			influences[bone->mWeights[w].mVertexId].add(b, bone->mWeights[w].mWeight);
+		}
+	}
+	for (auto& influence : influences) {
+		influence.normalize();
+	}
+
+	uint32_t skin = addSkin(attachedTo, std::move(boneNodes), std::move(offsets));
+	evaluate();
+	return skin;
+}
+
+uint32_t Skeleton::addClip(SkeletalClip&& clip) {
+	m_clips.emplace_back(std::move(clip));
+	return static_cast<uint32_t>(m_clips.size() - 1);
+}
+
+std::vector<ClipCompressionReport> Skeleton::compressClips(const ClipCompressionSettings& settings) {
+	std::vector<ClipCompressionReport> reports;
+	for (auto& clip : m_clips) {
+		if (clip.compressed != nullptr) {
+			continue;
+		}
+		ClipCompressionReport report;
+		clip.compressed = std::make_shared<CompressedClip>(CompressedClip::compress(clip, settings, report));
+		clip.translations.clear();
+		clip.rotations.clear();
+		clip.scales.clear();
+		reports.push_back(report);
+	}
+	evaluate();
+	return reports;
+}
+
+void Skeleton::saveCompressedClips(std::ostream& out) const {
+	uint32_t count = static_cast<uint32_t>(m_clips.size());
+	out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	for (auto& clip : m_clips) {
+		if (clip.compressed == nullptr) {
+			throw std::runtime_error("Clip " + clip.name + " is not compressed");
+		}
+		clip.compressed->save(out);
+	}
+}
+
+std::vector<ClipCompressionReport> Skeleton::loadCompressedClips(std::istream& in) {
+	uint32_t count = 0;
+	in.read(reinterpret_cast<char*>(&count), sizeof(count));
+	if (!in || count != m_clips.size()) {
+		throw std::runtime_error("Compressed clips are for a skeleton with other clips");
+	}
+	// Every clip is read and measured before any is replaced.
+	std::vector<std::shared_ptr<CompressedClip>> loaded;
+	std::vector<ClipCompressionReport> reports;
+	for (auto& clip : m_clips) {
+		if (clip.compressed != nullptr) {
+			throw std::runtime_error("Clip " + clip.name + " is already compressed");
+		}
+		auto compressed = std::make_shared<CompressedClip>(CompressedClip::load(in, m_nodes.size()));
+		if (compressed->name() != clip.name || compressed->duration() != clip.duration) {
+			throw std::runtime_error("Compressed clip " + compressed->name() + " is not clip " + clip.name);
+		}
+		reports.push_back(compressed->measure(clip));
+		loaded.push_back(std::move(compressed));
+	}
+	for (size_t i = 0; i < m_clips.size(); i++) {
+		m_clips[i].compressed = std::move(loaded[i]);
+		m_clips[i].translations.clear();
+		m_clips[i].rotations.clear();
+		m_clips[i].scales.clear();
+	}
+	evaluate();
+	return reports;
+}
+
+int32_t Skeleton::nodeIndex(const std::string& name) const {
+	auto existing = m_nodeIndices.find(name);
+	return existing != m_nodeIndices.end() ? static_cast<int32_t>(existing->second) : -1;
+}
+
+void Skeleton::play(uint32_t clip, bool looping) {
+	if (clip >= m_clips.size()) {
+		throw std::runtime_error("Skeleton has no clip with that index");
+	}
+	m_activeClip = static_cast<int32_t>(clip);
+	m_looping = looping;
+	m_time = 0;
+	evaluate();
+}
+
+void Skeleton::tick(float_t dt) {
+	if (m_activeClip < 0) {
+		return;
+	}
+	float_t duration = m_clips[m_activeClip].duration;
+	float_t time = m_time + dt;
+	if (m_looping && duration > 0) {
+		time = std::fmod(time, duration);
+	}
+	else {
+		time = std::min(time, duration);
+	}
+	if (time == m_time) {
+		return;
+	}
+	m_time = time;
+	evaluate();
+}
+
+void Skeleton::resetPose() {
+	size_t count = m_nodes.size();
+	m_translations.resize(count);
+	m_rotations.resize(count);
+	m_scales.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		const SkeletonNode& node = m_nodes[i];
+		m_translations.set(i, glm::vec4(node.bindPosition, 0));
+		m_rotations.set(i, glm::vec4(node.bindRotation.x, node.bindRotation.y, node.bindRotation.z,
+			node.bindRotation.w));
+		m_scales.set(i, glm::vec4(node.bindScale, 0));
+	}
+}
+
+void Skeleton::gatherChannels(const SkeletalClip::ChannelSet& channels, bool quaternion) {
+	size_t count = channels.node.size();
+	m_from.resize(count);
+	m_to.resize(count);
+	m_alpha.resize(count);
+
+	// Find the two keys bracketing the current time in each channel.
+	for (size_t c = 0; c < count; c++) {
+		size_t first = channels.firstKey[c];
+		size_t keys = channels.keyCount[c];
+		auto begin = channels.keyTimes.begin() + first;
+		// The number of keys at or before the current time; clamps to the first and last key.
+		size_t after = std::upper_bound(begin, begin + keys, m_time) - begin;
+		size_t a = first + (after == 0 ? 0 : after - 1);
+		size_t b = first + std::min(after, keys - 1);
+		float_t ta = channels.keyTimes[a];
+		float_t tb = channels.keyTimes[b];
+
+		glm::vec4 from = channels.keyValues.get(a);
+		glm::vec4 to = channels.keyValues.get(b);
+		if (quaternion && glm::dot(from, to) < 0) {
+			to = -1.0f * to;
+		}
+		m_from.set(c, from);
+		m_to.set(c, to);
+		m_alpha[c] = tb > ta ? std::clamp((m_time - ta) / (tb - ta), 0.0f, 1.0f) : 0;
+	}
+}
+
+void Skeleton::blendChannels(const std::vector<uint32_t>& nodes, bool quaternion, Vec4Lanes& pose) {
+	if (nodes.empty()) {
+		return;
+	}
+	lerpLanes(m_from, m_to, m_alpha, m_sampled);
+	if (quaternion) {
+		normalizeLanes(m_sampled);
+	}
+	for (size_t c = 0; c < nodes.size(); c++) {
+		pose.set(nodes[c], m_sampled.get(c));
+	}
+}
+
+void Skeleton::evaluate() {
+	resetPose();
+	if (m_activeClip >= 0) {
+		const SkeletalClip& clip = m_clips[m_activeClip];
+		if (clip.compressed != nullptr) {
+			// Compressed clips decode only the keys bracketing the current time.
+			const CompressedClip& compressed = *clip.compressed;
+			compressed.gather(TrackChannel::Translation, m_time, m_from, m_to, m_alpha);
+			blendChannels(compressed.nodes(TrackChannel::Translation), false, m_translations);
+			compressed.gather(TrackChannel::Rotation, m_time, m_from, m_to, m_alpha);
+			blendChannels(compressed.nodes(TrackChannel::Rotation), true, m_rotations);
+			compressed.gather(TrackChannel::Scale, m_time, m_from, m_to, m_alpha);
+			blendChannels(compressed.nodes(TrackChannel::Scale), false, m_scales);
+		}
+		else {
+			gatherChannels(clip.translations, false);
+			blendChannels(clip.translations.node, false, m_translations);
+			gatherChannels(clip.rotations, true);
+			blendChannels(clip.rotations.node, true, m_rotations);
+			gatherChannels(clip.scales, false);
+			blendChannels(clip.scales.node, false, m_scales);
+		}
+	}
+
+	// Compose the hierarchy; parents always precede their children.
+	m_globals.resize(m_nodes.size());
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		glm::quat rotation(m_rotations.w[i], m_rotations.x[i], m_rotations.y[i], m_rotations.z[i]);
+		glm::mat4 local = glm::translate(glm::mat4(1), glm::vec3(m_translations.get(i)));
+		multiplyMatrices(local, glm::mat4_cast(rotation), local);
+		local = glm::scale(local, glm::vec3(m_scales.get(i)));
+
+		int32_t parent = m_nodes[i].parent;
+		if (parent >= 0) {
+			multiplyMatrices(m_globals[parent], local, m_globals[i]);
+		}
+		else {
+			m_globals[i] = local;
+		}
+	}
+
+	// Each bone matrix takes a bind-pose vertex in mesh space into the bone's space, then
+	// out through the bone's current pose, and back into the (possibly moved) mesh's space.
+	for (auto& skin : m_skins) {
+		glm::mat4 meshInverse = glm::inverse(m_globals[skin.meshNode]);
+		for (size_t b = 0; b < skin.boneNodes.size(); b++) {
+			glm::mat4& bone = m_palette[skin.paletteOffset + b];
+			multiplyMatrices(m_globals[skin.boneNodes[b]], skin.offsets[b], bone);
+			multiplyMatrices(meshInverse, bone, bone);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_publishMutex);
+	m_publishedPalette = m_palette;
+	m_publishedVersion++;
+	m_paletteUploaded = false;
+}
+
+const glm::mat4* Skeleton::palette(uint32_t skin) const {
+	return m_palette.data() + m_skins[skin].paletteOffset;
+}
+
+void Skeleton::bindPalette(ShaderProgram& program, uint32_t skin) {
+	if (m_paletteBuffer == 0) {
+		glGenBuffers(1, &m_paletteBuffer);
+		glGenTextures(1, &m_paletteTexture);
+		glBindBuffer(GL_TEXTURE_BUFFER, m_paletteBuffer);
+		GLState::current().bindTexture(GL_TEXTURE_BUFFER, m_paletteTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_paletteBuffer);
+	}
+
+	// The palette of every skin is uploaded together, once per pose change.
+	{
+		std::lock_guard<std::mutex> lock(m_publishMutex);
+		if (!m_paletteUploaded) {
+			glBindBuffer(GL_TEXTURE_BUFFER, m_paletteBuffer);
+			glBufferData(GL_TEXTURE_BUFFER, m_publishedPalette.size() * sizeof(glm::mat4),
+				m_publishedPalette.data(), GL_STREAM_DRAW);
+			m_paletteUploaded = true;
+		}
+	}
+
+	GLState::current().bindTexture(BONE_PALETTE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_paletteTexture);
+	program.setUniform("bonePalette", BONE_PALETTE_TEXTURE_UNIT);
+	program.setUniform("paletteOffset", static_cast<int32_t>(m_skins[skin].paletteOffset));
+}
+
+uint64_t Skeleton::publishedVersion() const {
+	std::lock_guard<std::mutex> lock(m_publishMutex);
+	return m_publishedVersion;
+}
+
+uint64_t Skeleton::skinVertices(uint32_t skin, const Vertex3D* bindVertices,
+	const VertexBoneData* influences, size_t count, Vertex3D* out) const {
+	std::lock_guard<std::mutex> lock(m_publishMutex);
+	const glm::mat4* bones = m_publishedPalette.data() + m_skins[skin].paletteOffset;
+	for (size_t v = 0; v < count; v++) {
+		const Vertex3D& in = bindVertices[v];
+		const VertexBoneData& influence = influences[v];
+		float position[4];
+		float normal[4];
+#ifdef SIMD_SSE
+		// Blend the influencing bone matrices column by column.
+		__m128 columns[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+		for (size_t i = 0; i < 4; i++) {
+			if (influence.weights[i] == 0) {
+				continue;
+			}
+			const float* bone = &bones[influence.ids[i]][0][0];
+			__m128 weight = _mm_set1_ps(influence.weights[i]);
+			for (size_t c = 0; c < 4; c++) {
+				columns[c] = _mm_add_ps(columns[c], _mm_mul_ps(weight, _mm_loadu_ps(bone + 4 * c)));
+			}
+		}
+		__m128 p = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(in.x)), _mm_mul_ps(columns[1], _mm_set1_ps(in.y))),
+			_mm_add_ps(_mm_mul_ps(columns[2], _mm_set1_ps(in.z)), columns[3]));
+		__m128 n = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(in.nx)), _mm_mul_ps(columns[1], _mm_set1_ps(in.ny))),
+			_mm_mul_ps(columns[2], _mm_set1_ps(in.nz)));
+		_mm_storeu_ps(position, p);
+		_mm_storeu_ps(normal, n);
+#else
+		glm::mat4 blended(0);
+		for (size_t i = 0; i < 4; i++) {
+			if (influence.weights[i] != 0) {
+				blended = blended + bones[influence.ids[i]] * influence.weights[i];
+			}
+		}
+		glm::vec4 p = blended * glm::vec4(in.x, in.y, in.z, 1);
+		glm::vec4 n = blended * glm::vec4(in.nx, in.ny, in.nz, 0);
+		for (size_t i = 0; i < 4; i++) {
+			position[i] = p[i];
+			normal[i] = n[i];
+		}
+#endif
+		// Assumes bones don't scale non-uniformly, so the normal needs no inverse-transpose.
+		float_t length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float_t inverse = length > 0 ? 1.0f / length : 0;
+		out[v] = Vertex3D(position[0], position[1], position[2],
+			normal[0] * inverse, normal[1] * inverse, normal[2] * inverse, in.u, in.v);
+	}
+	return m_publishedVersion;
+}
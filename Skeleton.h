@@ -0,0 +1,248 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/gtc/quaternion.hpp>
+#include <assimp/scene.h>
+#include "ClipCompression.h"
+#include "KeyframeTracks.h"
+#include "Mesh3D.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief The texture unit the bone palette buffer texture is bound to, chosen above any unit
+ * used by a mesh's own textures.
+ */
+const int32_t BONE_PALETTE_TEXTURE_UNIT = 15;
+
+/**
+ * @brief Whether skinned meshes are deformed in the vertex shader, or on the CPU and
+ * re-uploaded each frame (slow, but useful for validating the GPU path under software GL).
+ */
+enum class SkinningMode {
+	Gpu,
+	Cpu
+};
+
+/**
+ * @brief A node of a skeleton hierarchy, which may or may not be a bone.
+ */
+struct SkeletonNode {
+	std::string name;
+	// The index of the parent node, which always precedes this node; or -1 for the root.
+	int32_t parent;
+	// The node's local transform when no animation channel drives it.
+	glm::vec3 bindPosition;
+	glm::quat bindRotation;
+	glm::vec3 bindScale;
+};
+
+/**
+ * @brief The bones deforming one mesh: for each bone index used by the mesh's vertices, the
+ * skeleton node it follows and the matrix taking mesh space to that bone's bind space.
+ */
+struct SkinBinding {
+	// The node the mesh is attached to; palettes are expressed in its space.
+	uint32_t meshNode;
+	std::vector<uint32_t> boneNodes;
+	std::vector<glm::mat4> offsets;
+	// Where this skin's matrices begin in the skeleton's combined palette.
+	uint32_t paletteOffset;
+};
+
+/**
+ * @brief An animation clip of a skeleton. Each channel animates one component of one node;
+ * channels of each component are stored in structure-of-arrays form, with their keys in
+ * contiguous ranges of a shared pool.
+ */
+struct SkeletalClip {
+	struct ChannelSet {
+		std::vector<uint32_t> node;
+		std::vector<uint32_t> firstKey;
+		std::vector<uint32_t> keyCount;
+		std::vector<float_t> keyTimes;
+		Vec4Lanes keyValues;
+
+		/**
+		 * @brief Appends a channel for the given node. Times must be ascending, in seconds.
+		 */
+		void addChannel(uint32_t nodeIndex, const std::vector<float_t>& times,
+			const std::vector<glm::vec4>& values);
+
+		void clear();
+	};
+
+	std::string name;
+	// Length of the clip, in seconds.
+	float_t duration;
+	// Translations and scales are (x, y, z, 0); rotations are quaternions (x, y, z, w).
+	ChannelSet translations;
+	ChannelSet rotations;
+	ChannelSet scales;
+	// If set, the clip has been compressed: the channel sets above are empty, and the clip is
+	// sampled from this instead.
+	std::shared_ptr<CompressedClip> compressed;
+};
+
+/**
+ * @brief The skeleton of an imported model, its animation clips, and its current animated
+ * pose. Each tick samples the active clip with batched SIMD interpolation, composes the node
+ * hierarchy, and computes one bone palette per skinned mesh.
+ */
+class Skeleton {
+private:
+	std::vector<SkeletonNode> m_nodes;
+	std::unordered_map<std::string, uint32_t> m_nodeIndices;
+	std::vector<SkinBinding> m_skins;
+	std::vector<SkeletalClip> m_clips;
+
+	int32_t m_activeClip;
+	float_t m_time;
+	bool m_looping;
+	SkinningMode m_skinningMode;
+
+	// The current local pose of every node, in structure-of-arrays form.
+	Vec4Lanes m_translations;
+	Vec4Lanes m_rotations;
+	Vec4Lanes m_scales;
+	// The current node->skeleton root transform of every node.
+	std::vector<glm::mat4> m_globals;
+	// Every skin's bone matrices, concatenated in skin order.
+	std::vector<glm::mat4> m_palette;
+	// The last palette published by evaluate, for rendering. It is double-buffered with
+	// m_palette so a render thread can upload it while the next pose is being evaluated.
+	std::vector<glm::mat4> m_publishedPalette;
+	// Counts the palettes evaluate has published, so CPU-skinned meshes re-skin once per pose.
+	uint64_t m_publishedVersion;
+	mutable std::mutex m_publishMutex;
+
+	// Sampling scratch space, reused across ticks.
+	Vec4Lanes m_from;
+	Vec4Lanes m_to;
+	std::vector<float_t> m_alpha;
+	Vec4Lanes m_sampled;
+
+	// The GL buffer and buffer texture exposing m_publishedPalette to the vertex shader.
+	uint32_t m_paletteBuffer;
+	uint32_t m_paletteTexture;
+	bool m_paletteUploaded;
+
+	void resetPose();
+	void gatherChannels(const SkeletalClip::ChannelSet& channels, bool quaternion);
+	void blendChannels(const std::vector<uint32_t>& nodes, bool quaternion, Vec4Lanes& pose);
+
+public:
+	Skeleton();
+	~Skeleton();
+	Skeleton(const Skeleton&) = delete;
+	Skeleton& operator=(const Skeleton&) = delete;
+
+	/**
+	 * @brief Builds a skeleton from every node of an Assimp scene, and imports its animations.
+	 * Skins are added as meshes are imported, with addSkin.
+	 */
+	static std::shared_ptr<Skeleton> fromAssimp(const aiScene* scene);
+
+	/**
+	 * @brief Appends a node, whose parent must already be in the skeleton (or -1).
+	 */
+	uint32_t addNode(const std::string& name, int32_t parent, const glm::vec3& position,
+		const glm::quat& rotation, const glm::vec3& scale);
+
+	/**
+	 * @brief Appends a skin and returns its index.
+	 */
+	uint32_t addSkin(uint32_t meshNode, std::vector<uint32_t>&& boneNodes,
+		std::vector<glm::mat4>&& offsets);
+
+	/**
+	 * @brief Appends a skin for an Assimp mesh attached to the given node, and fills in the
+	 * mesh's per-vertex bone influences.
+	 */
+	uint32_t addSkin(const aiMesh* mesh, const aiNode* meshNode,
+		std::vector<VertexBoneData>& influences);
+
+	/**
+	 * @brief Appends an animation clip and returns its index.
+	 */
+	uint32_t addClip(SkeletalClip&& clip);
+
+	/**
+	 * @brief Compresses every clip that is not already compressed, releasing its raw keys.
+	 * @return a report of the savings and error of each newly compressed clip.
+	 */
+	std::vector<ClipCompressionReport> compressClips(const ClipCompressionSettings& settings = {});
+
+	/**
+	 * @brief Writes every clip's compressed form to a binary stream, so a later import can load
+	 * them instead of compressing them again. Throws std::runtime_error if a clip is not
+	 * compressed.
+	 */
+	void saveCompressedClips(std::ostream& out) const;
+
+	/**
+	 * @brief Replaces every clip with its compressed form, read from a stream written by
+	 * saveCompressedClips, and releases its raw keys. Each compressed clip is measured against
+	 * the raw clip it replaces, so it must have the same name and duration and animate the same
+	 * nodes. Throws std::runtime_error, leaving the clips as they were, if the stream does not
+	 * match the skeleton or a clip is already compressed.
+	 * @return a report of the savings and error of each clip.
+	 */
+	std::vector<ClipCompressionReport> loadCompressedClips(std::istream& in);
+
+	/**
+	 * @brief The index of the node with the given name, or -1 if there is none.
+	 */
+	int32_t nodeIndex(const std::string& name) const;
+
+	size_t nodeCount() const { return m_nodes.size(); }
+	size_t boneCount() const { return m_palette.size(); }
+	const std::vector<SkeletalClip>& clips() const { return m_clips; }
+
+	SkinningMode skinningMode() const { return m_skinningMode; }
+	void setSkinningMode(SkinningMode mode) { m_skinningMode = mode; }
+
+	/**
+	 * @brief Starts playing the clip with the given index from its beginning.
+	 */
+	void play(uint32_t clip, bool looping = true);
+
+	/**
+	 * @brief Advances the active clip by the given interval, in seconds, and recomputes the
+	 * pose and bone palettes. Does nothing if no clip is playing, or the clip's time did not
+	 * change, as when a clip that does not loop has finished.
+	 */
+	void tick(float_t dt);
+
+	/**
+	 * @brief Recomputes the pose and bone palettes at the active clip's current time.
+	 */
+	void evaluate();
+
+	/**
+	 * @brief The bone matrices of the given skin, taking bind-pose mesh-space positions to
+	 * posed mesh-space positions. Only safe to call from the thread that ticks the skeleton.
+	 */
+	const glm::mat4* palette(uint32_t skin) const;
+
+	/**
+	 * @brief Uploads the published palette if it changed since the last upload, binds it to
+	 * BONE_PALETTE_TEXTURE_UNIT, and points the program's skinning uniforms at the given skin.
+	 */
+	void bindPalette(ShaderProgram& program, uint32_t skin);
+
+	/**
+	 * @brief Deforms bind-pose vertices by the given skin's published palette, on the CPU.
+	 * @return the version of the palette used, as publishedVersion gives it.
+	 */
+	uint64_t skinVertices(uint32_t skin, const Vertex3D* bindVertices,
+		const VertexBoneData* influences, size_t count, Vertex3D* out) const;
+
+	/**
+	 * @brief The version of the published palette, which changes whenever evaluate publishes a
+	 * new one.
+	 */
+	uint64_t publishedVersion() const;
+};
@@ -0,0 +1,469 @@
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+BoundingBox hierarchyBounds(const Object3D& object, const glm::mat4& parentMatrix) {
+	float_t inf = std::numeric_limits<float_t>::infinity();
+	BoundingBox bounds{ glm::vec3(inf), glm::vec3(-inf) };
+	glm::mat4 model = parentMatrix * object.getModelMatrix();
+	for (auto& mesh : object.getMeshes()) {
+		glm::vec3 center;
+		float_t radius;
+		transformSphere(model, mesh.boundsCenter(), mesh.boundsRadius(), center, radius);
+		bounds.low = glm::min(bounds.low, center - glm::vec3(radius));
+		bounds.high = glm::max(bounds.high, center + glm::vec3(radius));
+	}
+	for (size_t i = 0; i < object.numberOfChildren(); i++) {
+		BoundingBox child = hierarchyBounds(object.getChild(i), model);
+		bounds.low = glm::min(bounds.low, child.low);
+		bounds.high = glm::max(bounds.high, child.high);
+	}
+	return bounds;
+}
+
+/**
+ * @brief The box around a sphere, bounding the cells a sphere query visits.
+ */
+static BoundingBox sphereBox(const glm::vec3& center, float_t radius) {
+	return BoundingBox{ center - glm::vec3(radius), center + glm::vec3(radius) };
+}
+
+const uint32_t COORDINATE_BITS = 20;
+
+LooseOctree::LooseOctree(const glm::vec3& low, float_t size, uint32_t maxDepth)
+	: m_low(low), m_size(size), m_maxDepth(std::min(maxDepth, COORDINATE_BITS)), m_count(0) {
+}
+
+uint64_t LooseOctree::nodeKey(uint32_t depth, uint32_t x, uint32_t y, uint32_t z) {
+	return (static_cast<uint64_t>(depth) << (3 * COORDINATE_BITS)) | (static_cast<uint64_t>(x) << (2 * COORDINATE_BITS))
+		| (static_cast<uint64_t>(y) << COORDINATE_BITS) | z;
+}
+
+uint64_t LooseOctree::nodeFor(const BoundingBox& bounds) const {
+	glm::vec3 extent = bounds.high - bounds.low;
+	float_t largest = std::max(extent.x, std::max(extent.y, extent.z));
+	// The deepest level whose cells are at least as large as the box.
+	uint32_t depth = largest > 0
+		? static_cast<uint32_t>(std::clamp(std::floor(std::log2(m_size / largest)), 0.0f, static_cast<float_t>(m_maxDepth)))
+		: m_maxDepth;
+	glm::vec3 cell = (bounds.low + bounds.high) * 0.5f - m_low;
+	float_t cellSize = m_size / static_cast<float_t>(1u << depth);
+	float_t cells = static_cast<float_t>(1u << depth);
+	glm::vec3 index = glm::floor(cell / cellSize);
+	if (depth == 0 || index.x < 0 || index.y < 0 || index.z < 0 || index.x >= cells || index.y >= cells
+		|| index.z >= cells || !(largest >= 0)) {
+		// Outside the octree, or not a box.
+		return nodeKey(0, 0, 0, 0);
+	}
+	return nodeKey(depth, static_cast<uint32_t>(index.x), static_cast<uint32_t>(index.y),
+		static_cast<uint32_t>(index.z));
+}
+
+BoundingBox LooseOctree::looseBounds(uint64_t key) const {
+	uint32_t mask = (1u << COORDINATE_BITS) - 1;
+	uint32_t depth = static_cast<uint32_t>(key >> (3 * COORDINATE_BITS));
+	glm::vec3 index(static_cast<float_t>((key >> (2 * COORDINATE_BITS)) & mask),
+		static_cast<float_t>((key >> COORDINATE_BITS) & mask), static_cast<float_t>(key & mask));
+	float_t cellSize = m_size / static_cast<float_t>(1u << depth);
+	glm::vec3 low = m_low + index * cellSize;
+	return BoundingBox{ low - glm::vec3(cellSize * 0.5f), low + glm::vec3(cellSize * 1.5f) };
+}
+
+void LooseOctree::link(uint32_t item, uint64_t key) {
+	Node& node = m_nodes[key];
+	m_items[item].node = key;
+	m_items[item].slot = static_cast<uint32_t>(node.items.size());
+	node.items.push_back(item);
+
+	// Count the box in every ancestor, creating any that are missing.
+	uint32_t mask = (1u << COORDINATE_BITS) - 1;
+	uint32_t depth = static_cast<uint32_t>(key >> (3 * COORDINATE_BITS));
+	uint32_t x = (key >> (2 * COORDINATE_BITS)) & mask, y = (key >> COORDINATE_BITS) & mask, z = key & mask;
+	node.subtreeCount++;
+	while (depth > 0) {
+		uint8_t child = static_cast<uint8_t>((x & 1) | ((y & 1) << 1) | ((z & 1) << 2));
+		depth--;
+		x >>= 1;
+		y >>= 1;
+		z >>= 1;
+		Node& parent = m_nodes[nodeKey(depth, x, y, z)];
+		parent.childMask |= 1 << child;
+		parent.subtreeCount++;
+	}
+}
+
+void LooseOctree::unlink(uint32_t item) {
+	uint64_t key = m_items[item].node;
+	Node& node = m_nodes[key];
+	uint32_t slot = m_items[item].slot;
+	node.items[slot] = node.items.back();
+	m_items[node.items[slot]].slot = slot;
+	node.items.pop_back();
+	m_items[item].node = NO_NODE;
+
+	// Uncount the box in every ancestor, deleting nodes left empty.
+	uint32_t mask = (1u << COORDINATE_BITS) - 1;
+	uint32_t depth = static_cast<uint32_t>(key >> (3 * COORDINATE_BITS));
+	uint32_t x = (key >> (2 * COORDINATE_BITS)) & mask, y = (key >> COORDINATE_BITS) & mask, z = key & mask;
+	bool emptied = --node.subtreeCount == 0;
+	if (emptied && depth > 0) {
+		m_nodes.erase(key);
+	}
+	while (depth > 0) {
+		uint8_t child = static_cast<uint8_t>((x & 1) | ((y & 1) << 1) | ((z & 1) << 2));
+		depth--;
+		x >>= 1;
+		y >>= 1;
+		z >>= 1;
+		uint64_t parentKey = nodeKey(depth, x, y, z);
+		Node& parent = m_nodes[parentKey];
+		if (emptied) {
+			parent.childMask &= ~(1 << child);
+		}
+		emptied = --parent.subtreeCount == 0;
+		if (emptied && depth > 0) {
+			m_nodes.erase(parentKey);
+		}
+	}
+}
+
+uint32_t LooseOctree::insert(const BoundingBox& bounds, uint32_t value) {
+	uint32_t id;
+	if (!m_freeItems.empty()) {
+		id = m_freeItems.back();
+		m_freeItems.pop_back();
+	}
+	else {
+		id = static_cast<uint32_t>(m_items.size());
+		m_items.push_back({});
+	}
+	m_items[id].bounds = bounds;
+	m_items[id].value = value;
+	link(id, nodeFor(bounds));
+	m_count++;
+	return id;
+}
+
+void LooseOctree::update(uint32_t id, const BoundingBox& bounds) {
+	m_items[id].bounds = bounds;
+	uint64_t key = nodeFor(bounds);
+	if (key != m_items[id].node) {
+		unlink(id);
+		link(id, key);
+	}
+}
+
+void LooseOctree::remove(uint32_t id) {
+	unlink(id);
+	m_freeItems.push_back(id);
+	m_count--;
+}
+
+template <typename Overlaps>
+void LooseOctree::query(uint64_t key, const Overlaps& overlaps, std::vector<uint32_t>& results) const {
+	auto found = m_nodes.find(key);
+	if (found == m_nodes.end()) {
+		return;
+	}
+	const Node& node = found->second;
+	uint32_t depth = static_cast<uint32_t>(key >> (3 * COORDINATE_BITS));
+	// The root also holds boxes outside the octree, so its bounds are unlimited.
+	if (depth > 0 && !overlaps(looseBounds(key))) {
+		return;
+	}
+	for (uint32_t item : node.items) {
+		if (overlaps(m_items[item].bounds)) {
+			results.push_back(m_items[item].value);
+		}
+	}
+	uint32_t mask = (1u << COORDINATE_BITS) - 1;
+	uint32_t x = (key >> (2 * COORDINATE_BITS)) & mask, y = (key >> COORDINATE_BITS) & mask, z = key & mask;
+	for (uint32_t child = 0; child < 8; child++) {
+		if (node.childMask & (1 << child)) {
+			query(nodeKey(depth + 1, 2 * x + (child & 1), 2 * y + ((child >> 1) & 1), 2 * z + (child >> 2)),
+				overlaps, results);
+		}
+	}
+}
+
+void LooseOctree::queryBox(const BoundingBox& box, std::vector<uint32_t>& results) const {
+	query(nodeKey(0, 0, 0, 0), [&box](const BoundingBox& b) { return b.intersects(box); }, results);
+}
+
+void LooseOctree::querySphere(const glm::vec3& center, float_t radius, std::vector<uint32_t>& results) const {
+	float_t radiusSquared = radius * radius;
+	query(nodeKey(0, 0, 0, 0),
+		[&](const BoundingBox& b) { return b.distanceSquared(center) <= radiusSquared; }, results);
+}
+
+void LooseOctree::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const {
+	query(nodeKey(0, 0, 0, 0), [&frustum](const BoundingBox& b) { return frustum.intersectsBox(b.low, b.high); },
+		results);
+}
+
+void LooseOctree::nearest(const glm::vec3& point, size_t k, std::vector<uint32_t>& results) const {
+	results.clear();
+	if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+		return;
+	}
+	// Best first: nodes and boxes in one queue by distance, so a box is taken only once every
+	// node that could hold a nearer one has been opened.
+	struct Entry {
+		float_t distance;
+		bool isItem;
+		uint64_t index;
+		bool operator>(const Entry& other) const { return distance > other.distance; }
+	};
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	if (m_nodes.count(nodeKey(0, 0, 0, 0)) > 0) {
+		queue.push({ 0, false, nodeKey(0, 0, 0, 0) });
+	}
+	uint32_t mask = (1u << COORDINATE_BITS) - 1;
+	while (!queue.empty() && results.size() < k) {
+		Entry entry = queue.top();
+		queue.pop();
+		if (entry.isItem) {
+			results.push_back(m_items[entry.index].value);
+			continue;
+		}
+		const Node& node = m_nodes.at(entry.index);
+		for (uint32_t item : node.items) {
+			float_t distance = m_items[item].bounds.distanceSquared(point);
+			// NaN would break the queue's ordering.
+			if (!std::isnan(distance)) {
+				queue.push({ distance, true, item });
+			}
+		}
+		uint32_t depth = static_cast<uint32_t>(entry.index >> (3 * COORDINATE_BITS));
+		uint32_t x = (entry.index >> (2 * COORDINATE_BITS)) & mask;
+		uint32_t y = (entry.index >> COORDINATE_BITS) & mask;
+		uint32_t z = entry.index & mask;
+		for (uint32_t child = 0; child < 8; child++) {
+			if (node.childMask & (1 << child)) {
+				uint64_t key = nodeKey(depth + 1, 2 * x + (child & 1), 2 * y + ((child >> 1) & 1), 2 * z + (child >> 2));
+				queue.push({ looseBounds(key).distanceSquared(point), false, key });
+			}
+		}
+	}
+}
+
+SpatialHash::SpatialHash(float_t cellSize) : m_cellSize(cellSize), m_count(0), m_stamp(0) {
+}
+
+// Cell coordinates beyond this are not converted to integers; boxes reaching them are kept
+// outside the grid, and queries reaching them visit every cell.
+static const float_t MAX_CELL_COORDINATE = 1 << 30;
+
+/**
+ * @brief Whether the range of cells from low to high, inclusive, has integer coordinates.
+ */
+static bool cellsInRange(const glm::vec3& low, const glm::vec3& high) {
+	for (int32_t axis = 0; axis < 3; axis++) {
+		if (!(low[axis] >= -MAX_CELL_COORDINATE && high[axis] <= MAX_CELL_COORDINATE && low[axis] <= high[axis])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SpatialHash::cellRange(const BoundingBox& bounds, glm::ivec3& lowCell, glm::ivec3& highCell) const {
+	// Empty boxes and NaN fail the range test; infinite ones are beyond it.
+	glm::vec3 low = glm::floor(bounds.low / m_cellSize);
+	glm::vec3 high = glm::floor(bounds.high / m_cellSize);
+	if (!cellsInRange(low, high)) {
+		return false;
+	}
+	glm::vec3 span = high - low + glm::vec3(1);
+	if (static_cast<double>(span.x) * span.y * span.z > MAX_ITEM_CELLS) {
+		return false;
+	}
+	lowCell = glm::ivec3(low);
+	highCell = glm::ivec3(high);
+	return true;
+}
+
+uint64_t SpatialHash::cellKey(int32_t x, int32_t y, int32_t z) {
+	// 21 bits per coordinate, wrapping; distant cells may share a key, and a list.
+	uint64_t mask = (1u << 21) - 1;
+	return ((static_cast<uint64_t>(x) & mask) << 42) | ((static_cast<uint64_t>(y) & mask) << 21)
+		| (static_cast<uint64_t>(z) & mask);
+}
+
+void SpatialHash::link(uint32_t id) {
+	Item& item = m_items[id];
+	if (!item.gridded) {
+		m_unbounded.push_back(id);
+		return;
+	}
+	for (int32_t x = item.lowCell.x; x <= item.highCell.x; x++) {
+		for (int32_t y = item.lowCell.y; y <= item.highCell.y; y++) {
+			for (int32_t z = item.lowCell.z; z <= item.highCell.z; z++) {
+				m_cells[cellKey(x, y, z)].push_back(id);
+			}
+		}
+	}
+}
+
+void SpatialHash::unlink(uint32_t id) {
+	Item& item = m_items[id];
+	if (!item.gridded) {
+		*std::find(m_unbounded.begin(), m_unbounded.end(), id) = m_unbounded.back();
+		m_unbounded.pop_back();
+		return;
+	}
+	for (int32_t x = item.lowCell.x; x <= item.highCell.x; x++) {
+		for (int32_t y = item.lowCell.y; y <= item.highCell.y; y++) {
+			for (int32_t z = item.lowCell.z; z <= item.highCell.z; z++) {
+				auto cell = m_cells.find(cellKey(x, y, z));
+				auto& ids = cell->second;
+				*std::find(ids.begin(), ids.end(), id) = ids.back();
+				ids.pop_back();
+				if (ids.empty()) {
+					m_cells.erase(cell);
+				}
+			}
+		}
+	}
+}
+
+uint32_t SpatialHash::insert(const BoundingBox& bounds, uint32_t value) {
+	uint32_t id;
+	if (!m_freeItems.empty()) {
+		id = m_freeItems.back();
+		m_freeItems.pop_back();
+	}
+	else {
+		id = static_cast<uint32_t>(m_items.size());
+		m_items.push_back({});
+		m_stamps.push_back(0);
+	}
+	Item& item = m_items[id];
+	item.bounds = bounds;
+	item.value = value;
+	item.gridded = cellRange(bounds, item.lowCell, item.highCell);
+	item.live = true;
+	link(id);
+	m_count++;
+	return id;
+}
+
+void SpatialHash::update(uint32_t id, const BoundingBox& bounds) {
+	Item& item = m_items[id];
+	item.bounds = bounds;
+	glm::ivec3 lowCell(0);
+	glm::ivec3 highCell(0);
+	bool gridded = cellRange(bounds, lowCell, highCell);
+	if (gridded != item.gridded || (gridded && (lowCell != item.lowCell || highCell != item.highCell))) {
+		unlink(id);
+		item.gridded = gridded;
+		item.lowCell = lowCell;
+		item.highCell = highCell;
+		link(id);
+	}
+}
+
+void SpatialHash::remove(uint32_t id) {
+	unlink(id);
+	m_items[id].live = false;
+	m_freeItems.push_back(id);
+	m_count--;
+}
+
+template <typename Overlaps>
+void SpatialHash::query(const BoundingBox& region, const Overlaps& overlaps, std::vector<uint32_t>& results) const {
+	if (++m_stamp == 0) {
+		std::fill(m_stamps.begin(), m_stamps.end(), 0);
+		m_stamp = 1;
+	}
+	auto visit = [&](const std::vector<uint32_t>& ids) {
+		for (uint32_t id : ids) {
+			if (m_stamps[id] != m_stamp) {
+				m_stamps[id] = m_stamp;
+				if (overlaps(m_items[id].bounds)) {
+					results.push_back(m_items[id].value);
+				}
+			}
+		}
+	};
+
+	visit(m_unbounded);
+
+	// Look up each cell of the region, unless there are more of them than occupied cells.
+	// The span is measured in floating point, as unbounded regions have no cell coordinates.
+	glm::vec3 lowCell = glm::floor(region.low / m_cellSize);
+	glm::vec3 highCell = glm::floor(region.high / m_cellSize);
+	glm::vec3 span = highCell - lowCell + glm::vec3(1);
+	if (!cellsInRange(lowCell, highCell)
+		|| !(static_cast<double>(span.x) * span.y * span.z <= static_cast<double>(m_cells.size()))) {
+		for (auto& cell : m_cells) {
+			visit(cell.second);
+		}
+		return;
+	}
+	glm::ivec3 low(lowCell);
+	glm::ivec3 high(highCell);
+	for (int32_t x = low.x; x <= high.x; x++) {
+		for (int32_t y = low.y; y <= high.y; y++) {
+			for (int32_t z = low.z; z <= high.z; z++) {
+				auto cell = m_cells.find(cellKey(x, y, z));
+				if (cell != m_cells.end()) {
+					visit(cell->second);
+				}
+			}
+		}
+	}
+}
+
+void SpatialHash::queryBox(const BoundingBox& box, std::vector<uint32_t>& results) const {
+	query(box, [&box](const BoundingBox& b) { return b.intersects(box); }, results);
+}
+
+void SpatialHash::querySphere(const glm::vec3& center, float_t radius, std::vector<uint32_t>& results) const {
+	float_t radiusSquared = radius * radius;
+	query(sphereBox(center, radius),
+		[&](const BoundingBox& b) { return b.distanceSquared(center) <= radiusSquared; }, results);
+}
+
+void SpatialHash::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const {
+	float_t inf = std::numeric_limits<float_t>::infinity();
+	query(BoundingBox{ glm::vec3(-inf), glm::vec3(inf) },
+		[&frustum](const BoundingBox& b) { return frustum.intersectsBox(b.low, b.high); }, results);
+}
+
+void SpatialHash::nearest(const glm::vec3& point, size_t k, std::vector<uint32_t>& results) const {
+	results.clear();
+	k = std::min(k, m_count);
+	if (k == 0 || !std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+		return;
+	}
+	// Search ever larger spheres until one holds k boxes; those are the nearest k. The last,
+	// infinite, sphere holds every box at any distance, so the search ends even when fewer are.
+	std::vector<uint32_t> found;
+	for (float_t radius = m_cellSize;; radius *= 2) {
+		found.clear();
+		float_t radiusSquared = radius * radius;
+		std::vector<std::pair<float_t, uint32_t>> candidates;
+		query(sphereBox(point, radius), [&](const BoundingBox& b) {
+			float_t distance = b.distanceSquared(point);
+			if (distance <= radiusSquared) {
+				candidates.push_back({ distance, 0 });
+				return true;
+			}
+			return false;
+		}, found);
+		if (found.size() < k && !std::isinf(radius)) {
+			continue;
+		}
+		k = std::min(k, found.size());
+		for (size_t i = 0; i < found.size(); i++) {
+			candidates[i].second = found[i];
+		}
+		std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+		for (size_t i = 0; i < k; i++) {
+			results.push_back(candidates[i].second);
+		}
+		return;
+	}
+}
@@ -0,0 +1,179 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+#include "Object3D.h"
+
+/**
+ * @brief An axis-aligned box.
+ */
+struct BoundingBox {
+	glm::vec3 low;
+	glm::vec3 high;
+
+	bool intersects(const BoundingBox& other) const {
+		return low.x <= other.high.x && other.low.x <= high.x && low.y <= other.high.y
+			&& other.low.y <= high.y && low.z <= other.high.z && other.low.z <= high.z;
+	}
+
+	/**
+	 * @brief The squared distance from a point to the nearest point of the box; 0 inside it.
+	 */
+	float_t distanceSquared(const glm::vec3& point) const {
+		glm::vec3 outside = glm::max(glm::max(low - point, point - high), glm::vec3(0));
+		return glm::dot(outside, outside);
+	}
+};
+
+/**
+ * @brief The world-space box around every mesh of an object and its descendants, from their
+ * bounding spheres; empty (low above high) if none of them has a mesh.
+ */
+BoundingBox hierarchyBounds(const Object3D& object, const glm::mat4& parentMatrix = glm::mat4(1));
+
+/**
+ * @brief A loose octree of boxes, for dynamic objects. Each box lives in one node: the
+ * deepest whose cell is at least as large as the box, at the cell containing the box's
+ * center. Nodes' bounds are loose, twice the size of their cells, so the box always fits,
+ * and finding its node is arithmetic rather than a descent; moving a box within its cell
+ * only rewrites it. Nodes are kept in a hash map and created as boxes arrive, so empty space
+ * costs nothing. Boxes outside the octree's bounds are kept in the root, which every query
+ * visits.
+ * Each box carries a value, such as an ObjectHandle's, which queries return.
+ */
+class LooseOctree {
+private:
+	struct Node {
+		std::vector<uint32_t> items;
+		// Boxes in the node and below it, and which of its children exist.
+		uint32_t subtreeCount = 0;
+		uint8_t childMask = 0;
+	};
+
+	struct Item {
+		BoundingBox bounds;
+		uint32_t value;
+		uint64_t node;
+		// The item's index in its node's list.
+		uint32_t slot;
+	};
+
+	static constexpr uint64_t NO_NODE = UINT64_MAX;
+
+	glm::vec3 m_low;
+	float_t m_size;
+	uint32_t m_maxDepth;
+	std::unordered_map<uint64_t, Node> m_nodes;
+	std::vector<Item> m_items;
+	std::vector<uint32_t> m_freeItems;
+	size_t m_count;
+
+	static uint64_t nodeKey(uint32_t depth, uint32_t x, uint32_t y, uint32_t z);
+	uint64_t nodeFor(const BoundingBox& bounds) const;
+	BoundingBox looseBounds(uint64_t key) const;
+	void link(uint32_t item, uint64_t key);
+	void unlink(uint32_t item);
+	template <typename Overlaps>
+	void query(uint64_t key, const Overlaps& overlaps, std::vector<uint32_t>& results) const;
+
+public:
+	/**
+	 * @brief Constructs an empty octree over a cube.
+	 * @param maxDepth the depth of the smallest cells, at most 20.
+	 */
+	LooseOctree(const glm::vec3& low, float_t size, uint32_t maxDepth = 10);
+
+	/**
+	 * @brief Adds a box carrying a value, and returns an id to update or remove it by.
+	 */
+	uint32_t insert(const BoundingBox& bounds, uint32_t value);
+	void update(uint32_t id, const BoundingBox& bounds);
+	void remove(uint32_t id);
+	size_t size() const { return m_count; }
+
+	// Each query appends the values of the boxes that overlap a volume to results, in no
+	// particular order.
+	void queryBox(const BoundingBox& box, std::vector<uint32_t>& results) const;
+	void querySphere(const glm::vec3& center, float_t radius, std::vector<uint32_t>& results) const;
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+
+	/**
+	 * @brief Replaces results with the values of the k boxes nearest a point, nearest first.
+	 * Boxes containing the point are at distance 0. Boxes at no distance, such as boxes with
+	 * NaN coordinates, or any box from a point that is not finite, are never found; fewer than
+	 * k values are returned if there are not enough others.
+	 */
+	void nearest(const glm::vec3& point, size_t k, std::vector<uint32_t>& results) const;
+};
+
+/**
+ * @brief A uniform grid of cells hashed into a map, holding boxes in every cell they
+ * overlap. Cheaper than a LooseOctree for boxes of similar size, close to the cell size.
+ * Boxes overlapping more than MAX_ITEM_CELLS cells, and boxes that are empty, not finite or
+ * beyond the grid's coordinates, are kept in a list outside the grid, which every query visits.
+ * Each box carries a value, such as an ObjectHandle's, which queries return. Queries are
+ * const, but may not run concurrently.
+ */
+class SpatialHash {
+private:
+	struct Item {
+		BoundingBox bounds;
+		uint32_t value;
+		// The range of cells the box overlaps, inclusive, unless it is kept outside the grid.
+		glm::ivec3 lowCell;
+		glm::ivec3 highCell;
+		bool gridded;
+		bool live;
+	};
+
+	float_t m_cellSize;
+	std::unordered_map<uint64_t, std::vector<uint32_t>> m_cells;
+	// The boxes kept outside the grid.
+	std::vector<uint32_t> m_unbounded;
+	std::vector<Item> m_items;
+	std::vector<uint32_t> m_freeItems;
+	size_t m_count;
+	// The last query each item was found by, so items in several cells are reported once.
+	mutable std::vector<uint32_t> m_stamps;
+	mutable uint32_t m_stamp;
+
+	// The range of cells a box overlaps, or false if it is to be kept outside the grid.
+	bool cellRange(const BoundingBox& bounds, glm::ivec3& lowCell, glm::ivec3& highCell) const;
+	static uint64_t cellKey(int32_t x, int32_t y, int32_t z);
+	void link(uint32_t item);
+	void unlink(uint32_t item);
+	template <typename Overlaps>
+	void query(const BoundingBox& cells, const Overlaps& overlaps, std::vector<uint32_t>& results) const;
+
+public:
+	/**
+	 * @brief The most cells a box may be linked into before it is kept outside the grid.
+	 */
+	static constexpr double MAX_ITEM_CELLS = 4096;
+
+	explicit SpatialHash(float_t cellSize);
+
+	/**
+	 * @brief Adds a box carrying a value, and returns an id to update or remove it by.
+	 */
+	uint32_t insert(const BoundingBox& bounds, uint32_t value);
+	void update(uint32_t id, const BoundingBox& bounds);
+	void remove(uint32_t id);
+	size_t size() const { return m_count; }
+
+	// Each query appends the values of the boxes that overlap a volume to results, in no
+	// particular order. Frustum queries visit every occupied cell.
+	void queryBox(const BoundingBox& box, std::vector<uint32_t>& results) const;
+	void querySphere(const glm::vec3& center, float_t radius, std::vector<uint32_t>& results) const;
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+
+	/**
+	 * @brief Replaces results with the values of the k boxes nearest a point, nearest first.
+	 * Boxes containing the point are at distance 0. Boxes at no distance, such as boxes with
+	 * NaN coordinates, or any box from a point that is not finite, are never found; fewer than
+	 * k values are returned if there are not enough others.
+	 */
+	void nearest(const glm::vec3& point, size_t k, std::vector<uint32_t>& results) const;
+};
@@ -2,6 +2,7 @@
 #include <string>
 #include <filesystem>
 #include <SFML/Graphics.hpp>
+#include "GLState.h"
 
 /**
  * @brief Represents a texture that has been loaded into VRAM, and is expected to be bound
@@ -12,14 +13,18 @@ struct Texture {
 	uint32_t textureId;
 	// The name of the sampler2D uniform in the fragment shader that this texture will bind to.
 	std::string samplerName;
+	// The image file the texture was loaded from, so scene files can refer to it; empty if the
+	// image was generated.
+	std::string sourcePath;
 
 	/**
 	 * @brief Loads an SFML Image into VRAM and returns a Texture object identifying it.
 	 */
-	static Texture loadImage(const sf::Image& texture, const std::string& samplerName) {
+	static Texture loadImage(const sf::Image& texture, const std::string& samplerName,
+		const std::string& sourcePath = "") {
 		uint32_t texId;
 		glGenTextures(1, &texId);
-		glBindTexture(GL_TEXTURE_2D, texId);
+		GLState::current().bindTexture(GL_TEXTURE_2D, texId);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -27,8 +32,8 @@ struct Texture {
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture.getSize().x, texture.getSize().y, 0, GL_RGBA,
 			GL_UNSIGNED_BYTE, texture.getPixelsPtr());
 		glGenerateMipmap(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::current().bindTexture(GL_TEXTURE_2D, 0);
 
-		return Texture{ texId, samplerName };
+		return Texture{ texId, samplerName, sourcePath };
 	}
 };
\ No newline at end of file
@@ -1,15 +1,23 @@
 #pragma once
 #include "Object3D.h"
 #include "Animation.h"
+#include "KeyframeTracks.h"
 class TranslationAnimation : public Animation {
 private:
 	glm::vec3 m_translation;
 
-	void applyAnimation(float_t dt) override {
-		object().move(m_translation * dt);
+	void applyAnimation(Object3D& object, float_t dt) override {
+		object.move(m_translation * dt);
 	}
 public:
-	TranslationAnimation(Object3D& object, float_t duration, 
+	TranslationAnimation(ObjectHandle object, float_t duration, 
 		const glm::vec3& totalMovement) :
 		Animation(object, duration), m_translation(totalMovement / duration) {}
+
+	bool hasTrack() const override { return true; }
+
+	bool appendTrack(KeyframeTracks& tracks, float_t delay) const override {
+		tracks.addTranslation(object(), duration(), m_translation * duration(), delay);
+		return true;
+	}
 };
@@ -0,0 +1,178 @@
+#include "VertexWeld.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+std::string WeldReport::describe() const {
+	std::ostringstream out;
+	out.precision(3);
+	out << inputVertices << " vertices welded to " << outputVertices << " (" << ratio() * 100
+		<< "%) in " << ms << " ms";
+	return out.str();
+}
+
+/**
+ * @brief A vertex's attributes, quantized, as bits: two vertices weld if their keys are equal.
+ */
+struct WeldKey {
+	uint32_t bits[8];
+};
+
+static const uint32_t NO_VERTEX = 0xFFFFFFFF;
+// Vertices per task when hashing or remapping in parallel.
+static const size_t WELD_CHUNK = 1 << 14;
+
+// The cell of a value on a grid of the tolerance, as bits. Cells are counted in a float, so
+// only values beyond 2^24 cells from the origin share cells with their neighbors; adding 0
+// makes -0 and 0 the same.
+static uint32_t quantize(float_t value, float_t tolerance) {
+	float_t cell = (tolerance > 0 ? std::round(value / tolerance) : value) + 0.0f;
+	uint32_t bits;
+	std::memcpy(&bits, &cell, sizeof(bits));
+	return bits;
+}
+
+static uint64_t mix(uint64_t hash, uint32_t value) {
+	hash = (hash ^ value) * 0x9E3779B97F4A7C15ull;
+	return hash ^ (hash >> 29);
+}
+
+static void hashVertex(const Vertex3D& vertex, const VertexBoneData* influence, const WeldSettings& settings,
+	WeldKey& key, uint64_t& hash) {
+	key.bits[0] = quantize(vertex.x, settings.positionTolerance);
+	key.bits[1] = quantize(vertex.y, settings.positionTolerance);
+	key.bits[2] = quantize(vertex.z, settings.positionTolerance);
+	key.bits[3] = quantize(vertex.nx, settings.normalTolerance);
+	key.bits[4] = quantize(vertex.ny, settings.normalTolerance);
+	key.bits[5] = quantize(vertex.nz, settings.normalTolerance);
+	key.bits[6] = quantize(vertex.u, settings.uvTolerance);
+	key.bits[7] = quantize(vertex.v, settings.uvTolerance);
+	hash = 0xCBF29CE484222325ull;
+	for (uint32_t bits : key.bits) {
+		hash = mix(hash, bits);
+	}
+	if (influence != nullptr) {
+		uint32_t words[8];
+		std::memcpy(words, influence, sizeof(words));
+		for (uint32_t word : words) {
+			hash = mix(hash, word);
+		}
+	}
+}
+
+// Runs task(first, last) over chunks of count items, on the pool if there is one.
+template <typename Task>
+static void forChunks(size_t count, WorkerPool* pool, const Task& task) {
+	if (pool == nullptr) {
+		task(0, count);
+		return;
+	}
+	pool->run((count + WELD_CHUNK - 1) / WELD_CHUNK, [&](size_t chunk, size_t) {
+		task(chunk * WELD_CHUNK, std::min(count, (chunk + 1) * WELD_CHUNK));
+	});
+}
+
+size_t weldVertices(Vertex3D* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount,
+	const WeldSettings& settings, FrameArena& scratch, WorkerPool* pool, VertexBoneData* influences) {
+	if (vertexCount < 2) {
+		return vertexCount;
+	}
+	if (vertexCount < settings.parallelThreshold) {
+		pool = nullptr;
+	}
+
+	WeldKey* keys = scratch.allocateArray<WeldKey>(vertexCount);
+	uint64_t* hashes = scratch.allocateArray<uint64_t>(vertexCount);
+	forChunks(vertexCount, pool, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++) {
+			hashVertex(vertices[i], influences != nullptr ? &influences[i] : nullptr, settings, keys[i], hashes[i]);
+		}
+	});
+
+	// Split the vertices among shards by the high bits of their hashes, keeping their order
+	// within each, so equal vertices meet in one shard and the first of them is found first.
+	size_t shardCount = pool != nullptr ? pool->threadCount() * 4 : 1;
+	uint32_t* shardStart = scratch.allocateArray<uint32_t>(shardCount + 1);
+	uint32_t* members = scratch.allocateArray<uint32_t>(vertexCount);
+	auto shardOf = [shardCount](uint64_t hash) { return static_cast<size_t>(((hash >> 32) * shardCount) >> 32); };
+	std::fill(shardStart, shardStart + shardCount + 1, 0);
+	for (size_t i = 0; i < vertexCount; i++) {
+		shardStart[shardOf(hashes[i]) + 1]++;
+	}
+	for (size_t s = 0; s < shardCount; s++) {
+		shardStart[s + 1] += shardStart[s];
+	}
+	uint32_t* fill = scratch.allocateArray<uint32_t>(shardCount);
+	std::copy(shardStart, shardStart + shardCount, fill);
+	for (size_t i = 0; i < vertexCount; i++) {
+		members[fill[shardOf(hashes[i])]++] = static_cast<uint32_t>(i);
+	}
+
+	// Each shard matches its vertices through an open-addressed table of at least twice their
+	// number of slots, indexed by the low bits of the hash. remap[i] becomes the first vertex
+	// equal to vertex i.
+	size_t* tableStart = scratch.allocateArray<size_t>(shardCount + 1);
+	tableStart[0] = 0;
+	for (size_t s = 0; s < shardCount; s++) {
+		size_t slots = 16;
+		while (slots < 2 * static_cast<size_t>(shardStart[s + 1] - shardStart[s])) {
+			slots *= 2;
+		}
+		tableStart[s + 1] = tableStart[s] + slots;
+	}
+	uint32_t* tables = scratch.allocateArray<uint32_t>(tableStart[shardCount]);
+	uint32_t* remap = scratch.allocateArray<uint32_t>(vertexCount);
+	auto matchShard = [&](size_t shard) {
+		uint32_t* table = tables + tableStart[shard];
+		size_t mask = tableStart[shard + 1] - tableStart[shard] - 1;
+		std::fill(table, table + mask + 1, NO_VERTEX);
+		for (uint32_t m = shardStart[shard]; m < shardStart[shard + 1]; m++) {
+			uint32_t i = members[m];
+			size_t slot = hashes[i] & mask;
+			remap[i] = i;
+			while (table[slot] != NO_VERTEX) {
+				uint32_t j = table[slot];
+				if (hashes[j] == hashes[i] && std::memcmp(&keys[j], &keys[i], sizeof(WeldKey)) == 0
+					&& (influences == nullptr || std::memcmp(&influences[j], &influences[i], sizeof(VertexBoneData)) == 0)) {
+					remap[i] = j;
+					break;
+				}
+				slot = (slot + 1) & mask;
+			}
+			if (remap[i] == i) {
+				table[slot] = i;
+			}
+		}
+	};
+	if (pool != nullptr) {
+		pool->run(shardCount, [&](size_t shard, size_t) { matchShard(shard); });
+	}
+	else {
+		matchShard(0);
+	}
+
+	// Move the kept vertices to the front in order. Each merged vertex's first match comes
+	// before it, so its new index is known by the time it is reached.
+	size_t kept = 0;
+	for (size_t i = 0; i < vertexCount; i++) {
+		if (remap[i] == i) {
+			if (kept != i) {
+				vertices[kept] = vertices[i];
+				if (influences != nullptr) {
+					influences[kept] = influences[i];
+				}
+			}
+			remap[i] = static_cast<uint32_t>(kept++);
+		}
+		else {
+			remap[i] = remap[remap[i]];
+		}
+	}
+	forChunks(indexCount, pool, [&](size_t first, size_t last) {
+		for (size_t t = first; t < last; t++) {
+			indices[t] = remap[indices[t]];
+		}
+	});
+	return kept;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "FrameArena.h"
+#include "Mesh3D.h"
+#include "WorkerPool.h"
+
+/**
+ * @brief How close two vertices' attributes must be for weldVertices to merge them. Each
+ * attribute is quantized to a grid of its tolerance, and vertices merge when every attribute
+ * falls in the same cell, so vertices closer than a tolerance can still be kept apart by a cell
+ * boundary. A tolerance of 0 merges only bitwise-identical values.
+ */
+struct WeldSettings {
+	float_t positionTolerance = 1e-6f;
+	// Per component of the normal.
+	float_t normalTolerance = 1e-3f;
+	float_t uvTolerance = 1e-6f;
+	// Meshes with fewer vertices are welded on one thread; the rest are hashed and matched on
+	// every worker of the pool given.
+	size_t parallelThreshold = 1 << 16;
+};
+
+/**
+ * @brief The result of welding one or more meshes.
+ */
+struct WeldReport {
+	size_t inputVertices = 0;
+	size_t outputVertices = 0;
+	double ms = 0;
+
+	/**
+	 * @brief The fraction of the vertices that remain; 1 if none were merged.
+	 */
+	double ratio() const { return inputVertices == 0 ? 1 : static_cast<double>(outputVertices) / inputVertices; }
+
+	std::string describe() const;
+};
+
+/**
+ * @brief Merges vertices whose attributes match within the settings' tolerances, in place.
+ * The kept vertices are the first of each group, in their original order, moved to the front
+ * of the array; indices are rewritten to refer to them. If influences are given, one per
+ * vertex, vertices merge only if their bone influences are identical, and the influences are
+ * compacted with them.
+ * Vertices are hashed by their quantized attributes, then split by hash among the pool's
+ * workers, each matching the vertices of its share; the result is the same for any number of
+ * threads. Scratch memory comes from the arena, which the caller resets.
+ * @return the number of vertices kept.
+ */
+size_t weldVertices(Vertex3D* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount,
+	const WeldSettings& settings, FrameArena& scratch, WorkerPool* pool = nullptr,
+	VertexBoneData* influences = nullptr);
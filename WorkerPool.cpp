@@ -0,0 +1,110 @@
+#include "WorkerPool.h"
+#include <algorithm>
+#include <stdexcept>
+#include "FrameArena.h"
+
+WorkerPool::WorkerPool(size_t threadCount)
+	: m_generation(0), m_busyWorkers(0), m_stopping(false), m_running(false), m_task(nullptr),
+	m_taskCount(0), m_nextTask(0) {
+	for (size_t i = 1; i < std::max<size_t>(threadCount, 1); i++) {
+		m_threads.emplace_back(&WorkerPool::workerLoop, this, i);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_start.notify_all();
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void WorkerPool::work(size_t worker) {
+	for (size_t i = m_nextTask++; i < m_taskCount; i = m_nextTask++) {
+		try {
+			(*m_task)(i, worker);
+		}
+		catch (...) {
+			// Keep the first exception for run to rethrow, and leave the remaining tasks unclaimed.
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_error == nullptr) {
+				m_error = std::current_exception();
+			}
+			m_nextTask = m_taskCount;
+		}
+	}
+}
+
+void WorkerPool::workerLoop(size_t worker) {
+	uint64_t seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start.wait(lock, [&]() { return m_stopping || m_generation != seen; });
+			if (m_stopping) {
+				return;
+			}
+			seen = m_generation;
+		}
+		// Nothing the last batch allocated here is in use once the next one starts.
+		FrameArena::local().reset();
+		work(worker);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busyWorkers--;
+		}
+		m_finished.notify_one();
+	}
+}
+
+void WorkerPool::run(size_t taskCount, const std::function<void(size_t, size_t)>& task) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_running) {
+			throw std::logic_error("WorkerPool::run called while a batch is running");
+		}
+		m_running = true;
+	}
+	// Batches too small to share run on the calling thread, but still count as running, so
+	// nesting is caught however many tasks or threads there are.
+	if (m_threads.empty() || taskCount <= 1) {
+		try {
+			for (size_t i = 0; i < taskCount; i++) {
+				task(i, 0);
+			}
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+			throw;
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_taskCount = taskCount;
+		m_nextTask = 0;
+		m_error = nullptr;
+		m_busyWorkers = m_threads.size();
+		m_generation++;
+	}
+	m_start.notify_all();
+	work(0);
+	std::exception_ptr error;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_finished.wait(lock, [this]() { return m_busyWorkers == 0; });
+		m_running = false;
+		m_task = nullptr;
+		std::swap(error, m_error);
+	}
+	if (error != nullptr) {
+		std::rethrow_exception(error);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed set of threads that run batches of independent tasks. The thread calling run
+ * takes part as worker 0, and tasks are claimed one at a time, so uneven tasks balance out.
+ * Threads persist between batches, so a batch costs a wake-up rather than thread creation.
+ */
+class WorkerPool {
+private:
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_finished;
+	uint64_t m_generation;
+	size_t m_busyWorkers;
+	bool m_stopping;
+	bool m_running;
+
+	// The current batch, and the first exception one of its tasks threw.
+	const std::function<void(size_t, size_t)>* m_task;
+	size_t m_taskCount;
+	std::atomic<size_t> m_nextTask;
+	std::exception_ptr m_error;
+
+	void work(size_t worker);
+	void workerLoop(size_t worker);
+
+public:
+	/**
+	 * @brief Starts threadCount - 1 threads; with a count of 1, run executes serially.
+	 */
+	explicit WorkerPool(size_t threadCount = std::thread::hardware_concurrency());
+	~WorkerPool();
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	/**
+	 * @brief The number of workers, including the calling thread.
+	 */
+	size_t threadCount() const { return m_threads.size() + 1; }
+
+	/**
+	 * @brief Calls task(index, worker) for every index below taskCount, spread across the
+	 * workers, and returns once all have finished. Worker indices are below threadCount().
+	 * Tasks may allocate from FrameArena::local(); on the pool's own threads, that memory
+	 * lasts until the next run. If a task throws, tasks not yet started are skipped, and once
+	 * the running ones finish, the first exception is rethrown here. A batch may not be run
+	 * while another is running, as from within a task; that throws std::logic_error.
+	 */
+	void run(size_t taskCount, const std::function<void(size_t, size_t)>& task);
+};
@@ -0,0 +1,288 @@
+#include "WorldStreamer.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include "FrameArena.h"
+
+std::string StreamingStats::describe() const {
+	std::ostringstream out;
+	out.precision(3);
+	out << resident << "/" << cells << " cells resident (" << residentBytes / (1024.0 * 1024.0) << " MB), "
+		<< queued << " queued, " << loading << " loading, " << uploading << " uploading; " << loads
+		<< " loads, " << evictions << " evictions, " << failures << " failures; queue depth up to "
+		<< maxQueueDepth << ", uploads up to " << maxUploadMs << " ms per frame, stalled " << stallMs
+		<< " ms over " << stalledFrames << " frames";
+	return out.str();
+}
+
+WorldManifest loadWorldManifest(const std::filesystem::path& path) {
+	std::ifstream in(path);
+	if (!in) {
+		throw std::runtime_error("Failed to open " + path.string());
+	}
+	WorldManifest manifest;
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream words(line);
+		std::string keyword;
+		if (!(words >> keyword) || keyword[0] == '#') {
+			continue;
+		}
+		if (keyword == "shader") {
+			words >> manifest.shaderName;
+		}
+		else if (keyword == "cell") {
+			WorldCell cell;
+			std::string cellPath;
+			if (!(words >> cell.low.x >> cell.low.y >> cell.high.x >> cell.high.y >> cellPath)) {
+				throw std::runtime_error("Malformed cell in " + path.string() + ": " + line);
+			}
+			cell.path = path.parent_path() / cellPath;
+			manifest.cells.push_back(cell);
+		}
+		else {
+			throw std::runtime_error("Unknown line in " + path.string() + ": " + line);
+		}
+	}
+	return manifest;
+}
+
+WorldStreamer::WorldStreamer(const WorldManifest& manifest, const StreamingSettings& settings)
+	: m_settings(settings), m_cells(manifest.cells.size()), m_priority(manifest.cells.size(), 0),
+	m_stopping(false) {
+	for (size_t i = 0; i < m_cells.size(); i++) {
+		m_cells[i].cell = manifest.cells[i];
+		std::error_code error;
+		uintmax_t size = std::filesystem::file_size(manifest.cells[i].path, error);
+		m_cells[i].bytes = error ? 0 : size;
+	}
+	m_stats.cells = m_cells.size();
+	for (size_t i = 0; i < std::max<size_t>(settings.workerCount, 1); i++) {
+		m_workers.emplace_back(&WorldStreamer::work, this);
+	}
+}
+
+WorldStreamer::~WorldStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void WorldStreamer::work() {
+	while (true) {
+		size_t cell;
+		std::filesystem::path path;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+			if (m_stopping) {
+				return;
+			}
+			auto nearest = std::min_element(m_queue.begin(), m_queue.end(),
+				[this](size_t a, size_t b) { return m_priority[a] < m_priority[b]; });
+			cell = *nearest;
+			m_queue.erase(nearest);
+			// Only this worker touches the cell until it hands it back.
+			path = m_cells[cell].cell.path;
+		}
+
+		Loaded loaded{ cell };
+		try {
+			loaded.file = std::make_unique<SceneFile>(path);
+			loaded.instancer = std::make_unique<SceneInstancer>(*loaded.file);
+			loaded.instancer->prepare();
+		}
+		// Anything a load throws, std::bad_alloc from a huge cell included, fails only that
+		// cell; escaping the worker would terminate the program.
+		catch (std::exception& e) {
+			loaded.instancer.reset();
+			loaded.file.reset();
+			loaded.error = e.what();
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loaded.push_back(std::move(loaded));
+	}
+}
+
+void WorldStreamer::evict(size_t index, ObjectStore& objects) {
+	Cell& cell = m_cells[index];
+	for (ObjectHandle root : cell.instancer->roots()) {
+		objects.erase(root);
+	}
+	cell.instancer->release();
+	if (cell.state == CellState::Resident) {
+		m_stats.residentBytes -= cell.bytes;
+		m_stats.evictions++;
+	}
+	else {
+		m_uploads.erase(std::find(m_uploads.begin(), m_uploads.end(), index));
+	}
+	cell.instancer.reset();
+	cell.file.reset();
+	cell.tracks = KeyframeTracks();
+	cell.state = CellState::Unloaded;
+}
+
+void WorldStreamer::update(const glm::vec3& cameraPosition, ObjectStore& objects, float_t dt) {
+	using Clock = std::chrono::steady_clock;
+	glm::vec2 camera(cameraPosition.x, cameraPosition.z);
+	ArenaVector<size_t> nearby;
+	bool stalled = false;
+	for (size_t i = 0; i < m_cells.size(); i++) {
+		Cell& cell = m_cells[i];
+		glm::vec2 nearest = glm::clamp(camera, cell.cell.low, cell.cell.high);
+		cell.distance = glm::length(camera - nearest);
+		if (cell.distance <= m_settings.prefetchDistance) {
+			nearby.push_back(i);
+		}
+		if (cell.distance <= m_settings.viewDistance && cell.state != CellState::Resident
+			&& cell.state != CellState::Failed) {
+			stalled = true;
+		}
+	}
+	if (stalled) {
+		m_stats.stallMs += dt * 1000.0;
+		m_stats.stalledFrames++;
+	}
+
+	// The wanted cells: the nearby ones, nearest first, as many as fit in the budget. The
+	// nearest is always wanted, even if it alone is over.
+	std::sort(nearby.begin(), nearby.end(),
+		[this](size_t a, size_t b) { return m_cells[a].distance < m_cells[b].distance; });
+	ArenaVector<uint8_t> wanted(m_cells.size(), 0);
+	uint64_t wantedBytes = 0;
+	for (size_t i : nearby) {
+		if (wantedBytes > 0 && wantedBytes + m_cells[i].bytes > m_settings.memoryBudget) {
+			break;
+		}
+		wanted[i] = 1;
+		wantedBytes += m_cells[i].bytes;
+	}
+
+	std::vector<Loaded> loaded;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// Unwanted cells leave the queue; wanted ones join it, and every queued cell is
+		// reprioritized by its new distance.
+		m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(), [&](size_t i) {
+			if (!wanted[i]) {
+				m_cells[i].state = CellState::Unloaded;
+			}
+			return !wanted[i];
+		}), m_queue.end());
+		for (size_t i = 0; i < m_cells.size(); i++) {
+			if (wanted[i] && m_cells[i].state == CellState::Unloaded) {
+				m_cells[i].state = CellState::Queued;
+				m_queue.push_back(i);
+			}
+			m_priority[i] = m_cells[i].distance;
+		}
+		// Queued cells a worker has taken are loading.
+		for (size_t i = 0; i < m_cells.size(); i++) {
+			if (m_cells[i].state == CellState::Queued
+				&& std::find(m_queue.begin(), m_queue.end(), i) == m_queue.end()) {
+				m_cells[i].state = CellState::Loading;
+			}
+		}
+		m_stats.maxQueueDepth = std::max(m_stats.maxQueueDepth, m_queue.size());
+		std::swap(loaded, m_loaded);
+	}
+	m_wake.notify_all();
+
+	for (auto& l : loaded) {
+		Cell& cell = m_cells[l.cell];
+		if (l.instancer == nullptr) {
+			std::cout << "WARNING: failed to load world cell " << cell.cell.path.string() << ": " << l.error << std::endl;
+			cell.state = CellState::Failed;
+			m_stats.failures++;
+			continue;
+		}
+		cell.file = std::move(l.file);
+		cell.instancer = std::move(l.instancer);
+		cell.bytes = cell.instancer->gpuBytes();
+		cell.state = CellState::Uploading;
+		m_uploads.push_back(l.cell);
+	}
+
+	// Upload nearest first, until the time budget runs out.
+	auto start = Clock::now();
+	while (!m_uploads.empty()) {
+		auto nearest = std::min_element(m_uploads.begin(), m_uploads.end(),
+			[this](size_t a, size_t b) { return m_cells[a].distance < m_cells[b].distance; });
+		Cell& cell = m_cells[*nearest];
+		bool complete;
+		try {
+			complete = cell.instancer->step(objects, cell.tracks);
+		}
+		// As on the loader thread, any exception fails only the cell, not the frame.
+		catch (std::exception& e) {
+			std::cout << "WARNING: failed to load world cell " << cell.cell.path.string() << ": " << e.what() << std::endl;
+			evict(*nearest, objects);
+			cell.state = CellState::Failed;
+			m_stats.failures++;
+			continue;
+		}
+		if (complete) {
+			cell.state = CellState::Resident;
+			m_stats.residentBytes += cell.bytes;
+			m_stats.loads++;
+			m_uploads.erase(nearest);
+		}
+		if (std::chrono::duration<double, std::milli>(Clock::now() - start).count() >= m_settings.uploadBudgetMs) {
+			break;
+		}
+	}
+	m_stats.maxUploadMs = std::max(m_stats.maxUploadMs,
+		std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+	// Evict unwanted cells, farthest first, while over budget.
+	while (m_stats.residentBytes > m_settings.memoryBudget) {
+		size_t farthest = m_cells.size();
+		for (size_t i = 0; i < m_cells.size(); i++) {
+			if (m_cells[i].state == CellState::Resident && !wanted[i]
+				&& (farthest == m_cells.size() || m_cells[i].distance > m_cells[farthest].distance)) {
+				farthest = i;
+			}
+		}
+		if (farthest == m_cells.size()) {
+			break;
+		}
+		evict(farthest, objects);
+	}
+}
+
+void WorldStreamer::tick(ObjectStore& objects, float_t dt) {
+	for (auto& cell : m_cells) {
+		if (cell.state == CellState::Resident) {
+			cell.tracks.tick(objects, dt);
+		}
+	}
+}
+
+void WorldStreamer::clear(ObjectStore& objects) {
+	for (size_t i = 0; i < m_cells.size(); i++) {
+		if (m_cells[i].state == CellState::Resident || m_cells[i].state == CellState::Uploading) {
+			evict(i, objects);
+		}
+	}
+}
+
+StreamingStats WorldStreamer::stats() {
+	StreamingStats stats = m_stats;
+	stats.resident = stats.queued = stats.loading = stats.uploading = 0;
+	for (auto& cell : m_cells) {
+		stats.resident += cell.state == CellState::Resident;
+		stats.queued += cell.state == CellState::Queued;
+		stats.loading += cell.state == CellState::Loading;
+		stats.uploading += cell.state == CellState::Uploading;
+	}
+	return stats;
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "KeyframeTracks.h"
+#include "ObjectStore.h"
+#include "SceneFile.h"
+
+/**
+ * @brief A part of a world: the rectangle of the XZ plane it covers, and the scene file
+ * holding its objects, their assets and animations.
+ */
+struct WorldCell {
+	glm::vec2 low;
+	glm::vec2 high;
+	std::filesystem::path path;
+};
+
+/**
+ * @brief The cells of a world, and the shader they are all drawn with.
+ */
+struct WorldManifest {
+	std::string shaderName;
+	std::vector<WorldCell> cells;
+};
+
+/**
+ * @brief Reads a world manifest: a text file of "shader NAME" and one
+ * "cell MINX MINZ MAXX MAXZ PATH" line per cell, with paths relative to the manifest. Lines
+ * starting with # are comments. Throws if it cannot be read.
+ */
+WorldManifest loadWorldManifest(const std::filesystem::path& path);
+
+/**
+ * @brief How a WorldStreamer decides which cells to keep. Distances are from the camera to
+ * the nearest point of a cell, on the XZ plane.
+ */
+struct StreamingSettings {
+	// Cells within this distance are visible; the stream stalls while any is not resident.
+	float_t viewDistance = 30;
+	// Cells within this distance are loaded ahead of time, nearest first, as far as the
+	// memory budget allows.
+	float_t prefetchDistance = 60;
+	// The GPU memory resident cells may use. Cells no longer wanted are kept until it runs
+	// out, then evicted farthest first.
+	uint64_t memoryBudget = 512ull << 20;
+	// The time each update may spend uploading to the GPU, in milliseconds. At least one
+	// upload is made per update while any is waiting, however long it takes.
+	double uploadBudgetMs = 2;
+	size_t workerCount = 2;
+};
+
+/**
+ * @brief The state of a WorldStreamer's cells, and counters since it started.
+ */
+struct StreamingStats {
+	size_t cells = 0;
+	size_t resident = 0;
+	// Waiting for a worker, being read by one, and waiting for or in the middle of uploads.
+	size_t queued = 0;
+	size_t loading = 0;
+	size_t uploading = 0;
+	uint64_t residentBytes = 0;
+	uint64_t loads = 0;
+	uint64_t evictions = 0;
+	uint64_t failures = 0;
+	// The longest any update spent uploading, and the deepest the load queue has been.
+	double maxUploadMs = 0;
+	size_t maxQueueDepth = 0;
+	// The time visible cells spent not resident: the frames that drew without them.
+	double stallMs = 0;
+	uint64_t stalledFrames = 0;
+
+	std::string describe() const;
+};
+
+/**
+ * @brief Streams the cells of a world in and out of an ObjectStore around a moving camera,
+ * so a world far larger than memory can be run. Cells near the camera are queued for loading,
+ * nearest first, and read on worker threads: their scene file is mapped and checked, their
+ * images decoded, and their geometry paged in. The uploads that follow are made on the thread
+ * calling update, a few each update within a time budget, so a cell arriving does not stall a
+ * frame. Cells that are no longer wanted are evicted, farthest first, when the memory budget
+ * runs out: their objects are removed from the store, and their GL objects deleted.
+ * Each cell's tracks are kept with the cell, and only play while it is resident.
+ */
+class WorldStreamer {
+private:
+	enum class CellState {
+		Unloaded,
+		Queued,
+		Loading,
+		Uploading,
+		Resident,
+		// Failed to load; never retried.
+		Failed
+	};
+
+	struct Cell {
+		WorldCell cell;
+		CellState state = CellState::Unloaded;
+		// The memory the cell is expected to use, from its file size until it is first loaded.
+		uint64_t bytes = 0;
+		float_t distance = 0;
+		// While uploading or resident.
+		std::unique_ptr<SceneFile> file;
+		std::unique_ptr<SceneInstancer> instancer;
+		KeyframeTracks tracks;
+	};
+
+	/**
+	 * @brief A cell a worker finished reading.
+	 */
+	struct Loaded {
+		size_t cell;
+		std::unique_ptr<SceneFile> file;
+		std::unique_ptr<SceneInstancer> instancer;
+		std::string error;
+	};
+
+	StreamingSettings m_settings;
+	std::vector<Cell> m_cells;
+	// Cells being uploaded, in the order they arrived.
+	std::vector<size_t> m_uploads;
+	StreamingStats m_stats;
+
+	// Shared with the workers.
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::vector<size_t> m_queue;
+	// Each cell's distance when queued; workers take the nearest queued cell first.
+	std::vector<float_t> m_priority;
+	std::vector<Loaded> m_loaded;
+	bool m_stopping;
+	std::vector<std::thread> m_workers;
+
+	void work();
+	void evict(size_t cell, ObjectStore& objects);
+
+public:
+	/**
+	 * @brief Starts the worker threads. No cell is loaded until the first update.
+	 */
+	WorldStreamer(const WorldManifest& manifest, const StreamingSettings& settings = StreamingSettings());
+	/**
+	 * @brief Stops the workers. Cells left in a store are not removed, nor their GL objects
+	 * deleted; call clear first if the context outlives the streamer.
+	 */
+	~WorldStreamer();
+	WorldStreamer(const WorldStreamer&) = delete;
+	WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+	/**
+	 * @brief Queues and evicts cells for the camera's position, and makes uploads of arrived
+	 * cells within the upload budget. Must be called on the GL context's thread.
+	 * @param dt the time since the last update, in seconds, for the stall time.
+	 */
+	void update(const glm::vec3& cameraPosition, ObjectStore& objects, float_t dt);
+
+	/**
+	 * @brief Advances the tracks of every resident cell by the given interval, in seconds.
+	 */
+	void tick(ObjectStore& objects, float_t dt);
+
+	/**
+	 * @brief Evicts every cell that is resident or being uploaded.
+	 */
+	void clear(ObjectStore& objects);
+
+	/**
+	 * @brief The state of the cells now, and the counters so far.
+	 */
+	StreamingStats stats();
+};
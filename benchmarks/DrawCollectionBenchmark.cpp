@@ -0,0 +1,99 @@
+/**
+Measures how building a frame's draw list scales with threads, on a large generated hierarchy.
+Every thread count must produce exactly the same draws as one thread.
+
+Usage: DrawCollectionBenchmark [nodes] [fanout] [frames] [maxThreads]
+*/
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <glad/glad.h>
+#include "../ParallelDrawCollector.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Adds children to the object until the subtree has the given number of nodes, with
+ * at most fanout children per node. Each node draws one of the given meshes.
+ */
+void grow(Object3D& object, size_t nodes, size_t fanout, const std::vector<Mesh3D>& meshes,
+	size_t& counter) {
+	size_t remaining = nodes - 1;
+	for (size_t i = 0; i < fanout && remaining > 0; i++) {
+		size_t childNodes = (remaining + fanout - 1 - i) / (fanout - i);
+		remaining -= childNodes;
+		Object3D child(std::vector<Mesh3D>{ meshes[counter++ % meshes.size()] });
+		child.setPosition(glm::vec3(static_cast<float_t>(i), 1, 0));
+		grow(child, childNodes, fanout, meshes, counter);
+		object.addChild(std::move(child));
+	}
+}
+
+bool sameDraws(const std::vector<DrawItem>& a, const std::vector<DrawItem>& b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].mesh != b[i].mesh || std::memcmp(&a[i].model, &b[i].model, sizeof(glm::mat4)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	size_t nodeCount = argc > 1 ? std::stoul(argv[1]) : 100000;
+	size_t fanout = argc > 2 ? std::stoul(argv[2]) : 4;
+	size_t frames = argc > 3 ? std::stoul(argv[3]) : 100;
+	size_t maxThreads = argc > 4 ? std::stoul(argv[4]) : std::thread::hardware_concurrency();
+
+	// Meshes need a GL context to be created, though nothing is drawn.
+	sf::Context context;
+	gladLoadGL();
+	std::vector<Mesh3D> meshes;
+	for (uint32_t i = 0; i < 8; i++) {
+		meshes.push_back(Mesh3D::square({ Texture{ i + 1, "baseTexture" } }));
+	}
+
+	// A few roots, each with an even share of the nodes.
+	ObjectStore objects;
+	size_t counter = 0;
+	const size_t rootCount = 4;
+	for (size_t r = 0; r < rootCount; r++) {
+		Object3D root(std::vector<Mesh3D>{ meshes[counter++ % meshes.size()] });
+		grow(root, nodeCount / rootCount, fanout, meshes, counter);
+		objects.insert(std::move(root));
+	}
+
+	std::vector<DrawItem> reference;
+	double serialMs = 0;
+	for (size_t threads = 1; threads <= maxThreads; threads++) {
+		ParallelDrawCollector collector(threads);
+		std::vector<DrawItem> draws;
+		// One untimed frame to size the arenas and the draw list.
+		collector.collect(objects, draws);
+		FrameArena::local().reset();
+
+		auto start = Clock::now();
+		for (size_t f = 0; f < frames; f++) {
+			collector.collect(objects, draws);
+			FrameArena::local().reset();
+		}
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+
+		if (threads == 1) {
+			reference = draws;
+			serialMs = ms;
+		}
+		bool deterministic = sameDraws(reference, draws);
+		std::cout << threads << " threads: " << ms << " ms/frame, speedup " << serialMs / ms
+			<< "x, " << draws.size() << " draws in " << collector.unitCount() << " units"
+			<< (deterministic ? "" : " -- MISMATCH against 1 thread") << std::endl;
+		if (!deterministic) {
+			return 1;
+		}
+	}
+	return 0;
+}
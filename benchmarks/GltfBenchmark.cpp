@@ -0,0 +1,141 @@
+/**
+Compares loading glTF models through the native loader with loading them through Assimp, in a
+headless GL context: the time from starting the load to the first frame drawn with the model,
+and the process's peak resident memory. As the peak can only grow, each loader runs in a process
+of its own; without a loader given, the benchmark runs itself once for each.
+
+Usage: GltfBenchmark [native|assimp] [model...]
+Defaults to models/tiger/scene.gltf; run from the repository root, so the shaders can be found.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/ext.hpp>
+#include "../AssimpImport.h"
+#include "../HeadlessContext.h"
+#include "../OffscreenTarget.h"
+#include "../ShaderProgram.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief The most memory the process has had resident at once, in bytes.
+ */
+size_t peakResidentBytes() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	return static_cast<size_t>(usage.ru_maxrss);
+#else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+/**
+ * @brief Draws one frame of the object, framed by the bounds of its meshes, and waits for the
+ * GPU to finish it.
+ */
+void drawFirstFrame(const Object3D& object, OffscreenTarget& target, ShaderProgram& program) {
+	std::vector<DrawItem> draws;
+	object.collectDraws(glm::mat4(1), draws);
+	glm::vec3 low(0), high(0);
+	for (size_t i = 0; i < draws.size(); i++) {
+		glm::vec3 center(draws[i].model * glm::vec4(draws[i].mesh->boundsCenter(), 1));
+		glm::vec3 extent(draws[i].mesh->boundsRadius());
+		low = i == 0 ? center - extent : glm::min(low, center - extent);
+		high = i == 0 ? center + extent : glm::max(high, center + extent);
+	}
+	glm::vec3 center = (low + high) * 0.5f;
+	float_t radius = std::max(glm::length(high - low) * 0.5f, 0.001f);
+
+	glm::mat4 view = glm::lookAt(center + glm::vec3(0, 0, radius * 3), center, glm::vec3(0, 1, 0));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+		static_cast<float_t>(target.width()) / target.height(), radius * 0.1f, radius * 10);
+	program.activate();
+	program.setUniform("view", view);
+	program.setUniform("projection", projection);
+	target.bind();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	for (auto& draw : draws) {
+		program.setUniform("model", draw.model);
+		draw.mesh->render(program);
+	}
+	glFinish();
+}
+
+int main(int argc, char* argv[]) {
+	std::string loader = argc > 1 ? argv[1] : "";
+	bool loaderGiven = loader == "native" || loader == "assimp";
+	std::vector<std::string> paths(argv + (loaderGiven ? 2 : 1), argv + argc);
+	if (paths.empty()) {
+		paths = { "models/tiger/scene.gltf" };
+	}
+
+	if (!loaderGiven) {
+		int status = 0;
+		for (auto name : { "native", "assimp" }) {
+			std::string command = std::string("\"") + argv[0] + "\" " + name;
+			for (auto& path : paths) {
+				command += " \"" + path + "\"";
+			}
+			status |= std::system(command.c_str());
+		}
+		return status == 0 ? 0 : 1;
+	}
+
+	HeadlessContext context;
+	OffscreenTarget target(1280, 720);
+	glEnable(GL_DEPTH_TEST);
+	ShaderProgram program;
+	program.load("shaders/texture_perspective.vert", "shaders/texturing.frag");
+	ImportSettings settings = ImportSettings::profile(ImportProfile::Balanced);
+	settings.flipTextureCoords = true;
+	settings.nativeLoaders = loader == "native";
+
+	std::cout << "Loading with " << context.renderer() << " through " << loader << ", steps "
+		<< settings.describe() << std::endl;
+	for (auto& path : paths) {
+		size_t peakBefore = peakResidentBytes();
+		ImportReport report;
+		double firstFrameMs = 0;
+		try {
+			auto start = Clock::now();
+			Object3D object = assimpLoad(path, settings, &report);
+			drawFirstFrame(object, target, program);
+			firstFrameMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+		catch (std::runtime_error& e) {
+			std::cout << path << ": ERROR: " << e.what() << std::endl;
+			continue;
+		}
+		size_t peakAfter = peakResidentBytes();
+
+		std::cout << path << " (" << loader << ")" << std::endl;
+		std::cout << "  " << report.describe() << std::endl;
+		std::cout << std::fixed << std::setprecision(1) << "  time to first frame: " << firstFrameMs
+			<< " ms, peak resident: " << peakAfter / (1024.0 * 1024) << " MiB ("
+			<< peakBefore / (1024.0 * 1024) << " MiB before loading)" << std::defaultfloat << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,83 @@
+/**
+Compares the cost of reaching an object through an ObjectStore handle against a raw pointer,
+for root objects and for cached descendants, in random access order.
+
+Usage: HandleBenchmark [objects] [lookups]
+*/
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include "../ObjectStore.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Runs the lookup function for every index in the access order, and returns the
+ * average nanoseconds per lookup.
+ */
+template <typename Lookup>
+double timeLookups(const std::vector<uint32_t>& order, Lookup lookup, float_t& checksum) {
+	auto start = Clock::now();
+	for (uint32_t i : order) {
+		checksum += lookup(i).getPosition().x;
+	}
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / order.size();
+}
+
+int main(int argc, char* argv[]) {
+	size_t objectCount = argc > 1 ? std::stoul(argv[1]) : 100000;
+	size_t lookupCount = argc > 2 ? std::stoul(argv[2]) : 10000000;
+
+	// Every root object has one child, so descendant handles can be measured too.
+	ObjectStore store;
+	std::vector<ObjectHandle> roots;
+	std::vector<ObjectHandle> children;
+	for (size_t i = 0; i < objectCount; i++) {
+		Object3D object(std::vector<Mesh3D>{});
+		object.setPosition(glm::vec3(static_cast<float_t>(i), 0, 0));
+		object.addChild(Object3D(std::vector<Mesh3D>{}));
+		roots.push_back(store.insert(std::move(object)));
+	}
+	for (auto root : roots) {
+		children.push_back(store.child(root, 0));
+	}
+
+	// Raw pointers into the store, as the baseline; valid because nothing moves from here on.
+	std::vector<Object3D*> rootPointers;
+	std::vector<Object3D*> childPointers;
+	for (size_t i = 0; i < objectCount; i++) {
+		rootPointers.push_back(&store.get(roots[i]));
+		childPointers.push_back(&store.get(children[i]));
+	}
+
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<uint32_t> anyObject(0, static_cast<uint32_t>(objectCount - 1));
+	std::vector<uint32_t> order(lookupCount);
+	for (auto& i : order) {
+		i = anyObject(random);
+	}
+
+	float_t checksum = 0;
+	double rawRoot = timeLookups(order, [&](uint32_t i) -> Object3D& { return *rootPointers[i]; }, checksum);
+	double handleRoot = timeLookups(order, [&](uint32_t i) -> Object3D& { return store.get(roots[i]); }, checksum);
+	double rawChild = timeLookups(order, [&](uint32_t i) -> Object3D& { return *childPointers[i]; }, checksum);
+	double handleChild = timeLookups(order, [&](uint32_t i) -> Object3D& { return store.get(children[i]); }, checksum);
+
+	// Compaction moves every object; the first descendant lookups afterwards re-resolve.
+	auto start = Clock::now();
+	store.compact();
+	double compactMillis = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	double handleChildAfterCompact = timeLookups(order, [&](uint32_t i) -> Object3D& { return store.get(children[i]); }, checksum);
+
+	std::cout << "objects: " << objectCount << ", lookups: " << lookupCount << std::endl;
+	std::cout << "root, raw pointer: " << rawRoot << " ns/lookup" << std::endl;
+	std::cout << "root, handle: " << handleRoot << " ns/lookup" << std::endl;
+	std::cout << "child, raw pointer: " << rawChild << " ns/lookup" << std::endl;
+	std::cout << "child, handle: " << handleChild << " ns/lookup" << std::endl;
+	std::cout << "compact: " << compactMillis << " ms; child, handle after compact: "
+		<< handleChildAfterCompact << " ns/lookup" << std::endl;
+	std::cout << "(checksum " << checksum << ")" << std::endl;
+	return 0;
+}
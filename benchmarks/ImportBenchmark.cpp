@@ -0,0 +1,127 @@
+/**
+Loads every model under a directory repeatedly through assimpLoad, in a headless GL context,
+and reports the distribution of each import phase's time across the runs, and the heap
+allocations of the first run: their number, their total size, and the most the heap grew.
+Assets are imported with an import profile, or an explicit list of steps, whose times are
+reported alongside the phases', so profiles can be tuned per asset class.
+
+Usage: ImportBenchmark [directory] [runs] [fast|balanced|max|step,step,...]
+Defaults to models/, 5 runs and the balanced profile; run from the repository root. GL objects
+of earlier runs are not freed, so keep the run count modest for large assets.
+
+To compare heap use with a revision from before these counts, build it with this benchmark and
+AllocationTracker.h/.cpp copied in from the revision that added them, which depend on nothing
+else that changed then; both revisions are then counted alike. The before and after figures
+for models/boat/boat.fbx and models/tiger/scene.gltf have not been measured yet.
+*/
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../AllocationTracker.h"
+#include "../AssimpImport.h"
+#include "../HeadlessContext.h"
+
+/**
+ * @brief Prints the minimum, median, mean and maximum of a phase's times.
+ */
+void printDistribution(const std::string& phase, std::vector<double> ms) {
+	std::sort(ms.begin(), ms.end());
+	double total = 0;
+	for (double t : ms) {
+		total += t;
+	}
+	std::cout << "  " << std::left << std::setw(16) << phase << std::right << std::fixed
+		<< std::setprecision(2) << "min " << std::setw(9) << ms.front() << "  median "
+		<< std::setw(9) << ms[ms.size() / 2] << "  mean " << std::setw(9) << total / ms.size()
+		<< "  max " << std::setw(9) << ms.back() << " ms" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+	std::filesystem::path directory = argc > 1 ? argv[1] : "models";
+	size_t runs = argc > 2 ? std::max<size_t>(std::stoul(argv[2]), 1) : 5;
+	ImportSettings settings = ImportSettings::parse(argc > 3 ? argv[3] : "balanced");
+	settings.flipTextureCoords = true;
+	const std::vector<std::string> extensions = { ".obj", ".fbx", ".gltf", ".glb", ".dae", ".3ds", ".ply", ".stl" };
+
+	HeadlessContext context;
+	std::cout << "Importing with " << context.renderer() << ", steps " << settings.describe() << std::endl;
+
+	std::vector<std::filesystem::path> assets;
+	for (auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (entry.is_regular_file() && std::find(extensions.begin(), extensions.end(), extension) != extensions.end()) {
+			assets.push_back(entry.path());
+		}
+	}
+	std::sort(assets.begin(), assets.end());
+
+	AllocationTracker& allocations = AllocationTracker::current();
+	allocations.enable();
+	for (auto& asset : assets) {
+		std::vector<ImportReport> reports;
+		reports.reserve(runs);
+		FrameAllocations heap;
+		try {
+			for (size_t run = 0; run < runs; run++) {
+				ImportReport report;
+				// Each run is counted as a frame of its own; the first run's counts are reported.
+				allocations.beginFrame(false);
+				assimpLoad(asset.string(), settings, &report);
+				FrameAllocations counts = allocations.endFrame();
+				if (run == 0) {
+					heap = counts;
+				}
+				reports.push_back(report);
+			}
+		}
+		catch (std::runtime_error& e) {
+			std::cout << asset.string() << ": ERROR: " << e.what() << std::endl;
+			continue;
+		}
+
+		std::cout << asset.string() << " (" << runs << " runs)" << std::endl;
+		std::cout << "  " << reports[0].describe() << std::endl;
+		AllocationCounts total = heap.total();
+		std::cout << "  heap: " << total.allocations << " allocations, " << total.frees << " frees, "
+			<< total.bytes / (1024 * 1024) << " MiB allocated, peak growth "
+			<< heap.peakHeapGrowth / (1024 * 1024) << " MiB" << std::endl;
+		auto phase = [&](const std::string& name, double ImportReport::* field) {
+			std::vector<double> ms;
+			for (auto& r : reports) {
+				ms.push_back(r.*field);
+			}
+			printDistribution(name, ms);
+		};
+		phase("parse", &ImportReport::parseMs);
+		phase("post-process", &ImportReport::postProcessMs);
+		phase("skeleton", &ImportReport::skeletonMs);
+		phase("process", &ImportReport::processMs);
+		phase("texture decode", &ImportReport::textureDecodeMs);
+		phase("texture upload", &ImportReport::textureUploadMs);
+		phase("mesh upload", &ImportReport::meshUploadMs);
+		std::vector<double> other;
+		for (auto& r : reports) {
+			other.push_back(r.otherMs());
+		}
+		printDistribution("other", other);
+		phase("total", &ImportReport::totalMs);
+		// Summed over threads, for our steps.
+		phase("  convert", &ImportReport::convertMs);
+		for (size_t s = 0; s < IMPORT_STEP_COUNT; s++) {
+			if (settings.has(static_cast<ImportStep>(s)) || s == static_cast<size_t>(ImportStep::Triangulate)
+				|| s == static_cast<size_t>(ImportStep::SortByType)) {
+				std::vector<double> ms;
+				for (auto& r : reports) {
+					ms.push_back(r.stepMs[s]);
+				}
+				printDistribution("  " + std::string(importStepName(static_cast<ImportStep>(s))), ms);
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,71 @@
+/**
+Compares loading OBJ files through the native loader with loading them through Assimp, both
+with the same import profile, in a headless GL context. Reports the fastest of the runs for
+each, the speedup against the 10x target, and what each produced.
+
+Usage: ObjBenchmark [runs] [profile] [model.obj...]
+Defaults to 5 runs, the balanced profile, and bunny.obj and models/bunny_textured.obj; run
+from the repository root.
+*/
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../AssimpImport.h"
+#include "../HeadlessContext.h"
+
+// The speedup over Assimp the native loader is meant to reach.
+const double TARGET_SPEEDUP = 10;
+
+/**
+ * @brief Loads a file repeatedly and returns the report of the fastest run.
+ */
+ImportReport fastestLoad(const std::string& path, const ImportSettings& settings, size_t runs) {
+	ImportReport fastest;
+	for (size_t run = 0; run < runs; run++) {
+		ImportReport report;
+		assimpLoad(path, settings, &report);
+		if (run == 0 || report.totalMs < fastest.totalMs) {
+			fastest = report;
+		}
+	}
+	return fastest;
+}
+
+int main(int argc, char* argv[]) {
+	size_t runs = argc > 1 ? std::max<size_t>(std::stoul(argv[1]), 1) : 5;
+	ImportSettings settings = ImportSettings::parse(argc > 2 ? argv[2] : "balanced");
+	settings.flipTextureCoords = true;
+	std::vector<std::string> paths(argv + std::min(argc, 3), argv + argc);
+	if (paths.empty()) {
+		paths = { "bunny.obj", "models/bunny_textured.obj" };
+	}
+
+	HeadlessContext context;
+	std::cout << "Loading with " << context.renderer() << ", steps " << settings.describe() << std::endl;
+	for (auto& path : paths) {
+		ImportReport native, assimp;
+		try {
+			settings.nativeLoaders = true;
+			native = fastestLoad(path, settings, runs);
+			settings.nativeLoaders = false;
+			assimp = fastestLoad(path, settings, runs);
+		}
+		catch (std::runtime_error& e) {
+			std::cout << path << ": ERROR: " << e.what() << std::endl;
+			continue;
+		}
+		std::cout << path << " (" << runs << " runs, fastest shown)" << std::endl;
+		std::cout << "  native: " << native.describe() << std::endl;
+		std::cout << "  assimp: " << assimp.describe() << std::endl;
+		double speedup = assimp.totalMs / native.totalMs;
+		std::cout << std::fixed << std::setprecision(1) << "  speedup: " << speedup
+			<< "x in total, " << (assimp.parseMs + assimp.postProcessMs + assimp.processMs)
+				/ (native.parseMs + native.postProcessMs + native.processMs)
+			<< "x before upload; " << (speedup >= TARGET_SPEEDUP ? "meets" : "below") << " the "
+			<< TARGET_SPEEDUP << "x target" << std::defaultfloat << std::endl;
+	}
+	return 0;
+}
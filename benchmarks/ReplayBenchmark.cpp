@@ -0,0 +1,82 @@
+/**
+Replays a GL capture (main --headless --capture FILE) in a headless GL context as fast as the
+driver allows, with none of the program's scene code, and reports the distribution of frame
+times. Comparing replays of the same capture isolates driver and GPU changes; comparing
+captures of two builds on one machine isolates changes in the calls the renderer makes.
+
+Usage: ReplayBenchmark capture [passes]
+Replays the setup once, then every frame in order for the given number of passes (default 5).
+Each frame's time runs until glFinish returns, so it includes the GPU's work.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include "../GLCapture.h"
+#include "../HeadlessContext.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+/**
+ * @brief Prints the minimum, median, mean and maximum of a set of times.
+ */
+void printDistribution(const std::string& name, std::vector<double> ms) {
+	std::sort(ms.begin(), ms.end());
+	double total = 0;
+	for (double t : ms) {
+		total += t;
+	}
+	std::cout << "  " << std::left << std::setw(16) << name << std::right << std::fixed
+		<< std::setprecision(3) << "min " << std::setw(9) << ms.front() << "  median "
+		<< std::setw(9) << ms[ms.size() / 2] << "  mean " << std::setw(9) << total / ms.size()
+		<< "  max " << std::setw(9) << ms.back() << " ms" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cout << "Usage: ReplayBenchmark capture [passes]" << std::endl;
+		return 1;
+	}
+	size_t passes = argc > 2 ? std::max<size_t>(std::stoul(argv[2]), 1) : 5;
+
+	HeadlessContext context;
+	std::cout << "Replaying on " << context.renderer() << std::endl;
+	try {
+		auto loadStart = BenchClock::now();
+		GLReplay replay(argv[1]);
+		auto setupStart = BenchClock::now();
+		replay.replaySetup();
+		glFinish();
+		auto setupEnd = BenchClock::now();
+		std::cout << argv[1] << ": " << replay.frameCount() << " frames; loaded in "
+			<< std::chrono::duration<double, std::milli>(setupStart - loadStart).count() << " ms, setup ("
+			<< replay.calls() << " calls) replayed in "
+			<< std::chrono::duration<double, std::milli>(setupEnd - setupStart).count() << " ms" << std::endl;
+		if (replay.frameCount() == 0) {
+			return 0;
+		}
+
+		uint64_t setupCalls = replay.calls();
+		std::vector<double> frameMs;
+		for (size_t pass = 0; pass < passes; pass++) {
+			for (size_t frame = 0; frame < replay.frameCount(); frame++) {
+				auto start = BenchClock::now();
+				replay.replayFrame(frame);
+				glFinish();
+				frameMs.push_back(std::chrono::duration<double, std::milli>(BenchClock::now() - start).count());
+			}
+		}
+		std::cout << passes << " passes, " << (replay.calls() - setupCalls) / frameMs.size()
+			<< " calls per frame" << std::endl;
+		printDistribution("frame", frameMs);
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,322 @@
+/**
+Runs a suite of procedurally generated scenes headlessly and reports the CPU time of each frame
+phase (animation, transform, culling, submission) with draw-call and state-change counts, as
+JSON. Given a baseline from an earlier run, it fails if any phase regressed.
+
+Usage: SceneBenchmark [--frames N] [--quick] [--out results.json]
+	[--baseline old.json] [--tolerance 0.10]
+Run from the repository root, so the shaders can be found.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <glad/glad.h>
+#include <glm/ext.hpp>
+#include "../Frustum.h"
+#include "../HeadlessContext.h"
+#include "../Json.h"
+#include "../OffscreenTarget.h"
+#include "../SceneGenerator.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Scenario {
+	std::string name;
+	SyntheticSceneSettings settings;
+};
+
+/**
+ * @brief Average per-frame results of one scenario.
+ */
+struct ScenarioResult {
+	std::string name;
+	SyntheticSceneSettings settings;
+	std::map<std::string, double> metrics;
+};
+
+// The metrics compared against a baseline; lower is better for all of them.
+const char* PHASES[] = { "animation_ms", "transform_ms", "culling_ms", "submission_ms", "frame_ms" };
+
+std::vector<Scenario> suite(bool quick) {
+	std::vector<Scenario> scenarios;
+	auto add = [&](const std::string& name, size_t objects, size_t depth, size_t fanout,
+		size_t meshes, size_t triangles, size_t textures, float_t animated) {
+		SyntheticSceneSettings s;
+		s.objectCount = objects;
+		s.depth = depth;
+		s.fanout = fanout;
+		s.meshesPerNode = meshes;
+		s.trianglesPerMesh = triangles;
+		s.uniqueTextures = textures;
+		s.animatedFraction = animated;
+		scenarios.push_back(Scenario{ name, s });
+	};
+	// Object count scaling.
+	add("objects_1k", 1000, 3, 4, 1, 128, 8, 0.1f);
+	add("objects_10k", 10000, 3, 4, 1, 128, 8, 0.1f);
+	if (!quick) {
+		add("objects_100k", 100000, 3, 4, 1, 128, 8, 0.1f);
+	}
+	// Hierarchy shape: flat versus deep.
+	add("flat_10k", 10000, 1, 1, 1, 128, 8, 0.1f);
+	add("deep_10k", 10000, 8, 2, 1, 128, 8, 0.1f);
+	// Geometry and state variety.
+	add("heavy_meshes", 1000, 3, 4, 1, 8192, 8, 0.1f);
+	add("many_meshes_per_node", 2000, 3, 4, 8, 128, 8, 0.1f);
+	add("many_textures", 10000, 3, 4, 1, 128, 256, 0.1f);
+	// Animation load.
+	add("all_animated_10k", 10000, 3, 4, 1, 128, 8, 1.0f);
+	return scenarios;
+}
+
+/**
+ * @brief The number of GL state changes submitting the draws in order requires: a texture or
+ * vertex array bind whenever it differs from the previous draw's.
+ */
+size_t countStateChanges(const std::vector<DrawItem>& draws) {
+	size_t changes = 0;
+	uint64_t previous = ~0ull;
+	for (auto& draw : draws) {
+		changes += (draw.sortKey >> 32) != (previous >> 32);
+		changes += (draw.sortKey & 0xffffffff) != (previous & 0xffffffff);
+		previous = draw.sortKey;
+	}
+	return changes;
+}
+
+double millisecondsSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+ScenarioResult runScenario(const Scenario& scenario, size_t frames, OffscreenTarget& target,
+	ShaderProgram& program) {
+	auto generateStart = Clock::now();
+	SyntheticScene scene = generateScene(scenario.settings);
+	double generateMs = millisecondsSince(generateStart);
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0, 0, 5), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+		static_cast<float_t>(target.width()) / target.height(), 0.1f, 100.0f);
+	Frustum frustum = Frustum::fromMatrix(projection * view);
+	program.activate();
+	program.setUniform("view", view);
+	program.setUniform("projection", projection);
+
+	std::vector<DrawItem> draws;
+	std::vector<DrawItem> visible;
+	std::map<std::string, double> totals;
+	const float_t dt = 1.0f / 60;
+	// One untimed frame first, to size every buffer.
+	for (size_t frame = 0; frame <= frames; frame++) {
+		auto frameStart = Clock::now();
+		scene.tracks.tick(scene.objects, dt);
+		double animationMs = millisecondsSince(frameStart);
+
+		auto phaseStart = Clock::now();
+		draws.clear();
+		for (auto& o : scene.objects) {
+			o.collectDraws(glm::mat4(1), draws);
+		}
+		double transformMs = millisecondsSince(phaseStart);
+
+		phaseStart = Clock::now();
+		cullDraws(frustum, draws, visible);
+		double cullingMs = millisecondsSince(phaseStart);
+
+		// Submission includes waiting for the GPU, so the driver's deferred work is counted.
+		phaseStart = Clock::now();
+		target.bind();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		for (auto& draw : visible) {
+			program.setUniform("model", draw.model);
+			draw.mesh->render(program);
+		}
+		glFinish();
+		double submissionMs = millisecondsSince(phaseStart);
+
+		if (frame == 0) {
+			continue;
+		}
+		totals["animation_ms"] += animationMs;
+		totals["transform_ms"] += transformMs;
+		totals["culling_ms"] += cullingMs;
+		totals["submission_ms"] += submissionMs;
+		totals["frame_ms"] += millisecondsSince(frameStart);
+		totals["draws_total"] += draws.size();
+		totals["draw_calls"] += visible.size();
+		totals["state_changes"] += countStateChanges(visible);
+	}
+
+	ScenarioResult result{ scenario.name, scenario.settings, {} };
+	for (auto& total : totals) {
+		result.metrics[total.first] = total.second / frames;
+	}
+	result.metrics["generate_ms"] = generateMs;
+	result.metrics["animated_objects"] = static_cast<double>(scene.animatedCount);
+	result.metrics["triangles"] = static_cast<double>(scene.triangleCount);
+	return result;
+}
+
+/**
+ * @brief Quotes text as a JSON string, escaping quotes, backslashes and control characters.
+ */
+std::string jsonString(const std::string& text) {
+	std::string quoted = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			quoted += '\\';
+			quoted += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20) {
+			char escape[8];
+			std::snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+			quoted += escape;
+		}
+		else {
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+/**
+ * @brief Writes the results as JSON, one scenario object per line so baselines are easy to
+ * diff.
+ */
+void writeJson(std::ostream& out, const std::string& renderer, size_t frames,
+	const std::vector<ScenarioResult>& results) {
+	out << "{\n  \"renderer\": " << jsonString(renderer) << ",\n  \"frames\": " << frames
+		<< ",\n  \"scenarios\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		auto& r = results[i];
+		out << "    {\"name\": " << jsonString(r.name) << ", \"objects\": " << r.settings.objectCount
+			<< ", \"depth\": " << r.settings.depth << ", \"fanout\": " << r.settings.fanout
+			<< ", \"meshes_per_node\": " << r.settings.meshesPerNode
+			<< ", \"triangles_per_mesh\": " << r.settings.trianglesPerMesh
+			<< ", \"unique_textures\": " << r.settings.uniqueTextures
+			<< ", \"animated_fraction\": " << r.settings.animatedFraction;
+		for (auto& metric : r.metrics) {
+			out << ", \"" << metric.first << "\": " << metric.second;
+		}
+		out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+}
+
+/**
+ * @brief Reads the metrics of each scenario from JSON in the form writeJson writes, however it
+ * is laid out. Throws std::runtime_error if the file is not JSON of that form.
+ */
+std::map<std::string, std::map<std::string, double>> readBaseline(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		throw std::runtime_error("Could not open baseline " + path);
+	}
+	std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	JsonValue json = parseJson(text.data(), text.data() + text.size());
+	const JsonValue* scenarios = json.find("scenarios");
+	if (scenarios == nullptr || scenarios->type != JsonValue::Type::Array) {
+		throw std::runtime_error("Baseline " + path + " has no scenarios array");
+	}
+
+	std::map<std::string, std::map<std::string, double>> baseline;
+	for (auto& scenario : scenarios->elements) {
+		const JsonValue* name = scenario.find("name");
+		if (name == nullptr || name->type != JsonValue::Type::String) {
+			throw std::runtime_error("Baseline " + path + " has a scenario without a name");
+		}
+		for (const char* phase : PHASES) {
+			const JsonValue* value = scenario.find(phase);
+			if (value != nullptr && value->type == JsonValue::Type::Number) {
+				baseline[name->string][phase] = value->number;
+			}
+		}
+	}
+	return baseline;
+}
+
+int main(int argc, char* argv[]) {
+	size_t frames = 100;
+	bool quick = false;
+	std::string outPath;
+	std::string baselinePath;
+	double tolerance = 0.10;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--frames" && i + 1 < argc) {
+			frames = std::max<size_t>(std::stoul(argv[++i]), 1);
+		}
+		else if (arg == "--quick") {
+			quick = true;
+		}
+		else if (arg == "--out" && i + 1 < argc) {
+			outPath = argv[++i];
+		}
+		else if (arg == "--baseline" && i + 1 < argc) {
+			baselinePath = argv[++i];
+		}
+		else if (arg == "--tolerance" && i + 1 < argc) {
+			tolerance = std::stod(argv[++i]);
+		}
+	}
+
+	HeadlessContext context;
+	OffscreenTarget target(1280, 720);
+	glEnable(GL_DEPTH_TEST);
+	ShaderProgram program;
+	program.load("shaders/texture_perspective.vert", "shaders/texturing.frag");
+
+	std::vector<ScenarioResult> results;
+	for (auto& scenario : suite(quick)) {
+		results.push_back(runScenario(scenario, frames, target, program));
+		auto& m = results.back().metrics;
+		std::cerr << scenario.name << ": frame " << m["frame_ms"] << " ms (animation "
+			<< m["animation_ms"] << ", transform " << m["transform_ms"] << ", culling "
+			<< m["culling_ms"] << ", submission " << m["submission_ms"] << "), "
+			<< m["draw_calls"] << " draw calls, " << m["state_changes"] << " state changes" << std::endl;
+	}
+
+	std::ostringstream json;
+	writeJson(json, context.renderer(), frames, results);
+	if (outPath.empty()) {
+		std::cout << json.str();
+	}
+	else {
+		std::ofstream(outPath) << json.str();
+	}
+
+	if (baselinePath.empty()) {
+		return 0;
+	}
+	// Differences below a small absolute floor are timer noise, not regressions.
+	const double noiseMs = 0.05;
+	auto baseline = readBaseline(baselinePath);
+	bool regressed = false;
+	for (auto& result : results) {
+		auto scenario = baseline.find(result.name);
+		if (scenario == baseline.end()) {
+			continue;
+		}
+		for (const char* phase : PHASES) {
+			auto before = scenario->second.find(phase);
+			if (before == scenario->second.end()) {
+				continue;
+			}
+			double now = result.metrics[phase];
+			if (now > before->second * (1 + tolerance) && now - before->second > noiseMs) {
+				std::cerr << "REGRESSION: " << result.name << " " << phase << " " << before->second
+					<< " -> " << now << " ms" << std::endl;
+				regressed = true;
+			}
+		}
+	}
+	return regressed ? 1 : 0;
+}
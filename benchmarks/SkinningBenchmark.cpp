@@ -0,0 +1,105 @@
+/**
+Measures the CPU cost of animating one skinned character: sampling a clip, composing the
+skeleton, and building the bone palette (all that the GPU skinning path needs per frame), and
+separately the cost of the CPU skinning fallback.
+
+Usage: SkinningBenchmark [bones] [vertices] [iterations]
+*/
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include "../Skeleton.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Builds a binary tree of bones, with a clip that animates every bone at 30 keys per second.
+ */
+std::shared_ptr<Skeleton> syntheticSkeleton(size_t boneCount, float_t clipSeconds) {
+	auto skeleton = std::make_shared<Skeleton>();
+	for (size_t i = 0; i < boneCount; i++) {
+		int32_t parent = i == 0 ? -1 : static_cast<int32_t>((i - 1) / 2);
+		skeleton->addNode("bone" + std::to_string(i), parent, glm::vec3(0, 1, 0),
+			glm::quat(1, 0, 0, 0), glm::vec3(1, 1, 1));
+	}
+
+	SkeletalClip clip;
+	clip.name = "synthetic";
+	clip.duration = clipSeconds;
+	size_t keyCount = static_cast<size_t>(clipSeconds * 30) + 1;
+	for (size_t i = 0; i < boneCount; i++) {
+		std::vector<float_t> times;
+		std::vector<glm::vec4> translations;
+		std::vector<glm::vec4> rotations;
+		for (size_t k = 0; k < keyCount; k++) {
+			float_t t = k / 30.0f;
+			float_t angle = std::sin(t + i) * 0.5f;
+			times.push_back(t);
+			translations.emplace_back(0, 1 + 0.1f * std::sin(t * 3), 0, 0);
+			rotations.emplace_back(std::sin(angle / 2), 0, 0, std::cos(angle / 2));
+		}
+		clip.translations.addChannel(static_cast<uint32_t>(i), times, translations);
+		clip.rotations.addChannel(static_cast<uint32_t>(i), times, rotations);
+	}
+	skeleton->addClip(std::move(clip));
+
+	std::vector<uint32_t> boneNodes;
+	std::vector<glm::mat4> offsets;
+	for (size_t i = 0; i < boneCount; i++) {
+		boneNodes.push_back(static_cast<uint32_t>(i));
+		offsets.push_back(glm::mat4(1));
+	}
+	skeleton->addSkin(0, std::move(boneNodes), std::move(offsets));
+	skeleton->play(0);
+	return skeleton;
+}
+
+int main(int argc, char* argv[]) {
+	size_t boneCount = argc > 1 ? std::stoul(argv[1]) : 121;
+	size_t vertexCount = argc > 2 ? std::stoul(argv[2]) : 20000;
+	size_t iterations = argc > 3 ? std::stoul(argv[3]) : 1000;
+
+	auto skeleton = syntheticSkeleton(boneCount, 2.0f);
+
+	// Each vertex is influenced by 4 random bones.
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<uint32_t> anyBone(0, static_cast<uint32_t>(boneCount - 1));
+	std::uniform_real_distribution<float_t> anyFloat(0, 1);
+	std::vector<Vertex3D> bindVertices;
+	std::vector<VertexBoneData> influences(vertexCount);
+	bindVertices.reserve(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		bindVertices.emplace_back(anyFloat(random), anyFloat(random), anyFloat(random), 0, 1, 0, 0, 0);
+		for (size_t i = 0; i < 4; i++) {
+			influences[v].add(anyBone(random), anyFloat(random) + 0.01f);
+		}
+		influences[v].normalize();
+	}
+	std::vector<Vertex3D> skinned = bindVertices;
+
+	// Pose evaluation: the per-character cost of the GPU skinning path.
+	auto start = Clock::now();
+	for (size_t i = 0; i < iterations; i++) {
+		skeleton->tick(1 / 60.0f);
+	}
+	double poseMicros = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / iterations;
+
+	// CPU skinning of every vertex: the additional cost of the fallback path.
+	start = Clock::now();
+	for (size_t i = 0; i < iterations; i++) {
+		skeleton->skinVertices(0, bindVertices.data(), influences.data(), vertexCount, skinned.data());
+	}
+	double skinMicros = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / iterations;
+
+	const double frameMicros = 1e6 / 60.0;
+	std::cout << "bones: " << boneCount << ", vertices: " << vertexCount
+		<< ", iterations: " << iterations << std::endl;
+	std::cout << "pose + palette: " << poseMicros << " us/character ("
+		<< static_cast<size_t>(frameMicros / poseMicros) << " characters per 60 Hz frame)" << std::endl;
+	std::cout << "CPU skinning: " << skinMicros << " us/character ("
+		<< static_cast<size_t>(frameMicros / (poseMicros + skinMicros)) << " characters per 60 Hz frame)"
+		<< std::endl;
+	return 0;
+}
@@ -0,0 +1,266 @@
+/**
+Compares a LooseOctree and a SpatialHash against brute force on moving boxes, as animated
+objects' bounds: the cost of updating every box after it moves, of removing a quarter of them,
+and of frustum, sphere, box and k-nearest queries. Boxes are scattered at a constant density, so
+queries find about the same number of boxes at every object count; a few are empty, as the
+bounds of objects without meshes are. Every index must return the same set of boxes as brute
+force for every query, and k-nearest boxes at the same distances.
+
+Usage: SpatialBenchmark [objects...]
+Runs each object count given (default 10000 100000 1000000).
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/ext.hpp>
+#include "../SpatialIndex.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief The baseline: every box in an array, and every query a scan of all of them.
+ */
+class BruteForce {
+private:
+	std::vector<BoundingBox> m_boxes;
+	std::vector<bool> m_live;
+
+	template <typename Overlaps>
+	void scan(const Overlaps& overlaps, std::vector<uint32_t>& results) const {
+		for (uint32_t i = 0; i < m_boxes.size(); i++) {
+			if (m_live[i] && overlaps(m_boxes[i])) {
+				results.push_back(i);
+			}
+		}
+	}
+
+public:
+	// Boxes are numbered in insertion order, and carry their number as their value.
+	uint32_t insert(const BoundingBox& bounds, uint32_t) {
+		m_boxes.push_back(bounds);
+		m_live.push_back(true);
+		return static_cast<uint32_t>(m_boxes.size() - 1);
+	}
+	void update(uint32_t id, const BoundingBox& bounds) { m_boxes[id] = bounds; }
+	void remove(uint32_t id) { m_live[id] = false; }
+
+	void queryBox(const BoundingBox& box, std::vector<uint32_t>& results) const {
+		scan([&box](const BoundingBox& b) { return b.intersects(box); }, results);
+	}
+	void querySphere(const glm::vec3& center, float_t radius, std::vector<uint32_t>& results) const {
+		scan([&](const BoundingBox& b) { return b.distanceSquared(center) <= radius * radius; }, results);
+	}
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const {
+		scan([&frustum](const BoundingBox& b) { return frustum.intersectsBox(b.low, b.high); }, results);
+	}
+	void nearest(const glm::vec3& point, size_t k, std::vector<uint32_t>& results) const {
+		std::vector<std::pair<float_t, uint32_t>> distances;
+		for (uint32_t i = 0; i < m_boxes.size(); i++) {
+			if (m_live[i]) {
+				distances.push_back({ m_boxes[i].distanceSquared(point), i });
+			}
+		}
+		k = std::min(k, distances.size());
+		std::partial_sort(distances.begin(), distances.begin() + k, distances.end());
+		results.clear();
+		for (size_t i = 0; i < k; i++) {
+			results.push_back(distances[i].second);
+		}
+	}
+};
+
+/**
+ * @brief The boxes, their motion, and the queries of one run.
+ */
+struct Workload {
+	std::vector<BoundingBox> boxes;
+	std::vector<glm::vec3> velocities;
+	std::vector<Frustum> frustums;
+	std::vector<glm::vec3> points;
+	float_t extent;
+};
+
+const float_t QUERY_RADIUS = 8;
+const size_t NEAREST_COUNT = 16;
+const size_t MOVE_FRAMES = 5;
+// Every this many boxes, one is empty; and after moving, one is removed.
+const size_t EMPTY_INTERVAL = 1000;
+const size_t REMOVE_INTERVAL = 4;
+
+Workload makeWorkload(size_t objectCount, size_t queryCount) {
+	Workload workload;
+	// One box per 64 cubic units.
+	workload.extent = 4 * std::cbrt(static_cast<float_t>(objectCount));
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float_t> position(-workload.extent / 2, workload.extent / 2);
+	std::uniform_real_distribution<float_t> size(0.25f, 1);
+	std::uniform_real_distribution<float_t> speed(-0.2f, 0.2f);
+	float_t inf = std::numeric_limits<float_t>::infinity();
+	for (size_t i = 0; i < objectCount; i++) {
+		glm::vec3 center(position(random), position(random), position(random));
+		float_t half = size(random);
+		if (i % EMPTY_INTERVAL == EMPTY_INTERVAL - 1) {
+			// As hierarchyBounds gives for an object without meshes; it stays empty as it moves.
+			workload.boxes.push_back(BoundingBox{ glm::vec3(inf), glm::vec3(-inf) });
+		}
+		else {
+			workload.boxes.push_back(BoundingBox{ center - glm::vec3(half), center + glm::vec3(half) });
+		}
+		workload.velocities.push_back(glm::vec3(speed(random), speed(random), speed(random)));
+	}
+	auto projection = glm::perspective(glm::radians(45.0f), 16.0f / 9, 0.1f, 50.0f);
+	for (size_t i = 0; i < queryCount; i++) {
+		glm::vec3 eye(position(random), position(random), position(random));
+		glm::vec3 target(position(random), position(random), position(random));
+		workload.frustums.push_back(Frustum::fromMatrix(projection * glm::lookAt(eye, target, glm::vec3(0, 1, 0))));
+		workload.points.push_back(glm::vec3(position(random), position(random), position(random)));
+	}
+	return workload;
+}
+
+/**
+ * @brief What an index answered to the queries of a workload, to check against brute force:
+ * the sorted values found by each overlap query, and the distances of the boxes each nearest
+ * query found. Nearest queries are compared by distance, as boxes at the same distance may be
+ * taken in either order.
+ */
+struct Answers {
+	std::vector<std::vector<uint32_t>> found;
+	std::vector<std::vector<float_t>> nearest;
+	size_t results = 0;
+
+	bool operator==(const Answers& other) const { return found == other.found && nearest == other.nearest; }
+};
+
+/**
+ * @brief Times one index through the workload, and prints the time per update, per removal
+ * and per query of each kind. Returns what the queries found.
+ */
+template <typename Index>
+Answers run(const std::string& name, Index& index, const Workload& workload) {
+	std::vector<uint32_t> ids;
+	auto start = Clock::now();
+	for (uint32_t i = 0; i < workload.boxes.size(); i++) {
+		ids.push_back(index.insert(workload.boxes[i], i));
+	}
+	double insertNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / workload.boxes.size();
+
+	// Every box moves every frame, as if every object were animated.
+	std::vector<BoundingBox> boxes = workload.boxes;
+	start = Clock::now();
+	for (size_t frame = 0; frame < MOVE_FRAMES; frame++) {
+		for (size_t i = 0; i < boxes.size(); i++) {
+			boxes[i].low = boxes[i].low + workload.velocities[i];
+			boxes[i].high = boxes[i].high + workload.velocities[i];
+			index.update(ids[i], boxes[i]);
+		}
+	}
+	double updateNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (MOVE_FRAMES * boxes.size());
+
+	start = Clock::now();
+	size_t removed = 0;
+	for (size_t i = 0; i < boxes.size(); i += REMOVE_INTERVAL) {
+		index.remove(ids[i]);
+		removed++;
+	}
+	double removeNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / std::max<size_t>(removed, 1);
+
+	// Queries are timed in batches, and their results kept afterwards, outside the timing.
+	Answers answers;
+	std::vector<std::vector<uint32_t>> batch(workload.points.size());
+	auto timeQueries = [&](auto query) {
+		for (auto& found : batch) {
+			found.clear();
+		}
+		auto queryStart = Clock::now();
+		for (size_t q = 0; q < workload.points.size(); q++) {
+			query(q, batch[q]);
+		}
+		double us = std::chrono::duration<double, std::micro>(Clock::now() - queryStart).count() / workload.points.size();
+		for (auto& found : batch) {
+			answers.results += found.size();
+		}
+		return us;
+	};
+	auto keepFound = [&]() {
+		for (auto& found : batch) {
+			std::sort(found.begin(), found.end());
+			answers.found.push_back(found);
+		}
+	};
+	double frustumUs = timeQueries([&](size_t q, std::vector<uint32_t>& found) {
+		index.queryFrustum(workload.frustums[q], found);
+	});
+	keepFound();
+	double sphereUs = timeQueries([&](size_t q, std::vector<uint32_t>& found) {
+		index.querySphere(workload.points[q], QUERY_RADIUS, found);
+	});
+	keepFound();
+	double boxUs = timeQueries([&](size_t q, std::vector<uint32_t>& found) {
+		index.queryBox(BoundingBox{ workload.points[q] - glm::vec3(QUERY_RADIUS), workload.points[q] + glm::vec3(QUERY_RADIUS) }, found);
+	});
+	keepFound();
+	double nearestUs = timeQueries([&](size_t q, std::vector<uint32_t>& found) {
+		index.nearest(workload.points[q], NEAREST_COUNT, found);
+	});
+	for (size_t q = 0; q < batch.size(); q++) {
+		std::vector<float_t> distances;
+		for (uint32_t value : batch[q]) {
+			distances.push_back(boxes[value].distanceSquared(workload.points[q]));
+		}
+		std::sort(distances.begin(), distances.end());
+		answers.nearest.push_back(distances);
+		// Each box at most once, and never a removed one.
+		std::sort(batch[q].begin(), batch[q].end());
+		if (std::adjacent_find(batch[q].begin(), batch[q].end()) != batch[q].end()
+			|| std::any_of(batch[q].begin(), batch[q].end(), [](uint32_t value) { return value % REMOVE_INTERVAL == 0; })) {
+			answers.nearest.back().push_back(-1);
+		}
+	}
+
+	std::cout << "  " << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(1)
+		<< "insert " << std::setw(7) << insertNs << " ns  update " << std::setw(7) << updateNs
+		<< " ns  remove " << std::setw(7) << removeNs << " ns  frustum " << std::setw(9) << frustumUs << " us  sphere " << std::setw(8) << sphereUs
+		<< " us  box " << std::setw(8) << boxUs << " us  " << NEAREST_COUNT << "-nearest " << std::setw(8)
+		<< nearestUs << " us" << std::endl;
+	return answers;
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<size_t> counts;
+	for (int i = 1; i < argc; i++) {
+		counts.push_back(std::stoul(argv[i]));
+	}
+	if (counts.empty()) {
+		counts = { 10000, 100000, 1000000 };
+	}
+
+	for (size_t count : counts) {
+		Workload workload = makeWorkload(count, 100);
+		std::cout << count << " boxes in a " << workload.extent << " unit cube" << std::endl;
+		// The octree covers the boxes' range of motion; the hash's cells are a few boxes across.
+		float_t margin = 0.2f * MOVE_FRAMES + 1;
+		float_t size = workload.extent + 2 * margin;
+		uint32_t depth = static_cast<uint32_t>(std::ceil(std::log2(size / 2)));
+		BruteForce brute;
+		LooseOctree octree(glm::vec3(-size / 2), size, depth);
+		SpatialHash hash(4);
+		Answers expected = run("brute force", brute, workload);
+		Answers octreeAnswers = run("octree", octree, workload);
+		Answers hashAnswers = run("hash", hash, workload);
+		if (!(octreeAnswers == expected) || !(hashAnswers == expected)) {
+			std::cout << "ERROR: results differ from brute force (" << expected.results << " expected, octree "
+				<< octreeAnswers.results << (octreeAnswers == expected ? "" : " wrong") << ", hash "
+				<< hashAnswers.results << (hashAnswers == expected ? "" : " wrong") << ")" << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,132 @@
+/**
+Compares weldVertices with Assimp's JoinIdenticalVertices step on model files: each file is
+read with Assimp's steps of the balanced import profile, and its smooth normals, then its
+meshes are welded by weldVertices on one thread and on a pool, and by Assimp. Reports how many
+vertices each kept and the fastest of the runs' times. No GL context is needed.
+
+Usage: WeldBenchmark [runs] [model...]
+Defaults to 5 runs of models/bunny_textured.obj and models/tiger/scene.gltf; run from the
+repository root.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include "../VertexWeld.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief One mesh's triangles, as fromAssimpMesh converts them.
+ */
+struct ConvertedMesh {
+	std::vector<Vertex3D> vertices;
+	std::vector<uint32_t> indices;
+};
+
+std::vector<ConvertedMesh> convert(const aiScene* scene) {
+	std::vector<ConvertedMesh> meshes;
+	for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+		const aiMesh* mesh = scene->mMeshes[m];
+		if (mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE) {
+			continue;
+		}
+		ConvertedMesh converted;
+		converted.vertices.reserve(mesh->mNumVertices);
+		for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+			const aiVector3D& position = mesh->mVertices[i];
+			aiVector3D normal = mesh->mNormals != nullptr ? mesh->mNormals[i] : aiVector3D(0, 0, 1);
+			aiVector3D uv = mesh->mTextureCoords[0] != nullptr ? mesh->mTextureCoords[0][i] : aiVector3D(0, 0, 0);
+			converted.vertices.emplace_back(position.x, position.y, position.z, normal.x, normal.y, normal.z, uv.x, uv.y);
+		}
+		converted.indices.reserve(mesh->mNumFaces * 3);
+		for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+			converted.indices.insert(converted.indices.end(), mesh->mFaces[i].mIndices, mesh->mFaces[i].mIndices + 3);
+		}
+		meshes.push_back(std::move(converted));
+	}
+	return meshes;
+}
+
+/**
+ * @brief Welds copies of the meshes and returns the time taken, not counting the copies.
+ */
+double weldAll(const std::vector<ConvertedMesh>& meshes, WorkerPool* pool, FrameArena& scratch, WeldReport& report) {
+	double ms = 0;
+	report = WeldReport();
+	for (auto& mesh : meshes) {
+		ConvertedMesh copy = mesh;
+		auto start = Clock::now();
+		size_t kept = weldVertices(copy.vertices.data(), copy.vertices.size(), copy.indices.data(),
+			copy.indices.size(), WeldSettings(), scratch, pool);
+		ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		scratch.reset();
+		report.inputVertices += copy.vertices.size();
+		report.outputVertices += kept;
+	}
+	report.ms = ms;
+	return ms;
+}
+
+int main(int argc, char* argv[]) {
+	size_t runs = argc > 1 ? std::max<size_t>(std::stoul(argv[1]), 1) : 5;
+	std::vector<std::string> paths(argv + std::min(argc, 2), argv + argc);
+	if (paths.empty()) {
+		paths = { "models/bunny_textured.obj", "models/tiger/scene.gltf" };
+	}
+	// Assimp's steps of the balanced profile, with Assimp's normals in place of ours.
+	const unsigned int steps = aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_GenSmoothNormals
+		| aiProcess_GenUVCoords | aiProcess_LimitBoneWeights;
+
+	WorkerPool pool;
+	FrameArena scratch(1 << 20);
+	std::cout << "Welding with " << pool.threadCount() << " threads" << std::endl;
+	for (auto& path : paths) {
+		double serialMs = 1e30, parallelMs = 1e30, assimpMs = 1e30;
+		WeldReport serial, parallel;
+		size_t assimpVertices = 0;
+		for (size_t run = 0; run < runs; run++) {
+			// JoinIdenticalVertices changes the scene, so every run reads the file again.
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(path, steps);
+			if (scene == nullptr) {
+				std::cout << path << ": ERROR: " << importer.GetErrorString() << std::endl;
+				break;
+			}
+			std::vector<ConvertedMesh> meshes = convert(scene);
+			serialMs = std::min(serialMs, weldAll(meshes, nullptr, scratch, serial));
+			parallelMs = std::min(parallelMs, weldAll(meshes, &pool, scratch, parallel));
+
+			auto start = Clock::now();
+			scene = importer.ApplyPostProcessing(aiProcess_JoinIdenticalVertices);
+			assimpMs = std::min(assimpMs, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			assimpVertices = 0;
+			for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+				if (scene->mMeshes[m]->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+					assimpVertices += scene->mMeshes[m]->mNumVertices;
+				}
+			}
+		}
+		if (parallel.inputVertices == 0) {
+			continue;
+		}
+
+		serial.ms = serialMs;
+		parallel.ms = parallelMs;
+		std::cout << path << " (" << runs << " runs, fastest shown)" << std::endl;
+		std::cout << "  weldVertices, 1 thread:  " << serial.describe() << std::endl;
+		std::cout << "  weldVertices, pool:      " << parallel.describe() << std::endl;
+		std::cout << std::fixed << std::setprecision(3) << "  JoinIdenticalVertices:   " << parallel.inputVertices
+			<< " vertices welded to " << assimpVertices << " (" << 100.0 * assimpVertices / parallel.inputVertices
+			<< "%) in " << assimpMs << " ms" << std::endl;
+		std::cout << "  speedup: " << std::setprecision(2) << assimpMs / serialMs << "x on 1 thread, "
+			<< assimpMs / parallelMs << "x on the pool" << std::defaultfloat << std::endl;
+	}
+	return 0;
+}
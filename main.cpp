@@ -2,14 +2,38 @@
 This application renders a textured mesh that was loaded with Assimp.
 */
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <random>
+#include <string>
 #include <glad/glad.h>
 
 #include "Mesh3D.h"
 #include "Object3D.h"
 #include "AssimpImport.h"
+#include "AllocationTracker.h"
 #include "Animator.h"
+#include "ClusteredLighting.h"
+#include "DeferredRenderer.h"
+#include "DepthPrepass.h"
+#include "FrameArena.h"
+#include "GLCapture.h"
+#include "GLState.h"
+#include "HeadlessContext.h"
+#include "KeyframeTracks.h"
+#include "Light.h"
+#include "ObjectStore.h"
+#include "OffscreenTarget.h"
+#include "ParallelDrawCollector.h"
+#include "RenderThread.h"
+#include "SceneFile.h"
+#include "WorldStreamer.h"
+#include "ShadowCascades.h"
+#include "Skeleton.h"
 #include "ShaderProgram.h"
 
 /**
@@ -17,10 +41,53 @@ This application renders a textured mesh that was loaded with Assimp.
  */
 struct Scene {
 	ShaderProgram defaultShader;
-	std::vector<Object3D> objects;
+	// The name of the function that constructed the shader, as recorded in scene files.
+	std::string shaderName;
+	ObjectStore objects;
 	std::vector<Animator> animators;
+	KeyframeTracks tracks;
+	std::vector<std::shared_ptr<Skeleton>> skeletons;
+	// Point and spot lights, shaded through clustered lighting if the scene has it.
+	std::vector<Light> lights;
+	std::unique_ptr<ClusteredLighting> lighting;
+	// Shadows of the directional light, if the scene has them.
+	std::unique_ptr<ShadowCascades> shadows;
+	// How the scene is shaded; the deferred renderer is created by useRenderPath.
+	RenderPath renderPath = RenderPath::Forward;
+	std::unique_ptr<DeferredRenderer> deferred;
+	// Draws the forward path, with or without a depth pre-pass; created by useDepthPrepass.
+	std::unique_ptr<DepthPrepass> prepass;
+	// Streams the cells of a world into objects around the camera, if the scene is one.
+	std::unique_ptr<WorldStreamer> world;
+	// The savings and error of each skeletal clip compressed or loaded compressed for the scene.
+	std::vector<ClipCompressionReport> clipReports;
 };
 
+// The factor by which compressing a clip is meant to shrink it, at the least.
+const double CLIP_COMPRESSION_TARGET = 5;
+
+/**
+ * @brief Loads a skeleton's clips as compressed by an earlier run, from a file beside its
+ * model, or compresses them and writes the file if it is missing or does not match.
+ * @return the report of each clip.
+ */
+std::vector<ClipCompressionReport> compressClipsOffline(Skeleton& skeleton, const std::filesystem::path& path) {
+	std::ifstream in(path, std::ios::binary);
+	if (in) {
+		try {
+			return skeleton.loadCompressedClips(in);
+		}
+		catch (std::runtime_error& e) {
+			std::cout << "WARNING: compressing clips again, as " << path.string() << " does not match: "
+				<< e.what() << std::endl;
+		}
+	}
+	std::vector<ClipCompressionReport> reports = skeleton.compressClips();
+	std::ofstream out(path, std::ios::binary);
+	skeleton.saveCompressedClips(out);
+	return reports;
+}
+
 /**
  * @brief Constructs a shader program that renders textured meshes in the Phong reflection model.
  * The shaders used here are incomplete; see their source codes.
@@ -53,13 +120,70 @@ ShaderProgram textureMapping() {
 	return program;
 }
 
+/**
+ * @brief Constructs a shader program that renders textured meshes without lighting, deforming
+ * skinned meshes by their skeleton's bone palette.
+ */
+ShaderProgram skinnedTextureMapping() {
+	ShaderProgram program;
+	try {
+		program.load("shaders/skinned_texture_perspective.vert", "shaders/texturing.frag");
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		exit(1);
+	}
+	// The palette is a samplerBuffer, which may not share a unit with the sampler2Ds.
+	program.activate();
+	program.setUniform("bonePalette", BONE_PALETTE_TEXTURE_UNIT);
+	return program;
+}
+
+/**
+ * @brief The direction the directional light of the lit scenes travels in.
+ */
+const glm::vec3 LIGHT_DIRECTION(0.2, -1, -0.3);
+
+/**
+ * @brief Sets the material, ambient light and directional light of the lit scenes, on a
+ * forward shader or either pass of the deferred renderer.
+ */
+void setLightingUniforms(ShaderProgram& program) {
+	program.activate();
+	program.setUniform("material", glm::vec4(0.3, 0.9, 0.4, 32));
+	program.setUniform("ambientColor", glm::vec3(0.1, 0.1, 0.15));
+	program.setUniform("directionalLight", LIGHT_DIRECTION);
+	program.setUniform("directionalColor", glm::vec3(0.15, 0.15, 0.2));
+}
+
+/**
+ * @brief Constructs a shader program that renders textured meshes in the Phong reflection model
+ * with an ambient light, a directional light, and many point and spot lights binned by a
+ * ClusteredLighting.
+ */
+ShaderProgram clusteredLighting() {
+	ShaderProgram program;
+	try {
+		program.load("shaders/skinned_light_perspective.vert", "shaders/clustered_lighting.frag");
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		exit(1);
+	}
+	program.activate();
+	program.setUniform("bonePalette", BONE_PALETTE_TEXTURE_UNIT);
+	program.setUniform("shadowMap", SHADOW_TEXTURE_UNIT);
+	setLightingUniforms(program);
+	return program;
+}
+
 /**
  * @brief Loads an image from the given path into an OpenGL texture.
  */
 Texture loadTexture(const std::filesystem::path& path, const std::string& samplerName = "baseTexture") {
 	sf::Image i;
 	i.loadFromFile(path.string());
-	return Texture::loadImage(i, samplerName);
+	return Texture::loadImage(i, samplerName, path.string());
 }
 
 /**
@@ -76,9 +200,12 @@ Scene marbleSquare() {
 	auto square = Object3D(std::vector<Mesh3D>{mesh});
 	square.grow(glm::vec3(5, 5, 5));
 	square.rotate(glm::vec3(-3.14159 / 4, 0, 0));
+	ObjectStore objects;
+	objects.insert(std::move(square));
 	return Scene{
 		phongLighting(),
-		{square}
+		"phongLighting",
+		std::move(objects)
 	};
 }
 
@@ -90,9 +217,12 @@ Scene bunny() {
 	bunny.grow(glm::vec3(9, 9, 9));
 	bunny.move(glm::vec3(0.2, -1, 0));
 
+	ObjectStore objects;
+	objects.insert(std::move(bunny));
 	return Scene{
 		phongLighting(),
-		{bunny}
+		"phongLighting",
+		std::move(objects)
 	};
 }
 
@@ -108,37 +238,825 @@ Scene lifeOfPi() {
 	boat.grow(glm::vec3(0.01, 0.01, 0.01));
 	auto tiger = assimpLoad("models/tiger/scene.gltf", true);
 	tiger.move(glm::vec3(0, -5, 10));
+	// The tiger is rigged; compress its animation clips, once, and play the first one.
+	std::vector<std::shared_ptr<Skeleton>> skeletons;
+	std::vector<ClipCompressionReport> clipReports;
+	if (tiger.getSkeleton() != nullptr && !tiger.getSkeleton()->clips().empty()) {
+		clipReports = compressClipsOffline(*tiger.getSkeleton(), "models/tiger/scene.clips");
+		tiger.getSkeleton()->play(0);
+		skeletons.push_back(tiger.getSkeleton());
+	}
 	boat.addChild(std::move(tiger));
 	
 	// Because boat and tiger are local variables, they will be destroyed when this
-	// function terminates. To prevent that, we need to move them into a vector, and then
-	// move that vector as part of the return value.
-	std::vector<Object3D> objects;
-	objects.push_back(std::move(boat));
+	// function terminates. To prevent that, we move them into an object store, and then
+	// move that store as part of the return value.
+	ObjectStore objects;
+	ObjectHandle boatHandle = objects.insert(std::move(boat));
 	
-	// We want these animations to referenced the *moved* objects, which are no longer
-	// in the variables named "tiger" and "boat". "boat" is now in the "objects" list at
-	// index 0, and "tiger" is the index-1 child of the boat.
-	Animator animBoat;
-	animBoat.addAnimation(std::make_unique<RotationAnimation>(objects[0], 10, glm::vec3(0, 6.28, 0)));
-	Animator animTiger;
-	animTiger.addAnimation(std::make_unique<RotationAnimation>(objects[0].getChild(1), 10, glm::vec3(0, 0, 6.28)));
-
-	// The Animators will be destroyed when leaving this function, so we move them into
-	// a list to be returned.
-	std::vector<Animator> animators;
-	animators.push_back(std::move(animBoat));
-	animators.push_back(std::move(animTiger));
+	// The animations refer to objects by handle, which stays valid however the store moves
+	// its objects around. "tiger" is the index-1 child of the boat.
+	// Each rotation is a two-key track, sampled in one batch with every other track.
+	ObjectHandle tigerHandle = objects.child(boatHandle, 1);
+	KeyframeTracks tracks;
+	tracks.addRotation(boatHandle, 10, glm::vec3(0, 6.28, 0));
+	tracks.addRotation(tigerHandle, 10, glm::vec3(0, 0, 6.28));
 
-	// Transfer ownership of the objects and animators back to the main.
-	return Scene {
-		textureMapping(),
+	// Transfer ownership of the objects and tracks back to the main.
+	Scene scene {
+		skinnedTextureMapping(),
+		"skinnedTextureMapping",
 		std::move(objects),
-		std::move(animators)
+		{},
+		std::move(tracks),
+		std::move(skeletons)
 	};
+	scene.clipReports = std::move(clipReports);
+	return scene;
+}
+
+/**
+ * @brief Constructs a night scene of the boat on a marble plaza, lit by many colored point and
+ * spot lights. The plaza and boat overlap heavily in depth, so it is shaded deferred.
+ */
+Scene lanterns(size_t lightCount) {
+	std::vector<Texture> textures = {
+		loadTexture("models/White_marble_03/Textures_4K/white_marble_03_4k_baseColor.tga", "baseTexture"),
+	};
+	auto plaza = Object3D(std::vector<Mesh3D>{ Mesh3D::square(textures) });
+	plaza.grow(glm::vec3(40, 40, 40));
+	plaza.rotate(glm::vec3(-3.14159 / 2, 0, 0));
+	plaza.move(glm::vec3(0, -1, -15));
+	plaza.setStatic(true);
+	auto boat = assimpLoad("models/boat/boat.fbx", true);
+	boat.move(glm::vec3(0, -0.7, 0));
+	boat.grow(glm::vec3(0.01, 0.01, 0.01));
+	boat.setStatic(true);
+
+	ObjectStore objects;
+	objects.insert(std::move(plaza));
+	objects.insert(std::move(boat));
+
+	// Lanterns scattered over the plaza; every fourth one is a spotlight shining down.
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float_t> across(-15, 15);
+	std::uniform_real_distribution<float_t> deep(-35, 3);
+	std::uniform_real_distribution<float_t> unit(0, 1);
+	std::vector<Light> lights;
+	for (size_t i = 0; i < lightCount; i++) {
+		glm::vec3 position(across(random), -0.5f + 2 * unit(random), deep(random));
+		glm::vec3 color(0.5f + unit(random), 0.3f + 0.7f * unit(random), 0.2f + unit(random));
+		float_t range = 1.5f + 3 * unit(random);
+		if (i % 4 == 3) {
+			lights.push_back(Light::spot(position + glm::vec3(0, 2, 0), glm::vec3(0, -1, 0),
+				color * 3.0f, range + 2, 0.3f, 0.5f));
+		}
+		else {
+			lights.push_back(Light::point(position, color, range));
+		}
+	}
+
+	auto shadows = std::make_unique<ShadowCascades>();
+	shadows->setLightDirection(LIGHT_DIRECTION);
+
+	return Scene{
+		clusteredLighting(),
+		"clusteredLighting",
+		std::move(objects),
+		{},
+		{},
+		{},
+		std::move(lights),
+		std::make_unique<ClusteredLighting>(0.1f, 100.0f),
+		std::move(shadows),
+		RenderPath::Deferred
+	};
+}
+
+/**
+ * @brief Switches the scene to the given render path. The deferred path needs clustered
+ * lighting, so scenes without it get an empty one, leaving only the ambient and directional
+ * lights.
+ */
+void useRenderPath(Scene& scene, RenderPath path, uint32_t width, uint32_t height) {
+	scene.renderPath = path;
+	if (path == RenderPath::Deferred && scene.deferred == nullptr) {
+		try {
+			scene.deferred = std::make_unique<DeferredRenderer>(width, height);
+		}
+		catch (std::runtime_error& e) {
+			std::cout << "ERROR: " << e.what() << std::endl;
+			exit(1);
+		}
+		setLightingUniforms(scene.deferred->geometryProgram());
+		setLightingUniforms(scene.deferred->lightingProgram());
+		if (scene.lighting == nullptr) {
+			scene.lighting = std::make_unique<ClusteredLighting>(0.1f, 100.0f);
+		}
+	}
+}
+
+/**
+ * @brief Sets up the scene's forward path to draw through a DepthPrepass, starting with the
+ * pre-pass on or off; it can be toggled any time after.
+ */
+void useDepthPrepass(Scene& scene, bool enabled) {
+	try {
+		scene.prepass = std::make_unique<DepthPrepass>(scene.defaultShader);
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		exit(1);
+	}
+	scene.prepass->setEnabled(enabled);
+}
+
+/**
+ * @brief Bins the scene's lights for the camera, if the scene uses clustered lighting, and
+ * redraws whichever of its shadow cascades need it.
+ */
+void prepareLighting(Scene& scene, const glm::mat4& view, const glm::mat4& projection,
+	uint32_t width, uint32_t height) {
+	if (scene.lighting != nullptr) {
+		scene.lighting->update(view, projection, width, height, scene.lights);
+	}
+	if (scene.shadows != nullptr) {
+		scene.shadows->update(view, projection, scene.objects);
+	}
+}
+
+/**
+ * @brief Draws the scene into the bound framebuffer through the given render path, which
+ * must have been set up by useRenderPath.
+ */
+void renderScene(Scene& scene, RenderPath path, const glm::mat4& view, const glm::mat4& projection,
+	const glm::vec3& viewPosition) {
+	if (path == RenderPath::Deferred) {
+		scene.deferred->render(scene.objects, view, projection, viewPosition, *scene.lighting,
+			scene.shadows.get());
+		return;
+	}
+	scene.defaultShader.activate();
+	if (scene.lighting != nullptr) {
+		scene.lighting->bind(scene.defaultShader);
+	}
+	if (scene.shadows != nullptr) {
+		scene.shadows->bind(scene.defaultShader);
+	}
+	if (scene.prepass != nullptr) {
+		scene.prepass->render(scene.objects, scene.defaultShader, view, projection);
+		return;
+	}
+	for (auto& o : scene.objects) {
+		o.render(scene.defaultShader);
+	}
+}
+
+/**
+ * @brief Advances every animation of the scene by the given interval, in seconds.
+ */
+void tickScene(Scene& scene, float_t dt) {
+	for (auto& animator : scene.animators) {
+		animator.tick(scene.objects, dt);
+	}
+	scene.tracks.tick(scene.objects, dt);
+	if (scene.world != nullptr) {
+		scene.world->tick(scene.objects, dt);
+	}
+	for (auto& skeleton : scene.skeletons) {
+		skeleton->tick(dt);
+	}
+}
+
+/**
+ * @brief Streams the cells of the scene's world, if it is one, in and out around the camera.
+ * Uploads arriving cells, so must be called on the GL context's thread.
+ */
+void streamWorld(Scene& scene, const glm::vec3& cameraPosition, float_t dt) {
+	if (scene.world != nullptr) {
+		scene.world->update(cameraPosition, scene.objects, dt);
+	}
+}
+
+/**
+ * @brief Runs the scene with simulation and rendering on separate threads: this thread polls
+ * events and ticks the scene into frame packets, which a RenderThread draws. Timings are
+ * printed every few seconds.
+ * @param workerCount if nonzero, the number of threads building each frame's draw list.
+ */
+void runWithRenderThread(sf::RenderWindow& window, Scene& scene, const glm::mat4& camera,
+	const glm::mat4& perspective, size_t bufferCount, size_t workerCount) {
+	// The camera and lights never move, so the lights are binned once, while this thread
+	// still has the GL context. Scenes drawn here have no shadows, which would need redrawing
+	// as their casters move.
+	prepareLighting(scene, camera, perspective, window.getSize().x, window.getSize().y);
+	scene.defaultShader.activate();
+	if (scene.lighting != nullptr) {
+		scene.lighting->bind(scene.defaultShader);
+	}
+	RenderThread renderer(window, scene.defaultShader, bufferCount);
+	std::unique_ptr<ParallelDrawCollector> collector;
+	if (workerCount > 0) {
+		collector = std::make_unique<ParallelDrawCollector>(workerCount);
+	}
+	bool running = true;
+	sf::Clock c;
+	sf::Clock statsClock;
+
+	auto last = c.getElapsedTime();
+	while (running) {
+		// Events must still be polled on the thread that created the window.
+		sf::Event ev;
+		while (window.pollEvent(ev)) {
+			if (ev.type == sf::Event::Closed) {
+				running = false;
+			}
+		}
+
+		// Waits here while the render thread is a full mailbox behind. A stopped render thread
+		// hands out no more packets, which ends the loop.
+		FramePacket* packet = renderer.beginFrame();
+		if (packet == nullptr) {
+			break;
+		}
+		auto now = c.getElapsedTime();
+		auto diffSeconds = (now - last).asSeconds();
+		last = now;
+		tickScene(scene, diffSeconds);
+
+		packet->view = camera;
+		packet->projection = perspective;
+		if (collector != nullptr) {
+			collector->collect(scene.objects, packet->draws);
+		}
+		else {
+			packet->draws.clear();
+			for (auto& o : scene.objects) {
+				o.collectDraws(glm::mat4(1), packet->draws);
+			}
+		}
+		renderer.submitFrame(packet);
+		FrameArena::local().reset();
+
+		if (statsClock.getElapsedTime().asSeconds() >= 5) {
+			std::cout << "Render thread: " << renderer.takeStats().describe() << std::endl;
+			statsClock.restart();
+		}
+	}
+	renderer.stop();
 }
 
-int main() {
+/**
+ * @brief Command-line options.
+ */
+struct Options {
+	// Which scene to run: marbleSquare, bunny, lifeOfPi, lanterns, a scene file ending in
+	// .scene, or a world manifest ending in .world; and with --lights N, the number of lights
+	// in the lanterns scene. Headless runs also take "samples", running each sample scene in
+	// turn.
+	std::string scene = "lifeOfPi";
+	size_t lights = 256;
+	// --path forward|deferred overrides the scene's render path; --compare-paths also draws
+	// every headless frame through the other path, to time both on the same frames.
+	std::optional<RenderPath> renderPath;
+	bool comparePaths = false;
+	// --no-shadows turns off the scene's shadows.
+	bool shadows = true;
+	// --depth-prepass starts with the forward path's depth pre-pass on; P toggles it.
+	bool depthPrepass = false;
+	// --render-thread runs simulation and rendering on separate threads; --triple-buffer lets
+	// the simulation run up to two frames ahead instead of one; --workers N builds its draw
+	// lists on N threads.
+	bool renderThread = false;
+	size_t bufferCount = 2;
+	size_t workerCount = 0;
+	// --headless renders a fixed number of frames offscreen, with no window.
+	bool headless = false;
+	size_t frames = 300;
+	// --fly SPEED moves the headless camera forward (along -Z) at this many units per second,
+	// as through a streamed world.
+	float_t flySpeed = 0;
+	uint32_t width = 1200;
+	uint32_t height = 800;
+	// If set, every dumpEvery-th headless frame is saved as a PNG in this directory.
+	std::filesystem::path dumpDirectory;
+	size_t dumpEvery = 1;
+	// If set, per-frame headless timings are written to this CSV file.
+	std::filesystem::path timingsPath;
+	// If set, every GL call of a headless run, from context creation to the last frame, is
+	// recorded to this file for benchmarks/ReplayBenchmark.
+	std::filesystem::path capturePath;
+	// If set, the scene is saved to this file once it is constructed, to be run again with
+	// --scene FILE.
+	std::filesystem::path saveScenePath;
+	// --check-allocations N counts the heap allocations of every headless frame, and fails the
+	// run if any frame after the first N allocates; --abort-on-allocation aborts in the first
+	// such allocation instead, for a debugger.
+	std::optional<size_t> allocationWarmup;
+	bool abortOnAllocation = false;
+};
+
+Options parseOptions(int argc, char* argv[]) {
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--scene" && hasValue) {
+			options.scene = argv[++i];
+		}
+		else if (arg == "--lights" && hasValue) {
+			options.lights = std::stoul(argv[++i]);
+		}
+		else if (arg == "--path" && hasValue) {
+			std::string path = argv[++i];
+			if (path == "forward" || path == "deferred") {
+				options.renderPath = path == "forward" ? RenderPath::Forward : RenderPath::Deferred;
+			}
+			else {
+				std::cout << "WARNING: ignoring unknown render path " << path << std::endl;
+			}
+		}
+		else if (arg == "--compare-paths") {
+			options.comparePaths = true;
+		}
+		else if (arg == "--no-shadows") {
+			options.shadows = false;
+		}
+		else if (arg == "--depth-prepass") {
+			options.depthPrepass = true;
+		}
+		else if (arg == "--render-thread") {
+			options.renderThread = true;
+		}
+		else if (arg == "--triple-buffer") {
+			options.bufferCount = 3;
+		}
+		else if (arg == "--workers" && hasValue) {
+			options.workerCount = std::stoul(argv[++i]);
+		}
+		else if (arg == "--headless") {
+			options.headless = true;
+		}
+		else if (arg == "--frames" && hasValue) {
+			options.frames = std::stoul(argv[++i]);
+		}
+		else if (arg == "--fly" && hasValue) {
+			options.flySpeed = std::stof(argv[++i]);
+		}
+		else if (arg == "--size" && hasValue) {
+			// WIDTHxHEIGHT
+			std::string size = argv[++i];
+			size_t x = size.find('x');
+			options.width = std::stoul(size.substr(0, x));
+			options.height = std::stoul(size.substr(x + 1));
+		}
+		else if (arg == "--dump" && hasValue) {
+			options.dumpDirectory = argv[++i];
+		}
+		else if (arg == "--dump-every" && hasValue) {
+			options.dumpEvery = std::max<size_t>(std::stoul(argv[++i]), 1);
+		}
+		else if (arg == "--timings" && hasValue) {
+			options.timingsPath = argv[++i];
+		}
+		else if (arg == "--capture" && hasValue) {
+			options.capturePath = argv[++i];
+		}
+		else if (arg == "--save-scene" && hasValue) {
+			options.saveScenePath = argv[++i];
+		}
+		else if (arg == "--check-allocations" && hasValue) {
+			options.allocationWarmup = std::stoul(argv[++i]);
+		}
+		else if (arg == "--abort-on-allocation") {
+			options.abortOnAllocation = true;
+		}
+		else {
+			std::cout << "WARNING: ignoring unknown option " << arg << std::endl;
+		}
+	}
+	return options;
+}
+
+/**
+ * @brief Constructs the shader program a scene file names.
+ */
+ShaderProgram shaderNamed(const std::string& name) {
+	if (name == "phongLighting") {
+		return phongLighting();
+	}
+	if (name == "textureMapping") {
+		return textureMapping();
+	}
+	if (name == "skinnedTextureMapping") {
+		return skinnedTextureMapping();
+	}
+	if (name == "clusteredLighting") {
+		return clusteredLighting();
+	}
+	throw std::runtime_error("Unknown shader " + name);
+}
+
+/**
+ * @brief Constructs an empty scene drawn with the named shader. Scene files and worlds save no
+ * lights, so scenes drawn with clustered lighting get an empty one.
+ */
+Scene emptyScene(const std::string& shaderName) {
+	Scene scene{ shaderNamed(shaderName), shaderName };
+	if (shaderName == "clusteredLighting") {
+		scene.lighting = std::make_unique<ClusteredLighting>(0.1f, 100.0f);
+	}
+	return scene;
+}
+
+/**
+ * @brief Loads a scene saved with --save-scene.
+ */
+Scene sceneFromFile(const std::filesystem::path& path) {
+	auto start = std::chrono::steady_clock::now();
+	SceneFile file(path);
+	Scene scene = emptyScene(std::string(file.shaderName()));
+	file.instantiate(scene.objects, scene.tracks);
+	std::cout << "Loaded " << path.string() << " (" << file.nodeCount() << " objects, " << file.meshCount()
+		<< " meshes, " << file.trackCount() << " tracks) in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+		<< " ms" << std::endl;
+	return scene;
+}
+
+/**
+ * @brief Constructs a scene that streams in the cells of a world manifest around the camera.
+ */
+Scene worldScene(const std::filesystem::path& path) {
+	WorldManifest manifest = loadWorldManifest(path);
+	Scene scene = emptyScene(manifest.shaderName);
+	scene.world = std::make_unique<WorldStreamer>(manifest);
+	std::cout << "Streaming " << manifest.cells.size() << " cells of " << path.string() << std::endl;
+	return scene;
+}
+
+/**
+ * @brief Constructs the scene named by the options, from a scene file if the name ends in
+ * ".scene", or a world manifest if it ends in ".world".
+ */
+Scene buildScene(const Options& options) {
+	const std::string& name = options.scene;
+	if (name.ends_with(".scene")) {
+		return sceneFromFile(name);
+	}
+	if (name.ends_with(".world")) {
+		return worldScene(name);
+	}
+	if (name == "marbleSquare") {
+		return marbleSquare();
+	}
+	if (name == "bunny") {
+		return bunny();
+	}
+	if (name == "lifeOfPi") {
+		return lifeOfPi();
+	}
+	if (name == "lanterns") {
+		Scene scene = lanterns(options.lights);
+		if (!options.shadows) {
+			scene.shadows.reset();
+		}
+		return scene;
+	}
+	throw std::runtime_error("Unknown scene " + name);
+}
+
+/**
+ * @brief Constructs the scene named by the options, and saves it if asked to.
+ */
+Scene loadScene(const Options& options) {
+	Scene scene = buildScene(options);
+	if (!options.saveScenePath.empty()) {
+		// Animators are saved as the keyframe tracks they convert to.
+		KeyframeTracks tracks = scene.tracks;
+		for (auto& animator : scene.animators) {
+			if (!animator.appendTracks(tracks)) {
+				std::cout << "WARNING: an animator has animations that cannot be saved" << std::endl;
+			}
+		}
+		saveSceneFile(options.saveScenePath, scene.shaderName, scene.objects, tracks);
+		std::cout << "Saved " << options.scene << " to " << options.saveScenePath.string() << std::endl;
+	}
+	return scene;
+}
+
+/**
+ * @brief Prints the average, median, 95th percentile and worst of a series of timings.
+ */
+void printTimings(const std::string& label, std::vector<double> ms) {
+	if (ms.empty()) {
+		return;
+	}
+	double total = 0;
+	for (double t : ms) {
+		total += t;
+	}
+	std::sort(ms.begin(), ms.end());
+	std::cout << label << ": avg " << total / ms.size() << " ms, p50 " << ms[ms.size() / 2]
+		<< " ms, p95 " << ms[ms.size() * 95 / 100] << " ms, max " << ms.back() << " ms" << std::endl;
+}
+
+/**
+ * @brief Renders a fixed number of frames of the scene into an offscreen framebuffer, at a
+ * fixed 60 Hz timestep so runs are repeatable, and reports per-frame timings.
+ */
+int runHeadless(const Options& options) {
+	std::unique_ptr<HeadlessContext> context;
+	try {
+		context = std::make_unique<HeadlessContext>();
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	std::cout << "Headless rendering on " << context->renderer() << std::endl;
+	// A new context, if an earlier run had one: nothing GLState knows of it holds here.
+	GLState::current().invalidate();
+	std::unique_ptr<GLCapture> capture;
+	if (!options.capturePath.empty()) {
+		try {
+			capture = std::make_unique<GLCapture>(options.capturePath);
+		}
+		catch (std::runtime_error& e) {
+			std::cout << "ERROR: " << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	OffscreenTarget target(options.width, options.height);
+	target.bind();
+	glEnable(GL_DEPTH_TEST);
+
+	auto scene = loadScene(options);
+	auto cameraPosition = glm::vec3(0, 0, 5);
+	auto camera = glm::lookAt(cameraPosition, glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+	auto perspective = glm::perspective(glm::radians(45.0), static_cast<double>(options.width) / options.height, 0.1, 100.0);
+	ShaderProgram& mainShader = scene.defaultShader;
+	mainShader.activate();
+	mainShader.setUniform("view", camera);
+	mainShader.setUniform("projection", perspective);
+	mainShader.setUniform("viewPos", cameraPosition);
+	for (auto& animator : scene.animators) {
+		animator.start();
+	}
+	RenderPath path = options.renderPath.value_or(scene.renderPath);
+	RenderPath otherPath = path == RenderPath::Forward ? RenderPath::Deferred : RenderPath::Forward;
+	useRenderPath(scene, path, options.width, options.height);
+	if (options.comparePaths) {
+		useRenderPath(scene, otherPath, options.width, options.height);
+		scene.renderPath = path;
+	}
+	if (scene.deferred != nullptr) {
+		scene.deferred->setTiming(true);
+	}
+	useDepthPrepass(scene, options.depthPrepass);
+
+	if (!options.dumpDirectory.empty()) {
+		std::filesystem::create_directories(options.dumpDirectory);
+	}
+	// GPU time is measured with a timer query; CPU render time includes waiting for the GPU
+	// to finish, so both cover the whole frame.
+	uint32_t timerQuery;
+	glGenQueries(1, &timerQuery);
+	const float_t dt = 1.0f / 60;
+	std::vector<double> updateMs, renderMs, gpuMs;
+	// With --compare-paths, the GPU time of the other path; and of each deferred pass.
+	std::vector<double> otherGpuMs, geometryMs, lightingMs;
+	// The forward path's sample counts; each frame's arrive by the next frame.
+	std::vector<double> depthSamples, shadedSamples;
+	// State-changing GL calls of each frame, through GLState.
+	GLCallCounts glCalls;
+	// Sized up front, so recording a frame's timings never grows them.
+	for (auto* samples : { &updateMs, &renderMs, &gpuMs, &otherGpuMs, &geometryMs, &lightingMs,
+		&depthSamples, &shadedSamples }) {
+		samples->reserve(options.frames);
+	}
+
+	// With --check-allocations, frames past the warm-up must not allocate.
+	AllocationTracker& allocations = AllocationTracker::current();
+	AllocationCounts warmupAllocations;
+	AllocationCounts steadyAllocations[MAX_ALLOCATION_PHASES];
+	size_t allocatingFrames = 0;
+	if (options.allocationWarmup.has_value()) {
+		allocations.enable(options.abortOnAllocation ? SteadyStatePolicy::Abort : SteadyStatePolicy::Record);
+	}
+
+	using FrameClock = std::chrono::steady_clock;
+	for (size_t frame = 0; frame < options.frames; frame++) {
+		bool steadyState = options.allocationWarmup.has_value() && frame >= *options.allocationWarmup;
+		allocations.beginFrame(steadyState);
+		allocations.phase("update");
+		if (capture != nullptr) {
+			capture->beginFrame();
+		}
+		if (options.flySpeed != 0) {
+			cameraPosition.z -= options.flySpeed * dt;
+			camera = glm::lookAt(cameraPosition, cameraPosition + glm::vec3(0, 0, -6), glm::vec3(0, 1, 0));
+			mainShader.activate();
+			mainShader.setUniform("view", camera);
+			mainShader.setUniform("viewPos", cameraPosition);
+		}
+		auto updateStart = FrameClock::now();
+		streamWorld(scene, cameraPosition, dt);
+		tickScene(scene, dt);
+		prepareLighting(scene, camera, perspective, options.width, options.height);
+		auto renderStart = FrameClock::now();
+		allocations.phase("render");
+
+		GLState::current().resetCounts();
+		target.bind();
+		GLuint64 gpuNanoseconds = 0;
+		if (options.comparePaths) {
+			// Drawn first, so the frame left in the target is the selected path's.
+			glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			renderScene(scene, otherPath, camera, perspective, cameraPosition);
+			glEndQuery(GL_TIME_ELAPSED);
+			glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &gpuNanoseconds);
+			otherGpuMs.push_back(gpuNanoseconds / 1e6);
+			if (otherPath == RenderPath::Deferred) {
+				auto passes = scene.deferred->timings();
+				geometryMs.push_back(passes.geometryMs);
+				lightingMs.push_back(passes.lightingMs);
+			}
+		}
+		glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		renderScene(scene, path, camera, perspective, cameraPosition);
+		glEndQuery(GL_TIME_ELAPSED);
+		glFinish();
+		auto renderEnd = FrameClock::now();
+		allocations.phase("record");
+		auto& frameCalls = GLState::current().counts();
+		for (size_t i = 0; i < static_cast<size_t>(GLCall::Count); i++) {
+			glCalls.issued[i] += frameCalls.issued[i];
+			glCalls.elided[i] += frameCalls.elided[i];
+		}
+
+		glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &gpuNanoseconds);
+		if (path == RenderPath::Deferred) {
+			auto passes = scene.deferred->timings();
+			geometryMs.push_back(passes.geometryMs);
+			lightingMs.push_back(passes.lightingMs);
+		}
+		updateMs.push_back(std::chrono::duration<double, std::milli>(renderStart - updateStart).count());
+		renderMs.push_back(std::chrono::duration<double, std::milli>(renderEnd - renderStart).count());
+		gpuMs.push_back(gpuNanoseconds / 1e6);
+		if (frame > 0 && (path == RenderPath::Forward || options.comparePaths)) {
+			auto& samples = scene.prepass->stats();
+			depthSamples.push_back(static_cast<double>(samples.depthSamples));
+			shadedSamples.push_back(static_cast<double>(samples.shadedSamples));
+		}
+
+		// Dumped frames are not counted: encoding a PNG allocates.
+		if (allocations.enabled()) {
+			FrameAllocations counts = allocations.endFrame();
+			AllocationCounts total = counts.total();
+			if (!steadyState) {
+				warmupAllocations.allocations += total.allocations;
+				warmupAllocations.bytes += total.bytes;
+			}
+			else if (total.allocations > 0) {
+				allocatingFrames++;
+				for (size_t i = 0; i < MAX_ALLOCATION_PHASES; i++) {
+					steadyAllocations[i].allocations += counts.phases[i].allocations;
+					steadyAllocations[i].bytes += counts.phases[i].bytes;
+				}
+			}
+		}
+
+		if (!options.dumpDirectory.empty() && frame % options.dumpEvery == 0) {
+			std::string number = std::to_string(frame);
+			number.insert(0, number.size() < 5 ? 5 - number.size() : 0, '0');
+			target.save(options.dumpDirectory / ("frame_" + number + ".png"));
+		}
+		FrameArena::local().reset();
+	}
+	allocations.disable();
+	if (capture != nullptr) {
+		// Stopped before anything is deleted, so replays end with the last frame.
+		std::cout << "Captured " << capture->stats().describe() << " to " << options.capturePath.string() << std::endl;
+		capture.reset();
+	}
+	glDeleteQueries(1, &timerQuery);
+
+	std::cout << options.frames << " frames of " << options.scene << " at " << options.width << "x"
+		<< options.height << std::endl;
+	const char* pathNames[2] = { "forward", "deferred" };
+	std::cout << "Render path: " << pathNames[static_cast<size_t>(path)] << std::endl;
+	printTimings("Update", updateMs);
+	printTimings("Render (CPU)", renderMs);
+	printTimings("Render (GPU)", gpuMs);
+	if (options.comparePaths) {
+		printTimings(std::string("Render (GPU, ") + pathNames[static_cast<size_t>(otherPath)] + ")", otherGpuMs);
+	}
+	printTimings("G-buffer pass (GPU)", geometryMs);
+	printTimings("Lighting pass (GPU)", lightingMs);
+	if (!shadedSamples.empty()) {
+		double depthTotal = 0;
+		double shadedTotal = 0;
+		for (size_t frame = 0; frame < shadedSamples.size(); frame++) {
+			depthTotal += depthSamples[frame];
+			shadedTotal += shadedSamples[frame];
+		}
+		double pixels = static_cast<double>(options.width) * options.height;
+		std::cout << "Forward shading: " << shadedTotal / shadedSamples.size() << " samples per frame ("
+			<< shadedTotal / shadedSamples.size() / pixels << " per pixel)";
+		if (options.depthPrepass) {
+			std::cout << ", of " << depthTotal / shadedSamples.size() << " passing the depth pre-pass; "
+				<< (1 - shadedTotal / depthTotal) * 100 << "% saved";
+		}
+		std::cout << std::endl;
+	}
+	for (size_t i = 0; i < static_cast<size_t>(GLCall::Count); i++) {
+		glCalls.issued[i] /= std::max<size_t>(options.frames, 1);
+		glCalls.elided[i] /= std::max<size_t>(options.frames, 1);
+	}
+	std::cout << "GL state per frame: " << glCalls.describe() << std::endl;
+	FrameArena& arena = FrameArena::local();
+	std::cout << "Frame arena: " << arena.peakBytesUsed() / 1024.0 << " KB at most per frame, in "
+		<< arena.capacity() / 1024.0 << " KB" << std::endl;
+	if (options.allocationWarmup.has_value()) {
+		size_t warmup = std::min(*options.allocationWarmup, options.frames);
+		std::cout << "Allocations: " << warmupAllocations.allocations << " (" << warmupAllocations.bytes / 1024.0
+			<< " KB) in " << warmup << " warm-up frames; " << allocatingFrames << " of "
+			<< options.frames - warmup << " steady-state frames allocated";
+		for (size_t i = 0; i < allocations.phaseCount(); i++) {
+			std::cout << (i == 0 ? ": " : ", ") << steadyAllocations[i].allocations << " ("
+				<< steadyAllocations[i].bytes << " bytes) in " << allocations.phaseName(i);
+		}
+		std::cout << std::endl;
+		for (size_t i = 0; i < allocations.siteCount(); i++) {
+			std::cout << "Allocation site " << i << ": " << allocations.describe(allocations.site(i)) << std::endl;
+		}
+		if (allocations.unrecordedAllocations() > 0) {
+			std::cout << allocations.unrecordedAllocations() << " more allocations not recorded" << std::endl;
+		}
+	}
+	if (scene.world != nullptr) {
+		std::cout << "World streaming: " << scene.world->stats().describe() << std::endl;
+	}
+	if (scene.lighting != nullptr) {
+		auto& stats = scene.lighting->stats();
+		std::cout << "Clustered lighting: " << stats.lights << " lights, " << stats.visibleLights
+			<< " visible, " << stats.assignments << " light/cluster pairs over "
+			<< scene.lighting->clusterCount() << " clusters, at most " << stats.maxLightsPerCluster
+			<< " in one; binned in " << stats.binMs << " ms, uploaded in " << stats.uploadMs
+			<< " ms" << std::endl;
+	}
+	for (auto& report : scene.clipReports) {
+		ClipCompressionSettings bounds;
+		bool bounded = report.maxTranslationError <= bounds.translationTolerance
+			&& report.maxRotationError <= bounds.rotationTolerance && report.maxScaleError <= bounds.scaleTolerance;
+		std::cout << "Compressed clip " << report.describe() << "; "
+			<< (report.ratio() >= CLIP_COMPRESSION_TARGET ? "meets" : "below") << " the " << CLIP_COMPRESSION_TARGET
+			<< "x target, error " << (bounded ? "within" : "over") << " tolerance" << std::endl;
+	}
+	if (scene.shadows != nullptr) {
+		auto cascades = scene.shadows->stats();
+		for (size_t i = 0; i < cascades.size(); i++) {
+			std::cout << "Shadow cascade " << i << " " << cascades[i].describe() << std::endl;
+		}
+	}
+
+	if (!options.timingsPath.empty()) {
+		std::ofstream csv(options.timingsPath);
+		csv << "frame,update_ms,render_ms,gpu_ms" << (options.comparePaths ? ",other_path_gpu_ms\n" : "\n");
+		for (size_t frame = 0; frame < updateMs.size(); frame++) {
+			csv << frame << "," << updateMs[frame] << "," << renderMs[frame] << "," << gpuMs[frame];
+			if (options.comparePaths) {
+				csv << "," << otherGpuMs[frame];
+			}
+			csv << "\n";
+		}
+	}
+	if (allocatingFrames > 0) {
+		std::cout << "ERROR: steady-state frames allocated" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	Options options = parseOptions(argc, argv);
+	if (options.headless && options.scene == "samples") {
+		int status = 0;
+		for (const char* name : { "marbleSquare", "bunny", "lifeOfPi", "lanterns" }) {
+			Options sample = options;
+			sample.scene = name;
+			status = std::max(status, runHeadless(sample));
+		}
+		return status;
+	}
+	if (options.headless) {
+		return runHeadless(options);
+	}
+
 	// Initialize the window and OpenGL.
 	sf::ContextSettings Settings;
 	Settings.depthBits = 24; // Request a 24 bits depth buffer
@@ -149,10 +1067,7 @@ int main() {
 	glEnable(GL_DEPTH_TEST);
 
 	// Initialize scene objects.
-	auto scene = lifeOfPi();
-	// In case you want to manipulate the scene objects directly by name.
-	auto& boat = scene.objects[0];
-	auto& tiger = boat.getChild(1);
+	auto scene = loadScene(options);
 
 	auto cameraPosition = glm::vec3(0, 0, 5);
 	auto camera = glm::lookAt(cameraPosition, glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
@@ -162,11 +1077,34 @@ int main() {
 	mainShader.activate();
 	mainShader.setUniform("view", camera);
 	mainShader.setUniform("projection", perspective);
+	mainShader.setUniform("viewPos", cameraPosition);
+	RenderPath path = options.renderPath.value_or(scene.renderPath);
+	if (options.renderThread && path == RenderPath::Deferred) {
+		// The render thread only draws frame packets through the scene's shader.
+		std::cout << "WARNING: the render thread draws the forward path only" << std::endl;
+		path = RenderPath::Forward;
+	}
+	useRenderPath(scene, path, window.getSize().x, window.getSize().y);
+	useDepthPrepass(scene, options.depthPrepass);
 
 	// Ready, set, go!
 	for (auto& animator : scene.animators) {
 		animator.start();
 	}
+	if (options.renderThread && scene.world != nullptr) {
+		// Cells are uploaded by the simulation, which has no GL context on the render thread.
+		std::cout << "WARNING: worlds stream on one thread only" << std::endl;
+		options.renderThread = false;
+	}
+	if (options.renderThread && scene.shadows != nullptr) {
+		// The render thread draws packets only; nothing there redraws the shadow maps.
+		std::cout << "WARNING: the render thread draws no shadows" << std::endl;
+		scene.shadows.reset();
+	}
+	if (options.renderThread) {
+		runWithRenderThread(window, scene, camera, perspective, options.bufferCount, options.workerCount);
+		return 0;
+	}
 	bool running = true;
 	sf::Clock c;
 
@@ -177,23 +1115,38 @@ int main() {
 			if (ev.type == sf::Event::Closed) {
 				running = false;
 			}
+			else if (ev.type == sf::Event::Resized && ev.size.width > 0 && ev.size.height > 0) {
+				// Fit the viewport and projection to the window; the deferred G-buffer follows.
+				glViewport(0, 0, ev.size.width, ev.size.height);
+				perspective = glm::perspective(glm::radians(45.0),
+					static_cast<double>(ev.size.width) / ev.size.height, 0.1, 100.0);
+				mainShader.activate();
+				mainShader.setUniform("projection", perspective);
+				if (scene.deferred != nullptr) {
+					scene.deferred->resize(ev.size.width, ev.size.height);
+				}
+			}
+			else if (ev.type == sf::Event::KeyPressed && ev.key.code == sf::Keyboard::P) {
+				std::cout << "Depth pre-pass: " << scene.prepass->stats().describe() << std::endl;
+				scene.prepass->setEnabled(!scene.prepass->enabled());
+				std::cout << "Depth pre-pass " << (scene.prepass->enabled() ? "on" : "off") << std::endl;
+			}
 		}
 		
 		auto now = c.getElapsedTime();
 		auto diff = now - last;
 		auto diffSeconds = diff.asSeconds();
 		last = now;
-		for (auto& animator : scene.animators) {
-			animator.tick(diffSeconds);
-		}
+		streamWorld(scene, cameraPosition, diffSeconds);
+		tickScene(scene, diffSeconds);
+		prepareLighting(scene, camera, perspective, window.getSize().x, window.getSize().y);
 
 		// Clear the OpenGL "context".
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		// Render each object in the scene.
-		for (auto& o : scene.objects) {
-			o.render(window, mainShader);
-		}
+		renderScene(scene, path, camera, perspective, cameraPosition);
 		window.display();
+		FrameArena::local().reset();
 	}
 
 	return 0;
@@ -0,0 +1,99 @@
+#version 330
+// A fragment shader for rendering fragments in the Phong reflection model, lit by an ambient
+// light, one directional light, and any number of point and spot lights. The point and spot
+// lights are binned into clusters of the view frustum by ClusteredLighting; each fragment
+// shades only the lights of its own cluster.
+layout (location=0) out vec4 FragColor;
+
+// Inputs: the texture coordinates, world-space normal, and world-space position
+// of this fragment, interpolated between its vertices.
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 FragWorldPos;
+
+// The mesh's base (diffuse) texture.
+uniform sampler2D baseTexture;
+
+// Material parameters for the whole mesh: k_a, k_d, k_s, shininess.
+uniform vec4 material;
+
+// Ambient light color, and the direction ("I" vector) and color of the directional light.
+uniform vec3 ambientColor;
+uniform vec3 directionalLight;
+uniform vec3 directionalColor;
+
+// Location of the camera, and its view matrix, to find the fragment's depth slice.
+uniform vec3 viewPos;
+uniform mat4 view;
+
+// The clustered lights. Each light is 3 texels: (position, range), (color, outer cone cosine),
+// (spot direction, inner cone cosine). Each cluster is an (offset, count) range of the light
+// index list. Clusters are ordered by depth slice, then tile row, then tile column.
+uniform samplerBuffer lights;
+uniform usamplerBuffer clusters;
+uniform usamplerBuffer lightIndices;
+uniform int clusterTilesX;
+uniform int clusterTilesY;
+uniform int clusterSlices;
+// The size of a cluster tile in pixels, and the constants mapping log(depth) to a slice.
+uniform vec2 tileSize;
+uniform float sliceScale;
+uniform float sliceBias;
+
+// Directional light shadows from cascaded shadow maps; see ShadowCascades. Each cascade's
+// matrix takes world space to its map's texture coordinates and depth.
+uniform bool shadowsEnabled;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[4];
+uniform vec4 cascadeFar;
+uniform int cascadeCount;
+
+// How much of the directional light reaches a point at the given view-space depth.
+float directionalShadow(vec3 worldPos, float viewDepth) {
+    if (!shadowsEnabled || viewDepth > cascadeFar[cascadeCount - 1]) {
+        return 1.0;
+    }
+    int cascade = 0;
+    while (viewDepth > cascadeFar[cascade]) {
+        cascade++;
+    }
+    vec4 coord = shadowMatrices[cascade] * vec4(worldPos, 1.0);
+    return texture(shadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
+
+// The diffuse and specular reflection of a light arriving from direction L.
+vec3 phong(vec3 N, vec3 L, vec3 V, vec3 color) {
+    float diffuse = max(dot(N, L), 0.0);
+    vec3 R = reflect(-L, N);
+    float specular = diffuse > 0.0 ? pow(max(dot(R, V), 0.0), material.w) : 0.0;
+    return color * (material.y * diffuse + material.z * specular);
+}
+
+void main() {
+    vec3 N = normalize(Normal);
+    vec3 V = normalize(viewPos - FragWorldPos);
+    float depth = -(view * vec4(FragWorldPos, 1.0)).z;
+    vec3 lightIntensity = material.x * ambientColor
+        + phong(N, normalize(-directionalLight), V, directionalColor) * directionalShadow(FragWorldPos, depth);
+
+    int slice = clamp(int(log(depth) * sliceScale - sliceBias), 0, clusterSlices - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / tileSize), ivec2(0), ivec2(clusterTilesX - 1, clusterTilesY - 1));
+    uvec2 range = texelFetch(clusters, (slice * clusterTilesY + tile.y) * clusterTilesX + tile.x).xy;
+
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).x) * 3;
+        vec4 positionRange = texelFetch(lights, light);
+        vec4 colorOuter = texelFetch(lights, light + 1);
+        vec4 directionInner = texelFetch(lights, light + 2);
+
+        vec3 toLight = positionRange.xyz - FragWorldPos;
+        float distance = length(toLight);
+        vec3 L = toLight / distance;
+        // Inverse-square falloff, windowed to reach exactly 0 at the light's range.
+        float window = clamp(1.0 - pow(distance / positionRange.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 1.0);
+        float cone = smoothstep(colorOuter.w, directionInner.w, dot(-L, directionInner.xyz));
+        lightIntensity += phong(N, L, V, colorOuter.rgb) * attenuation * cone;
+    }
+    FragColor = vec4(lightIntensity, 1) * texture(baseTexture, TexCoord);
+}
@@ -0,0 +1,122 @@
+#version 330
+// A fragment shader for the lighting pass of deferred shading: decodes the G-buffer written by
+// gbuffer.frag, reconstructs the world-space position from depth, and shades the pixel in the
+// Phong reflection model with the same lights as clustered_lighting.frag.
+layout (location=0) out vec4 FragColor;
+
+// The G-buffer: albedo and k_a; octahedral normal; k_d, k_s, and shininess / 255; depth.
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gMaterial;
+uniform sampler2D gDepth;
+
+// Takes normalized device coordinates back to world space.
+uniform mat4 inverseViewProjection;
+// The viewport the G-buffer was drawn with and is lit into: x, y, width, height in pixels.
+uniform vec4 viewport;
+
+// Ambient light color, and the direction ("I" vector) and color of the directional light.
+uniform vec3 ambientColor;
+uniform vec3 directionalLight;
+uniform vec3 directionalColor;
+
+// Location of the camera, and its view matrix, to find the pixel's depth slice.
+uniform vec3 viewPos;
+uniform mat4 view;
+
+// The clustered lights; see clustered_lighting.frag.
+uniform samplerBuffer lights;
+uniform usamplerBuffer clusters;
+uniform usamplerBuffer lightIndices;
+uniform int clusterTilesX;
+uniform int clusterTilesY;
+uniform int clusterSlices;
+uniform vec2 tileSize;
+uniform float sliceScale;
+uniform float sliceBias;
+
+// Directional light shadows from cascaded shadow maps; see
+// clustered_lighting.frag.
+uniform bool shadowsEnabled;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[4];
+uniform vec4 cascadeFar;
+uniform int cascadeCount;
+
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// The inverse of octahedralEncode in gbuffer.frag.
+vec3 octahedralDecode(vec2 encoded) {
+    vec2 folded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(folded, 1.0 - abs(folded.x) - abs(folded.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    }
+    return normalize(n);
+}
+
+// The same as in clustered_lighting.frag.
+float directionalShadow(vec3 worldPos, float viewDepth) {
+    if (!shadowsEnabled || viewDepth > cascadeFar[cascadeCount - 1]) {
+        return 1.0;
+    }
+    int cascade = 0;
+    while (viewDepth > cascadeFar[cascade]) {
+        cascade++;
+    }
+    vec4 coord = shadowMatrices[cascade] * vec4(worldPos, 1.0);
+    return texture(shadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
+
+// The diffuse and specular reflection of a light arriving from direction L.
+vec3 phong(vec3 N, vec3 L, vec3 V, vec3 color, vec3 material) {
+    float diffuse = max(dot(N, L), 0.0);
+    vec3 R = reflect(-L, N);
+    float specular = diffuse > 0.0 ? pow(max(dot(R, V), 0.0), material.z) : 0.0;
+    return color * (material.x * diffuse + material.y * specular);
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // Nothing was drawn here; keep whatever the target was cleared to.
+    if (depth == 1.0) {
+        discard;
+    }
+    vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+    vec3 N = octahedralDecode(texelFetch(gNormal, pixel, 0).xy);
+    vec4 packedMaterial = texelFetch(gMaterial, pixel, 0);
+    vec3 material = vec3(packedMaterial.xy, packedMaterial.z * 255.0);
+
+    vec2 uv = (vec2(pixel) - viewport.xy + 0.5) / viewport.zw;
+    vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 position = world.xyz / world.w;
+
+    vec3 V = normalize(viewPos - position);
+    float viewDepth = -(view * vec4(position, 1.0)).z;
+    vec3 lightIntensity = albedo.a * ambientColor
+        + phong(N, normalize(-directionalLight), V, directionalColor, material)
+        * directionalShadow(position, viewDepth);
+
+    int slice = clamp(int(log(viewDepth) * sliceScale - sliceBias), 0, clusterSlices - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / tileSize), ivec2(0), ivec2(clusterTilesX - 1, clusterTilesY - 1));
+    uvec2 range = texelFetch(clusters, (slice * clusterTilesY + tile.y) * clusterTilesX + tile.x).xy;
+
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).x) * 3;
+        vec4 positionRange = texelFetch(lights, light);
+        vec4 colorOuter = texelFetch(lights, light + 1);
+        vec4 directionInner = texelFetch(lights, light + 2);
+
+        vec3 toLight = positionRange.xyz - position;
+        float distance = length(toLight);
+        vec3 L = toLight / distance;
+        float window = clamp(1.0 - pow(distance / positionRange.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 1.0);
+        float cone = smoothstep(colorOuter.w, directionInner.w, dot(-L, directionInner.xyz));
+        lightIntensity += phong(N, L, V, colorOuter.rgb, material) * attenuation * cone;
+    }
+    FragColor = vec4(lightIntensity * albedo.rgb, 1);
+}
@@ -0,0 +1,4 @@
+#version 330
+// A fragment shader for depth-only passes; the depth buffer is written without any color.
+void main() {
+}
@@ -0,0 +1,28 @@
+#version 330
+// A vertex shader for depth-only passes, such as drawing shadow casters into a cascade's depth
+// map: positions only, deformed by a skeleton's bone palette as in skinned_texture_perspective.
+layout (location=0) in vec3 vPosition;
+layout (location=3) in uvec4 vBoneIds;
+layout (location=4) in vec4 vBoneWeights;
+
+uniform mat4 viewProjection;
+uniform mat4 model;
+
+uniform bool skinned;
+uniform samplerBuffer bonePalette;
+uniform int paletteOffset;
+
+mat4 boneMatrix(uint bone) {
+    int base = (paletteOffset + int(bone)) * 4;
+    return mat4(texelFetch(bonePalette, base), texelFetch(bonePalette, base + 1),
+        texelFetch(bonePalette, base + 2), texelFetch(bonePalette, base + 3));
+}
+
+void main() {
+    mat4 skin = mat4(1.0);
+    if (skinned) {
+        skin = vBoneWeights.x * boneMatrix(vBoneIds.x) + vBoneWeights.y * boneMatrix(vBoneIds.y)
+            + vBoneWeights.z * boneMatrix(vBoneIds.z) + vBoneWeights.w * boneMatrix(vBoneIds.w);
+    }
+    gl_Position = viewProjection * model * skin * vec4(vPosition, 1.0);
+}
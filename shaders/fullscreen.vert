@@ -0,0 +1,7 @@
+#version 330
+// A vertex shader for full-screen passes: draws a single triangle covering the whole viewport,
+// from gl_VertexID alone, with no vertex attributes.
+void main() {
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,34 @@
+#version 330
+// A fragment shader for the geometry pass of deferred shading: writes the surface attributes
+// of the fragment to the G-buffer, for deferred_lighting.frag to light. See DeferredRenderer.
+layout (location=0) out vec4 Albedo;
+layout (location=1) out vec2 EncodedNormal;
+layout (location=2) out vec4 Material;
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 FragWorldPos;
+
+// The mesh's base (diffuse) texture.
+uniform sampler2D baseTexture;
+
+// Material parameters for the whole mesh: k_a, k_d, k_s, shininess.
+uniform vec4 material;
+
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Maps a unit vector onto the octahedron |x| + |y| + |z| = 1, folds the lower half over the
+// upper, and flattens it to [0, 1]^2: two channels, with error spread evenly over the sphere.
+vec2 octahedralEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return folded * 0.5 + 0.5;
+}
+
+void main() {
+    Albedo = vec4(texture(baseTexture, TexCoord).rgb, material.x);
+    EncodedNormal = octahedralEncode(normalize(Normal));
+    Material = vec4(material.y, material.z, material.w / 255.0, 0.0);
+}
@@ -0,0 +1,46 @@
+#version 330
+// A vertex shader for rendering vertices with normal vectors and texture coordinates,
+// which may be deformed by a skeleton's bone palette, and creates outputs needed for a
+// Phong reflection fragment shader.
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+layout (location=2) in vec2 vTexCoord;
+layout (location=3) in uvec4 vBoneIds;
+layout (location=4) in vec4 vBoneWeights;
+
+// Positions must match the depth pre-pass, which reuses this shader, exactly; see DepthPrepass.
+invariant gl_Position;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+// Skinning: see skinned_texture_perspective.vert.
+uniform bool skinned;
+uniform samplerBuffer bonePalette;
+uniform int paletteOffset;
+
+out vec2 TexCoord;
+out vec3 Normal;
+out vec3 FragWorldPos;
+
+mat4 boneMatrix(uint bone) {
+    int base = (paletteOffset + int(bone)) * 4;
+    return mat4(texelFetch(bonePalette, base), texelFetch(bonePalette, base + 1),
+        texelFetch(bonePalette, base + 2), texelFetch(bonePalette, base + 3));
+}
+
+void main() {
+    mat4 skin = mat4(1.0);
+    if (skinned) {
+        skin = vBoneWeights.x * boneMatrix(vBoneIds.x) + vBoneWeights.y * boneMatrix(vBoneIds.y)
+            + vBoneWeights.z * boneMatrix(vBoneIds.z) + vBoneWeights.w * boneMatrix(vBoneIds.w);
+    }
+    mat4 skinnedModel = model * skin;
+
+    // Transform the position to clip space.
+    gl_Position = projection * view * skinnedModel * vec4(vPosition, 1.0);
+    TexCoord = vTexCoord;
+    Normal = mat3(transpose(inverse(skinnedModel))) * vNormal;
+    FragWorldPos = vec3(skinnedModel * vec4(vPosition, 1.0));
+}
@@ -0,0 +1,48 @@
+#version 330
+// A vertex shader for perspective viewing of a mesh with normal vectors and texture coordinates,
+// which may be deformed by a skeleton's bone palette.
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+layout (location=2) in vec2 vTexCoord;
+layout (location=3) in uvec4 vBoneIds;
+layout (location=4) in vec4 vBoneWeights;
+
+// Positions must match the depth pre-pass, which reuses this shader, exactly; see DepthPrepass.
+invariant gl_Position;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+// Skinning: when "skinned" is set, the mesh's bone matrices start at "paletteOffset" in the
+// palette buffer, where each matrix is 4 consecutive RGBA32F texels (one per column).
+uniform bool skinned;
+uniform samplerBuffer bonePalette;
+uniform int paletteOffset;
+
+out vec2 TexCoord;
+out vec3 Normal;
+
+mat4 boneMatrix(uint bone) {
+    int base = (paletteOffset + int(bone)) * 4;
+    return mat4(texelFetch(bonePalette, base), texelFetch(bonePalette, base + 1),
+        texelFetch(bonePalette, base + 2), texelFetch(bonePalette, base + 3));
+}
+
+void main() {
+    // Blend the bone matrices influencing this vertex.
+    mat4 skin = mat4(1.0);
+    if (skinned) {
+        skin = vBoneWeights.x * boneMatrix(vBoneIds.x) + vBoneWeights.y * boneMatrix(vBoneIds.y)
+            + vBoneWeights.z * boneMatrix(vBoneIds.z) + vBoneWeights.w * boneMatrix(vBoneIds.w);
+    }
+    mat4 skinnedModel = model * skin;
+
+    // Transform the position to clip space.
+    gl_Position = projection * view * skinnedModel * vec4(vPosition, 1.0);
+    TexCoord = vTexCoord;
+
+    // Transform the vertex normal to world space using the normal matrix.
+    mat4 normalMatrix = transpose(inverse(skinnedModel));
+    Normal = mat3(normalMatrix) * vNormal;
+}
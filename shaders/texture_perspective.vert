@@ -4,6 +4,9 @@ layout (location=0) in vec3 vPosition;
 layout (location=1) in vec3 vNormal;
 layout (location=2) in vec2 vTexCoord;
 
+// Positions must match the depth pre-pass, which reuses this shader, exactly; see DepthPrepass.
+invariant gl_Position;
+
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
@@ -0,0 +1,291 @@
+/**
+Checks the import code on small fixtures built in memory or written to the temporary
+directory: weldVertices on one thread and on a pool, the kept vertices, remapped indices and
+compacted bone influences; the native OBJ loader's quads and negative indices; and the native
+glTF loader's data-URI and GLB buffers, uploaded as stored and converted, and read back from
+the GPU. Prints each check's result; exits with 1 if any failed. The benchmarks only time these
+paths, and rely on this.
+
+Usage: ImportTests
+The glTF checks need a headless GL context, as the benchmarks do.
+*/
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../GltfImport.h"
+#include "../HeadlessContext.h"
+#include "../ObjImport.h"
+#include "../VertexWeld.h"
+
+/**
+ * @brief Whether two vertices' attributes are within the weld tolerances of each other.
+ */
+bool sameWithin(const Vertex3D& a, const Vertex3D& b, const WeldSettings& settings) {
+	auto near = [](float_t x, float_t y, float_t tolerance) { return std::abs(x - y) <= tolerance; };
+	return near(a.x, b.x, settings.positionTolerance) && near(a.y, b.y, settings.positionTolerance)
+		&& near(a.z, b.z, settings.positionTolerance) && near(a.nx, b.nx, settings.normalTolerance)
+		&& near(a.ny, b.ny, settings.normalTolerance) && near(a.nz, b.nz, settings.normalTolerance)
+		&& near(a.u, b.u, settings.uvTolerance) && near(a.v, b.v, settings.uvTolerance);
+}
+
+/**
+ * @brief Welds nine vertices in three triangles: exact copies and copies within the position
+ * tolerance merge, while a different normal, texture coordinate or bone influence keeps a
+ * vertex apart.
+ */
+bool weldKeepsDistinctVertices(WorkerPool* pool, FrameArena& scratch) {
+	std::vector<Vertex3D> vertices = {
+		{ 0, 0, 0, 0, 0, 1, 0, 0 }, { 1, 0, 0, 0, 0, 1, 1, 0 }, { 0, 1, 0, 0, 0, 1, 0, 1 },
+		{ 0, 0, 0, 0, 0, 1, 0, 0 }, { 1 + 2e-7f, 0, 0, 0, 0, 1, 1, 0 }, { 0, 1, 0, 0, 1, 0, 0, 1 },
+		{ 0, 0, 0, 0, 0, 1, 0.5f, 0 }, { 0, 1, 0, 0, 0, 1, 0, 1 }, { 0, 0, 0, 0, 0, 1, 0, 0 },
+	};
+	std::vector<uint32_t> indices = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+	std::vector<VertexBoneData> influences(vertices.size());
+	for (size_t i = 0; i < influences.size(); i++) {
+		influences[i].add(i == 7 ? 2 : 1, 1);
+	}
+	// Small meshes are welded on one thread even with a pool; these must not be.
+	WeldSettings settings;
+	settings.parallelThreshold = 0;
+	size_t kept = weldVertices(vertices.data(), vertices.size(), indices.data(), indices.size(), settings,
+		scratch, pool, influences.data());
+	scratch.reset();
+
+	const std::vector<uint32_t> expectedIndices = { 0, 1, 2, 0, 1, 3, 4, 5, 0 };
+	const uint32_t expectedBones[6] = { 1, 1, 1, 1, 1, 2 };
+	bool correct = kept == 6 && indices == expectedIndices && vertices[3].ny == 1 && vertices[4].u == 0.5f;
+	for (size_t i = 0; correct && i < kept; i++) {
+		correct = influences[i].ids[0] == expectedBones[i] && influences[i].weights[0] == 1;
+	}
+	return correct;
+}
+
+/**
+ * @brief Welds a grid of quads stored as separate triangles, so each inner corner appears six
+ * times: one vertex per corner must remain, and every index must still refer to a vertex within
+ * the tolerances of the one it referred to before.
+ */
+bool weldRemapsGrid(WorkerPool* pool, FrameArena& scratch) {
+	const uint32_t size = 64;
+	std::vector<Vertex3D> original;
+	auto corner = [&original](uint32_t x, uint32_t y) {
+		original.emplace_back(static_cast<float_t>(x), static_cast<float_t>(y), 0.0f, 0.0f, 0.0f, 1.0f,
+			static_cast<float_t>(x) / size, static_cast<float_t>(y) / size);
+	};
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			corner(x, y); corner(x + 1, y); corner(x + 1, y + 1);
+			corner(x, y); corner(x + 1, y + 1); corner(x, y + 1);
+		}
+	}
+	std::vector<uint32_t> indices(original.size());
+	for (uint32_t i = 0; i < indices.size(); i++) {
+		indices[i] = i;
+	}
+	std::vector<Vertex3D> vertices = original;
+	WeldSettings settings;
+	settings.parallelThreshold = 0;
+	size_t kept = weldVertices(vertices.data(), vertices.size(), indices.data(), indices.size(), settings,
+		scratch, pool);
+	scratch.reset();
+
+	bool correct = kept == (size + 1) * (size + 1);
+	for (size_t i = 0; correct && i < indices.size(); i++) {
+		correct = indices[i] < kept && sameWithin(vertices[indices[i]], original[i], settings);
+	}
+	return correct;
+}
+
+/**
+ * @brief Writes a fixture to the temporary directory, and returns its path.
+ */
+std::filesystem::path writeFixture(const std::string& name, const std::string& contents) {
+	auto path = std::filesystem::temp_directory_path() / name;
+	std::ofstream file(path, std::ios::binary);
+	file << contents;
+	return path;
+}
+
+/**
+ * @brief Reads an OBJ file with a quad, fanned into two triangles, whose indices all count
+ * back from the end, and a triangle mixing positive and negative indices, with normals but no
+ * texture coordinates; and checks every corner.
+ */
+bool objReadsQuadsAndNegativeIndices() {
+	auto path = writeFixture("ImportTestsQuad.obj",
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+		"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 0 1\n"
+		"f -4/-4/-1 -3/-3/-1 -2/-2/-1 -1/-1/-1\n"
+		"v 0 0 1\n"
+		"f 1//1 2//1 -1//1\n");
+	// Each corner's position and texture coordinate, as x, y, z, u, v.
+	const float_t expected[9][5] = {
+		{ 0, 0, 0, 0, 0 }, { 1, 0, 0, 1, 0 }, { 1, 1, 0, 1, 1 },
+		{ 0, 0, 0, 0, 0 }, { 1, 1, 0, 1, 1 }, { 0, 1, 0, 0, 1 },
+		{ 0, 0, 0, 0, 0 }, { 1, 0, 0, 0, 0 }, { 0, 0, 1, 0, 0 },
+	};
+	ImportSettings settings;
+	ImportStaging staging(settings);
+	bool correct = false;
+	try {
+		ObjGeometry geometry = readObj(path, staging);
+		correct = geometry.meshes.size() == 1 && geometry.meshes[0].indexCount == 9
+			&& geometry.meshes[0].vertexCount == 7;
+		for (size_t i = 0; correct && i < 9; i++) {
+			const ObjMesh& mesh = geometry.meshes[0];
+			const Vertex3D& v = mesh.vertices[mesh.indices[i]];
+			correct = v.x == expected[i][0] && v.y == expected[i][1] && v.z == expected[i][2]
+				&& v.u == expected[i][3] && v.v == expected[i][4] && v.nz == 1;
+		}
+	}
+	catch (std::runtime_error& e) {
+		std::cout << path.filename().string() << ": " << e.what() << std::endl;
+	}
+	std::filesystem::remove(path);
+	return correct;
+}
+
+// The glTF fixture's triangle, as glTF stores it: positions, normals and texture coordinates,
+// each an accessor over its own range of one buffer, then 16-bit indices.
+const float_t GLTF_POSITIONS[9] = { 0, 0, 0, 1, 0, 0, 0, 1, 0 };
+const float_t GLTF_NORMALS[9] = { 0, 0, 1, 0, 0, 1, 0, 0, 1 };
+const float_t GLTF_UVS[6] = { 0, 0, 1, 0, 0, 1 };
+const uint16_t GLTF_INDICES[3] = { 0, 1, 2 };
+
+std::string gltfBuffer() {
+	std::string buffer;
+	buffer.append(reinterpret_cast<const char*>(GLTF_POSITIONS), sizeof(GLTF_POSITIONS));
+	buffer.append(reinterpret_cast<const char*>(GLTF_NORMALS), sizeof(GLTF_NORMALS));
+	buffer.append(reinterpret_cast<const char*>(GLTF_UVS), sizeof(GLTF_UVS));
+	buffer.append(reinterpret_cast<const char*>(GLTF_INDICES), sizeof(GLTF_INDICES));
+	return buffer;
+}
+
+std::string base64(const std::string& bytes) {
+	static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string text;
+	for (size_t i = 0; i < bytes.size(); i += 3) {
+		uint32_t group = static_cast<uint32_t>(static_cast<uint8_t>(bytes[i])) << 16;
+		group |= i + 1 < bytes.size() ? static_cast<uint32_t>(static_cast<uint8_t>(bytes[i + 1])) << 8 : 0;
+		group |= i + 2 < bytes.size() ? static_cast<uint8_t>(bytes[i + 2]) : 0;
+		for (size_t d = 0; d < 4; d++) {
+			text += i + d <= bytes.size() ? digits[(group >> (18 - 6 * d)) & 63] : '=';
+		}
+	}
+	return text;
+}
+
+/**
+ * @brief The glTF fixture's JSON, with the given URI for its buffer, or no URI for a GLB's own.
+ */
+std::string gltfJson(size_t bufferBytes, const std::string& uri) {
+	std::string buffer = "{\"byteLength\":" + std::to_string(bufferBytes);
+	if (!uri.empty()) {
+		buffer += ",\"uri\":\"" + uri + "\"";
+	}
+	return "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+		"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}],"
+		"\"buffers\":[" + buffer + "}],"
+		"\"bufferViews\":[{\"buffer\":0,\"byteLength\":36},{\"buffer\":0,\"byteOffset\":36,\"byteLength\":36},"
+		"{\"buffer\":0,\"byteOffset\":72,\"byteLength\":24},{\"buffer\":0,\"byteOffset\":96,\"byteLength\":6}],"
+		"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\",\"min\":[0,0,0],\"max\":[1,1,0]},"
+		"{\"bufferView\":1,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"},"
+		"{\"bufferView\":2,\"componentType\":5126,\"count\":3,\"type\":\"VEC2\"},"
+		"{\"bufferView\":3,\"componentType\":5123,\"count\":3,\"type\":\"SCALAR\"}]}";
+}
+
+/**
+ * @brief The glTF fixture as a GLB file: the JSON chunk, padded with spaces, then the buffer
+ * chunk, padded with zeros.
+ */
+std::string gltfBinary() {
+	std::string buffer = gltfBuffer();
+	std::string json = gltfJson(buffer.size(), "");
+	json.resize((json.size() + 3) / 4 * 4, ' ');
+	buffer.resize((buffer.size() + 3) / 4 * 4, '\0');
+	std::string file;
+	auto word = [&file](uint32_t value) { file.append(reinterpret_cast<const char*>(&value), 4); };
+	// The magic "glTF", version 2, and the whole file's length.
+	word(0x46546C67);
+	word(2);
+	word(static_cast<uint32_t>(12 + 8 + json.size() + 8 + buffer.size()));
+	word(static_cast<uint32_t>(json.size()));
+	word(0x4E4F534A);
+	file += json;
+	word(static_cast<uint32_t>(buffer.size()));
+	word(0x004E4942);
+	file += buffer;
+	return file;
+}
+
+/**
+ * @brief Loads a glTF fixture through the native loader, uploaded as stored or, without
+ * flipTextureCoords, converted, and checks each corner of the triangle read back from the GPU.
+ */
+bool gltfLoadsFixture(const std::filesystem::path& path, bool flip) {
+	ImportSettings settings;
+	settings.flipTextureCoords = flip;
+	std::vector<Vertex3D> vertices;
+	std::vector<uint32_t> indices;
+	try {
+		Object3D object = gltfLoad(path.string(), settings);
+		std::vector<DrawItem> draws;
+		object.collectDraws(glm::mat4(1), draws);
+		if (draws.size() == 1) {
+			draws[0].mesh->readGeometry(vertices, indices);
+		}
+	}
+	catch (std::runtime_error& e) {
+		std::cout << path.filename().string() << ": " << e.what() << std::endl;
+	}
+	bool correct = indices.size() == 3;
+	for (size_t i = 0; correct && i < 3; i++) {
+		const Vertex3D& v = vertices[indices[i]];
+		// glTF's texture origin is the top left; converting moves it to the bottom left.
+		float_t u = GLTF_UVS[i * 2];
+		float_t t = flip ? GLTF_UVS[i * 2 + 1] : 1 - GLTF_UVS[i * 2 + 1];
+		correct = v.x == GLTF_POSITIONS[i * 3] && v.y == GLTF_POSITIONS[i * 3 + 1]
+			&& v.z == GLTF_POSITIONS[i * 3 + 2] && v.nz == 1 && v.u == u && v.v == t;
+	}
+	return correct;
+}
+
+int main() {
+	WorkerPool pool;
+	FrameArena scratch(1 << 20);
+	size_t failed = 0;
+	auto check = [&failed](const std::string& name, bool passed) {
+		std::cout << (passed ? "passed: " : "FAILED: ") << name << std::endl;
+		failed += passed ? 0 : 1;
+	};
+
+	check("weld keeps distinct vertices, 1 thread", weldKeepsDistinctVertices(nullptr, scratch));
+	check("weld keeps distinct vertices, pool", weldKeepsDistinctVertices(&pool, scratch));
+	check("weld remaps a grid, 1 thread", weldRemapsGrid(nullptr, scratch));
+	check("weld remaps a grid, pool", weldRemapsGrid(&pool, scratch));
+	check("OBJ reads quads and negative indices", objReadsQuadsAndNegativeIndices());
+
+	std::string buffer = gltfBuffer();
+	auto dataUri = writeFixture("ImportTestsTriangle.gltf",
+		gltfJson(buffer.size(), "data:application/octet-stream;base64," + base64(buffer)));
+	auto binary = writeFixture("ImportTestsTriangle.glb", gltfBinary());
+	try {
+		HeadlessContext context;
+		check("glTF data URI, as stored", gltfLoadsFixture(dataUri, true));
+		check("glTF data URI, converted", gltfLoadsFixture(dataUri, false));
+		check("GLB, as stored", gltfLoadsFixture(binary, true));
+		check("GLB, converted", gltfLoadsFixture(binary, false));
+	}
+	catch (std::runtime_error& e) {
+		check(std::string("glTF loads, in a GL context: ") + e.what(), false);
+	}
+	std::filesystem::remove(dataUri);
+	std::filesystem::remove(binary);
+
+	std::cout << failed << " checks failed" << std::endl;
+	return failed > 0 ? 1 : 0;
+}